@@ -23,6 +23,9 @@
 #include "FileUtils.h"
 #include "SerializationKeys.h"
 
+#define CONFIG_FILE_MAGIC 0x48434647
+#define CONFIG_MAX_LOGGED_RECORDS 512
+
 String Config::getMachineId()
 {
     const String systemStats =
@@ -41,12 +44,12 @@ bool Config::hasNewMachineId()
 
 void Config::set(const String &keyName, const var &value)
 {
-    App::Helio()->getConfig()->setValue(keyName, value);
+    App::Helio()->getConfig()->setProperty(keyName, value);
 }
 
 void Config::set(const String &keyName, const XmlElement *xml)
 {
-    App::Helio()->getConfig()->setValue(keyName, xml);
+    App::Helio()->getConfig()->setProperty(keyName, xml);
 }
 
 String Config::get(StringRef keyName, const String &defaultReturnValue /*= String::empty*/)
@@ -75,28 +78,154 @@ void Config::load(const String &key, Serializable *serializer)
 }
 
 
+//===----------------------------------------------------------------------===//
+// Records
+//===----------------------------------------------------------------------===//
+
+// FNV-1a, enough to detect a torn write
+static uint32 getChecksum(const void *data, size_t size) noexcept
+{
+    const uint8 *bytes = static_cast<const uint8 *>(data);
+    uint32 hash = 2166136261u;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+static void writeRecord(OutputStream &out, const String &key, const var &value)
+{
+    MemoryOutputStream payload;
+    payload.writeString(key);
+    value.writeToStream(payload);
+
+    out.writeInt(int(payload.getDataSize()));
+    out.writeInt(int(getChecksum(payload.getData(), payload.getDataSize())));
+    out.write(payload.getData(), payload.getDataSize());
+}
+
+// Both the snapshot and the log start with the magic number and the generation;
+// each compaction increments the generation, so that a stale log,
+// left by a crash right after the compaction, can be told apart
+
+// Reads the records up to the end of file, or up to the first torn or corrupted one,
+// which is where the writing has been interrupted.
+// Returns the number of records read, or -1 if there's no valid file
+static int readRecords(const File &file, NamedValueSet &target, int &generation)
+{
+    if (! file.existsAsFile())
+    {
+        return -1;
+    }
+
+    FileInputStream in(file);
+
+    if (in.failedToOpen() || in.readInt() != CONFIG_FILE_MAGIC)
+    {
+        return -1;
+    }
+
+    generation = in.readInt();
+
+    MemoryBlock payload;
+    int numRecords = 0;
+
+    while (! in.isExhausted())
+    {
+        const int size = in.readInt();
+        const uint32 checksum = uint32(in.readInt());
+
+        if (size <= 0 || size > in.getNumBytesRemaining())
+        {
+            break;
+        }
+
+        payload.setSize(size_t(size));
+
+        if (in.read(payload.getData(), size) != size ||
+            getChecksum(payload.getData(), payload.getSize()) != checksum)
+        {
+            break;
+        }
+
+        MemoryInputStream record(payload, false);
+        const String key(record.readString());
+        const var value(var::readFromStream(record));
+
+        if (key.isNotEmpty())
+        {
+            target.set(key, value);
+        }
+
+        ++numRecords;
+    }
+
+    return numRecords;
+}
+
+static bool loadLegacyConfig(const File &file, NamedValueSet &target)
+{
+    ScopedPointer<XmlElement> doc(DataEncoder::loadObfuscated(file));
+
+    if (doc == nullptr || ! doc->hasTagName(Serialization::Core::globalConfig))
+    {
+        return false;
+    }
+
+    forEachXmlChildElementWithTagName(*doc, e, Serialization::Core::valueTag)
+    {
+        const String name(e->getStringAttribute(Serialization::Core::nameAttribute));
+
+        if (name.isNotEmpty())
+        {
+            target.set(name,
+                       var(e->getFirstChildElement() != nullptr
+                           ? e->getFirstChildElement()->createDocument(String::empty, true)
+                           : e->getStringAttribute(Serialization::Core::valueAttribute)));
+        }
+    }
+
+    return true;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Config
+//===----------------------------------------------------------------------===//
 
 Config::Config(const int millisecondsBeforeSaving) :
+    Thread("Config"),
     fileLock("Config Lock"),
-    needsWriting(false),
+    numPendingRecords(0),
+    numLoggedRecords(0),
+    generation(0),
     saveTimeout(millisecondsBeforeSaving)
 {
     // Deal with legacy settings file
     auto legacySettingsFile(FileUtils::getConfigSlot("helio.settings"));
-    auto newSettingsFile(FileUtils::getConfigSlot("settings.helio"));
+    auto xmlSettingsFile(FileUtils::getConfigSlot("settings.helio"));
 
     if (legacySettingsFile.existsAsFile())
     {
-        legacySettingsFile.moveFileTo(newSettingsFile);
+        legacySettingsFile.moveFileTo(xmlSettingsFile);
     }
 
-    this->propertiesFile = newSettingsFile;
+    this->legacyFile = xmlSettingsFile;
+    this->snapshotFile = FileUtils::getConfigSlot("settings.bin");
+    this->logFile = FileUtils::getConfigSlot("settings.log");
     this->reload();
+
+    this->startThread(3);
 }
 
 Config::~Config()
 {
-    this->setValue(Serialization::Core::machineID, this->getMachineId());
+    this->setProperty(Serialization::Core::machineID, this->getMachineId());
+    this->stopTimer();
+    this->stopThread(1000);
     this->saveIfNeeded();
 }
 
@@ -108,103 +237,240 @@ bool Config::machineIdChanged()
     return (storedID != currentID);
 }
 
-bool Config::saveIfNeeded()
+void Config::setProperty(const String &keyName, const var &value)
 {
-    if (this->propertiesFile.getFullPathName().isEmpty())
+    const ScopedLock lock(this->logLock);
+
+    if (const var *existingValue = this->typedProperties.getVarPointer(keyName))
     {
-        return false;
+        if (existingValue->equalsWithSameType(value))
+        {
+            return;
+        }
     }
 
-    Logger::writeToLog("Config::saveIfNeeded - " + this->propertiesFile.getFullPathName());
+    {
+        MemoryOutputStream out(this->pendingRecords, true);
+        writeRecord(out, keyName, value);
+        this->numPendingRecords++;
+    }
+
+    this->typedProperties.set(keyName, value);
+    this->setValue(keyName, value);
+}
 
-    XmlElement doc(Serialization::Core::globalConfig);
+void Config::setProperty(const String &keyName, const XmlElement *xml)
+{
+    this->setProperty(keyName, (xml == nullptr) ? var() :
+        var(xml->createDocument(String::empty, true)));
+}
 
-    for (int i = 0; i < getAllProperties().size(); ++i)
+bool Config::saveIfNeeded()
+{
+    jassert(! this->isThreadRunning());
+    return this->writePendingRecords();
+}
+
+bool Config::reload()
+{
+    InterProcessLock::ScopedLockType fLock(this->fileLock);
+
+    NamedValueSet properties;
+    const int numSnapshotRecords = readRecords(this->snapshotFile, properties, this->generation);
+
+    if (numSnapshotRecords < 0 && this->legacyFile.existsAsFile())
     {
-        XmlElement *const e = doc.createNewChildElement(Serialization::Core::valueTag);
-        e->setAttribute(Serialization::Core::nameAttribute, getAllProperties().getAllKeys() [i]);
+        Logger::writeToLog("Config::reload - migrating " + this->legacyFile.getFullPathName());
+        loadLegacyConfig(this->legacyFile, properties);
+    }
+
+    NamedValueSet loggedProperties;
+    int logGeneration = -1;
+    const int numLogRecords = readRecords(this->logFile, loggedProperties, logGeneration);
 
-        // if the value seems to contain xml, store it as such..
-        if (XmlElement *const childElement = XmlDocument::parse(getAllProperties().getAllValues()[i]))
+    if (numLogRecords > 0 && logGeneration == this->generation)
+    {
+        for (int i = 0; i < loggedProperties.size(); ++i)
         {
-            e->addChildElement(childElement);
+            properties.set(loggedProperties.getName(i), loggedProperties.getValueAt(i));
         }
-        else
+    }
+
+    {
+        const ScopedLock lock(this->logLock);
+        this->typedProperties = properties;
+
+        StringPairArray &strings = this->getAllProperties();
+        strings.clear();
+
+        for (int i = 0; i < properties.size(); ++i)
         {
-            e->setAttribute(Serialization::Core::valueAttribute,
-                            getAllProperties().getAllValues() [i]);
+            strings.set(properties.getName(i).toString(), properties.getValueAt(i).toString());
         }
     }
 
+    // The log may end with a torn record, and nothing should be appended after it,
+    // so the log is always compacted on startup
+    if ((numSnapshotRecords < 0 && properties.size() > 0) || numLogRecords >= 0)
+    {
+        return this->writeSnapshot(properties);
+    }
 
-    InterProcessLock::ScopedLockType fLock(this->fileLock);
+    return (numSnapshotRecords >= 0);
+}
+
+
+//===----------------------------------------------------------------------===//
+// Writer
+//===----------------------------------------------------------------------===//
 
-    if (!fLock.isLocked())
+void Config::run()
+{
+    while (! this->threadShouldExit())
     {
-        Logger::writeToLog("Config !fLock.isLocked()");
-        return false;
+        this->wait(-1);
+        this->writePendingRecords();
+    }
+}
+
+bool Config::writePendingRecords()
+{
+    MemoryBlock records;
+    NamedValueSet snapshot;
+    bool shouldCompact = false;
+    int numRecords = 0;
+
+    {
+        const ScopedLock lock(this->logLock);
+
+        if (this->numPendingRecords == 0)
+        {
+            return true;
+        }
+
+        this->numLoggedRecords += this->numPendingRecords;
+        shouldCompact = (this->numLoggedRecords > CONFIG_MAX_LOGGED_RECORDS);
+
+        if (shouldCompact)
+        {
+            // the snapshot includes all the pending changes
+            snapshot = this->typedProperties;
+        }
+
+        records.swapWith(this->pendingRecords);
+        numRecords = this->numPendingRecords;
+        this->numPendingRecords = 0;
     }
 
-    if (DataEncoder::saveObfuscated(this->propertiesFile, &doc))
+    InterProcessLock::ScopedLockType fLock(this->fileLock);
+
+    const bool succeeded = shouldCompact ?
+        this->writeSnapshot(snapshot) :
+        this->appendToLog(records);
+
+    if (! succeeded)
     {
-        needsWriting = false;
-        return true;
+        this->restorePendingRecords(records, numRecords);
+        return false;
     }
 
-    return false;
+    return true;
 }
 
-bool Config::reload()
+void Config::restorePendingRecords(const MemoryBlock &records, int numRecords)
+{
+    const ScopedLock lock(this->logLock);
+
+    // the records go back in front of the ones added since they were taken,
+    // so that the next write retries them, and the order of the changes is kept
+    MemoryBlock restored(records);
+    restored.append(this->pendingRecords.getData(), this->pendingRecords.getSize());
+    this->pendingRecords.swapWith(restored);
+    this->numPendingRecords += numRecords;
+
+    // the changes are still in properties, next time they will make it to the snapshot
+    this->numLoggedRecords = CONFIG_MAX_LOGGED_RECORDS;
+}
+
+bool Config::appendToLog(const MemoryBlock &records)
 {
-    if (!this->propertiesFile.existsAsFile())
+    const bool needsHeader = (this->logFile.getSize() == 0);
+
+    FileOutputStream out(this->logFile);
+
+    if (out.failedToOpen())
     {
+        Logger::writeToLog("Config::appendToLog failed - " + out.getStatus().getErrorMessage());
         return false;
     }
 
-    Logger::writeToLog("Config::reload - " + this->propertiesFile.getFullPathName());
+    if (needsHeader)
+    {
+        out.writeInt(CONFIG_FILE_MAGIC);
+        out.writeInt(this->generation);
+    }
 
-    InterProcessLock::ScopedLockType fLock(this->fileLock);
+    out.write(records.getData(), records.getSize());
+    out.flush(); // also syncs the file to disk
 
-    //if (!fLock.isLocked()) { return false; }
+    return out.getStatus().wasOk();
+}
 
-    ScopedPointer<XmlElement> doc(DataEncoder::loadObfuscated(this->propertiesFile));
+bool Config::writeSnapshot(const NamedValueSet &properties)
+{
+    TemporaryFile tempFile(this->snapshotFile);
 
-    if (doc != nullptr)
     {
-        if (doc->hasTagName(Serialization::Core::globalConfig))
+        FileOutputStream out(tempFile.getFile());
+
+        if (out.failedToOpen())
         {
-            forEachXmlChildElementWithTagName(*doc, e, Serialization::Core::valueTag)
-            {
-                const String name(e->getStringAttribute(Serialization::Core::nameAttribute));
-
-                if (name.isNotEmpty())
-                {
-                    getAllProperties().set(name,
-                                           e->getFirstChildElement() != nullptr
-                                           ? e->getFirstChildElement()->createDocument(String::empty, true)
-                                           : e->getStringAttribute(Serialization::Core::valueAttribute));
-                }
-            }
+            return false;
+        }
 
-            return true;
+        out.writeInt(CONFIG_FILE_MAGIC);
+        out.writeInt(this->generation + 1);
+
+        for (int i = 0; i < properties.size(); ++i)
+        {
+            writeRecord(out, properties.getName(i).toString(), properties.getValueAt(i));
         }
+
+        // also syncs the file to disk, so the replacement below never exposes a partial snapshot
+        out.flush();
+
+        if (out.getStatus().failed())
+        {
+            return false;
+        }
+    }
+
+    if (! tempFile.overwriteTargetFileWithTemporary())
+    {
+        Logger::writeToLog("Config::writeSnapshot failed - " + this->snapshotFile.getFullPathName());
+        return false;
     }
 
-    return false;
+    // If the log is not removed because of a crash,
+    // it will be ignored on load as the one of the previous generation
+    this->generation++;
+    this->logFile.deleteFile();
+    this->numLoggedRecords = 0;
+    return true;
 }
 
 
 void Config::timerCallback()
 {
-    this->saveIfNeeded();
     this->stopTimer();
+    this->notify();
 }
 
 
 void Config::saveConfig(const String &key, const Serializable *serializer)
 {
     ScopedPointer<XmlElement> serialized(serializer->serialize());
-    this->setValue(key, serialized);
+    this->setProperty(key, serialized);
 }
 
 void Config::loadConfig(const String &key, Serializable *serializer)
@@ -220,14 +486,12 @@ void Config::loadConfig(const String &key, Serializable *serializer)
 
 void Config::propertyChanged()
 {
-    this->needsWriting = true;
-
     if (this->saveTimeout > 0)
     {
         this->startTimer(this->saveTimeout);
     }
     else if (this->saveTimeout == 0)
     {
-        this->saveIfNeeded();
+        this->notify();
     }
 }
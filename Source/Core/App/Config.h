@@ -19,9 +19,21 @@
 
 class Serializable;
 
+// Global settings, stored as a binary key/value snapshot
+// plus an append-only log of the changes made since the snapshot.
+//
+// Changes are serialized on the message thread and appended to the log
+// by a background thread, so that saving never blocks the UI.
+// Once the log gets long enough, the writer compacts it into a new snapshot,
+// which replaces the old one atomically. Each record is checksummed,
+// and the records after a torn or corrupted one are ignored on load.
+//
+// Values are stored as typed vars, xml values are stored as strings.
+
 class Config :
     public PropertySet,
-    private Timer
+    private Timer,
+    private Thread
 {
 public:
 
@@ -56,8 +68,15 @@ public:
 
     void loadConfig(const String &key, Serializable *serializer);
 
+    // All changes should go through this, not PropertySet::setValue,
+    // so that they get to the log
+    void setProperty(const String &keyName, const var &value);
+
+    void setProperty(const String &keyName, const XmlElement *xml);
+
 protected:
 
+    // Synchronously writes the pending changes
     bool saveIfNeeded();
 
     bool reload();
@@ -68,11 +87,38 @@ private:
 
     void timerCallback() override;
 
+    void run() override;
+
+    bool writePendingRecords();
+
+    void restorePendingRecords(const MemoryBlock &records, int numRecords);
+
+    bool appendToLog(const MemoryBlock &records);
+
+    bool writeSnapshot(const NamedValueSet &properties);
+
     InterProcessLock fileLock;
 
-    File propertiesFile;
-    
-    bool needsWriting;
+    File snapshotFile;
+
+    File logFile;
+
+    File legacyFile;
+
+    // Guards the properties' changes and the pending records
+    CriticalSection logLock;
+
+    // The same properties as in PropertySet, but keeping their types,
+    // which is what goes to the snapshot and the log
+    NamedValueSet typedProperties;
+
+    MemoryBlock pendingRecords;
+
+    int numPendingRecords;
+
+    // Only accessed by the writer
+    int numLoggedRecords;
+    int generation;
     
     int saveTimeout;
 
@@ -0,0 +1,125 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "MemoryAccounting.h"
+
+static Atomic<int64> numBytes[MemoryAccounting::numSubsystems];
+static Atomic<int64> numObjects[MemoryAccounting::numSubsystems];
+
+void MemoryAccounting::add(Subsystem subsystem, int64 bytes) noexcept
+{
+#if HELIO_MEMORY_ACCOUNTING
+    numBytes[subsystem] += bytes;
+#endif
+}
+
+void MemoryAccounting::remove(Subsystem subsystem, int64 bytes) noexcept
+{
+#if HELIO_MEMORY_ACCOUNTING
+    numBytes[subsystem] -= bytes;
+#endif
+}
+
+void MemoryAccounting::addObject(Subsystem subsystem, int64 bytes) noexcept
+{
+#if HELIO_MEMORY_ACCOUNTING
+    numBytes[subsystem] += bytes;
+    ++numObjects[subsystem];
+#endif
+}
+
+void MemoryAccounting::removeObject(Subsystem subsystem, int64 bytes) noexcept
+{
+#if HELIO_MEMORY_ACCOUNTING
+    numBytes[subsystem] -= bytes;
+    --numObjects[subsystem];
+#endif
+}
+
+int64 MemoryAccounting::getNumBytes(Subsystem subsystem) noexcept
+{
+    return numBytes[subsystem].get();
+}
+
+int64 MemoryAccounting::getNumObjects(Subsystem subsystem) noexcept
+{
+    return numObjects[subsystem].get();
+}
+
+String MemoryAccounting::getSubsystemName(Subsystem subsystem)
+{
+    switch (subsystem)
+    {
+        case layers: return "layers";
+        case components: return "components";
+        case undo: return "undo";
+        case vcs: return "vcs";
+        case audio: return "audio";
+        case caches: return "caches";
+        default: return String::empty;
+    }
+}
+
+String MemoryAccounting::createReport()
+{
+#if HELIO_MEMORY_ACCOUNTING
+    String report;
+    int64 totalBytes = 0;
+
+    for (int i = 0; i < numSubsystems; ++i)
+    {
+        const Subsystem subsystem = Subsystem(i);
+        totalBytes += getNumBytes(subsystem);
+
+        report << getSubsystemName(subsystem).paddedRight(' ', 12)
+               << File::descriptionOfSizeInBytes(getNumBytes(subsystem)).paddedRight(' ', 12)
+               << String(getNumObjects(subsystem)) << " objects" << newLine;
+    }
+
+    report << "total".paddedRight(' ', 12) << File::descriptionOfSizeInBytes(totalBytes);
+    return report;
+#else
+    return "Memory accounting is disabled in this build";
+#endif
+}
+
+var MemoryAccounting::createJsonReport()
+{
+    DynamicObject::Ptr report(new DynamicObject());
+    report->setProperty("time", Time::getCurrentTime().toISO8601(true));
+    report->setProperty("enabled", bool(HELIO_MEMORY_ACCOUNTING));
+
+    DynamicObject::Ptr subsystems(new DynamicObject());
+
+    for (int i = 0; i < numSubsystems; ++i)
+    {
+        const Subsystem subsystem = Subsystem(i);
+        DynamicObject::Ptr counters(new DynamicObject());
+        counters->setProperty("bytes", getNumBytes(subsystem));
+        counters->setProperty("objects", getNumObjects(subsystem));
+        subsystems->setProperty(getSubsystemName(subsystem), var(counters.get()));
+    }
+
+    report->setProperty("subsystems", var(subsystems.get()));
+    return var(report.get());
+}
+
+bool MemoryAccounting::dumpToJson(const File &file)
+{
+    return file.replaceWithText(JSON::toString(createJsonReport()));
+}
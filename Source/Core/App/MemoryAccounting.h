@@ -0,0 +1,98 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Enabled in debug builds only, like the leak detector
+#ifndef HELIO_MEMORY_ACCOUNTING
+#   if JUCE_DEBUG
+#       define HELIO_MEMORY_ACCOUNTING 1
+#   else
+#       define HELIO_MEMORY_ACCOUNTING 0
+#   endif
+#endif
+
+// Approximate per-subsystem memory counters, shown in the debug memory report.
+//
+// Classes are counted with MEMORY_ACCOUNTED(className, subsystem) put next to their
+// leak detectors: it adds sizeof(className) for each instance, including temporary copies.
+// Big buffers owned by objects (sample data, cached images, undo history, unsaved
+// vcs data) are not seen that way, so their owners report them with add() and remove().
+//
+// All counters are atomic and never allocate, so they can be updated from any thread.
+// When a project is closed, the layers, components and undo counters should get
+// back to where they were before it was opened, otherwise something has leaked.
+
+class MemoryAccounting
+{
+public:
+
+    enum Subsystem
+    {
+        layers = 0,
+        components,
+        undo,
+        vcs,
+        audio,
+        caches,
+        numSubsystems
+    };
+
+    static void add(Subsystem subsystem, int64 numBytes) noexcept;
+    static void remove(Subsystem subsystem, int64 numBytes) noexcept;
+
+    static void addObject(Subsystem subsystem, int64 numBytes) noexcept;
+    static void removeObject(Subsystem subsystem, int64 numBytes) noexcept;
+
+    static int64 getNumBytes(Subsystem subsystem) noexcept;
+    static int64 getNumObjects(Subsystem subsystem) noexcept;
+
+    static String getSubsystemName(Subsystem subsystem);
+
+    // A readable table, one subsystem per line
+    static String createReport();
+
+    static var createJsonReport();
+    static bool dumpToJson(const File &file);
+
+};
+
+template <class OwnerClass, MemoryAccounting::Subsystem subsystem>
+class MemoryAccountedObject
+{
+public:
+
+    MemoryAccountedObject() noexcept
+    { MemoryAccounting::addObject(subsystem, sizeof(OwnerClass)); }
+
+    MemoryAccountedObject(const MemoryAccountedObject &) noexcept
+    { MemoryAccounting::addObject(subsystem, sizeof(OwnerClass)); }
+
+    MemoryAccountedObject &operator= (const MemoryAccountedObject &) noexcept
+    { return *this; }
+
+    ~MemoryAccountedObject() noexcept
+    { MemoryAccounting::removeObject(subsystem, sizeof(OwnerClass)); }
+
+};
+
+#if HELIO_MEMORY_ACCOUNTING
+#   define MEMORY_ACCOUNTED(OwnerClass, subsystem) \
+        MemoryAccountedObject<OwnerClass, MemoryAccounting::subsystem> JUCE_JOIN_MACRO(memoryAccountedObject, __LINE__);
+#else
+#   define MEMORY_ACCOUNTED(OwnerClass, subsystem)
+#endif
@@ -26,6 +26,7 @@
 #include "SettingsTreeItem.h"
 #include "InstrumentsRootTreeItem.h"
 #include "ProjectTreeItem.h"
+#include "MidiFileWriter.h"
 #include "RootTreeItem.h"
 #include "MainLayout.h"
 #include "App.h"
@@ -251,6 +252,41 @@ void Workspace::stopPlaybackForAllProjects()
     }
 }
 
+int Workspace::exportAllProjectsToMidi(const File &targetFolder)
+{
+    if (! targetFolder.isDirectory() && ! targetFolder.createDirectory())
+    {
+        return 0;
+    }
+
+    Array<ProjectTreeItem *> projects = this->getLoadedProjects();
+    OwnedArray<MidiFileWriter::Task> tasks;
+    StringArray usedNames;
+
+    for (auto project : projects)
+    {
+        const String safeName = TreeItem::createSafeName(project->getName());
+        String fileName = safeName;
+
+        // projects with the same name should not overwrite each other's files
+        for (int suffix = 2; usedNames.contains(fileName, true); ++suffix)
+        {
+            fileName = safeName + " (" + String(suffix) + ")";
+        }
+
+        usedNames.add(fileName);
+
+        auto task = new MidiFileWriter::Task();
+        task->layers = project->getLayersList();
+        task->file = targetFolder.getChildFile(fileName + ".mid");
+        tasks.add(task);
+    }
+
+    // the layers must not change while the files are being written
+    this->stopPlaybackForAllProjects();
+    return MidiFileWriter::writeBatch(tasks);
+}
+
 //===----------------------------------------------------------------------===//
 // Save/Load/Init
 //===----------------------------------------------------------------------===//
@@ -61,6 +61,10 @@ public:
     Array<ProjectTreeItem *> getLoadedProjects() const;
     void stopPlaybackForAllProjects();
 
+    // Exports every loaded project into the folder, a midi file per project,
+    // using all cores; returns the number of files written
+    int exportAllProjectsToMidi(const File &targetFolder);
+
     //===------------------------------------------------------------------===//
     // Save/Load
     //===------------------------------------------------------------------===//
@@ -22,9 +22,13 @@
 #include "PluginWindow.h"
 #include "OrchestraPit.h"
 #include "Instrument.h"
+#include "PluginStatesStore.h"
+#include "InstrumentsLoader.h"
+#include "FileUtils.h"
 #include "DataEncoder.h"
 #include "SerializationKeys.h"
 #include "AudioMonitor.h"
+#include "RealtimeChecker.h"
 #include "AudiobusOutput.h"
 
 void AudioCore::initAudioFormats(AudioPluginFormatManager &formatManager)
@@ -41,7 +45,10 @@ AudioCore::AudioCore()
     this->audioMonitor = new AudioMonitor();
     this->deviceManager.addAudioCallback(this->audioMonitor);
 
+    this->pluginStatesStore = new PluginStatesStore(FileUtils::getConfigFolder("PluginStates"));
+
     AudioCore::initAudioFormats(this->formatManager);
+    this->instrumentsLoader = new InstrumentsLoader(this->formatManager, *this->pluginStatesStore);
 
     // requesting 0 inputs and only 2 outputs because of fucking alsa
     this->deviceManager.initialise(0, 2, nullptr, true);
@@ -59,6 +66,8 @@ AudioCore::~AudioCore()
     AudiobusOutput::shutdown();
 #endif
 
+    this->instrumentsLoader = nullptr;
+
     this->deviceManager.removeAudioCallback(this->audioMonitor);
     this->audioMonitor = nullptr;
 
@@ -67,6 +76,10 @@ AudioCore::~AudioCore()
 
     this->deviceManager.closeAudioDevice();
     this->masterReference.clear();
+
+#if HELIO_REALTIME_CHECKS
+    Logger::writeToLog(RealtimeChecker::createReport());
+#endif
 }
 
 void AudioCore::mute()
@@ -109,7 +122,7 @@ AudioMonitor *AudioCore::getMonitor() const noexcept
 Instrument *AudioCore::addInstrument(const PluginDescription &pluginDescription,
                                      const String &name)
 {
-    auto instrument = new Instrument(formatManager, name);
+    auto instrument = new Instrument(this->formatManager, *this->pluginStatesStore, name);
     this->addInstrumentToDevice(instrument);
 
     instrument->initializeFrom(pluginDescription);
@@ -281,11 +294,18 @@ void AudioCore::deserialize(const XmlElement &xml)
         {
             //Logger::writeToLog("--- instrument ---");
             //Logger::writeToLog(instrumentNode->createDocument(""));
-            Instrument *instrument = new Instrument(this->formatManager, "");
+            Instrument *instrument = new Instrument(this->formatManager, *this->pluginStatesStore, "");
             this->addInstrumentToDevice(instrument);
-            instrument->deserialize(*instrumentNode);
+            this->instrumentsLoader->addInstrument(*instrument, *instrumentNode);
             this->instruments.add(instrument);
         }
+
+        // all the states referenced by the loaded workspace are retained by now,
+        // the rest are leftovers of the saves that have been overwritten since
+        this->pluginStatesStore->removeUnusedBlobs();
+
+        // the plugins are loaded in the background, so that projects don't wait for them
+        this->instrumentsLoader->start();
     }
 
 
@@ -307,6 +327,8 @@ void AudioCore::deserialize(const XmlElement &xml)
 
 void AudioCore::reset()
 {
+    this->instrumentsLoader->cancel();
+
     while (this->instruments.size() > 0)
     {
         this->removeInstrument(this->instruments[0]);
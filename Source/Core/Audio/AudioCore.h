@@ -19,6 +19,8 @@
 
 class Instrument;
 class AudioMonitor;
+class PluginStatesStore;
+class InstrumentsLoader;
 
 #include "Serializable.h"
 #include "OrchestraPit.h"
@@ -95,6 +97,10 @@ private:
     void addInstrumentToDevice(Instrument *instrument);
     void removeInstrumentFromDevice(Instrument *instrument);
 
+    // declared before the instruments, which refer to it
+    ScopedPointer<PluginStatesStore> pluginStatesStore;
+    ScopedPointer<InstrumentsLoader> instrumentsLoader;
+
     OwnedArray<Instrument> instruments;
     ScopedPointer<AudioMonitor> audioMonitor;
 
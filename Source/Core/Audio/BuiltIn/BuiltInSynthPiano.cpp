@@ -18,6 +18,7 @@
 #include "Common.h"
 #include "BuiltInSynthPiano.h"
 #include "BinaryData.h"
+#include "MemoryAccounting.h"
 
 #define ATTACK_TIME 0.0
 #define RELEASE_TIME 1.0
@@ -30,7 +31,8 @@
 #endif
 
 
-BuiltInSynthPiano::BuiltInSynthPiano(bool empty /*= false*/)
+BuiltInSynthPiano::BuiltInSynthPiano(bool empty /*= false*/) :
+    samplesDataSize(0)
 {
     if (! empty)
     {
@@ -53,6 +55,7 @@ BuiltInSynthPiano::BuiltInSynthPiano(bool empty /*= false*/)
 BuiltInSynthPiano::~BuiltInSynthPiano()
 {
     this->samples.clear();
+    MemoryAccounting::remove(MemoryAccounting::audio, this->samplesDataSize);
 }
 
 const String BuiltInSynthPiano::getName() const
@@ -91,16 +94,30 @@ void BuiltInSynthPiano::initSampler()
 {
     this->synth.clearSounds();
 
+    // may be called from the audio thread, the counters are fine with that
+    MemoryAccounting::remove(MemoryAccounting::audio, this->samplesDataSize);
+    this->samplesDataSize = 0;
+
     for (auto s : this->samples)
     {
-        this->synth.addSound(new SamplerSound(s->name,
-                                              *s->reader,
-                                              s->midiNotes,
-                                              s->midiNoteForNormalPitch,
-                                              ATTACK_TIME,
-                                              RELEASE_TIME,
-                                              MAX_PLAY_TIME));
+        auto sound = new SamplerSound(s->name,
+                                      *s->reader,
+                                      s->midiNotes,
+                                      s->midiNoteForNormalPitch,
+                                      ATTACK_TIME,
+                                      RELEASE_TIME,
+                                      MAX_PLAY_TIME);
+
+        if (const AudioSampleBuffer *data = sound->getAudioData())
+        {
+            this->samplesDataSize +=
+                int64(data->getNumSamples()) * data->getNumChannels() * sizeof(float);
+        }
+
+        this->synth.addSound(sound);
     }
+
+    MemoryAccounting::add(MemoryAccounting::audio, this->samplesDataSize);
 }
 
 void BuiltInSynthPiano::initSamples()
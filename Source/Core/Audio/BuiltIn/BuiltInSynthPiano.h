@@ -77,6 +77,9 @@ protected:
 
     OwnedArray<GrandSample> samples;
     
+    // decoded samples' size, as reported to MemoryAccounting
+    int64 samplesDataSize;
+    
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BuiltInSynthPiano)
 
 };
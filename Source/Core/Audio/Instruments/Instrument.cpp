@@ -20,23 +20,84 @@
 #include "PluginWindow.h"
 #include "InternalPluginFormat.h"
 #include "PluginSmartDescription.h"
+#include "PluginStatesStore.h"
+#include "InstrumentsLoader.h"
 #include "SerializationKeys.h"
 
 const int Instrument::midiChannelNumber = 0x1000;
 
-Instrument::Instrument(AudioPluginFormatManager &formatManager, String name) :
+// Merges the events from instrument's playback queue
+// into the incoming midi buffer before processing the graph.
+// Both buffers are pre-allocated in prepareToPlay, and the merged one is swapped
+// with the incoming one, so that once the player's buffer has grown as well,
+// no allocations happen in the callback.
+class InstrumentProcessorGraph : public AudioProcessorGraph
+{
+public:
+
+    explicit InstrumentProcessorGraph(MidiEventsQueue &queue) :
+        midiEventsQueue(queue) {}
+
+    void prepareToPlay(double sampleRate, int estimatedSamplesPerBlock) override
+    {
+        AudioProcessorGraph::prepareToPlay(sampleRate, estimatedSamplesPerBlock);
+        this->midiEventsQueue.reset(sampleRate);
+        this->queuedMidi.ensureSize(MIDI_EVENTS_QUEUE_DEFAULT_CAPACITY * MIDI_EVENTS_QUEUE_MAX_MESSAGE_SIZE);
+        this->mergedMidi.ensureSize(MIDI_EVENTS_QUEUE_DEFAULT_CAPACITY * MIDI_EVENTS_QUEUE_MAX_MESSAGE_SIZE);
+    }
+
+    void processBlock(AudioSampleBuffer &buffer, MidiBuffer &midiMessages) override
+    {
+        const int numSamples = buffer.getNumSamples();
+
+        this->queuedMidi.clear();
+        this->midiEventsQueue.removeNextBlockOfMessages(this->queuedMidi, numSamples);
+
+        if (! this->queuedMidi.isEmpty())
+        {
+            this->mergedMidi.clear();
+            this->mergedMidi.addEvents(midiMessages, 0, -1, 0);
+            this->mergedMidi.addEvents(this->queuedMidi, 0, -1, 0);
+            midiMessages.swapWith(this->mergedMidi);
+        }
+
+        AudioProcessorGraph::processBlock(buffer, midiMessages);
+    }
+
+private:
+
+    MidiEventsQueue &midiEventsQueue;
+
+    MidiBuffer queuedMidi;
+    MidiBuffer mergedMidi;
+
+    JUCE_DECLARE_NON_COPYABLE(InstrumentProcessorGraph)
+};
+
+static int getNextInstrumentHandle() noexcept
+{
+    static Atomic<int> lastHandle;
+    return ++lastHandle;
+}
+
+Instrument::Instrument(AudioPluginFormatManager &formatManager,
+                       PluginStatesStore &statesStore, String name) :
     formatManager(formatManager),
+    statesStore(statesStore),
     instrumentName(std::move(name)),
     lastUID(0),
+    handle(getNextInstrumentHandle()),
     instrumentID()
 {
-    this->processorGraph = new AudioProcessorGraph();
+    this->midiEventsQueue.setFallbackCollector(&this->processorPlayer.getMidiMessageCollector());
+    this->processorGraph = new InstrumentProcessorGraph(this->midiEventsQueue);
     this->initializeDefaultNodes();
     this->processorPlayer.setProcessor(this->processorGraph);
 }
 
 Instrument::~Instrument()
 {
+    this->loader = nullptr;
     this->masterReference.clear();
     this->processorPlayer.setProcessor(nullptr);
     
@@ -61,13 +122,21 @@ String Instrument::getInstrumentID() const
     return this->instrumentID.toString();
 }
 
+int Instrument::getHandle() const noexcept
+{
+    return this->handle;
+}
+
 String Instrument::getInstrumentHash() const
 {
     // для одного и того же инструмента на разных платформах этот хэш будет одинаковым
     // но если создать два инструмента с одним и тем же плагином - хэш тоже будет одинаковым
     // поэтому в слое мы храним id и хэш
     
-    //const double t1 = Time::getMillisecondCounterHiRes();
+    if (this->instrumentHash.isNotEmpty())
+    {
+        return this->instrumentHash;
+    }
     
     String iID;
     const int numNodes = this->processorGraph->getNumNodes();
@@ -78,12 +147,16 @@ String Instrument::getInstrumentHash() const
         iID += nodeHash;
     }
     
-    const String &hash = MD5(iID.toUTF8()).toHexString();
-    
-    //const double t2 = Time::getMillisecondCounterHiRes();
-    //Logger::writeToLog(String(t2 - t1));
-    
-    return hash;
+    this->instrumentHash = MD5(iID.toUTF8()).toHexString();
+    return this->instrumentHash;
+}
+
+void Instrument::invalidateInstrumentHash()
+{
+    this->instrumentHash = String::empty;
+
+    // lets the transport re-link the layers by the new hash
+    this->sendChangeMessage();
 }
 
 String Instrument::getIdAndHash() const
@@ -203,6 +276,7 @@ AudioProcessorGraph::Node *Instrument::addNode(Instrument *instrument, double x,
     
     if (node != nullptr)
     {
+        this->invalidateInstrumentHash();
         node->properties.set("x", x);
         node->properties.set("y", y);
         this->sendChangeMessage();
@@ -215,6 +289,7 @@ void Instrument::removeNode(const uint32 id)
 {
     PluginWindow::closeCurrentlyOpenWindowsFor(id);
     this->processorGraph->removeNode(id);
+    this->invalidateInstrumentHash();
     this->sendChangeMessage();
 }
 
@@ -352,6 +427,7 @@ void Instrument::reset()
 {
     PluginWindow::closeAllCurrentlyOpenWindows();
     this->processorGraph->clear();
+    this->invalidateInstrumentHash();
     this->sendChangeMessage();
 }
 
@@ -391,68 +467,11 @@ XmlElement *Instrument::serialize() const
 
 void Instrument::deserialize(const XmlElement &xml)
 {
-    this->reset();
-
-    const XmlElement *mainSlot = (xml.getTagName() == Serialization::Core::instrument) ?
-                                 &xml : xml.getChildByName(Serialization::Core::instrument);
-
-    if (mainSlot == nullptr)
-    { return; }
-
-    this->instrumentID = mainSlot->getStringAttribute(Serialization::Core::instrumentId, this->instrumentID.toString());
-    this->instrumentName = mainSlot->getStringAttribute(Serialization::Core::instrumentName, this->instrumentName);
-
-    // Well this hack of an incredible ugliness
-    // is here to handle loading of async-loaded AUv3 plugins
-    
-    // Fill up the connections info for further processing
-    struct ConnectionDescription
-    {
-        uint32 srcFilter;
-        uint32 dstFilter;
-        int srcChannel;
-        int dstChannel;
-    };
-    
-    Array<ConnectionDescription> connectionDescriptions;
-    
-    forEachXmlChildElementWithTagName(*mainSlot, e, Serialization::Core::instrumentConnection)
-    {
-        connectionDescriptions.add({
-            static_cast<uint32>(e->getIntAttribute("srcFilter")),
-            static_cast<uint32>(e->getIntAttribute("dstFilter")),
-            e->getIntAttribute("srcChannel"),
-            e->getIntAttribute("dstChannel")
-        });
-    }
-    
-    forEachXmlChildElementWithTagName(*mainSlot, e, Serialization::Core::instrumentNode)
-    {
-        this->createNodeFromXmlAsync(*e, [this, connectionDescriptions](AudioProcessorGraph::Node *)
-                                     {
-                                         // Try to create as many connections as possible
-                                         for (const auto &connectionInfo : connectionDescriptions)
-                                         {
-                                             this->addConnection(connectionInfo.srcFilter, connectionInfo.srcChannel,
-                                                                 connectionInfo.dstFilter, connectionInfo.dstChannel);
-                                         }
-                                         
-                                         this->processorGraph->removeIllegalConnections();
-                                         this->sendChangeMessage();
-                                     });
-    }
-
-//    forEachXmlChildElementWithTagName(*mainSlot, e, Serialization::Core::instrumentConnection)
-//    {
-//        this->addConnection(static_cast<uint32>( e->getIntAttribute("srcFilter")),
-//                            e->getIntAttribute("srcChannel"),
-//                            static_cast<uint32>( e->getIntAttribute("dstFilter")),
-//                            e->getIntAttribute("dstChannel"));
-//    }
-//
-//    this->processorGraph->removeIllegalConnections();
-//
-//    this->sendChangeMessage();
+    // the node xml has a single reader, which is the loader used for the whole workspace;
+    // here it loads just this instrument, in the background as well
+    this->loader = new InstrumentsLoader(this->formatManager, this->statesStore);
+    this->loader->addInstrument(*this, xml);
+    this->loader->start();
 }
 
 XmlElement *Instrument::createNodeXml(AudioProcessorGraph::Node *const node) const
@@ -476,7 +495,20 @@ XmlElement *Instrument::createNodeXml(AudioProcessorGraph::Node *const node) con
 
         MemoryBlock m;
         node->getProcessor()->getStateInformation(m);
-        state->addTextElement(m.toBase64Encoding());
+
+        // big states go to the blob store, which skips writing the unchanged ones
+        const String blobHash = (m.getSize() >= PLUGIN_STATES_STORE_MIN_BLOB_SIZE) ?
+            this->statesStore.store(m) : String::empty;
+
+        if (blobHash.isNotEmpty())
+        {
+            state->setAttribute(Serialization::Core::pluginStateBlob, blobHash);
+        }
+        else
+        {
+            state->addTextElement(m.toBase64Encoding());
+        }
+
         e->addChildElement(state);
 
         return e;
@@ -485,106 +517,24 @@ XmlElement *Instrument::createNodeXml(AudioProcessorGraph::Node *const node) con
     return nullptr;
 }
 
-void Instrument::createNodeFromXmlAsync(const XmlElement &xml,
-                                        std::function<void (AudioProcessorGraph::Node *)> f)
+AudioProcessorGraph::Node *Instrument::restoreNode(AudioPluginInstance *instance, uint32 nodeUid,
+                                                   const String &nodeHash, double x, double y,
+                                                   double lastX, double lastY)
 {
-    PluginSmartDescription pd;
-    
-    forEachXmlChildElement(xml, e)
-    {
-        if (pd.loadFromXml(*e))
-        { break; }
-    }
-    
-    MemoryBlock nodeStateBlock;
-    const XmlElement *const state = xml.getChildByName(Serialization::Core::pluginState);
-    if (state != nullptr)
-    {
-        nodeStateBlock.fromBase64Encoding(state->getAllSubText());
-    }
-    
-    const uint32 nodeUid = xml.getIntAttribute("uid");
-    const String nodeHash = xml.getStringAttribute("hash");
-    const double nodeX = xml.getDoubleAttribute("x");
-    const double nodeY = xml.getDoubleAttribute("y");
-    const double nodeLastX = xml.getDoubleAttribute("uiLastX");
-    const double nodeLastY = xml.getDoubleAttribute("uiLastY");
-    
-    formatManager.
-    createPluginInstanceAsync(pd,
-                              this->processorGraph->getSampleRate(),
-                              this->processorGraph->getBlockSize(),
-                              [this, nodeStateBlock, nodeUid, nodeHash, nodeX, nodeY, nodeLastX, nodeLastY, f]
-                              (AudioPluginInstance *instance, const String &error)
-                              {
-                                  if (instance == nullptr)
-                                  {
-                                      f(nullptr);
-                                      return;
-                                  }
-                                  
-                                  AudioProcessorGraph::Node::Ptr node(this->processorGraph->addNode(instance, nodeUid));
-                                  
-                                  if (nodeStateBlock.getSize() > 0)
-                                  {
-                                      node->getProcessor()->
-                                      setStateInformation(nodeStateBlock.getData(),
-                                                          static_cast<int>(nodeStateBlock.getSize()));
-                                  }
-                                  
-                                  Uuid fallbackRandomHash;
-                                  node->properties.set("x", nodeX);
-                                  node->properties.set("y", nodeY);
-                                  node->properties.set("hash", nodeHash.isNotEmpty() ? nodeHash : fallbackRandomHash.toString());
-                                  node->properties.set("uiLastX", nodeLastX);
-                                  node->properties.set("uiLastY", nodeLastY);
-                                  
-                                  f(node);
-                              });
-}
+    AudioProcessorGraph::Node *node = this->processorGraph->addNode(instance, nodeUid);
 
-void Instrument::createNodeFromXml(const XmlElement &xml)
-{
-    PluginSmartDescription pd;
+    if (node == nullptr)
+    { return nullptr; }
 
-    forEachXmlChildElement(xml, e)
-    {
-        if (pd.loadFromXml(*e))
-        { break; }
-    }
-    
-    String errorMessage;
-
-    AudioPluginInstance *instance =
-        formatManager.createPluginInstance(pd,
-                                           this->processorGraph->getSampleRate(),
-                                           this->processorGraph->getBlockSize(),
-                                           errorMessage);
-
-    if (instance == nullptr)
-    {
-        return;
-    }
-
-    AudioProcessorGraph::Node::Ptr node(this->processorGraph->addNode(instance, xml.getIntAttribute("uid")));
-
-    const XmlElement *const state = xml.getChildByName(Serialization::Core::pluginState);
-
-    if (state != nullptr)
-    {
-        MemoryBlock m;
-        m.fromBase64Encoding(state->getAllSubText());
-        node->getProcessor()->setStateInformation(m.getData(), static_cast<int>( m.getSize()));
-    }
-
-    const String& hash = xml.getStringAttribute("hash");
     Uuid fallbackRandomHash;
-    
-    node->properties.set("x", xml.getDoubleAttribute("x"));
-    node->properties.set("y", xml.getDoubleAttribute("y"));
-    node->properties.set("hash", hash.isNotEmpty() ? hash : fallbackRandomHash.toString());
-    node->properties.set("uiLastX", xml.getIntAttribute("uiLastX"));
-    node->properties.set("uiLastY", xml.getIntAttribute("uiLastY"));
+    node->properties.set("x", x);
+    node->properties.set("y", y);
+    node->properties.set("hash", nodeHash.isNotEmpty() ? nodeHash : fallbackRandomHash.toString());
+    node->properties.set("uiLastX", lastX);
+    node->properties.set("uiLastY", lastY);
+    this->invalidateInstrumentHash();
+
+    return node;
 }
 
 void Instrument::initializeDefaultNodes()
@@ -641,6 +591,7 @@ void Instrument::configureNode(AudioProcessorGraph::Node *node, const PluginDesc
     node->properties.set("hash", nodeHash);
     node->properties.set("x", x);
     node->properties.set("y", y);
+    this->invalidateInstrumentHash();
 }
 
 
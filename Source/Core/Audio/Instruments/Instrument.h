@@ -20,8 +20,13 @@
 class AudioCore;
 class FilterInGraph;
 class Instrument;
+class PluginStatesStore;
+class InstrumentsLoader;
 
 #include "Serializable.h"
+#include "MidiEventsQueue.h"
+#include "MemoryAccounting.h"
+#include "RealtimeChecker.h"
 
 class Instrument :
     public Serializable,
@@ -29,7 +34,8 @@ class Instrument :
 {
 public:
 
-    Instrument(AudioPluginFormatManager &formatManager, String name);
+    Instrument(AudioPluginFormatManager &formatManager,
+               PluginStatesStore &statesStore, String name);
 
     ~Instrument() override;
 
@@ -38,6 +44,10 @@ public:
     void setName(const String &name);
 
     String getIdAndHash() const; // эта строчка назначается слоям
+
+    // A unique number, valid for this session only,
+    // so that the transport can refer to instruments without keeping pointers
+    int getHandle() const noexcept;
     
     
     void initializeFrom(const PluginDescription &pluginDescription);
@@ -51,6 +61,11 @@ public:
     AudioProcessorGraph *getProcessorGraph() noexcept
     { return this->processorGraph; }
 
+    // playback events go here instead of the player's MidiMessageCollector,
+    // this queue is drained by the graph in the audio callback without locking
+    MidiEventsQueue &getMidiEventsQueue() noexcept
+    { return this->midiEventsQueue; }
+
 
 
 
@@ -155,6 +170,9 @@ private:
     String getInstrumentID() const; // будет разным для всех на разных платформах
     
     String getInstrumentHash() const; // будет один для одинаковых инструментов на разных платформах
+
+    // Called whenever nodes are added or removed
+    void invalidateInstrumentHash();
     
     AudioProcessorGraph::Node *addDefaultNode(const PluginDescription &, double x, double y);
 
@@ -163,26 +181,42 @@ private:
     friend class Transport;
 
     friend class AudioCore;
+
+    friend class InstrumentsLoader;
     
 private:
 
     AudioPluginFormatManager &formatManager;
 
-    AudioProcessorPlayer processorPlayer;
+    PluginStatesStore &statesStore;
+
+    RealtimeCheckedCallback<AudioProcessorPlayer> processorPlayer;
 
     ScopedPointer<AudioProcessorGraph> processorGraph;
 
+    MidiEventsQueue midiEventsQueue;
+
 
     uint32 lastUID;
 
+    const int handle;
+
+    // Computed on demand, empty if outdated
+    mutable String instrumentHash;
+
     uint32 getNextUID() noexcept;
 
     XmlElement *createNodeXml(AudioProcessorGraph::Node *const node) const;
-    
-    void createNodeFromXml(const XmlElement &xml);
 
-    void createNodeFromXmlAsync(const XmlElement &xml,
-                                std::function<void (AudioProcessorGraph::Node *)> f);
+    // Only used when the instrument is deserialized on its own,
+    // otherwise the workspace's loader restores it along with the others
+    ScopedPointer<InstrumentsLoader> loader;
+
+    // adds the deserialized plugin to the graph under its saved id,
+    // and restores node's properties (not the plugin state)
+    AudioProcessorGraph::Node *restoreNode(AudioPluginInstance *instance, uint32 nodeUid,
+                                           const String &nodeHash, double x, double y,
+                                           double lastX, double lastY);
 
 private:
 
@@ -190,6 +224,7 @@ private:
 
     friend class WeakReference<Instrument>;
 
+    MEMORY_ACCOUNTED(Instrument, audio);
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Instrument);
 
 };
@@ -0,0 +1,482 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "InstrumentsLoader.h"
+#include "Instrument.h"
+#include "PluginStatesStore.h"
+#include "PluginSmartDescription.h"
+#include "SerializationKeys.h"
+
+static const int kWarmUpChunkSize = 64 * 1024;
+
+static double getMilliseconds()
+{
+    return Time::getMillisecondCounterHiRes();
+}
+
+// Reads the file through, so that it gets into the OS file cache
+static void warmUpFile(const File &file, ThreadPoolJob &job)
+{
+    FileInputStream in(file);
+
+    if (in.failedToOpen())
+    { return; }
+
+    HeapBlock<char> buffer(kWarmUpChunkSize);
+
+    while (!in.isExhausted() && !job.shouldExit())
+    {
+        if (in.read(buffer, kWarmUpChunkSize) <= 0)
+        { break; }
+    }
+}
+
+class InstrumentsLoader::PrepareNodeJob : public ThreadPoolJob
+{
+public:
+
+    PrepareNodeJob(InstrumentsLoader &loaderRef, NodePlan &nodeRef) :
+        ThreadPoolJob("Prepare " + nodeRef.description.name),
+        loader(loaderRef),
+        node(nodeRef) {}
+
+    JobStatus runJob() override
+    {
+        this->loader.prepareNode(this->node, *this);
+
+        if (!this->shouldExit())
+        {
+            this->loader.onNodePrepared(&this->node);
+        }
+
+        return jobHasFinished;
+    }
+
+private:
+
+    InstrumentsLoader &loader;
+    NodePlan &node;
+
+};
+
+InstrumentsLoader::InstrumentsLoader(AudioPluginFormatManager &formatManager,
+                                     PluginStatesStore &statesStore) :
+    formatManager(formatManager),
+    statesStore(statesStore),
+    pool(INSTRUMENTS_LOADER_NUM_THREADS),
+    numPendingNodes(0),
+    isInstantiating(false),
+    generation(0),
+    startTime(0.0)
+{
+}
+
+InstrumentsLoader::~InstrumentsLoader()
+{
+    this->cancel();
+    this->masterReference.clear();
+}
+
+
+//===----------------------------------------------------------------------===//
+// Planning
+//===----------------------------------------------------------------------===//
+
+void InstrumentsLoader::addInstrument(Instrument &instrument, const XmlElement &xml)
+{
+    instrument.reset();
+
+    const XmlElement *mainSlot = (xml.getTagName() == Serialization::Core::instrument) ?
+                                 &xml : xml.getChildByName(Serialization::Core::instrument);
+
+    if (mainSlot == nullptr)
+    { return; }
+
+    instrument.instrumentID = mainSlot->getStringAttribute(Serialization::Core::instrumentId, instrument.instrumentID.toString());
+    instrument.instrumentName = mainSlot->getStringAttribute(Serialization::Core::instrumentName, instrument.instrumentName);
+
+    auto instrumentPlan = new InstrumentPlan();
+    instrumentPlan->instrument = &instrument;
+    instrumentPlan->numPendingNodes = 0;
+    this->instrumentPlans.add(instrumentPlan);
+
+    forEachXmlChildElementWithTagName(*mainSlot, e, Serialization::Core::instrumentConnection)
+    {
+        instrumentPlan->connections.add({
+            static_cast<uint32>(e->getIntAttribute("srcFilter")),
+            static_cast<uint32>(e->getIntAttribute("dstFilter")),
+            e->getIntAttribute("srcChannel"),
+            e->getIntAttribute("dstChannel")
+        });
+    }
+
+    forEachXmlChildElementWithTagName(*mainSlot, e, Serialization::Core::instrumentNode)
+    {
+        PluginSmartDescription pd;
+
+        forEachXmlChildElement(*e, d)
+        {
+            if (pd.loadFromXml(*d))
+            { break; }
+        }
+
+        auto node = new NodePlan();
+        node->instrumentPlan = instrumentPlan;
+        node->description = pd;
+        node->uid = static_cast<uint32>(e->getIntAttribute("uid"));
+        node->hash = e->getStringAttribute("hash");
+        node->x = e->getDoubleAttribute("x");
+        node->y = e->getDoubleAttribute("y");
+        node->lastX = e->getDoubleAttribute("uiLastX");
+        node->lastY = e->getDoubleAttribute("uiLastY");
+        node->isQueued = false;
+        node->isInstantiatedConcurrently = false;
+        node->startTime = 0.0;
+        node->preparedTime = 0.0;
+        node->instantiationTime = 0.0;
+        node->instantiatedTime = 0.0;
+        node->restoredTime = 0.0;
+
+        if (const XmlElement *const state = e->getChildByName(Serialization::Core::pluginState))
+        {
+            node->stateBlobHash = state->getStringAttribute(Serialization::Core::pluginStateBlob);
+
+            if (node->stateBlobHash.isNotEmpty())
+            {
+                // retained right away, so that the unused blobs cleanup keeps it
+                this->statesStore.retain(node->stateBlobHash);
+            }
+            else
+            {
+                node->stateBase64 = state->getAllSubText();
+            }
+        }
+
+        this->nodePlans.add(node);
+        instrumentPlan->numPendingNodes++;
+        this->numPendingNodes++;
+    }
+
+    if (instrumentPlan->numPendingNodes == 0)
+    {
+        this->connectInstrument(*instrumentPlan);
+    }
+}
+
+void InstrumentsLoader::start()
+{
+    this->startTime = getMilliseconds();
+
+    for (auto node : this->nodePlans)
+    {
+        if (!node->isQueued)
+        {
+            node->isQueued = true;
+            node->startTime = this->startTime;
+            this->pool.addJob(new PrepareNodeJob(*this, *node), true);
+        }
+    }
+}
+
+void InstrumentsLoader::cancel()
+{
+    // waits for the running jobs, so that nobody touches the plan after it's gone
+    this->pool.removeAllJobs(true, -1);
+    this->cancelPendingUpdate();
+
+    {
+        const ScopedLock lock(this->preparedNodesLock);
+        this->preparedNodes.clear();
+    }
+
+    this->generation++;
+    this->isInstantiating = false;
+    this->numPendingNodes = 0;
+    this->nodePlans.clear();
+    this->instrumentPlans.clear();
+}
+
+bool InstrumentsLoader::isLoading() const noexcept
+{
+    return this->numPendingNodes > 0;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Preparing, on the pool's threads
+//===----------------------------------------------------------------------===//
+
+void InstrumentsLoader::prepareNode(NodePlan &node, ThreadPoolJob &job)
+{
+    if (node.stateBlobHash.isNotEmpty())
+    {
+        node.mappedState = this->statesStore.map(node.stateBlobHash);
+
+        if (node.mappedState != nullptr)
+        {
+            // touch every page, so that the plugin doesn't wait for the disk
+            const char *data = static_cast<const char *>(node.mappedState->getData());
+            const size_t size = node.mappedState->getSize();
+            volatile char checksum = 0;
+
+            for (size_t i = 0; i < size && !job.shouldExit(); i += 4096)
+            {
+                checksum += data[i];
+            }
+        }
+    }
+    else if (node.stateBase64.isNotEmpty())
+    {
+        node.state.fromBase64Encoding(node.stateBase64);
+        node.stateBase64 = String::empty;
+    }
+
+    // internal plugins are identified by names, AU ones by ids, others by paths
+    const String &path = node.description.fileOrIdentifier;
+
+    if (File::isAbsolutePath(path))
+    {
+        const File pluginFile(path);
+
+        if (pluginFile.existsAsFile())
+        {
+            warmUpFile(pluginFile, job);
+        }
+        else if (pluginFile.isDirectory())
+        {
+            // a bundle: it's the binaries that matter
+            const File binaries(pluginFile.getChildFile("Contents").getChildFile("MacOS"));
+
+            Array<File> files;
+            binaries.findChildFiles(files, File::findFiles, false);
+
+            for (const auto &file : files)
+            {
+                warmUpFile(file, job);
+            }
+        }
+    }
+
+    node.preparedTime = getMilliseconds();
+}
+
+void InstrumentsLoader::onNodePrepared(NodePlan *node)
+{
+    {
+        const ScopedLock lock(this->preparedNodesLock);
+        this->preparedNodes.add(node);
+    }
+
+    this->triggerAsyncUpdate();
+}
+
+
+//===----------------------------------------------------------------------===//
+// Instantiating, on the message thread
+//===----------------------------------------------------------------------===//
+
+void InstrumentsLoader::handleAsyncUpdate()
+{
+    NodePlan *node = nullptr;
+
+    {
+        const ScopedLock lock(this->preparedNodesLock);
+
+        // the nodes of almost loaded instruments go first,
+        // so that some of the instruments become usable as soon as possible
+        for (auto preparedNode : this->preparedNodes)
+        {
+            // while a plugin is created synchronously, only the asynchronous ones may start
+            if (this->isInstantiating &&
+                ! this->canInstantiateConcurrently(preparedNode->description))
+            { continue; }
+
+            if (node == nullptr ||
+                preparedNode->instrumentPlan->numPendingNodes < node->instrumentPlan->numPendingNodes)
+            {
+                node = preparedNode;
+            }
+        }
+
+        this->preparedNodes.removeFirstMatchingValue(node);
+    }
+
+    if (node == nullptr)
+    { return; }
+
+    Instrument *instrument = node->instrumentPlan->instrument;
+
+    if (instrument == nullptr)
+    {
+        // removed while loading
+        node->instantiationTime = node->instantiatedTime = node->restoredTime = getMilliseconds();
+        this->onNodeLoaded(node);
+        this->triggerAsyncUpdate();
+        return;
+    }
+
+    node->isInstantiatedConcurrently = this->canInstantiateConcurrently(node->description);
+    node->instantiationTime = getMilliseconds();
+
+    if (! node->isInstantiatedConcurrently)
+    {
+        this->isInstantiating = true;
+    }
+
+    WeakReference<InstrumentsLoader> weakThis(this);
+    const int callbackGeneration = this->generation;
+
+    this->formatManager.
+    createPluginInstanceAsync(node->description,
+                              instrument->getProcessorGraph()->getSampleRate(),
+                              instrument->getProcessorGraph()->getBlockSize(),
+                              [weakThis, callbackGeneration, node](AudioPluginInstance *instance, const String &error)
+                              {
+                                  if (weakThis == nullptr || weakThis->generation != callbackGeneration)
+                                  {
+                                      delete instance;
+                                      return;
+                                  }
+
+                                  weakThis->onNodeInstantiated(node, instance, error);
+                              });
+
+    // start the rest of the asynchronous ones, if any
+    if (node->isInstantiatedConcurrently)
+    {
+        this->triggerAsyncUpdate();
+    }
+}
+
+bool InstrumentsLoader::canInstantiateConcurrently(const PluginDescription &description) const
+{
+    for (int i = 0; i < this->formatManager.getNumFormats(); ++i)
+    {
+        AudioPluginFormat *format = this->formatManager.getFormat(i);
+
+        if (format->getName() == description.pluginFormatName)
+        {
+            return format->requiresUnblockedMessageThreadDuringCreation(description);
+        }
+    }
+
+    return false;
+}
+
+void InstrumentsLoader::onNodeInstantiated(NodePlan *node, AudioPluginInstance *instance, const String &error)
+{
+    if (! node->isInstantiatedConcurrently)
+    {
+        this->isInstantiating = false;
+    }
+
+    node->instantiatedTime = getMilliseconds();
+
+    Instrument *instrument = node->instrumentPlan->instrument;
+
+    if (instance == nullptr || instrument == nullptr)
+    {
+        Logger::writeToLog("Failed to load " + node->description.name + ": " + error);
+        delete instance;
+    }
+    else if (AudioProcessorGraph::Node *graphNode =
+             instrument->restoreNode(instance, node->uid, node->hash,
+                                     node->x, node->y, node->lastX, node->lastY))
+    {
+        if (node->mappedState != nullptr)
+        {
+            graphNode->getProcessor()->setStateInformation(node->mappedState->getData(),
+                                                           static_cast<int>(node->mappedState->getSize()));
+        }
+        else if (node->stateBlobHash.isNotEmpty())
+        {
+            Logger::writeToLog("Missing plugin state " + node->stateBlobHash);
+        }
+        else if (node->state.getSize() > 0)
+        {
+            graphNode->getProcessor()->setStateInformation(node->state.getData(),
+                                                           static_cast<int>(node->state.getSize()));
+        }
+    }
+
+    node->restoredTime = getMilliseconds();
+    node->mappedState = nullptr;
+    node->state.reset();
+
+    this->onNodeLoaded(node);
+    this->triggerAsyncUpdate();
+}
+
+void InstrumentsLoader::onNodeLoaded(NodePlan *node)
+{
+    InstrumentPlan &instrumentPlan = *node->instrumentPlan;
+
+    if (--instrumentPlan.numPendingNodes == 0)
+    {
+        this->connectInstrument(instrumentPlan);
+    }
+
+    if (--this->numPendingNodes == 0)
+    {
+        this->logTimings();
+    }
+}
+
+void InstrumentsLoader::connectInstrument(InstrumentPlan &plan)
+{
+    Instrument *instrument = plan.instrument;
+
+    if (instrument == nullptr)
+    { return; }
+
+    // all nodes are there now, so the connections are added once
+    for (const auto &c : plan.connections)
+    {
+        instrument->processorGraph->addConnection(c.srcFilter, c.srcChannel, c.dstFilter, c.dstChannel);
+    }
+
+    instrument->processorGraph->removeIllegalConnections();
+    instrument->sendChangeMessage();
+}
+
+void InstrumentsLoader::logTimings() const
+{
+    Array<const NodePlan *> nodes;
+
+    for (auto node : this->nodePlans)
+    {
+        nodes.add(node);
+    }
+
+    std::sort(nodes.begin(), nodes.end(), [](const NodePlan *a, const NodePlan *b)
+    {
+        return (a->restoredTime - a->startTime) > (b->restoredTime - b->startTime);
+    });
+
+    Logger::writeToLog("Instruments loaded in " +
+                       String(getMilliseconds() - this->startTime, 1) + " ms");
+
+    for (auto node : nodes)
+    {
+        Logger::writeToLog(node->description.name +
+                           ": prepared in " + String(node->preparedTime - node->startTime, 1) +
+                           " ms, queued for " + String(node->instantiationTime - node->preparedTime, 1) +
+                           " ms, instantiated in " + String(node->instantiatedTime - node->instantiationTime, 1) +
+                           " ms, restored in " + String(node->restoredTime - node->instantiatedTime, 1) + " ms");
+    }
+}
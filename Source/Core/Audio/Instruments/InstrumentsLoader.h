@@ -0,0 +1,144 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class Instrument;
+class PluginStatesStore;
+
+#define INSTRUMENTS_LOADER_NUM_THREADS 4
+
+// Loads the workspace's instruments, see AudioCore::deserialize.
+//
+// First, all instruments' nodes and connections are parsed into a loading plan.
+// Then everything that doesn't touch the plugins themselves is done concurrently
+// on a thread pool: decoding or mapping the saved states, and reading the plugins' binaries,
+// so that they are already in the OS file cache when the plugins get loaded.
+//
+// Plugins themselves are instantiated and restored on the message thread; the formats
+// that create instances synchronously (most of them) are loaded one by one, so that the app
+// stays responsive in between, while the truly asynchronous ones, like AUv3, are all started
+// at once and created concurrently. The nodes of almost loaded instruments go first.
+// Meanwhile the app keeps running, so projects open before the slow instruments are ready.
+// Each instrument's graph is connected once, when all its nodes are there,
+// and when everything is loaded, a per-plugin time breakdown is logged.
+
+class InstrumentsLoader : private AsyncUpdater
+{
+public:
+
+    InstrumentsLoader(AudioPluginFormatManager &formatManager,
+                      PluginStatesStore &statesStore);
+
+    ~InstrumentsLoader() override;
+
+    // Resets the instrument and adds its nodes to the plan;
+    // instrument's id and name are restored right away, so that layers can find it
+    void addInstrument(Instrument &instrument, const XmlElement &xml);
+
+    // Starts loading all the planned nodes
+    void start();
+
+    // Drops the plan, i.e. when the instruments are about to be removed
+    void cancel();
+
+    bool isLoading() const noexcept;
+
+private:
+
+    struct ConnectionDescription
+    {
+        uint32 srcFilter;
+        uint32 dstFilter;
+        int srcChannel;
+        int dstChannel;
+    };
+
+    struct InstrumentPlan
+    {
+        WeakReference<Instrument> instrument;
+        Array<ConnectionDescription> connections;
+        int numPendingNodes;
+    };
+
+    struct NodePlan
+    {
+        InstrumentPlan *instrumentPlan;
+        PluginDescription description;
+
+        uint32 uid;
+        String hash;
+        double x;
+        double y;
+        double lastX;
+        double lastY;
+
+        String stateBlobHash;
+        String stateBase64;
+        MemoryBlock state;
+        ScopedPointer<MemoryMappedFile> mappedState;
+
+        bool isQueued;
+        bool isInstantiatedConcurrently;
+        double startTime;
+        double preparedTime;
+        double instantiationTime;
+        double instantiatedTime;
+        double restoredTime;
+    };
+
+    class PrepareNodeJob;
+
+    // Called on the pool's threads
+    void prepareNode(NodePlan &node, ThreadPoolJob &job);
+    void onNodePrepared(NodePlan *node);
+
+    // Called on the message thread
+    void handleAsyncUpdate() override;
+    bool canInstantiateConcurrently(const PluginDescription &description) const;
+    void onNodeInstantiated(NodePlan *node, AudioPluginInstance *instance, const String &error);
+    void onNodeLoaded(NodePlan *node);
+    void connectInstrument(InstrumentPlan &plan);
+    void logTimings() const;
+
+    AudioPluginFormatManager &formatManager;
+    PluginStatesStore &statesStore;
+
+    ThreadPool pool;
+
+    OwnedArray<InstrumentPlan> instrumentPlans;
+    OwnedArray<NodePlan> nodePlans;
+    int numPendingNodes;
+
+    CriticalSection preparedNodesLock;
+    Array<NodePlan *> preparedNodes;
+
+    // Only one plugin of the synchronous formats is being instantiated at a time
+    bool isInstantiating;
+
+    // Incremented on cancel, so that the late callbacks are ignored
+    int generation;
+
+    double startTime;
+
+    WeakReference<InstrumentsLoader>::Master masterReference;
+
+    friend class WeakReference<InstrumentsLoader>;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(InstrumentsLoader);
+
+};
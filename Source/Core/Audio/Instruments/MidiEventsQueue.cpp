@@ -0,0 +1,132 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "MidiEventsQueue.h"
+
+MidiEventsQueue::MidiEventsQueue(int capacity) :
+    fifo(capacity),
+    events(capacity),
+    fallbackCollector(nullptr),
+    sampleRate(44100.0)
+{
+}
+
+void MidiEventsQueue::setFallbackCollector(MidiMessageCollector *collector) noexcept
+{
+    this->fallbackCollector = collector;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Producer side
+//===----------------------------------------------------------------------===//
+
+bool MidiEventsQueue::addMessageToQueue(const MidiMessage &message) noexcept
+{
+    const int messageSize = message.getRawDataSize();
+
+    if (messageSize <= MIDI_EVENTS_QUEUE_MAX_MESSAGE_SIZE)
+    {
+        const SpinLock::ScopedLockType lock(this->producerLock);
+
+        int start1, size1, start2, size2;
+        this->fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+        if (size1 + size2 > 0)
+        {
+            QueuedEvent &event = this->events[(size1 > 0) ? start1 : start2];
+            event.timeStamp = message.getTimeStamp();
+            event.size = messageSize;
+            memcpy(event.data, message.getRawData(), size_t(messageSize));
+            this->fifo.finishedWrite(1);
+            return true;
+        }
+    }
+
+    if (this->fallbackCollector != nullptr)
+    {
+        this->fallbackCollector->addMessageToQueue(message);
+        return true;
+    }
+
+    return false;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Consumer side
+//===----------------------------------------------------------------------===//
+
+void MidiEventsQueue::reset(double newSampleRate) noexcept
+{
+    jassert(newSampleRate > 0.0);
+    this->sampleRate = newSampleRate;
+    this->fifo.finishedRead(this->fifo.getNumReady());
+}
+
+void MidiEventsQueue::removeNextBlockOfMessages(MidiBuffer &destBuffer, int numSamples) noexcept
+{
+    const int numReady = this->fifo.getNumReady();
+
+    if (numReady == 0 || numSamples <= 0)
+    { return; }
+
+    // Events are placed so that the ones sent just now go to the end of the block,
+    // and the ones sent earlier keep their relative spacing, if they fit in a block;
+    // this adds one block of latency, the same way MidiMessageCollector does
+    const double timeNow = Time::getMillisecondCounterHiRes() * 0.001;
+    const int lastSample = numSamples - 1;
+
+    int start1, size1, start2, size2;
+    this->fifo.prepareToRead(numReady, start1, size1, start2, size2);
+
+    auto addEvents = [&](int start, int size)
+    {
+        for (int i = start; i < start + size; ++i)
+        {
+            const QueuedEvent &event = this->events[i];
+            const int samplesAgo = int((timeNow - event.timeStamp) * this->sampleRate);
+            const int samplePosition = jlimit(0, lastSample, lastSample - samplesAgo);
+            destBuffer.addEvent(event.data, event.size, samplePosition);
+        }
+    };
+
+    addEvents(start1, size1);
+    addEvents(start2, size2);
+
+    this->fifo.finishedRead(size1 + size2);
+}
+
+bool MidiEventsQueue::removeNextMessage(MidiMessage &outMessage)
+{
+    int start1, size1, start2, size2;
+    this->fifo.prepareToRead(1, start1, size1, start2, size2);
+
+    if (size1 + size2 == 0)
+    { return false; }
+
+    const QueuedEvent &event = this->events[(size1 > 0) ? start1 : start2];
+    outMessage = MidiMessage(event.data, event.size, event.timeStamp);
+    this->fifo.finishedRead(1);
+    return true;
+}
+
+int MidiEventsQueue::getNumPendingEvents() const noexcept
+{
+    return this->fifo.getNumReady();
+}
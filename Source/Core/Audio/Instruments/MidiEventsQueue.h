@@ -0,0 +1,89 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#define MIDI_EVENTS_QUEUE_DEFAULT_CAPACITY 4096
+#define MIDI_EVENTS_QUEUE_MAX_MESSAGE_SIZE 16
+
+// A pre-allocated single-consumer queue of timestamped midi events,
+// used instead of MidiMessageCollector to deliver playback and auditioning events
+// to the instrument's graph without sharing a lock with the audio thread.
+//
+// Consumer side (the audio callback) never locks or allocates, so it is wait-free.
+// Producers (the player thread and the transport's realtime sends from the message thread)
+// are not: they share a spin lock, so one of them may spin while the other copies an event.
+// The lock is never taken by the consumer, and is only held for a single copy,
+// so the audio thread is never blocked by the producers.
+//
+// Timestamps are in seconds, as in Time::getMillisecondCounterHiRes() * 0.001.
+// Messages that don't fit the inline storage (i.e. long sysex)
+// are passed to the fallback collector, if one is set.
+
+class MidiEventsQueue
+{
+public:
+
+    explicit MidiEventsQueue(int capacity = MIDI_EVENTS_QUEUE_DEFAULT_CAPACITY);
+
+    void setFallbackCollector(MidiMessageCollector *collector) noexcept;
+
+    //===------------------------------------------------------------------===//
+    // Producer side
+    //===------------------------------------------------------------------===//
+
+    // Returns false if the message was not queued (i.e. the queue is full
+    // and no fallback collector is set), which should never happen in practice
+    bool addMessageToQueue(const MidiMessage &message) noexcept;
+
+    //===------------------------------------------------------------------===//
+    // Consumer side
+    //===------------------------------------------------------------------===//
+
+    // Called from prepareToPlay, discards everything pending
+    void reset(double newSampleRate) noexcept;
+
+    // Called from the audio callback: moves all pending events into the buffer,
+    // placing them according to their timestamps within the last block's time span
+    void removeNextBlockOfMessages(MidiBuffer &destBuffer, int numSamples) noexcept;
+
+    // Pops one pending message, keeping its timestamp; returns false if there's none.
+    // Not for the audio callback, as it may allocate for the long messages
+    bool removeNextMessage(MidiMessage &outMessage);
+
+    int getNumPendingEvents() const noexcept;
+
+private:
+
+    struct QueuedEvent
+    {
+        double timeStamp;
+        int size;
+        uint8 data[MIDI_EVENTS_QUEUE_MAX_MESSAGE_SIZE];
+    };
+
+    AbstractFifo fifo;
+    HeapBlock<QueuedEvent> events;
+
+    SpinLock producerLock;
+    MidiMessageCollector *fallbackCollector;
+
+    double sampleRate;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MidiEventsQueue);
+
+};
@@ -0,0 +1,97 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "PluginStatesStore.h"
+
+#define PLUGIN_STATES_STORE_BLOB_EXTENSION ".state"
+
+PluginStatesStore::PluginStatesStore(const File &storeFolder) :
+    folder(storeFolder)
+{
+}
+
+String PluginStatesStore::store(const MemoryBlock &state)
+{
+    const String hash(SHA256(state.getData(), state.getSize()).toHexString());
+    const File blobFile(this->getBlobFile(hash));
+
+    // the name is the hash of the content, so an existing blob is the same state
+    if (! blobFile.existsAsFile() || blobFile.getSize() != int64(state.getSize()))
+    {
+        TemporaryFile tempFile(blobFile);
+
+        {
+            FileOutputStream out(tempFile.getFile());
+
+            if (out.failedToOpen() || ! out.write(state.getData(), state.getSize()))
+            { return String::empty; }
+
+            out.flush();
+        }
+
+        if (! tempFile.overwriteTargetFileWithTemporary())
+        { return String::empty; }
+    }
+
+    const ScopedLock lock(this->usedBlobsLock);
+    this->usedBlobs.set(hash, true);
+    return hash;
+}
+
+void PluginStatesStore::retain(const String &hash)
+{
+    const ScopedLock lock(this->usedBlobsLock);
+    this->usedBlobs.set(hash, true);
+}
+
+MemoryMappedFile *PluginStatesStore::map(const String &hash) const
+{
+    const File blobFile(this->getBlobFile(hash));
+
+    if (hash.isEmpty() || ! blobFile.existsAsFile())
+    { return nullptr; }
+
+    ScopedPointer<MemoryMappedFile> mappedFile(new MemoryMappedFile(blobFile, MemoryMappedFile::readOnly));
+
+    if (mappedFile->getData() == nullptr)
+    { return nullptr; }
+
+    return mappedFile.release();
+}
+
+void PluginStatesStore::removeUnusedBlobs()
+{
+    const ScopedLock lock(this->usedBlobsLock);
+
+    Array<File> blobFiles;
+    this->folder.findChildFiles(blobFiles, File::findFiles, false, "*" PLUGIN_STATES_STORE_BLOB_EXTENSION);
+
+    for (const auto &blobFile : blobFiles)
+    {
+        if (! this->usedBlobs.contains(blobFile.getFileNameWithoutExtension()))
+        {
+            Logger::writeToLog("Removing unused plugin state " + blobFile.getFileName());
+            blobFile.deleteFile();
+        }
+    }
+}
+
+File PluginStatesStore::getBlobFile(const String &hash) const
+{
+    return this->folder.getChildFile(hash + PLUGIN_STATES_STORE_BLOB_EXTENSION);
+}
@@ -0,0 +1,62 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Plugin states smaller than this are still kept inline, as base64 text
+#define PLUGIN_STATES_STORE_MIN_BLOB_SIZE (16 * 1024)
+
+// A content-addressed storage of plugins' states, owned by AudioCore.
+//
+// Each state is written once into the store's folder as a binary file named
+// by its SHA-256 hash, and the instrument xml only keeps that hash,
+// so that unchanged states (i.e. big samplers' ones) are not re-encoded
+// and rewritten on every workspace save. Same states are stored only once.
+//
+// The blobs referenced by the loaded workspace, and the ones stored since,
+// are considered in use; removeUnusedBlobs() cleans up all the others.
+
+class PluginStatesStore
+{
+public:
+
+    explicit PluginStatesStore(const File &storeFolder);
+
+    // Writes the blob, unless it is stored already, returns its hash or empty string on failure
+    String store(const MemoryBlock &state);
+
+    // Marks the blob as referenced by the loaded workspace
+    void retain(const String &hash);
+
+    // Maps the blob into memory, so that the plugin can read it right from the file;
+    // returns nullptr if there's no such blob
+    MemoryMappedFile *map(const String &hash) const;
+
+    void removeUnusedBlobs();
+
+private:
+
+    File getBlobFile(const String &hash) const;
+
+    const File folder;
+
+    CriticalSection usedBlobsLock;
+    HashMap<String, bool> usedBlobs;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginStatesStore);
+
+};
@@ -19,6 +19,7 @@
 #include "AudioMonitor.h"
 #include "AudioCore.h"
 #include "AudiobusOutput.h"
+#include "RealtimeChecker.h"
 
 #define AUDIO_MONITOR_SPECTRUM_SIZE                 512
 #define AUDIO_MONITOR_DEFAULT_SAMPLERATE            44100
@@ -96,8 +97,7 @@ void AudioMonitor::audioDeviceIOCallback(const float **inputChannelData,
                                              int numOutputChannels,
                                              int numSamples)
 {
-    
-    
+    REALTIME_CHECKED_SCOPE
     
     const int numChannels =
     jmin(AUDIO_MONITOR_MAX_CHANNELS, numOutputChannels);
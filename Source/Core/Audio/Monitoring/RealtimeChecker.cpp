@@ -0,0 +1,430 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "RealtimeChecker.h"
+
+#if HELIO_REALTIME_CHECKS
+#   if JUCE_LINUX || JUCE_MAC
+#       include <execinfo.h>
+#   endif
+#   if JUCE_LINUX
+#       include <dlfcn.h>
+#       include <fcntl.h>
+#       include <pthread.h>
+#       include <stdarg.h>
+#       include <stdio.h>
+#       include <time.h>
+#       include <unistd.h>
+#   else
+#       include <new>
+#   endif
+#endif
+
+struct ViolationRecord
+{
+    RealtimeChecker::Violation violation;
+    int64 key;
+    int64 count;
+    String stackTrace;
+};
+
+static Atomic<int64> violationCounters[RealtimeChecker::numViolations];
+
+static CriticalSection recordsLock;
+static Array<ViolationRecord> records;
+
+#if HELIO_REALTIME_CHECKS
+
+// Both are trivial, so accessing them never allocates, even from within malloc
+static thread_local int checkedScopeDepth = 0;
+static thread_local bool isReporting = false;
+
+static inline void checkCall(RealtimeChecker::Violation violation) noexcept
+{
+    if (checkedScopeDepth > 0 && ! isReporting)
+    {
+        RealtimeChecker::reportViolation(violation);
+    }
+}
+
+// Distinguishes the call sites without symbolizing the stack,
+// which is only done once for each new record
+static int64 getCallStackKey(RealtimeChecker::Violation violation) noexcept
+{
+    int64 key = int64(violation);
+
+#if JUCE_LINUX || JUCE_MAC
+    void *frames[REALTIME_CHECKER_MAX_STACK_FRAMES];
+    const int numFrames = backtrace(frames, REALTIME_CHECKER_MAX_STACK_FRAMES);
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+        key = key * 31 + int64(pointer_sized_int(frames[i]));
+    }
+#endif
+
+    return key;
+}
+
+#endif
+
+//===----------------------------------------------------------------------===//
+// RealtimeChecker
+//===----------------------------------------------------------------------===//
+
+RealtimeChecker::ScopedCheck::ScopedCheck() noexcept
+{
+#if HELIO_REALTIME_CHECKS
+    ++checkedScopeDepth;
+#endif
+}
+
+RealtimeChecker::ScopedCheck::~ScopedCheck() noexcept
+{
+#if HELIO_REALTIME_CHECKS
+    --checkedScopeDepth;
+#endif
+}
+
+bool RealtimeChecker::isInCheckedScope() noexcept
+{
+#if HELIO_REALTIME_CHECKS
+    return checkedScopeDepth > 0;
+#else
+    return false;
+#endif
+}
+
+void RealtimeChecker::reportViolation(Violation violation) noexcept
+{
+#if HELIO_REALTIME_CHECKS
+    if (isReporting)
+    { return; }
+
+    isReporting = true;
+    ++violationCounters[violation];
+
+    const int64 key = getCallStackKey(violation);
+
+    {
+        const ScopedLock lock(recordsLock);
+        bool isNewCallStack = true;
+
+        for (int i = 0; i < records.size(); ++i)
+        {
+            ViolationRecord &record = records.getReference(i);
+
+            if (record.key == key)
+            {
+                ++record.count;
+                isNewCallStack = false;
+                break;
+            }
+        }
+
+        if (isNewCallStack && records.size() < REALTIME_CHECKER_MAX_RECORDS)
+        {
+            ViolationRecord record;
+            record.violation = violation;
+            record.key = key;
+            record.count = 1;
+            record.stackTrace = SystemStats::getStackBacktrace();
+            records.add(record);
+        }
+    }
+
+    isReporting = false;
+#endif
+}
+
+int64 RealtimeChecker::getNumViolations(Violation violation) noexcept
+{
+    return violationCounters[violation].get();
+}
+
+int64 RealtimeChecker::getTotalNumViolations() noexcept
+{
+    int64 total = 0;
+
+    for (int i = 0; i < numViolations; ++i)
+    {
+        total += getNumViolations(Violation(i));
+    }
+
+    return total;
+}
+
+String RealtimeChecker::getViolationName(Violation violation)
+{
+    switch (violation)
+    {
+        case allocation: return "allocation";
+        case deallocation: return "deallocation";
+        case lock: return "lock";
+        case fileAccess: return "file access";
+        case sleep: return "sleep";
+        default: return String::empty;
+    }
+}
+
+String RealtimeChecker::createReport()
+{
+#if HELIO_REALTIME_CHECKS
+    String report;
+    report << "Realtime violations in audio callbacks: " << String(getTotalNumViolations()) << newLine;
+
+    for (int i = 0; i < numViolations; ++i)
+    {
+        const Violation violation = Violation(i);
+        report << getViolationName(violation).paddedRight(' ', 16)
+               << String(getNumViolations(violation)) << newLine;
+    }
+
+    const ScopedLock lock(recordsLock);
+
+    for (const auto &record : records)
+    {
+        report << newLine << getViolationName(record.violation)
+               << ", " << String(record.count) << " times:" << newLine
+               << record.stackTrace;
+    }
+
+    if (records.size() == REALTIME_CHECKER_MAX_RECORDS)
+    {
+        report << newLine << "(only the first " << String(REALTIME_CHECKER_MAX_RECORDS)
+               << " call stacks are listed)" << newLine;
+    }
+
+    return report;
+#else
+    return "Realtime checks are disabled in this build";
+#endif
+}
+
+void RealtimeChecker::reset()
+{
+    for (int i = 0; i < numViolations; ++i)
+    {
+        violationCounters[i] = 0;
+    }
+
+    const ScopedLock lock(recordsLock);
+    records.clear();
+}
+
+//===----------------------------------------------------------------------===//
+// Interceptors
+//===----------------------------------------------------------------------===//
+
+#if HELIO_REALTIME_CHECKS
+
+#if JUCE_LINUX
+
+// glibc allows the application to replace the malloc family,
+// and exports the original implementations with the __libc_ prefix.
+// Other interposed functions are looked up with dlsym(RTLD_NEXT),
+// which never calls them itself, so there's no recursion.
+
+#define REALTIME_CHECKER_EXPORT __attribute__((visibility("default")))
+
+template <typename FunctionType>
+static FunctionType findNextFunction(FunctionType &function, const char *name) noexcept
+{
+    if (function == nullptr)
+    {
+        function = reinterpret_cast<FunctionType>(dlsym(RTLD_NEXT, name));
+    }
+
+    return function;
+}
+
+static int (*nextMutexLock)(pthread_mutex_t *) = nullptr;
+static int (*nextOpen)(const char *, int, ...) = nullptr;
+static int (*nextOpen64)(const char *, int, ...) = nullptr;
+static int (*nextOpenAt)(int, const char *, int, ...) = nullptr;
+static FILE *(*nextFileOpen)(const char *, const char *) = nullptr;
+static FILE *(*nextFileOpen64)(const char *, const char *) = nullptr;
+
+// The mode argument is only passed when a file may be created
+#define REALTIME_CHECKER_READ_MODE(flags, mode) \
+    if (((flags) & O_CREAT) != 0) \
+    { \
+        va_list args; \
+        va_start(args, flags); \
+        mode = mode_t(va_arg(args, int)); \
+        va_end(args); \
+    }
+static int (*nextMicrosecondsSleep)(useconds_t) = nullptr;
+static int (*nextNanosecondsSleep)(const struct timespec *, struct timespec *) = nullptr;
+
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t numElements, size_t elementSize);
+    void *__libc_realloc(void *ptr, size_t size);
+    void __libc_free(void *ptr);
+
+    REALTIME_CHECKER_EXPORT void *malloc(size_t size) noexcept
+    {
+        checkCall(RealtimeChecker::allocation);
+        return __libc_malloc(size);
+    }
+
+    REALTIME_CHECKER_EXPORT void *calloc(size_t numElements, size_t elementSize) noexcept
+    {
+        checkCall(RealtimeChecker::allocation);
+        return __libc_calloc(numElements, elementSize);
+    }
+
+    REALTIME_CHECKER_EXPORT void *realloc(void *ptr, size_t size) noexcept
+    {
+        checkCall(RealtimeChecker::allocation);
+        return __libc_realloc(ptr, size);
+    }
+
+    REALTIME_CHECKER_EXPORT void free(void *ptr) noexcept
+    {
+        if (ptr != nullptr)
+        {
+            checkCall(RealtimeChecker::deallocation);
+        }
+
+        __libc_free(ptr);
+    }
+
+    REALTIME_CHECKER_EXPORT int pthread_mutex_lock(pthread_mutex_t *mutex) noexcept
+    {
+        checkCall(RealtimeChecker::lock);
+        return findNextFunction(nextMutexLock, "pthread_mutex_lock")(mutex);
+    }
+
+    REALTIME_CHECKER_EXPORT int open(const char *path, int flags, ...)
+    {
+        checkCall(RealtimeChecker::fileAccess);
+
+        mode_t mode = 0;
+        REALTIME_CHECKER_READ_MODE(flags, mode);
+        return findNextFunction(nextOpen, "open")(path, flags, mode);
+    }
+
+    // With _FILE_OFFSET_BITS=64, and in some plugins, open and fopen
+    // are redirected to their 64-bit versions, so those are caught too
+
+    REALTIME_CHECKER_EXPORT int open64(const char *path, int flags, ...)
+    {
+        checkCall(RealtimeChecker::fileAccess);
+
+        mode_t mode = 0;
+        REALTIME_CHECKER_READ_MODE(flags, mode);
+        return findNextFunction(nextOpen64, "open64")(path, flags, mode);
+    }
+
+    REALTIME_CHECKER_EXPORT int openat(int directory, const char *path, int flags, ...)
+    {
+        checkCall(RealtimeChecker::fileAccess);
+
+        mode_t mode = 0;
+        REALTIME_CHECKER_READ_MODE(flags, mode);
+        return findNextFunction(nextOpenAt, "openat")(directory, path, flags, mode);
+    }
+
+    REALTIME_CHECKER_EXPORT FILE *fopen(const char *path, const char *mode)
+    {
+        checkCall(RealtimeChecker::fileAccess);
+        return findNextFunction(nextFileOpen, "fopen")(path, mode);
+    }
+
+    REALTIME_CHECKER_EXPORT FILE *fopen64(const char *path, const char *mode)
+    {
+        checkCall(RealtimeChecker::fileAccess);
+        return findNextFunction(nextFileOpen64, "fopen64")(path, mode);
+    }
+
+    REALTIME_CHECKER_EXPORT int usleep(useconds_t microseconds)
+    {
+        checkCall(RealtimeChecker::sleep);
+        return findNextFunction(nextMicrosecondsSleep, "usleep")(microseconds);
+    }
+
+    REALTIME_CHECKER_EXPORT int nanosleep(const struct timespec *duration, struct timespec *remaining)
+    {
+        checkCall(RealtimeChecker::sleep);
+        return findNextFunction(nextNanosecondsSleep, "nanosleep")(duration, remaining);
+    }
+}
+
+#else
+
+// Replaceable allocation functions, see [new.delete];
+// plugins' own allocations are not seen here
+
+void *operator new(size_t size)
+{
+    checkCall(RealtimeChecker::allocation);
+
+    if (void *ptr = std::malloc(size == 0 ? 1 : size))
+    { return ptr; }
+
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    checkCall(RealtimeChecker::allocation);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    checkCall(RealtimeChecker::allocation);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    if (ptr != nullptr)
+    {
+        checkCall(RealtimeChecker::deallocation);
+    }
+
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+    operator delete(ptr);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,111 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Opt-in, as it slows down every allocation in the app
+#ifndef HELIO_REALTIME_CHECKS
+#   define HELIO_REALTIME_CHECKS 0
+#endif
+
+#define REALTIME_CHECKER_MAX_RECORDS 256
+#define REALTIME_CHECKER_MAX_STACK_FRAMES 32
+
+// Detects the calls which may block the audio device callbacks.
+//
+// The callbacks are marked with REALTIME_CHECKED_SCOPE (or wrapped
+// with RealtimeCheckedCallback), and while a thread is inside such a scope:
+// - allocations and deallocations are caught by the replaced malloc family on Linux,
+//   which also sees operator new and plugins' allocations,
+//   and by the replaced operators new and delete elsewhere;
+// - on Linux, pthread mutex locks (i.e. all CriticalSection's, including the one
+//   in MidiMessageCollector), file opening (open, open64, openat, fopen, fopen64)
+//   and sleeping are caught by the interposed libc functions; other entry points,
+//   like raw syscalls, are not, and on other platforms none of these are detected.
+//
+// Each violation is counted, and the first ones from each distinct call stack
+// are kept with their stack traces; the report is written to the log on shutdown.
+// Reporting itself allocates and locks, so it is never checked recursively.
+
+class RealtimeChecker
+{
+public:
+
+    enum Violation
+    {
+        allocation = 0,
+        deallocation,
+        lock,
+        fileAccess,
+        sleep,
+        numViolations
+    };
+
+    class ScopedCheck
+    {
+    public:
+        ScopedCheck() noexcept;
+        ~ScopedCheck() noexcept;
+    private:
+        JUCE_DECLARE_NON_COPYABLE(ScopedCheck)
+    };
+
+    static bool isInCheckedScope() noexcept;
+
+    // Called by the interceptors, but can also be used directly
+    // to mark the calls that cannot be intercepted
+    static void reportViolation(Violation violation) noexcept;
+
+    static int64 getNumViolations(Violation violation) noexcept;
+    static int64 getTotalNumViolations() noexcept;
+
+    static String getViolationName(Violation violation);
+
+    // Counters per violation kind, followed by each distinct stack trace
+    static String createReport();
+
+    static void reset();
+
+};
+
+#if HELIO_REALTIME_CHECKS
+#   define REALTIME_CHECKED_SCOPE \
+        const RealtimeChecker::ScopedCheck JUCE_JOIN_MACRO(realtimeCheck, __LINE__);
+#else
+#   define REALTIME_CHECKED_SCOPE
+#endif
+
+// Marks the audioDeviceIOCallback of a callback class which cannot be changed,
+// like AudioProcessorPlayer, as a checked scope
+template <class CallbackClass>
+class RealtimeCheckedCallback : public CallbackClass
+{
+public:
+
+    void audioDeviceIOCallback(const float **inputChannelData,
+                               int numInputChannels,
+                               float **outputChannelData,
+                               int numOutputChannels,
+                               int numSamples) override
+    {
+        REALTIME_CHECKED_SCOPE
+        CallbackClass::audioDeviceIOCallback(inputChannelData, numInputChannels,
+                                             outputChannelData, numOutputChannels,
+                                             numSamples);
+    }
+
+};
@@ -0,0 +1,361 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "MidiRecorder.h"
+#include "Transport.h"
+#include "PianoLayer.h"
+
+MidiRecorder::MidiRecorder(Transport &parentTransport) :
+    transport(parentTransport),
+    device(nullptr),
+    layer(nullptr),
+    defaultMsPerTick(0.0),
+    trackStartMs(0.0),
+    latencyMs(0.0),
+    anchorTimestamp(0.0),
+    anchorTimeMs(0.0),
+    hasAnchor(false)
+{
+}
+
+MidiRecorder::~MidiRecorder()
+{
+    this->cancel();
+}
+
+void MidiRecorder::start(PianoLayer *targetLayer, AudioDeviceManager &deviceManager)
+{
+    jassert(targetLayer != nullptr);
+
+    if (this->isRecording())
+    { this->stop(); }
+
+    this->layer = targetLayer;
+    this->device = &deviceManager;
+    this->trackStartMs = this->transport.trackStartMs;
+    this->buildTempoMap();
+
+    // the player is heard that late, and that's what the input is played along with
+    this->latencyMs = 0.0;
+
+    if (AudioIODevice *audioDevice = deviceManager.getCurrentAudioDevice())
+    {
+        const double sampleRate = audioDevice->getCurrentSampleRate();
+
+        if (sampleRate > 0.0)
+        {
+            const int latencySamples = audioDevice->getOutputLatencyInSamples() +
+                                       audioDevice->getCurrentBufferSizeSamples();
+
+            this->latencyMs = latencySamples * 1000.0 / sampleRate;
+        }
+    }
+
+    {
+        const SpinLock::ScopedLockType lock(this->anchorLock);
+        this->hasAnchor = false;
+    }
+
+    this->numDroppedMessages = 0;
+    this->device->addMidiInputCallback(String::empty, this);
+    this->startTimer(MIDI_RECORDER_UPDATE_TIME_MS);
+}
+
+void MidiRecorder::stop()
+{
+    if (!this->isRecording())
+    { return; }
+
+    this->stopListening();
+
+    if (this->hasPlaybackAnchor())
+    {
+        this->processPendingMessages();
+
+        // the keys still held are released right now
+        const float endBeat = this->getBeatForTime(Time::getMillisecondCounterHiRes());
+
+        Array<int> heldNoteIds;
+
+        for (HashMap<int, HeldNote>::Iterator i(this->heldNotes); i.next();)
+        {
+            heldNoteIds.add(i.getKey());
+        }
+
+        for (auto noteId : heldNoteIds)
+        {
+            this->finishNote(noteId, endBeat);
+        }
+    }
+
+    // inserting notes may change the project's beat range, which stops the transport,
+    // so the recorder is reset beforehand, not to merge the same take twice
+    PianoLayer *targetLayer = this->layer;
+    Array<Note> notes;
+    notes.swapWith(this->recordedNotes);
+    this->cancel();
+
+    Logger::writeToLog("Recorded " + String(notes.size()) + " notes");
+
+    if (notes.size() > 0)
+    {
+        targetLayer->checkpoint();
+        targetLayer->insertGroup(notes, true);
+    }
+}
+
+void MidiRecorder::cancel()
+{
+    this->stopListening();
+
+    MidiMessage message;
+    while (this->queue.removeNextMessage(message)) {}
+
+    this->heldNotes.clear();
+    this->recordedNotes.clear();
+    this->tempoMap.clear();
+    this->layer = nullptr;
+}
+
+bool MidiRecorder::isRecording() const noexcept
+{
+    return (this->layer != nullptr);
+}
+
+bool MidiRecorder::isRecordingInto(const MidiLayer *targetLayer) const noexcept
+{
+    return (this->layer != nullptr && this->layer == targetLayer);
+}
+
+bool MidiRecorder::hasPlaybackAnchor() const noexcept
+{
+    const SpinLock::ScopedLockType lock(this->anchorLock);
+    return this->hasAnchor;
+}
+
+void MidiRecorder::setPlaybackAnchor(double startTimestamp, double timeMs) noexcept
+{
+    const SpinLock::ScopedLockType lock(this->anchorLock);
+    this->anchorTimestamp = startTimestamp;
+    this->anchorTimeMs = timeMs;
+    this->hasAnchor = true;
+}
+
+void MidiRecorder::stopListening()
+{
+    this->stopTimer();
+
+    if (this->device != nullptr)
+    {
+        // no callbacks are running after this returns
+        this->device->removeMidiInputCallback(String::empty, this);
+        this->device = nullptr;
+    }
+}
+
+
+//===----------------------------------------------------------------------===//
+// MidiInputCallback
+//===----------------------------------------------------------------------===//
+
+void MidiRecorder::handleIncomingMidiMessage(MidiInput *source, const MidiMessage &message)
+{
+    // the message keeps the driver's timestamp, in seconds
+    if (message.isNoteOnOrOff() &&
+        ! this->queue.addMessageToQueue(message))
+    {
+        ++this->numDroppedMessages;
+    }
+}
+
+
+//===----------------------------------------------------------------------===//
+// Timer
+//===----------------------------------------------------------------------===//
+
+void MidiRecorder::timerCallback()
+{
+    // until the player has started, there's nothing to map the timestamps to
+    if (! this->hasPlaybackAnchor())
+    { return; }
+
+    // the player thread has reached the end of the track and exited by itself,
+    // so the take is complete
+    if (! this->transport.isPlaying())
+    {
+        this->stop();
+        return;
+    }
+
+    this->processPendingMessages();
+}
+
+
+//===----------------------------------------------------------------------===//
+// Tempo map
+//===----------------------------------------------------------------------===//
+
+void MidiRecorder::buildTempoMap()
+{
+    const double TPQN = Transport::millisecondsPerBeat; // ticks-per-quarter-note
+
+    this->tempoMap.clearQuick();
+
+    this->transport.rebuildSequencesIfNeeded();
+    this->transport.sequences.seekToZeroIndexes();
+
+    MessageWrapper wrapper;
+
+    while (this->transport.sequences.getNextMessage(wrapper))
+    {
+        if (wrapper.message.isTempoMetaEvent())
+        {
+            const double msPerTick = wrapper.message.getTempoSecondsPerQuarterNote() * 1000.0 / TPQN;
+            this->tempoMap.add({ wrapper.message.getTimeStamp(), msPerTick });
+        }
+    }
+
+    // same as in Transport::calcTimeAndTempoAt, the tempo before
+    // the first tempo event is the one of that event
+    this->defaultMsPerTick = (this->tempoMap.size() > 0) ?
+        this->tempoMap.getReference(0).msPerTick : (250.0 / TPQN);
+}
+
+double MidiRecorder::getMsPerTickAt(double timestamp) const
+{
+    double msPerTick = this->defaultMsPerTick;
+
+    for (const auto &marker : this->tempoMap)
+    {
+        if (marker.timestamp > timestamp)
+        { break; }
+
+        msPerTick = marker.msPerTick;
+    }
+
+    return msPerTick;
+}
+
+double MidiRecorder::getTimeBetween(double startTimestamp, double endTimestamp) const
+{
+    double timeMs = 0.0;
+    double timestamp = startTimestamp;
+    double msPerTick = this->getMsPerTickAt(startTimestamp);
+
+    for (const auto &marker : this->tempoMap)
+    {
+        if (marker.timestamp <= timestamp)
+        { continue; }
+
+        if (marker.timestamp >= endTimestamp)
+        { break; }
+
+        timeMs += (marker.timestamp - timestamp) * msPerTick;
+        timestamp = marker.timestamp;
+        msPerTick = marker.msPerTick;
+    }
+
+    return timeMs + (endTimestamp - timestamp) * msPerTick;
+}
+
+double MidiRecorder::getTimestampAfter(double startTimestamp, double timeMs) const
+{
+    double timestamp = startTimestamp;
+    double msPerTick = this->getMsPerTickAt(startTimestamp);
+
+    if (timeMs <= 0.0)
+    {
+        return timestamp + timeMs / msPerTick;
+    }
+
+    for (const auto &marker : this->tempoMap)
+    {
+        if (marker.timestamp <= timestamp)
+        { continue; }
+
+        const double segmentMs = (marker.timestamp - timestamp) * msPerTick;
+
+        if (segmentMs >= timeMs)
+        { break; }
+
+        timeMs -= segmentMs;
+        timestamp = marker.timestamp;
+        msPerTick = marker.msPerTick;
+    }
+
+    return timestamp + timeMs / msPerTick;
+}
+
+float MidiRecorder::getBeatForTime(double timeMs) const
+{
+    double startTimestamp = 0.0;
+    double startTimeMs = 0.0;
+
+    {
+        const SpinLock::ScopedLockType lock(this->anchorLock);
+        startTimestamp = this->anchorTimestamp;
+        startTimeMs = this->anchorTimeMs;
+    }
+
+    const double elapsedMs = timeMs - startTimeMs - this->latencyMs;
+    const double timestamp = this->getTimestampAfter(startTimestamp, elapsedMs);
+    return float((timestamp + this->trackStartMs) / Transport::millisecondsPerBeat);
+}
+
+
+//===----------------------------------------------------------------------===//
+// Notes
+//===----------------------------------------------------------------------===//
+
+void MidiRecorder::processPendingMessages()
+{
+    const int numDropped = this->numDroppedMessages.exchange(0);
+
+    if (numDropped > 0)
+    {
+        Logger::writeToLog("MidiRecorder: " + String(numDropped) + " messages dropped, the queue is full");
+    }
+
+    MidiMessage message;
+
+    while (this->queue.removeNextMessage(message))
+    {
+        const float beat = this->getBeatForTime(message.getTimeStamp() * 1000.0);
+        const int noteId = message.getNoteNumber() + message.getChannel() * 128;
+
+        // a key pressed again without being released first ends the previous note
+        this->finishNote(noteId, beat);
+
+        if (message.isNoteOn())
+        {
+            this->heldNotes.set(noteId, { beat, message.getFloatVelocity() });
+        }
+    }
+}
+
+void MidiRecorder::finishNote(int noteId, float endBeat)
+{
+    if (!this->heldNotes.contains(noteId))
+    { return; }
+
+    const HeldNote heldNote = this->heldNotes[noteId];
+    this->heldNotes.remove(noteId);
+
+    const float length = jmax(MIDI_RECORDER_MIN_NOTE_LENGTH, endBeat - heldNote.beat);
+    this->recordedNotes.add(Note(this->layer, noteId % 128, heldNote.beat, length, heldNote.velocity));
+}
@@ -0,0 +1,137 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class Transport;
+class MidiLayer;
+class PianoLayer;
+
+#include "MidiEventsQueue.h"
+#include "Note.h"
+
+#define MIDI_RECORDER_UPDATE_TIME_MS 20
+#define MIDI_RECORDER_MIN_NOTE_LENGTH (1.f / 64.f)
+
+// Records midi input into a piano layer while the transport is playing, owned by Transport.
+//
+// Note events are taken right in the midi input callback, with the driver's timestamps,
+// and pushed into a pre-allocated queue; the message thread drains it periodically,
+// converts the timestamps into beats and pairs note-ons with note-offs.
+//
+// Timestamps are mapped to beats with the tempo map taken at start, counting from
+// the moment the player thread actually started; since the player is heard with
+// the output latency plus one block of the instruments' queues, that much is subtracted.
+// Recorded notes are merged into the layer as a single undoable action on stop,
+// which also happens when the player thread finishes by itself at the end of the track.
+//
+// Recording is never looped: the transport merges the take before restarting
+// the playback, so that the timestamps always map to beats linearly.
+
+class MidiRecorder : private MidiInputCallback, private Timer
+{
+public:
+
+    explicit MidiRecorder(Transport &parentTransport);
+
+    ~MidiRecorder() override;
+
+    void start(PianoLayer *targetLayer, AudioDeviceManager &deviceManager);
+
+    // Merges all the recorded notes into the target layer
+    void stop();
+
+    // Drops everything recorded, i.e. when the target layer is removed
+    void cancel();
+
+    bool isRecording() const noexcept;
+
+    bool isRecordingInto(const MidiLayer *layer) const noexcept;
+
+    // True once the player thread has started for this take
+    bool hasPlaybackAnchor() const noexcept;
+
+    // Called by the player thread right when the playback starts
+    void setPlaybackAnchor(double startTimestamp, double timeMs) noexcept;
+
+private:
+
+    //===------------------------------------------------------------------===//
+    // MidiInputCallback
+    //===------------------------------------------------------------------===//
+
+    void handleIncomingMidiMessage(MidiInput *source, const MidiMessage &message) override;
+
+    //===------------------------------------------------------------------===//
+    // Timer
+    //===------------------------------------------------------------------===//
+
+    void timerCallback() override;
+
+private:
+
+    struct TempoMarker
+    {
+        double timestamp;
+        double msPerTick;
+    };
+
+    struct HeldNote
+    {
+        float beat;
+        float velocity;
+    };
+
+    void buildTempoMap();
+    double getMsPerTickAt(double timestamp) const;
+    double getTimeBetween(double startTimestamp, double endTimestamp) const;
+    double getTimestampAfter(double startTimestamp, double timeMs) const;
+
+    float getBeatForTime(double timeMs) const;
+
+    void processPendingMessages();
+    void finishNote(int noteId, float endBeat);
+    void stopListening();
+
+    Transport &transport;
+
+    AudioDeviceManager *device;
+    PianoLayer *layer;
+
+    MidiEventsQueue queue;
+
+    Array<TempoMarker> tempoMap;
+    double defaultMsPerTick;
+
+    // transport's timestamps are in ticks, relative to the track start
+    double trackStartMs;
+
+    double latencyMs;
+
+    SpinLock anchorLock;
+    double anchorTimestamp;
+    double anchorTimeMs;
+    bool hasAnchor;
+
+    // incremented in the midi input callback when the queue is full
+    Atomic<int> numDroppedMessages;
+
+    HashMap<int, HeldNote> heldNotes; // key + channel * 128 : note
+    Array<Note> recordedNotes;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MidiRecorder)
+};
@@ -21,6 +21,7 @@
 #include "PlayerThread.h"
 #include "Instrument.h"
 #include "MidiLayer.h"
+#include "MidiRecorder.h"
 
 #include "DataEncoder.h"
 
@@ -52,7 +53,6 @@ void PlayerThread::run()
     Array<Instrument *> uniqueInstruments(sequences.getUniqueInstruments());
     
     double TPQN = Transport::millisecondsPerBeat; // ticks-per-quarter-note
-    double nextEventTimeDelta = 0.0;
     
     double tempoAtTheEndOfTrack = 0.0;
     double totalTimeMs = 0.0;
@@ -67,6 +67,10 @@ void PlayerThread::run()
                                        currentTimeMs,
                                        msPerTick);
     
+    // Each loop iteration starts with the same tempo and time
+    const double startMsPerTick = msPerTick;
+    const double startTimeMs = currentTimeMs;
+    
     this->transport.broadcastTempoChanged(msPerTick);
     
     const double startPositionInTime = round(absStartPosition * this->transport.getTotalTime());
@@ -75,43 +79,56 @@ void PlayerThread::run()
     sequences.seekToTime(startPositionInTime);
     double prevTimeStamp = startPositionInTime;
     
+    // The wall clock time at prevTimeStamp: every event is scheduled relative to it,
+    // not to the moment the previous wait has ended, so that timing errors don't add up;
+    // messages are stamped with their scheduled times as well, so that the instruments'
+    // queues place them at the right samples, regardless of when the thread woke up
+    double prevTimeMs = Time::getMillisecondCounterHiRes();
+    
     // This hack is here to keep track of still playing events
     // to be able to send noteOff's when playback interrupts.
     struct HoldingNote
     {
         int key;
         int channel;
-        MidiMessageCollector *listener;
+        MidiEventsQueue *listener;
     };
     // (some plugins just don't understand allNotesOff message)
     Array<HoldingNote> holdingNotes;
     
     // Some shorthand labmdas:
-    auto sendMidiStart = [&uniqueInstruments]()
+    auto sendMidiStart = [&uniqueInstruments, &prevTimeMs]()
     {
         for (auto &instrument : uniqueInstruments)
         {
             MidiMessage startPlayback(MidiMessage::midiStart());
-            startPlayback.setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
-            instrument->getProcessorPlayer().getMidiMessageCollector().addMessageToQueue(startPlayback);
+            startPlayback.setTimeStamp(prevTimeMs * 0.001);
+            instrument->getMidiEventsQueue().addMessageToQueue(startPlayback);
         }
     };
 
-    auto sendHoldingNotesOffAndMidiStop = [&holdingNotes, &uniqueInstruments]()
+    auto sendHoldingNotesOff = [&holdingNotes](double timeMs)
     {
         for (const auto &holding : holdingNotes)
         {
             MidiMessage noteOff(MidiMessage::noteOff(holding.channel, holding.key, 0.f));
-            noteOff.setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
+            noteOff.setTimeStamp(timeMs * 0.001);
             holding.listener->addMessageToQueue(noteOff);
         }
         
+        holdingNotes.clearQuick();
+    };
+
+    auto sendHoldingNotesOffAndMidiStop = [&sendHoldingNotesOff, &uniqueInstruments]()
+    {
+        sendHoldingNotesOff(Time::getMillisecondCounterHiRes());
+        
         MidiMessage stopPlayback(MidiMessage::midiStop());
         stopPlayback.setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
         
         for (auto &instrument : uniqueInstruments)
         {
-            instrument->getProcessorPlayer().getMidiMessageCollector().addMessageToQueue(stopPlayback);
+            instrument->getMidiEventsQueue().addMessageToQueue(stopPlayback);
         }
         
         // Wait until all plugins process the messages in their queues
@@ -122,166 +139,161 @@ void PlayerThread::run()
     {
         for (auto &instrument : uniqueInstruments)
         {
-            instrument->getProcessorPlayer().getMidiMessageCollector().addMessageToQueue(tempoEvent);
+            instrument->getMidiEventsQueue().addMessageToQueue(tempoEvent);
         }
     };
     
+    // Waits until the wall clock time of the given timestamp;
+    // returns false if the thread should exit
+    auto waitUntil = [&](double targetTimeMs, double targetTimeStamp)
+    {
+#if PLAYER_THREAD_SENDS_SEEK_EVENTS
+        
+        double deltaTime = targetTimeMs - Time::getMillisecondCounterHiRes();
+        
+        while (deltaTime > UPDATE_TIME_MS)
+        {
+            // fixme! extremely unsafe, no message manager lock gained
+            this->transport.broadcastSeek((targetTimeStamp - deltaTime / msPerTick) / this->transport.getTotalTime(),
+                                          currentTimeMs,
+                                          totalTimeMs);
+            
+            Time::waitForMillisecondCounter(Time::getMillisecondCounter() + UPDATE_TIME_MS);
+            
+            if (this->threadShouldExit())
+            { return false; }
+            
+            deltaTime = targetTimeMs - Time::getMillisecondCounterHiRes();
+        }
+        
+#endif
+        
+        Time::waitForMillisecondCounter(uint32(ceil(targetTimeMs)));
+        return !this->threadShouldExit();
+    };
+    
     // And here we go.
+    this->transport.recorder->setPlaybackAnchor(startPositionInTime, prevTimeMs);
     sendMidiStart();
     
     while (1)
     {
         MessageWrapper wrapper;
-
-        if (! sequences.getNextMessage(wrapper))
+        
+        const bool hasNextMessage = sequences.getNextMessage(wrapper);
+        
+        // Events at the loop end belong to the next iteration: i.e. the note-offs
+        // of the notes ending right at the loop end are sent as the holding ones
+        const bool reachedLoopEnd = (this->transport.isLooped() &&
+                                     (! hasNextMessage || wrapper.message.getTimeStamp() >= endPositionInTime));
+        
+        if (! hasNextMessage || reachedLoopEnd)
         {
-            nextEventTimeDelta = msPerTick * (endPositionInTime - prevTimeStamp);
-            
-#if PLAYER_THREAD_SENDS_SEEK_EVENTS
+            const double endTimeMs = prevTimeMs + msPerTick * (endPositionInTime - prevTimeStamp);
+            currentTimeMs += msPerTick * (endPositionInTime - prevTimeStamp);
             
-            const double targetTimeStamp = endPositionInTime;
-            const double targetTime = Time::getMillisecondCounterHiRes() + nextEventTimeDelta;
-            double deltaTime = targetTime - Time::getMillisecondCounterHiRes();
-            
-            while (deltaTime > UPDATE_TIME_MS)
+            if (this->transport.isLooped())
             {
-                // fixme! extremely unsafe, no message manager lock gained
-                this->transport.broadcastSeek((targetTimeStamp - deltaTime / msPerTick) / this->transport.getTotalTime(),
-                                              currentTimeMs,
-                                              totalTimeMs);
-                
-                Time::waitForMillisecondCounter(Time::getMillisecondCounter() + UPDATE_TIME_MS);
+                // The next iteration is prepared before the wrap, and is scheduled
+                // from the loop end's time, so that there's no gap at the boundary
+                sequences.seekToTime(startPositionInTime);
                 
-                if (this->threadShouldExit())
+                if (! waitUntil(endTimeMs, endPositionInTime))
                 {
                     sendHoldingNotesOffAndMidiStop();
                     return;
                 }
                 
-                deltaTime = targetTime - Time::getMillisecondCounterHiRes();
-            }
-            
-            Time::waitForMillisecondCounter(Time::getMillisecondCounter() + uint32(deltaTime));
-            
-#else
-            
-            Time::waitForMillisecondCounter(Time::getMillisecondCounter() + uint32(nextEventTimeDelta));
-
-#endif
-            
-            if (this->transport.isLooped())
-            {
-                //Logger::writeToLog("Sekk to time " + String(startPositionInTime));
-                sequences.seekToTime(startPositionInTime);
+                // Only the notes straddling the loop end are still holding at this point,
+                // so they are the only ones released, right at the boundary
+                sendHoldingNotesOff(endTimeMs);
+                
+                if (msPerTick != startMsPerTick)
+                {
+                    msPerTick = startMsPerTick;
+                    this->transport.broadcastTempoChanged(msPerTick);
+                    
+                    MidiMessage tempoEvent(MidiMessage::tempoMetaEvent(int(msPerTick * TPQN * 1000.0)));
+                    tempoEvent.setTimeStamp(endTimeMs * 0.001);
+                    sendTempoChangeToEverybody(tempoEvent);
+                }
+                
                 prevTimeStamp = startPositionInTime;
+                prevTimeMs = endTimeMs;
+                currentTimeMs = startTimeMs;
+                
+                this->transport.broadcastSeek(prevTimeStamp / this->transport.getTotalTime(),
+                                              currentTimeMs, totalTimeMs);
                 continue;
             }
-            else
+            
+            if (! waitUntil(endTimeMs, endPositionInTime))
             {
-                //Logger::writeToLog("Track finished");
                 sendHoldingNotesOffAndMidiStop();
-                this->transport.allNotesControllersAndSoundOff();
-                this->transport.seekToPosition(this->transport.getSeekPosition());
-                this->transport.broadcastStop();
                 return;
             }
+            
+            //Logger::writeToLog("Track finished");
+            sendHoldingNotesOffAndMidiStop();
+            this->transport.allNotesControllersAndSoundOff();
+            this->transport.seekToPosition(this->transport.getSeekPosition());
+            this->transport.broadcastStop();
+            return;
         }
         
-        const bool shouldRewind = (this->transport.isLooped() &&
-                                   (wrapper.message.getTimeStamp() > endPositionInTime));
-        
-        const double nextEventTimeStamp = shouldRewind ? endPositionInTime : wrapper.message.getTimeStamp();
+        const double nextEventTimeStamp = wrapper.message.getTimeStamp();
+        const double nextEventTimeDelta = msPerTick * (nextEventTimeStamp - prevTimeStamp);
+        const double nextEventTimeMs = prevTimeMs + nextEventTimeDelta;
         
         //Logger::writeToLog(String(prevTimeStamp) + " > " + String(nextEventTimeStamp));
         
-        nextEventTimeDelta = msPerTick * (nextEventTimeStamp - prevTimeStamp);
-        
         currentTimeMs += nextEventTimeDelta;
         
-#if PLAYER_THREAD_SENDS_SEEK_EVENTS
-
-        const double targetTimeStamp = nextEventTimeStamp;
-        const double targetTime = Time::getMillisecondCounterHiRes() + nextEventTimeDelta;
-        double deltaTime = targetTime - Time::getMillisecondCounterHiRes();
-        
-        while (deltaTime > UPDATE_TIME_MS)
-        {
-            this->transport.broadcastSeek((targetTimeStamp - deltaTime / msPerTick) / this->transport.getTotalTime(),
-                                          currentTimeMs,
-                                          totalTimeMs);
-            
-            Time::waitForMillisecondCounter(Time::getMillisecondCounter() + UPDATE_TIME_MS);
-            
-            if (this->threadShouldExit())
-            {
-                sendHoldingNotesOffAndMidiStop();
-                return;
-            }
-        
-            deltaTime = targetTime - Time::getMillisecondCounterHiRes();
-        }
-        
-        
-        Time::waitForMillisecondCounter(Time::getMillisecondCounter() + uint32(deltaTime));
-        
-#else
-      
-        Time::waitForMillisecondCounter(Time::getMillisecondCounter() + uint32(nextEventTimeDelta));
-        
-        if (this->threadShouldExit())
+        if (! waitUntil(nextEventTimeMs, nextEventTimeStamp))
         {
             sendHoldingNotesOffAndMidiStop();
             return;
         }
         
-#endif
-        
         prevTimeStamp = nextEventTimeStamp;
+        prevTimeMs = nextEventTimeMs;
 
         this->transport.broadcastSeek(prevTimeStamp / this->transport.getTotalTime(),
                                       currentTimeMs, totalTimeMs);
         
-        if (shouldRewind)
+        const int key = wrapper.message.getNoteNumber();
+        const int channel = wrapper.message.getChannel();
+        wrapper.message.setTimeStamp(nextEventTimeMs * 0.001);
+        
+        // Master tempo event is sent to everybody
+        if (wrapper.message.isTempoMetaEvent())
         {
-            sequences.seekToTime(startPositionInTime);
-            prevTimeStamp = startPositionInTime;
+            msPerTick = wrapper.message.getTempoSecondsPerQuarterNote() * 1000.f / TPQN;
+            this->transport.broadcastTempoChanged(msPerTick);
+            
+            // Sends this to everybody (need to do that for drum-machines) - TODO test
+            sendTempoChangeToEverybody(wrapper.message);
         }
         else
         {
-            const int key = wrapper.message.getNoteNumber();
-            const int channel = wrapper.message.getChannel();
-            wrapper.message.setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
-            
-            // Master tempo event is sent to everybody
-            if (wrapper.message.isTempoMetaEvent())
-            {
-                msPerTick = wrapper.message.getTempoSecondsPerQuarterNote() * 1000.f / TPQN;
-                this->transport.broadcastTempoChanged(msPerTick);
-                
-                // Sends this to everybody (need to do that for drum-machines) - TODO test
-                sendTempoChangeToEverybody(wrapper.message);
-            }
-            else
-            {
-                wrapper.listener->addMessageToQueue(wrapper.message);
-            }
-            
-            if (wrapper.message.isNoteOn())
-            {
-                holdingNotes.add(HoldingNote({key, channel, wrapper.listener}));
-            }
-            
-            if (wrapper.message.isNoteOff())
+            wrapper.listener->addMessageToQueue(wrapper.message);
+        }
+        
+        if (wrapper.message.isNoteOn())
+        {
+            holdingNotes.add(HoldingNote({key, channel, wrapper.listener}));
+        }
+        
+        if (wrapper.message.isNoteOff())
+        {
+            for (int i = 0; i < holdingNotes.size(); ++i)
             {
-                for (int i = 0; i < holdingNotes.size(); ++i)
+                if (holdingNotes[i].key == key &&
+                    holdingNotes[i].channel == channel &&
+                    holdingNotes[i].listener == wrapper.listener)
                 {
-                    if (holdingNotes[i].key == key &&
-                        holdingNotes[i].channel == channel &&
-                        holdingNotes[i].listener == wrapper.listener)
-                    {
-                        holdingNotes.remove(i);
-                        break;
-                    }
+                    holdingNotes.remove(i);
+                    break;
                 }
             }
         }
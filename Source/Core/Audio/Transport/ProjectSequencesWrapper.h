@@ -26,7 +26,7 @@ struct SequenceWrapper : public ReferenceCountedObject
 {
     MidiMessageSequence sequence;
     int currentIndex;
-    MidiMessageCollector *listener;
+    MidiEventsQueue *listener;
     Instrument *instrument;
     const MidiLayer *layer;
     typedef ReferenceCountedObjectPtr<SequenceWrapper> Ptr;
@@ -35,7 +35,7 @@ struct SequenceWrapper : public ReferenceCountedObject
 struct MessageWrapper : public ReferenceCountedObject
 {
     MidiMessage message;
-    MidiMessageCollector *listener;
+    MidiEventsQueue *listener;
     Instrument *instrument;
     typedef ReferenceCountedObjectPtr<MessageWrapper> Ptr;
 };
@@ -137,18 +137,26 @@ public:
     int getNextIndexAtTime(const MidiMessageSequence &sequence,
                            const double timeStamp) const
     {
-        const int numEvents = sequence.getNumEvents();
+        // sequences are sorted, so a binary search is enough
+        // to start playback from the middle of a long project
+        int start = 0;
+        int end = sequence.getNumEvents();
         
-        int i = 0;
-        for (; i < numEvents; ++i)
+        while (start < end)
         {
-            if (sequence.getEventPointer(i)->message.getTimeStamp() >= timeStamp)
+            const int middle = (start + end) / 2;
+            
+            if (sequence.getEventPointer(middle)->message.getTimeStamp() < timeStamp)
+            {
+                start = middle + 1;
+            }
+            else
             {
-                break;
+                end = middle;
             }
         }
         
-        return i;
+        return start;
     }
     
     void seekToZeroIndexes()
@@ -45,7 +45,49 @@ float RendererThread::getPercentsComplete() const
 }
 
 
-void RendererThread::startRecording(const File &file)
+AudioFormatWriter *RendererThread::createWriterFor(const File &file, double sampleRate, int numChannels)
+{
+    // Create an OutputStream to write to our destination file...
+    file.deleteFile();
+    ScopedPointer<FileOutputStream> fileStream(file.createOutputStream());
+
+    if (fileStream == nullptr)
+    {
+        return nullptr;
+    }
+
+    ScopedPointer<AudioFormat> format;
+    const String extension = file.getFileExtension().toLowerCase();
+
+    if (extension == ".wav")
+    {
+        format = new WavAudioFormat();
+    }
+    else if (extension == ".ogg")
+    {
+        format = new OggVorbisAudioFormat();
+    }
+    else if (extension == ".flac")
+    {
+        format = new FlacAudioFormat();
+    }
+
+    if (format == nullptr)
+    {
+        return nullptr;
+    }
+
+    AudioFormatWriter *writer = format->createWriterFor(fileStream, sampleRate, numChannels, 16, StringPairArray(), 0);
+
+    if (writer != nullptr)
+    {
+        fileStream.release(); // (passes responsibility for deleting the stream to the writer object that is now using it)
+    }
+
+    return writer;
+}
+
+void RendererThread::startRecording(const File &file, bool renderStems)
 {
     this->transport.rebuildSequencesIfNeeded();
     const ProjectSequences sequences = this->transport.getSequences();
@@ -60,47 +102,98 @@ void RendererThread::startRecording(const File &file)
     double sampleRate = sequences.getSampleRate();
     int numChannels = sequences.getNumOutputChannels();
 
-    // Create an OutputStream to write to our destination file...
-    file.deleteFile();
-    ScopedPointer<FileOutputStream> fileStream(file.createOutputStream());
+    Array<AudioFormatWriter *> newWriters;
+    Array<Instrument *> stemInstruments;
 
-    if (fileStream != nullptr)
+    if (AudioFormatWriter *masterWriter = createWriterFor(file, sampleRate, numChannels))
     {
+        newWriters.add(masterWriter);
+    }
+    else
+    {
+        return;
+    }
+
+    {
+        const ScopedWriteLock pl(this->percentsLock);
+        this->percentsDone = 0.f;
+    }
+
+    const String extension = file.getFileExtension().toLowerCase();
+
+    if (extension == ".wav")
+    {
+        Supervisor::track(Serialization::Activities::transportRenderWav);
+    }
+    else if (extension == ".ogg")
+    {
+        Supervisor::track(Serialization::Activities::transportRenderOgg);
+    }
+    else if (extension == ".flac")
+    {
+        Supervisor::track(Serialization::Activities::transportRenderFlac);
+    }
+
+    Logger::writeToLog(file.getFullPathName());
+
+    if (renderStems)
+    {
+        StringArray usedNames;
+
+        for (auto instrument : sequences.getUniqueInstruments())
         {
-            const ScopedWriteLock pl(this->percentsLock);
-            this->percentsDone = 0.f;
-        }
-        
-        if (file.getFileExtension().toLowerCase() == ".wav")
-        {
-            Supervisor::track(Serialization::Activities::transportRenderWav);
-            WavAudioFormat wavFormat;
-            const ScopedLock sl(this->writerLock);
-            this->writer = wavFormat.createWriterFor(fileStream, sampleRate, numChannels, 16, StringPairArray(), 0);
-        }
-        else if (file.getFileExtension().toLowerCase() == ".ogg")
-        {
-            Supervisor::track(Serialization::Activities::transportRenderOgg);
-            OggVorbisAudioFormat oggVorbisFormat;
-            const ScopedLock sl(this->writerLock);
-            this->writer = oggVorbisFormat.createWriterFor(fileStream, sampleRate, numChannels, 16, StringPairArray(), 0);
+            String stemName = file.getFileNameWithoutExtension() + " - " +
+                              File::createLegalFileName(instrument->getName());
+
+            for (int i = 2; usedNames.contains(stemName, true); ++i)
+            {
+                stemName = file.getFileNameWithoutExtension() + " - " +
+                           File::createLegalFileName(instrument->getName()) + " " + String(i);
+            }
+
+            usedNames.add(stemName);
+
+            const File stemFile(file.getSiblingFile(stemName + file.getFileExtension()));
+
+            if (AudioFormatWriter *stemWriter = createWriterFor(stemFile, sampleRate, numChannels))
+            {
+                Logger::writeToLog(stemFile.getFullPathName());
+                newWriters.add(stemWriter);
+                stemInstruments.add(instrument);
+            }
         }
-        else if (file.getFileExtension().toLowerCase() == ".flac")
+    }
+
+    {
+        const ScopedLock sl(this->writerLock);
+
+        const int numWriterThreads = jmin(newWriters.size(), RENDERER_THREAD_MAX_WRITER_THREADS);
+
+        for (int i = 0; i < numWriterThreads; ++i)
         {
-            Supervisor::track(Serialization::Activities::transportRenderFlac);
-            FlacAudioFormat flacFormat;
-            const ScopedLock sl(this->writerLock);
-            this->writer = flacFormat.createWriterFor(fileStream, sampleRate, numChannels, 16, StringPairArray(), 0);
+            auto writerThread = new TimeSliceThread("RenderWriterThread");
+            writerThread->startThread();
+            this->writerThreads.add(writerThread);
         }
 
-        if (writer != nullptr)
+        // writers are spread over the threads, so that encoding of the stems goes in parallel
+        this->writer = new AudioFormatWriter::ThreadedWriter(newWriters.getFirst(),
+                                                             *this->writerThreads.getFirst(),
+                                                             RENDERER_THREAD_WRITER_BUFFER_SIZE);
+
+        for (int i = 0; i < stemInstruments.size(); ++i)
         {
-            Logger::writeToLog(file.getFullPathName());
-            Supervisor::track(Serialization::Activities::transportStartRender);
-            fileStream.release(); // (passes responsibility for deleting the stream to the writer object that is now using it)
-            this->startThread(9);
+            auto stem = new Stem();
+            stem->instrument = stemInstruments[i];
+            stem->writer = new AudioFormatWriter::ThreadedWriter(newWriters[i + 1],
+                                                                 *this->writerThreads[(i + 1) % numWriterThreads],
+                                                                 RENDERER_THREAD_WRITER_BUFFER_SIZE);
+            this->stems.add(stem);
         }
     }
+
+    Supervisor::track(Serialization::Activities::transportStartRender);
+    this->startThread(9);
 }
 
 void RendererThread::stop()
@@ -111,10 +204,17 @@ void RendererThread::stop()
         this->stopThread(500);
     }
 
-    {
-        const ScopedLock sl(this->writerLock);
-        this->writer = nullptr;
-    }
+    this->resetWriters();
+}
+
+void RendererThread::resetWriters()
+{
+    const ScopedLock sl(this->writerLock);
+
+    // the writers flush what they have buffered, and only then the threads are stopped
+    this->stems.clear();
+    this->writer = nullptr;
+    this->writerThreads.clear();
 }
 
 bool RendererThread::isRecording() const
@@ -131,6 +231,7 @@ bool RendererThread::isRecording() const
 struct RenderBuffer
 {
     Instrument *instrument;
+    AudioFormatWriter::ThreadedWriter *stemWriter;
     AudioSampleBuffer sampleBuffer;
     MidiBuffer midiBuffer;
 };
@@ -168,10 +269,37 @@ void RendererThread::run()
         Instrument *instrument = uniqueInstruments[i];
         auto subBuffer = new RenderBuffer();
         subBuffer->instrument = instrument;
+        subBuffer->stemWriter = nullptr;
         subBuffer->sampleBuffer = AudioSampleBuffer(numOutChannels, bufferSize);
         subBuffers.add(subBuffer);
+
+        const ScopedLock sl(this->writerLock);
+
+        for (auto stem : this->stems)
+        {
+            if (stem->instrument == instrument)
+            {
+                subBuffer->stemWriter = stem->writer;
+            }
+        }
     }
 
+    // only blocks when the disk is lagging behind, as the writers are flushed on other threads
+    auto writeBuffer = [this](AudioFormatWriter::ThreadedWriter *targetWriter, const AudioSampleBuffer &buffer)
+    {
+        while (! targetWriter->write(buffer.getArrayOfReadPointers(), buffer.getNumSamples()))
+        {
+            if (this->threadShouldExit())
+            {
+                return;
+            }
+
+            Thread::sleep(1);
+        }
+    };
+
+    const double renderStartTime = Time::getMillisecondCounterHiRes();
+
     // step 2. release resources, prepare to play, etc.
     for (auto subBuffer : subBuffers)
     {
@@ -268,11 +396,17 @@ void RendererThread::run()
             }
         }
 
-        // step 3c. mix them down to the render buffer.
+        // step 3c. mix them down to the render buffer, writing the stems on the way.
         mixingBuffer.clear();
 
         for (auto subBuffer : subBuffers)
         {
+            if (subBuffer->stemWriter != nullptr)
+            {
+                const ScopedLock sl(this->writerLock);
+                writeBuffer(subBuffer->stemWriter, subBuffer->sampleBuffer);
+            }
+
             for (int j = 0; j < numOutChannels; ++j)
             {
                 mixingBuffer.addFrom(j, 0,
@@ -285,13 +419,7 @@ void RendererThread::run()
         // step 3d. write resulting buffer to disk.
         {
             const ScopedLock sl(this->writerLock);
-            bool writedSuccessfullty = false;
-            
-            while (! writedSuccessfullty)
-            {
-                writedSuccessfullty =
-                this->writer->writeFromAudioSampleBuffer(mixingBuffer, 0, mixingBuffer.getNumSamples());
-            }
+            writeBuffer(this->writer, mixingBuffer);
         }
 
         // step 3e. finally, update counters.
@@ -311,10 +439,16 @@ void RendererThread::run()
         graph->setNonRealtime(false);
     }
     
-    {
-        const ScopedLock sl(this->writerLock);
-        this->writer = nullptr;
-    }
+    // the time reported includes flushing all the writers
+    const int numFiles = this->stems.size() + 1;
+    this->resetWriters();
+
+    const double renderTimeSeconds = (Time::getMillisecondCounterHiRes() - renderStartTime) / 1000.0;
+    const double audioTimeSeconds = currentFrame / sampleRate;
+
+    Logger::writeToLog("Rendered " + String(audioTimeSeconds, 1) + "s of audio into " +
+                       String(numFiles) + " files in " + String(renderTimeSeconds, 1) + "s, " +
+                       String(audioTimeSeconds / jmax(0.001, renderTimeSeconds), 1) + "x realtime");
     
     Supervisor::track(Serialization::Activities::transportFinishRender);
     
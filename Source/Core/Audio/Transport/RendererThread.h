@@ -19,6 +19,14 @@
 
 #include "Transport.h"
 
+// Samples buffered by each writer, before they're written by the background threads
+#define RENDERER_THREAD_WRITER_BUFFER_SIZE (1 << 16)
+#define RENDERER_THREAD_MAX_WRITER_THREADS 4
+
+// Renders the project in a single pass; optionally, each instrument's output
+// is also written into a separate file next to the master one, i.e. "song - piano.wav".
+// Writers are buffered, and encoding and disk writes are done on background threads.
+
 class RendererThread : private Thread
 {
 public:
@@ -29,7 +37,7 @@ public:
     
     float getPercentsComplete() const;
 
-    void startRecording(const File &file);
+    void startRecording(const File &file, bool renderStems = false);
 
     void stop();
 
@@ -45,10 +53,25 @@ private:
 
 private:
 
+    struct Stem
+    {
+        Instrument *instrument;
+        ScopedPointer<AudioFormatWriter::ThreadedWriter> writer;
+    };
+
+    static AudioFormatWriter *createWriterFor(const File &file, double sampleRate, int numChannels);
+
+    void resetWriters();
+
     Transport &transport;
 
     CriticalSection writerLock;
-    ScopedPointer<AudioFormatWriter> writer;
+
+    // declared before the writers, which use them
+    OwnedArray<TimeSliceThread> writerThreads;
+
+    ScopedPointer<AudioFormatWriter::ThreadedWriter> writer;
+    OwnedArray<Stem> stems;
 
     ReadWriteLock percentsLock;
     float percentsDone;
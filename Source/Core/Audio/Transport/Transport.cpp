@@ -21,8 +21,11 @@
 #include "OrchestraPit.h"
 #include "PlayerThread.h"
 #include "RendererThread.h"
+#include "MidiRecorder.h"
 #include "MidiLayer.h"
 #include "MidiEvent.h"
+#include "PianoLayer.h"
+#include "AutomationEvent.h"
 
 #include "App.h"
 #include "Workspace.h"
@@ -46,18 +49,28 @@ Transport::Transport(OrchestraPit &orchestraPit) :
     loopStart(0.0),
     loopEnd(0.0),
     projectFirstBeat(0.f),
-    projectLastBeat(DEFAULT_NUM_BARS * NUM_BEATS_IN_BAR)
+    projectLastBeat(DEFAULT_NUM_BARS * NUM_BEATS_IN_BAR),
+    defaultInstrumentHandle(0)
 {
     this->player = new PlayerThread(*this);
     this->renderer = new RendererThread(*this);
+    this->recorder = new MidiRecorder(*this);
 
+    this->updateInstrumentsCache();
     this->orchestra.addOrchestraListener(this);
 }
 
 Transport::~Transport()
 {
     this->orchestra.removeOrchestraListener(this);
+
+    for (auto instrument : this->orchestra.getInstruments())
+    {
+        instrument->removeChangeListener(this);
+    }
     
+    this->recorder->cancel();
+
     if (this->player->isThreadRunning())
     {
         this->player->stopThread(500);
@@ -175,37 +188,54 @@ void Transport::seekToPosition(double absPosition)
 
 void Transport::probeSoundAt(double absTrackPosition, const MidiLayer *limitToLayer)
 {
-    this->rebuildSequencesIfNeeded();
-    
+    // Sequences are not needed here: each piano layer keeps an interval index
+    // of its notes, so this is a O(log n + k) lookup per layer, not a full sweep
     const double targetFlatTime = round(this->getTotalTime() * absTrackPosition);
-    const auto sequencesToProbe(this->sequences.getAllFor(limitToLayer));
-    
-    for (auto && i : sequencesToProbe)
+    const float targetBeat = float((targetFlatTime + this->trackStartMs) / Transport::millisecondsPerBeat);
+    const double timeNow = Time::getMillisecondCounterHiRes() * 0.001;
+
+    Array<const Note *> soundingNotes;
+
+    for (int i = 0; i < this->layersCache.size(); ++i)
     {
-        SequenceWrapper::Ptr seq(i);
+        const MidiLayer *layer = this->layersCache.getUnchecked(i);
+
+        if (limitToLayer != nullptr && limitToLayer != layer)
+        { continue; }
+
+        const PianoLayer *pianoLayer = dynamic_cast<const PianoLayer *>(layer);
+
+        if (pianoLayer == nullptr || pianoLayer->isMuted())
+        { continue; }
+
+        Instrument *targetInstrument = this->findInstrumentForLayer(layer);
 
-        for (int j = 0; j < seq->sequence.getNumEvents(); ++j)
+        if (targetInstrument == nullptr)
+        { continue; }
+
+        soundingNotes.clearQuick();
+        pianoLayer->findNotesAt(targetBeat, soundingNotes);
+
+        for (auto note : soundingNotes)
         {
-            MidiMessageSequence::MidiEventHolder *noteOnHolder = seq->sequence.getEventPointer(j);
-            
-            if (MidiMessageSequence::MidiEventHolder *noteOffHolder = noteOnHolder->noteOffObject)
-            {
-                const double noteOn(noteOnHolder->message.getTimeStamp());
-                const double noteOff(noteOffHolder->message.getTimeStamp());
-                
-                if (noteOn <= targetFlatTime && noteOff > targetFlatTime)
-                {
-                    MidiMessage messageTimestampedAsNow(noteOnHolder->message);
-                    messageTimestampedAsNow.setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
-                    seq->listener->addMessageToQueue(messageTimestampedAsNow);
-                }
-            }
+            MidiMessage messageTimestampedAsNow(MidiMessage::noteOn(layer->getChannel(),
+                                                                    note->getKey(),
+                                                                    note->getVelocity()));
+            messageTimestampedAsNow.setTimeStamp(timeNow);
+            targetInstrument->getMidiEventsQueue().addMessageToQueue(messageTimestampedAsNow);
         }
     }
 }
 
 void Transport::startPlayback()
 {
+    // restarting the player would re-anchor the take in the middle,
+    // so a take that is already playing is merged, but a just started one is kept
+    if (this->recorder->hasPlaybackAnchor())
+    {
+        this->recorder->stop();
+    }
+
     this->rebuildSequencesIfNeeded();
 
     if (this->player->isThreadRunning() &&
@@ -223,6 +253,9 @@ void Transport::startPlayback()
 
 void Transport::startPlaybackLooped(double absLoopStart, double absLoopEnd)
 {
+    // recording is not looped, see MidiRecorder
+    this->recorder->stop();
+
     this->rebuildSequencesIfNeeded();
     
     if (this->player->isThreadRunning() &&
@@ -251,6 +284,8 @@ void Transport::stopPlayback()
         this->seekToPosition(this->getSeekPosition());
         this->broadcastStop();
     }
+
+    this->recorder->stop();
 }
 
 bool Transport::isPlaying() const
@@ -273,8 +308,23 @@ double Transport::getLoopEnd() const
     return this->loopEnd;
 }
 
+void Transport::startRecording(PianoLayer *targetLayer)
+{
+    // merges the previous take, if any
+    this->stopPlayback();
+
+    // the recorder waits for the player thread to start
+    this->recorder->start(targetLayer, App::Workspace().getAudioCore().getDevice());
+    this->startPlayback();
+}
 
-void Transport::startRender(const String &fileName)
+bool Transport::isRecording() const
+{
+    return this->recorder->isRecording();
+}
+
+
+void Transport::startRender(const String &fileName, bool renderStems)
 {
     if (this->renderer->isRecording())
     {
@@ -284,7 +334,7 @@ void Transport::startRender(const String &fileName)
     App::Workspace().getAudioCore().mute();
     
     File file(File::getCurrentWorkingDirectory().getChildFile(fileName));
-    this->renderer->startRecording(file);
+    this->renderer->startRecording(file, renderStems);
 }
 
 void Transport::stopRender()
@@ -317,21 +367,25 @@ float Transport::getRenderingPercentsComplete() const
 // Sending messages at realtime
 //===----------------------------------------------------------------------===//
 
-void Transport::sendMidiMessage(const String &layerId, const MidiMessage &message) const
+void Transport::sendMidiMessage(const MidiLayer *layer, const MidiMessage &message) const
 {
+    Instrument *targetInstrument = this->findInstrumentForLayer(layer);
+
+    if (targetInstrument == nullptr)
+    { return; }
+
     MidiMessage messageTimestampedAsNow(message);
     
 #if HELIO_MOBILE
     // iSEM tends to hang >_< if too many messages are send simultaniously
-    messageTimestampedAsNow.setTimeStamp(Time::getMillisecondCounter() + (rand() % 50));
+    messageTimestampedAsNow.setTimeStamp((Time::getMillisecondCounter() + (rand() % 50)) * 0.001);
 #elif HELIO_DESKTOP
     messageTimestampedAsNow.setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
 #endif
     
-    MidiMessageCollector *collector =
-    &this->linksCache[layerId]->getProcessorPlayer().getMidiMessageCollector();
-    
-    collector->addMessageToQueue(messageTimestampedAsNow);
+    // the same queue as the playback uses, so that auditioning
+    // never takes the collector's lock shared with the audio callback
+    targetInstrument->getMidiEventsQueue().addMessageToQueue(messageTimestampedAsNow);
 }
 
 void Transport::allNotesAndControllersOff() const
@@ -341,21 +395,23 @@ void Transport::allNotesAndControllersOff() const
         const MidiMessage notesOff(MidiMessage::allNotesOff(c));
         const MidiMessage controllersOff(MidiMessage::allControllersOff(c));
         
-        Array<MidiMessageCollector *>duplicateCollectors;
+        Array<MidiEventsQueue *> duplicateQueues;
         
         for (int l = 0; l < this->layersCache.size(); ++l)
         {
-            const String &layerId =
-            this->layersCache.getUnchecked(l)->getLayerIdAsString();
+            const MidiLayer *layer = this->layersCache.getUnchecked(l);
+            Instrument *instrument = this->findInstrumentForLayer(layer);
             
-            MidiMessageCollector *collector =
-            &this->linksCache[layerId]->getProcessorPlayer().getMidiMessageCollector();
+            if (instrument == nullptr)
+            { continue; }
             
-            if (! duplicateCollectors.contains(collector))
+            MidiEventsQueue *queue = &instrument->getMidiEventsQueue();
+            
+            if (! duplicateQueues.contains(queue))
             {
-                this->sendMidiMessage(layerId, notesOff);
-                this->sendMidiMessage(layerId, controllersOff);
-                duplicateCollectors.add(collector);
+                this->sendMidiMessage(layer, notesOff);
+                this->sendMidiMessage(layer, controllersOff);
+                duplicateQueues.add(queue);
             }
         }
     }
@@ -369,22 +425,24 @@ void Transport::allNotesControllersAndSoundOff() const
         const MidiMessage soundOff(MidiMessage::allSoundOff(c));
         const MidiMessage controllersOff(MidiMessage::allControllersOff(c));
         
-        Array<MidiMessageCollector *>duplicateCollectors;
+        Array<MidiEventsQueue *> duplicateQueues;
         
         for (int l = 0; l < this->layersCache.size(); ++l)
         {
-            const String &layerId =
-            this->layersCache.getUnchecked(l)->getLayerIdAsString();
+            const MidiLayer *layer = this->layersCache.getUnchecked(l);
+            Instrument *instrument = this->findInstrumentForLayer(layer);
+            
+            if (instrument == nullptr)
+            { continue; }
             
-            MidiMessageCollector *collector =
-            &this->linksCache[layerId]->getProcessorPlayer().getMidiMessageCollector();
+            MidiEventsQueue *queue = &instrument->getMidiEventsQueue();
             
-            if (! duplicateCollectors.contains(collector))
+            if (! duplicateQueues.contains(queue))
             {
-                this->sendMidiMessage(layerId, notesOff);
-                this->sendMidiMessage(layerId, controllersOff);
-                this->sendMidiMessage(layerId, soundOff);
-                duplicateCollectors.add(collector);
+                this->sendMidiMessage(layer, notesOff);
+                this->sendMidiMessage(layer, controllersOff);
+                this->sendMidiMessage(layer, soundOff);
+                duplicateQueues.add(queue);
             }
         }
     }
@@ -401,11 +459,8 @@ void Transport::instrumentAdded(Instrument *instrument)
     
     // invalidate sequences as they use pointers to the players too
     this->sequencesAreOutdated = true;
-
-    for (int i = 0; i < this->layersCache.size(); ++i)
-    {
-        this->updateLinkForLayer(this->layersCache.getUnchecked(i));
-    }
+    this->updateInstrumentsCache();
+    this->updateLinksForAllLayers();
 }
 
 void Transport::instrumentRemoved(Instrument *instrument)
@@ -413,15 +468,40 @@ void Transport::instrumentRemoved(Instrument *instrument)
     // the instrument stack have still not changed here,
     // so just stop the playback before it's too late
     this->stopPlayback();
+    instrument->removeChangeListener(this);
+
+    // the links to it are resolved to nothing until they are updated
+    this->instrumentsCache.remove(instrument->getHandle());
 }
 
 void Transport::instrumentRemovedPostAction()
 {
     this->sequencesAreOutdated = true;
+    this->updateInstrumentsCache();
+    this->updateLinksForAllLayers();
+}
+
+
+//===----------------------------------------------------------------------===//
+// ChangeListener
+//===----------------------------------------------------------------------===//
+
+void Transport::changeListenerCallback(ChangeBroadcaster *source)
+{
+    // a change message is sent on any change of an instrument, and rebuilding
+    // the tables is cheap, but the sequences are only rebuilt if any link has changed
+    this->updateInstrumentsCache();
 
     for (int i = 0; i < this->layersCache.size(); ++i)
     {
-        this->updateLinkForLayer(this->layersCache.getUnchecked(i));
+        const MidiLayer *layer = this->layersCache.getUnchecked(i);
+        const int oldHandle = this->linksCache[layer];
+        this->updateLinkForLayer(layer);
+
+        if (this->linksCache[layer] != oldHandle)
+        {
+            this->sequencesAreOutdated = true;
+        }
     }
 }
 
@@ -486,6 +566,21 @@ void Transport::onEventRemovedPostAction(const MidiLayer *layer)
     this->sequencesAreOutdated = true;
 }
 
+void Transport::onEventsChanged(const MidiEventsChangeSet &changes)
+{
+    if (this->player->isThreadRunning())
+    { this->stopPlayback(); }
+    
+    // a hack, done once per group; removals seek in onEventRemovedPostAction
+    if (changes.getLayer()->getControllerNumber() == MidiLayer::tempoController &&
+        changes.getNumRemovedEvents() == 0)
+    {
+        this->seekToPosition(this->getSeekPosition());
+    }
+    
+    this->sequencesAreOutdated = true;
+}
+
 void Transport::onLayerChanged(const MidiLayer *layer)
 {
     if (this->player->isThreadRunning())
@@ -507,6 +602,9 @@ void Transport::onLayerAdded(const MidiLayer *layer)
 
 void Transport::onLayerRemoved(const MidiLayer *layer)
 {
+    if (this->recorder->isRecordingInto(layer))
+    { this->recorder->cancel(); }
+
     if (this->player->isThreadRunning())
     {this->stopPlayback(); }
     
@@ -605,18 +703,31 @@ void Transport::calcTimeAndTempoAt(const double targetAbsPosition,
 
 MidiMessage Transport::findFirstTempoEvent()
 {
-    this->rebuildSequencesIfNeeded();
-    this->sequences.seekToZeroIndexes();
-    
-    MessageWrapper wrapper;
-    
-    while (this->sequences.getNextMessage(wrapper))
+    // Layer events are sorted, so only the first event of each tempo layer
+    // needs to be checked, instead of merging all the sequences
+    const AutomationEvent *firstTempoEvent = nullptr;
+
+    for (int i = 0; i < this->layersCache.size(); ++i)
     {
-        if (wrapper.message.isTempoMetaEvent())
+        const MidiLayer *layer = this->layersCache.getUnchecked(i);
+
+        if (!layer->isTempoLayer() || layer->isMuted() || layer->size() == 0)
+        { continue; }
+
+        const auto event = static_cast<const AutomationEvent *>(layer->getUnchecked(0));
+
+        if (firstTempoEvent == nullptr || event->getBeat() < firstTempoEvent->getBeat())
         {
-            return wrapper.message;
+            firstTempoEvent = event;
         }
     }
+
+    if (firstTempoEvent != nullptr)
+    {
+        MidiMessage tempoEvent(firstTempoEvent->getSequence().getFirst());
+        tempoEvent.addToTimeStamp(-this->trackStartMs);
+        return tempoEvent;
+    }
     
     return MidiMessage::tempoMetaEvent(Transport::millisecondsPerBeat * 1000);
 }
@@ -640,13 +751,13 @@ void Transport::rebuildSequencesIfNeeded()
             
             if (sequence.getNumEvents() > 0)
             {
-                Instrument *targetInstrument = this->linksCache[layer->getLayerId().toString()];
+                Instrument *targetInstrument = this->findInstrumentForLayer(layer);
                 auto wrapper = new SequenceWrapper();
                 wrapper->layer = layer;
                 wrapper->sequence = sequence;
                 wrapper->currentIndex = 0;
                 wrapper->instrument = targetInstrument;
-                wrapper->listener = &targetInstrument->getProcessorPlayer().getMidiMessageCollector();
+                wrapper->listener = &targetInstrument->getMidiEventsQueue();
                 this->sequences.addWrapper(wrapper);
             }
         }
@@ -661,50 +772,78 @@ ProjectSequences Transport::getSequences()
     return this->sequences;
 }
 
-void Transport::updateLinkForLayer(const MidiLayer *layer)
+Instrument *Transport::findInstrumentForLayer(const MidiLayer *layer) const
 {
-//    Instrument *targetInstrument = this->orchestra.findInstrumentById(layer->getInstrumentId());
-//    
-//    if (targetInstrument != nullptr)
-//    {
-//        this->linksCache.set(layer->getLayerId().toString(), targetInstrument);
-//        return;
-//    }
+    return this->instrumentsCache[this->linksCache[layer]];
+}
+
+void Transport::updateInstrumentsCache()
+{
+    this->instrumentsCache.clear();
+    this->instrumentIdsCache.clear();
+    this->instrumentHashesCache.clear();
     
     const Array<Instrument *> instruments = this->orchestra.getInstruments();
+    this->defaultInstrumentHandle = (instruments.size() > 0) ? instruments.getFirst()->getHandle() : 0;
     
-    // check by ids
-    for (int i = 1; i < instruments.size(); ++i)
+    for (int i = 0; i < instruments.size(); ++i)
     {
         Instrument *instrument = instruments.getUnchecked(i);
+        this->instrumentsCache.set(instrument->getHandle(), instrument);
+        instrument->addChangeListener(this); // only added once
         
-        if (layer->getInstrumentId().contains(instrument->getInstrumentID()))
+        // the default instrument is never matched explicitly, it is the fallback anyway;
+        // if several instruments have the same hash, the first one wins
+        if (i > 0)
         {
-            // corresponding node already exists, lets addd
-            this->linksCache.set(layer->getLayerId().toString(), instrument);
-            return;
+            this->instrumentIdsCache.set(instrument->getInstrumentID(), instrument->getHandle());
+            
+            const String hash(instrument->getInstrumentHash());
+            
+            if (! this->instrumentHashesCache.contains(hash))
+            {
+                this->instrumentHashesCache.set(hash, instrument->getHandle());
+            }
         }
     }
+}
+
+void Transport::updateLinksForAllLayers()
+{
+    for (int i = 0; i < this->layersCache.size(); ++i)
+    {
+        this->updateLinkForLayer(this->layersCache.getUnchecked(i));
+    }
+}
+
+void Transport::updateLinkForLayer(const MidiLayer *layer)
+{
+    // Layers keep instrument's id followed by its hash (see Instrument::getIdAndHash),
+    // both are md5/uuid hex strings of the same length; older projects may only have one of them
+    static const int idLength = Uuid().toString().length();
+    const String &layerInstrumentId = layer->getInstrumentId();
+    
+    // check by ids
+    int handle = this->instrumentIdsCache[layerInstrumentId.substring(0, idLength)];
     
     // check by hashes
-    for (int i = 1; i < instruments.size(); ++i)
+    if (handle == 0)
     {
-        Instrument *instrument = instruments.getUnchecked(i);
-        
-        if (layer->getInstrumentId().contains(instrument->getInstrumentHash()))
-        {
-            this->linksCache.set(layer->getLayerId().toString(), instrument);
-            return;
-        }
+        handle = this->instrumentHashesCache[layerInstrumentId.getLastCharacters(idLength)];
     }
     
     // set default instrument, if none found
-    this->linksCache.set(layer->getLayerId().toString(), this->orchestra.getInstruments()[0]);
+    if (handle == 0)
+    {
+        handle = this->defaultInstrumentHandle;
+    }
+    
+    this->linksCache.set(layer, handle);
 }
 
 void Transport::removeLinkForLayer(const MidiLayer *layer)
 {
-    this->linksCache.remove(layer->getLayerId().toString());
+    this->linksCache.remove(layer);
 }
 
 
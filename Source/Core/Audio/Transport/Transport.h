@@ -21,13 +21,17 @@ class Instrument;
 class OrchestraPit;
 class PlayerThread;
 class RendererThread;
+class MidiRecorder;
+class PianoLayer;
 
 #include "TransportListener.h"
 #include "ProjectSequencesWrapper.h"
 #include "ProjectListener.h"
 #include "OrchestraListener.h"
 
-class Transport : public ProjectListener, private OrchestraListener
+class Transport : public ProjectListener,
+                  private OrchestraListener,
+                  private ChangeListener
 {
 public:
 
@@ -63,11 +67,16 @@ public:
     bool isPlaying() const;
     void stopPlayback();
     
-    void startRender(const String &filename);
+    void startRender(const String &filename, bool renderStems = false);
     bool isRendering() const;
     void stopRender();
     
     float getRenderingPercentsComplete() const;
+
+    // Starts playback and records midi input into the layer,
+    // stopping playback merges the recorded notes into it
+    void startRecording(PianoLayer *targetLayer);
+    bool isRecording() const;
     
     void calcTimeAndTempoAt(const double absPosition,
                             double &outTimeMs,
@@ -82,7 +91,7 @@ public:
     // Sending messages at realtime
     //===------------------------------------------------------------------===//
     
-    void sendMidiMessage(const String &layerId, const MidiMessage &message) const;
+    void sendMidiMessage(const MidiLayer *layer, const MidiMessage &message) const;
     
     void allNotesAndControllersOff() const;
 
@@ -99,6 +108,13 @@ public:
 
     void instrumentRemovedPostAction() override;
     
+    //===------------------------------------------------------------------===//
+    // ChangeListener
+    //===------------------------------------------------------------------===//
+    
+    // Instruments' hashes depend on their nodes, which are mostly loaded asynchronously
+    void changeListenerCallback(ChangeBroadcaster *source) override;
+    
     
     //===------------------------------------------------------------------===//
     // ProjectListener
@@ -112,6 +128,8 @@ public:
     
     void onEventRemovedPostAction(const MidiLayer *layer) override;
 
+    void onEventsChanged(const MidiEventsChangeSet &changes) override;
+
     void onLayerChanged(const MidiLayer *layer) override;
     
     void onLayerAdded(const MidiLayer *layer) override;
@@ -148,9 +166,11 @@ private:
 
     ScopedPointer<PlayerThread> player;
     ScopedPointer<RendererThread> renderer;
+    ScopedPointer<MidiRecorder> recorder;
     
     friend class PlayerThread;
     friend class RendererThread;
+    friend class MidiRecorder;
 
 private:
 
@@ -161,8 +181,19 @@ private:
     bool sequencesAreOutdated;
     
     Array<const MidiLayer *> layersCache;
-    HashMap<String, Instrument *> linksCache; // layer id : instrument
     
+    // All of these are only updated on orchestra and layer callbacks,
+    // so that finding a layer's instrument is a couple of table lookups
+    HashMap<int, Instrument *> instrumentsCache; // handle : instrument
+    HashMap<String, int> instrumentIdsCache; // instrument id : handle
+    HashMap<String, int> instrumentHashesCache; // instrument hash : handle
+    HashMap<const MidiLayer *, int> linksCache; // layer : instrument handle
+    int defaultInstrumentHandle;
+    
+    Instrument *findInstrumentForLayer(const MidiLayer *layer) const;
+    
+    void updateInstrumentsCache();
+    void updateLinksForAllLayers();
     void updateLinkForLayer(const MidiLayer *layer);
     void removeLinkForLayer(const MidiLayer *layer);
     
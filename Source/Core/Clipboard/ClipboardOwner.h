@@ -23,8 +23,9 @@ public:
 
     virtual ~ClipboardOwner() {}
 
-    virtual XmlElement *clipboardCopy() const = 0;
+    // Writes the selection as a ClipboardPayload
+    virtual void clipboardCopy(MemoryBlock &payload) const = 0;
 
-    virtual void clipboardPaste(const XmlElement &xml) = 0;
+    virtual void clipboardPaste(const MemoryBlock &payload) = 0;
 
 };
@@ -0,0 +1,319 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "Common.h"
+#include "ClipboardPayload.h"
+#include "Note.h"
+#include "AutomationEvent.h"
+#include "AnnotationEvent.h"
+#include "SerializationKeys.h"
+
+#define CLIPBOARD_PAYLOAD_MAGIC 0x48434c50
+#define CLIPBOARD_PAYLOAD_VERSION 1
+#define CLIPBOARD_PAYLOAD_TEXT_PREFIX "HelioClipboard:"
+
+// The smallest possible records, used to check the events count
+// in the payloads coming from the system clipboard
+#define CLIPBOARD_PAYLOAD_MIN_NOTE_SIZE (1 + 3 * 4)
+#define CLIPBOARD_PAYLOAD_MIN_AUTOMATION_EVENT_SIZE (3 * 4)
+#define CLIPBOARD_PAYLOAD_MIN_ANNOTATION_SIZE (4 + 1 + 4)
+
+//===----------------------------------------------------------------------===//
+// Writer
+//===----------------------------------------------------------------------===//
+
+ClipboardPayload::Writer::Writer() :
+    numLayers(0),
+    layerType(Notes),
+    numLayerEvents(0)
+{
+}
+
+void ClipboardPayload::Writer::beginLayer(const String &newLayerId, EventsType eventsType)
+{
+    this->flushLayer();
+    this->layerId = newLayerId;
+    this->layerType = eventsType;
+}
+
+void ClipboardPayload::Writer::addNote(const Note &note)
+{
+    jassert(this->layerType == Notes);
+    this->layerEvents.writeCompressedInt(note.getKey());
+    this->layerEvents.writeFloat(note.getBeat());
+    this->layerEvents.writeFloat(note.getLength());
+    this->layerEvents.writeFloat(note.getVelocity());
+    this->numLayerEvents++;
+}
+
+void ClipboardPayload::Writer::addAutomationEvent(const AutomationEvent &event)
+{
+    jassert(this->layerType == AutomationEvents);
+    this->layerEvents.writeFloat(event.getBeat());
+    this->layerEvents.writeFloat(event.getControllerValue());
+    this->layerEvents.writeFloat(event.getCurvature());
+    this->numLayerEvents++;
+}
+
+void ClipboardPayload::Writer::addAnnotation(const AnnotationEvent &event)
+{
+    jassert(this->layerType == Annotations);
+    this->layerEvents.writeFloat(event.getBeat());
+    this->layerEvents.writeString(event.getDescription());
+    this->layerEvents.writeInt(int(event.getColour().getARGB()));
+    this->numLayerEvents++;
+}
+
+void ClipboardPayload::Writer::writeTo(MemoryBlock &target, float firstBeat, float lastBeat)
+{
+    this->flushLayer();
+
+    MemoryOutputStream out(target, false);
+    out.writeInt(CLIPBOARD_PAYLOAD_MAGIC);
+    out.writeInt(CLIPBOARD_PAYLOAD_VERSION);
+    out.writeFloat(firstBeat);
+    out.writeFloat(lastBeat);
+    out.writeCompressedInt(this->numLayers);
+    out.write(this->layers.getData(), this->layers.getDataSize());
+}
+
+void ClipboardPayload::Writer::flushLayer()
+{
+    if (this->layerId.isEmpty())
+    {
+        return;
+    }
+
+    this->layers.writeString(this->layerId);
+    this->layers.writeByte(char(this->layerType));
+    this->layers.writeCompressedInt(this->numLayerEvents);
+    this->layers.writeInt(int(this->layerEvents.getDataSize()));
+    this->layers.write(this->layerEvents.getData(), this->layerEvents.getDataSize());
+    this->numLayers++;
+
+    this->layerEvents.reset();
+    this->layerId = String::empty;
+    this->numLayerEvents = 0;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Reader
+//===----------------------------------------------------------------------===//
+
+ClipboardPayload::Reader::Reader(const MemoryBlock &payload) :
+    in(payload, false),
+    valid(false),
+    firstBeat(0.f),
+    lastBeat(0.f),
+    numLayersLeft(0),
+    layerType(Notes),
+    numLayerEvents(0),
+    layerEnd(0)
+{
+    if (this->in.getTotalLength() < 20 ||
+        this->in.readInt() != CLIPBOARD_PAYLOAD_MAGIC ||
+        this->in.readInt() != CLIPBOARD_PAYLOAD_VERSION)
+    {
+        return;
+    }
+
+    this->firstBeat = this->in.readFloat();
+    this->lastBeat = this->in.readFloat();
+    this->numLayersLeft = this->in.readCompressedInt();
+    this->layerEnd = this->in.getPosition();
+    this->valid = true;
+}
+
+bool ClipboardPayload::Reader::isValid() const noexcept
+{
+    return this->valid;
+}
+
+float ClipboardPayload::Reader::getFirstBeat() const noexcept
+{
+    return this->firstBeat;
+}
+
+float ClipboardPayload::Reader::getLastBeat() const noexcept
+{
+    return this->lastBeat;
+}
+
+bool ClipboardPayload::Reader::nextLayer()
+{
+    if (! this->valid || this->numLayersLeft <= 0)
+    {
+        return false;
+    }
+
+    this->in.setPosition(this->layerEnd);
+    this->layerId = this->in.readString();
+    this->layerType = EventsType(this->in.readByte());
+    this->numLayerEvents = this->in.readCompressedInt();
+
+    const int layerSize = this->in.readInt();
+    this->layerEnd = this->in.getPosition() + layerSize;
+    this->numLayersLeft--;
+
+    // a truncated or forged payload, i.e. from the system clipboard
+    if (layerSize < 0 || this->numLayerEvents < 0 ||
+        this->layerEnd > this->in.getTotalLength() ||
+        this->numLayerEvents > layerSize / ClipboardPayload::Reader::getMinRecordSize(this->layerType))
+    {
+        this->valid = false;
+        this->numLayerEvents = 0;
+        return false;
+    }
+
+    return true;
+}
+
+int ClipboardPayload::Reader::getMinRecordSize(EventsType eventsType) noexcept
+{
+    switch (eventsType)
+    {
+        case Notes: return CLIPBOARD_PAYLOAD_MIN_NOTE_SIZE;
+        case AutomationEvents: return CLIPBOARD_PAYLOAD_MIN_AUTOMATION_EVENT_SIZE;
+        case Annotations: return CLIPBOARD_PAYLOAD_MIN_ANNOTATION_SIZE;
+        default: return 1;
+    }
+}
+
+void ClipboardPayload::Reader::checkLayerBounds() noexcept
+{
+    // the stream returns zeros when reading past its end,
+    // but a record crossing the layer's end is garbage anyway
+    if (this->in.getPosition() > this->layerEnd)
+    {
+        this->valid = false;
+        this->numLayersLeft = 0;
+    }
+}
+
+const String &ClipboardPayload::Reader::getLayerId() const noexcept
+{
+    return this->layerId;
+}
+
+ClipboardPayload::EventsType ClipboardPayload::Reader::getEventsType() const noexcept
+{
+    return this->layerType;
+}
+
+int ClipboardPayload::Reader::getNumEvents() const noexcept
+{
+    return this->numLayerEvents;
+}
+
+Note ClipboardPayload::Reader::readNote(MidiLayer *targetLayer)
+{
+    jassert(this->layerType == Notes);
+    const int key = this->in.readCompressedInt();
+    const float beat = this->in.readFloat();
+    const float length = this->in.readFloat();
+    const float velocity = this->in.readFloat();
+    this->checkLayerBounds();
+    return Note(targetLayer, key, beat, length, velocity);
+}
+
+AutomationEvent ClipboardPayload::Reader::readAutomationEvent(MidiLayer *targetLayer)
+{
+    jassert(this->layerType == AutomationEvents);
+    const float beat = this->in.readFloat();
+    const float controllerValue = this->in.readFloat();
+    const float curvature = this->in.readFloat();
+    this->checkLayerBounds();
+    return AutomationEvent(targetLayer, beat, controllerValue).withCurvature(curvature);
+}
+
+AnnotationEvent ClipboardPayload::Reader::readAnnotation(MidiLayer *targetLayer)
+{
+    jassert(this->layerType == Annotations);
+    const float beat = this->in.readFloat();
+    const String description = this->in.readString();
+    const Colour colour(uint32(this->in.readInt()));
+    this->checkLayerBounds();
+    return AnnotationEvent(targetLayer, beat, description, colour);
+}
+
+
+//===----------------------------------------------------------------------===//
+// Conversions
+//===----------------------------------------------------------------------===//
+
+String ClipboardPayload::toText(const MemoryBlock &payload)
+{
+    return CLIPBOARD_PAYLOAD_TEXT_PREFIX + payload.toBase64Encoding();
+}
+
+bool ClipboardPayload::fromText(const String &text, MemoryBlock &outPayload)
+{
+    if (! text.startsWith(CLIPBOARD_PAYLOAD_TEXT_PREFIX))
+    {
+        return false;
+    }
+
+    outPayload.reset();
+    return outPayload.fromBase64Encoding(text.substring(String(CLIPBOARD_PAYLOAD_TEXT_PREFIX).length()));
+}
+
+XmlElement *ClipboardPayload::createXml(const MemoryBlock &payload)
+{
+    Reader reader(payload);
+
+    if (! reader.isValid())
+    {
+        return nullptr;
+    }
+
+    auto xml = new XmlElement(Serialization::Clipboard::clipboard);
+
+    while (reader.nextLayer())
+    {
+        auto layerElement = new XmlElement(Serialization::Clipboard::layer);
+        layerElement->setAttribute(Serialization::Clipboard::layerId, reader.getLayerId());
+        xml->addChildElement(layerElement);
+
+        for (int i = 0; i < reader.getNumEvents() && reader.isValid(); ++i)
+        {
+            switch (reader.getEventsType())
+            {
+                case Notes:
+                    layerElement->addChildElement(reader.readNote(nullptr).serialize());
+                    break;
+
+                case AutomationEvents:
+                    layerElement->addChildElement(reader.readAutomationEvent(nullptr).serialize());
+                    break;
+
+                case Annotations:
+                    layerElement->addChildElement(reader.readAnnotation(nullptr).serialize());
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+
+    xml->setAttribute(Serialization::Clipboard::firstBeat, reader.getFirstBeat());
+    xml->setAttribute(Serialization::Clipboard::lastBeat, reader.getLastBeat());
+
+    return xml;
+}
@@ -0,0 +1,136 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+class MidiLayer;
+class Note;
+class AutomationEvent;
+class AnnotationEvent;
+
+// A packed binary form of the copied events, as held by InternalClipboard.
+//
+// The layout is: the magic number and the version, first and last beats of the selection,
+// the number of layers, then each layer's id, events type, events count and events data size,
+// followed by the events' parameters. Event ids are not stored, as pasted events get new ones.
+
+class ClipboardPayload
+{
+public:
+
+    enum EventsType
+    {
+        Notes = 1,
+        AutomationEvents = 2,
+        Annotations = 3
+    };
+
+    class Writer
+    {
+    public:
+
+        Writer();
+
+        void beginLayer(const String &layerId, EventsType eventsType);
+
+        void addNote(const Note &note);
+
+        void addAutomationEvent(const AutomationEvent &event);
+
+        void addAnnotation(const AnnotationEvent &event);
+
+        void writeTo(MemoryBlock &target, float firstBeat, float lastBeat);
+
+    private:
+
+        void flushLayer();
+
+        MemoryOutputStream layers;
+        int numLayers;
+
+        MemoryOutputStream layerEvents;
+        String layerId;
+        EventsType layerType;
+        int numLayerEvents;
+
+        JUCE_DECLARE_NON_COPYABLE(Writer);
+
+    };
+
+    class Reader
+    {
+    public:
+
+        explicit Reader(const MemoryBlock &payload);
+
+        bool isValid() const noexcept;
+
+        float getFirstBeat() const noexcept;
+
+        float getLastBeat() const noexcept;
+
+        // Moves to the next layer, skipping the events left unread in the current one;
+        // returns false if there are no more layers
+        bool nextLayer();
+
+        const String &getLayerId() const noexcept;
+
+        EventsType getEventsType() const noexcept;
+
+        int getNumEvents() const noexcept;
+
+        // These create the events with new ids;
+        // a record crossing the layer's end makes the reader invalid,
+        // so isValid() should be checked after each read
+        Note readNote(MidiLayer *targetLayer);
+
+        AutomationEvent readAutomationEvent(MidiLayer *targetLayer);
+
+        AnnotationEvent readAnnotation(MidiLayer *targetLayer);
+
+    private:
+
+        static int getMinRecordSize(EventsType eventsType) noexcept;
+        void checkLayerBounds() noexcept;
+
+        MemoryInputStream in;
+        bool valid;
+
+        float firstBeat;
+        float lastBeat;
+        int numLayersLeft;
+
+        String layerId;
+        EventsType layerType;
+        int numLayerEvents;
+        int64 layerEnd;
+
+        JUCE_DECLARE_NON_COPYABLE(Reader);
+
+    };
+
+    // The system clipboard holds a base64 form, prefixed with a marker,
+    // so that it can be told apart from whatever text the user has copied
+    static String toText(const MemoryBlock &payload);
+
+    static bool fromText(const String &text, MemoryBlock &outPayload);
+
+    // The old xml layout, for the code that still expects it, i.e. arpeggiators
+    static XmlElement *createXml(const MemoryBlock &payload);
+
+};
@@ -19,8 +19,13 @@
 #include "InternalClipboard.h"
 #include "SerializationKeys.h"
 #include "ClipboardOwner.h"
+#include "ClipboardPayload.h"
 #include "App.h"
 
+// Larger selections are only kept in-process,
+// not to flood the system clipboard with megabytes of base64
+#define CLIPBOARD_MAX_SYSTEM_CLIPBOARD_SIZE (1024 * 1024)
+
 // todo multiple clipboards
 
 void InternalClipboard::copy(const ClipboardOwner &owner, bool mirrorToSystemClipboard /*= false*/)
@@ -35,7 +40,14 @@ void InternalClipboard::paste(ClipboardOwner &owner)
 
 XmlElement *InternalClipboard::getCurrentContent()
 {
-    return App::Helio()->getClipboard()->clipboard.get();
+    InternalClipboard *clipboard = App::Helio()->getClipboard();
+
+    if (clipboard->xmlContent == nullptr && clipboard->payload.getSize() > 0)
+    {
+        clipboard->xmlContent = ClipboardPayload::createXml(clipboard->payload);
+    }
+
+    return clipboard->xmlContent.get();
 }
 
 String InternalClipboard::getCurrentContentAsString()
@@ -61,18 +73,30 @@ InternalClipboard::~InternalClipboard()
 
 void InternalClipboard::copyFrom(const ClipboardOwner &owner, bool mirrorToSystemClipboard /*= false*/)
 {
-    this->clipboard = owner.clipboardCopy();
+    this->xmlContent = nullptr;
+    this->payload.reset();
+    owner.clipboardCopy(this->payload);
 
-    if (mirrorToSystemClipboard)
+    if (mirrorToSystemClipboard &&
+        this->payload.getSize() <= CLIPBOARD_MAX_SYSTEM_CLIPBOARD_SIZE)
     {
-        SystemClipboard::copyTextToClipboard(this->clipboard->createDocument("", false, false, "UTF-8", 1024));
+        SystemClipboard::copyTextToClipboard(ClipboardPayload::toText(this->payload));
     }
 }
 
 void InternalClipboard::pasteTo(ClipboardOwner &owner)
 {
-    if (this->clipboard != nullptr)
+    if (this->payload.getSize() > 0)
+    {
+        owner.clipboardPaste(this->payload);
+        return;
+    }
+
+    // i.e. copied in another instance of the app
+    MemoryBlock systemPayload;
+
+    if (ClipboardPayload::fromText(SystemClipboard::getTextFromClipboard(), systemPayload))
     {
-        owner.clipboardPaste(*this->clipboard);
+        owner.clipboardPaste(systemPayload);
     }
 }
@@ -43,6 +43,9 @@ public:
 
 private:
 
-    ScopedPointer<XmlElement> clipboard;
+    MemoryBlock payload;
+
+    // Only created on demand, for the code that still expects xml
+    ScopedPointer<XmlElement> xmlContent;
 
 };
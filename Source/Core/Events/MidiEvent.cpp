@@ -27,6 +27,13 @@ MidiEvent::MidiEvent(MidiLayer *owner, float beatVal) :
     this->id = this->createId();
 }
 
+MidiEvent::MidiEvent(MidiLayer *owner, const Id &existingId, float beatVal) :
+    layer(owner),
+    beat(beatVal),
+    id(existingId)
+{
+}
+
 MidiEvent::~MidiEvent()
 {
 
@@ -36,6 +36,9 @@ public:
 
     MidiEvent(MidiLayer *owner, float beat);
 
+    // For the events restored with their ids, not to generate the ids in vain
+    MidiEvent(MidiLayer *owner, const Id &existingId, float beat);
+
     ~MidiEvent() override;
 
     virtual Array<MidiMessage> getSequence() const = 0;
@@ -48,12 +48,20 @@ Note::Note(const Note &other) :
 }
 
 Note::Note(MidiLayer *newOwner, const Note &parametersToCopy) :
-    MidiEvent(newOwner, parametersToCopy.beat),
+    MidiEvent(newOwner, parametersToCopy.getID(), parametersToCopy.beat),
     key(parametersToCopy.key),
     length(parametersToCopy.length),
     velocity(parametersToCopy.velocity)
 {
-    this->id = parametersToCopy.getID();
+}
+
+Note::Note(MidiLayer *owner, const Id &existingId,
+           int keyVal, float beatVal, float lengthVal, float velocityVal) :
+    MidiEvent(owner, existingId, beatVal),
+    key(keyVal),
+    length(lengthVal),
+    velocity(velocityVal)
+{
 }
 
 
@@ -36,6 +36,10 @@ public:
 
     Note(MidiLayer *newOwner,
          const Note &parametersToCopy);
+
+    // used to restore a note with all its parameters, i.e. from the packed undo history
+    Note(MidiLayer *owner, const Id &existingId,
+         int keyVal, float beatVal, float lengthVal, float velocityVal);
     
     ~Note() override {}
 
@@ -19,6 +19,7 @@
 #include "AnnotationsLayer.h"
 #include "Note.h"
 #include "AnnotationEventActions.h"
+#include "MidiEventsChangeSet.h"
 #include "SerializationKeys.h"
 #include "UndoStack.h"
 
@@ -82,6 +83,11 @@ void AnnotationsLayer::silentImport(const MidiEvent &eventToImport)
     this->updateBeatRange(false);
 }
 
+size_t AnnotationsLayer::getEventSize() const noexcept
+{
+    return sizeof(AnnotationEvent);
+}
+
 MidiEvent *AnnotationsLayer::insert(const AnnotationEvent &annotation, bool undoable)
 {
     if (this->annotationsHashTable.contains(annotation))
@@ -182,6 +188,8 @@ bool AnnotationsLayer::insertGroup(Array<AnnotationEvent> &annotations, bool und
     }
     else
     {
+        MidiEventsChangeSet changes(this);
+
         for (int i = 0; i < annotations.size(); ++i)
         {
             const AnnotationEvent &annotation = annotations.getUnchecked(i);
@@ -190,10 +198,11 @@ bool AnnotationsLayer::insertGroup(Array<AnnotationEvent> &annotations, bool und
             
             this->midiEvents.add(storedAnnotation); // sorted later
             this->annotationsHashTable.set(annotation, storedAnnotation);
-            this->notifyEventAdded(*storedAnnotation);
+            changes.addAddedEvent(*storedAnnotation);
         }
         
         this->sort();
+        this->notifyEventsChanged(changes);
         this->updateBeatRange(true);
     }
     
@@ -210,17 +219,28 @@ bool AnnotationsLayer::removeGroup(Array<AnnotationEvent> &annotations, bool und
     }
     else
     {
+        MidiEventsChangeSet changes(this);
+        Array<AnnotationEvent *> removedAnnotations;
+
         for (int i = 0; i < annotations.size(); ++i)
         {
             const AnnotationEvent &annotation = annotations.getUnchecked(i);
             
             if (AnnotationEvent *matchingAnnotation = this->annotationsHashTable[annotation])
             {
-                this->notifyEventRemoved(*matchingAnnotation);
-                this->midiEvents.removeObject(matchingAnnotation);
                 this->annotationsHashTable.removeValue(matchingAnnotation);
+                removedAnnotations.add(matchingAnnotation);
+                changes.addRemovedEvent(*matchingAnnotation);
             }
         }
+
+        // listeners are notified while the events are still there
+        this->notifyEventsChanged(changes);
+
+        for (int i = 0; i < removedAnnotations.size(); ++i)
+        {
+            this->midiEvents.removeObject(removedAnnotations.getUnchecked(i));
+        }
         
         this->updateBeatRange(true);
         this->notifyEventRemovedPostAction();
@@ -244,6 +264,8 @@ bool AnnotationsLayer::changeGroup(Array<AnnotationEvent> &annotationsBefore,
     }
     else
     {
+        MidiEventsChangeSet changes(this);
+
         for (int i = 0; i < annotationsBefore.size(); ++i)
         {
             // doing this sucks
@@ -257,11 +279,12 @@ bool AnnotationsLayer::changeGroup(Array<AnnotationEvent> &annotationsBefore,
                 (*matchingAnnotation) = newAnnotation;
                 
                 this->annotationsHashTable.set(newAnnotation, matchingAnnotation);
-                this->notifyEventChanged(annotation, *matchingAnnotation);
+                changes.addChangedEvent(annotation, *matchingAnnotation);
             }
         }
 
         this->sort();
+        this->notifyEventsChanged(changes);
         this->updateBeatRange(true);
     }
 
@@ -39,6 +39,8 @@ public:
     //===------------------------------------------------------------------===//
 
     void silentImport(const MidiEvent &eventToImport) override;
+
+    size_t getEventSize() const noexcept override;
     
     MidiEvent *insert(const AnnotationEvent &annotationToCopy, bool undoable);
 
@@ -18,6 +18,7 @@
 #include "Common.h"
 #include "AutomationLayer.h"
 #include "AutomationEventActions.h"
+#include "MidiEventsChangeSet.h"
 
 #include "ProjectTreeItem.h"
 #include "ProjectListener.h"
@@ -82,6 +83,11 @@ void AutomationLayer::silentImport(const MidiEvent &eventToImport)
     this->updateBeatRange(false);
 }
 
+size_t AutomationLayer::getEventSize() const noexcept
+{
+    return sizeof(AutomationEvent);
+}
+
 MidiEvent *AutomationLayer::insert(const AutomationEvent &autoEvent, bool undoable)
 {
     if (AutomationEvent *matchingEvent = this->eventsHashTable[autoEvent])
@@ -184,6 +190,8 @@ bool AutomationLayer::insertGroup(Array<AutomationEvent> &events, bool undoable)
     }
     else
     {
+        MidiEventsChangeSet changes(this);
+
         for (int i = 0; i < events.size(); ++i)
         {
             const AutomationEvent &autoEvent = events.getUnchecked(i);
@@ -192,10 +200,11 @@ bool AutomationLayer::insertGroup(Array<AutomationEvent> &events, bool undoable)
             
             this->midiEvents.add(storedEvent); // sorted later
             this->eventsHashTable.set(autoEvent, storedEvent);
-            this->notifyEventAdded(*storedEvent);
+            changes.addAddedEvent(*storedEvent);
         }
         
         this->sort();
+        this->notifyEventsChanged(changes);
         this->updateBeatRange(true);
     }
     
@@ -212,17 +221,28 @@ bool AutomationLayer::removeGroup(Array<AutomationEvent> &events, bool undoable)
     }
     else
     {
+        MidiEventsChangeSet changes(this);
+        Array<AutomationEvent *> removedEvents;
+
         for (int i = 0; i < events.size(); ++i)
         {
             const AutomationEvent &autoEvent = events.getUnchecked(i);
             
             if (AutomationEvent *matchingEvent = this->eventsHashTable[autoEvent])
             {
-                this->notifyEventRemoved(*matchingEvent);
-                this->midiEvents.removeObject(matchingEvent);
                 this->eventsHashTable.removeValue(matchingEvent);
+                removedEvents.add(matchingEvent);
+                changes.addRemovedEvent(*matchingEvent);
             }
         }
+
+        // listeners are notified while the events are still there
+        this->notifyEventsChanged(changes);
+
+        for (int i = 0; i < removedEvents.size(); ++i)
+        {
+            this->midiEvents.removeObject(removedEvents.getUnchecked(i));
+        }
         
         this->updateBeatRange(true);
         this->notifyEventRemovedPostAction();
@@ -246,6 +266,8 @@ bool AutomationLayer::changeGroup(const Array<AutomationEvent> eventsBefore,
     }
     else
     {
+        MidiEventsChangeSet changes(this);
+
         for (int i = 0; i < eventsBefore.size(); ++i)
         {
             // doing this sucks
@@ -259,12 +281,12 @@ bool AutomationLayer::changeGroup(const Array<AutomationEvent> eventsBefore,
                 (*matchingEvent) = newAutoEvent;
                 //this->eventsHashTable.removeValue(matchingEvent);
                 this->eventsHashTable.set(newAutoEvent, matchingEvent);
-                //this->notifyEventChanged(autoEvent, *matchingEvent); // lets notify the whole layer change
+                changes.addChangedEvent(autoEvent, *matchingEvent);
             }
         }
         
         this->sort();
-        this->notifyLayerChanged();
+        this->notifyEventsChanged(changes);
         this->updateBeatRange(true);
     }
 
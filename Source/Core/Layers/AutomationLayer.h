@@ -33,6 +33,8 @@ public:
 
     void silentImport(const MidiEvent &eventToImport) override;
 
+    size_t getEventSize() const noexcept override;
+
     MidiEvent *insert(const AutomationEvent &autoEvent, bool undoable);
 
     bool remove(const AutomationEvent &autoEvent, bool undoable);
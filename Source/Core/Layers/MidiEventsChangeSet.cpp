@@ -0,0 +1,93 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "MidiEventsChangeSet.h"
+#include "MidiEvent.h"
+
+MidiEventsChangeSet::MidiEventsChangeSet(const MidiLayer *targetLayer) :
+    layer(targetLayer)
+{
+}
+
+void MidiEventsChangeSet::addChangedEvent(const MidiEvent &oldEvent, const MidiEvent &newEvent)
+{
+    this->changedBefore.add(&oldEvent);
+    this->changedAfter.add(&newEvent);
+}
+
+void MidiEventsChangeSet::addAddedEvent(const MidiEvent &event)
+{
+    this->added.add(&event);
+}
+
+void MidiEventsChangeSet::addRemovedEvent(const MidiEvent &event)
+{
+    this->removed.add(&event);
+}
+
+const MidiLayer *MidiEventsChangeSet::getLayer() const noexcept
+{
+    return this->layer;
+}
+
+bool MidiEventsChangeSet::isEmpty() const noexcept
+{
+    return this->changedAfter.size() == 0 &&
+        this->added.size() == 0 &&
+        this->removed.size() == 0;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Accessors
+//===----------------------------------------------------------------------===//
+
+int MidiEventsChangeSet::getNumChangedEvents() const noexcept
+{
+    return this->changedAfter.size();
+}
+
+const MidiEvent &MidiEventsChangeSet::getChangedEventBefore(int index) const noexcept
+{
+    return *this->changedBefore.getUnchecked(index);
+}
+
+const MidiEvent &MidiEventsChangeSet::getChangedEventAfter(int index) const noexcept
+{
+    return *this->changedAfter.getUnchecked(index);
+}
+
+int MidiEventsChangeSet::getNumAddedEvents() const noexcept
+{
+    return this->added.size();
+}
+
+const MidiEvent &MidiEventsChangeSet::getAddedEvent(int index) const noexcept
+{
+    return *this->added.getUnchecked(index);
+}
+
+int MidiEventsChangeSet::getNumRemovedEvents() const noexcept
+{
+    return this->removed.size();
+}
+
+const MidiEvent &MidiEventsChangeSet::getRemovedEvent(int index) const noexcept
+{
+    return *this->removed.getUnchecked(index);
+}
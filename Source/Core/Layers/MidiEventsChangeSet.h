@@ -0,0 +1,64 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class MidiEvent;
+class MidiLayer;
+
+// A batch of changes made to a single layer by one group operation,
+// which is broadcast to the listeners as a whole, instead of a callback per event.
+//
+// It only keeps pointers: the events before the change are owned by the caller,
+// and the other ones by the layer, so the change set is only valid
+// while being broadcast, and removed events are still there at that moment.
+
+class MidiEventsChangeSet
+{
+public:
+
+    explicit MidiEventsChangeSet(const MidiLayer *targetLayer);
+
+    void addChangedEvent(const MidiEvent &oldEvent, const MidiEvent &newEvent);
+    void addAddedEvent(const MidiEvent &event);
+    void addRemovedEvent(const MidiEvent &event);
+
+    const MidiLayer *getLayer() const noexcept;
+    bool isEmpty() const noexcept;
+
+    int getNumChangedEvents() const noexcept;
+    const MidiEvent &getChangedEventBefore(int index) const noexcept;
+    const MidiEvent &getChangedEventAfter(int index) const noexcept;
+
+    int getNumAddedEvents() const noexcept;
+    const MidiEvent &getAddedEvent(int index) const noexcept;
+
+    int getNumRemovedEvents() const noexcept;
+    const MidiEvent &getRemovedEvent(int index) const noexcept;
+
+private:
+
+    const MidiLayer *layer;
+
+    Array<const MidiEvent *> changedBefore;
+    Array<const MidiEvent *> changedAfter;
+    Array<const MidiEvent *> added;
+    Array<const MidiEvent *> removed;
+
+    JUCE_DECLARE_NON_COPYABLE(MidiEventsChangeSet);
+
+};
@@ -18,6 +18,7 @@
 #include "Common.h"
 #include "MidiLayer.h"
 #include "MidiEvent.h"
+#include "MidiEventsChangeSet.h"
 #include "Transport.h"
 #include "MidiRoll.h"
 #include "ProjectTreeItem.h"
@@ -33,12 +34,14 @@ MidiLayer::MidiLayer(MidiLayerOwner &parent) :
     cacheIsOutdated(false),
     lastEndBeat(0.f),
     instrumentId(String::empty),
-    controllerNumber(0)
+    controllerNumber(0),
+    accountedEventsMemory(0)
 {
 }
 
 MidiLayer::~MidiLayer()
 {
+    MemoryAccounting::remove(MemoryAccounting::layers, this->accountedEventsMemory);
     this->masterReference.clear();
 }
 
@@ -287,8 +290,18 @@ void MidiLayer::notifyEventRemovedPostAction()
     this->owner.onEventRemovedPostAction(this);
 }
 
+void MidiLayer::notifyEventsChanged(const MidiEventsChangeSet &changes)
+{
+    if (changes.isEmpty())
+    { return; }
+
+    this->cacheIsOutdated = true;
+    this->owner.onEventsChanged(changes);
+}
+
 void MidiLayer::notifyLayerChanged()
 {
+    this->updateEventsMemoryAccounting();
     this->cacheIsOutdated = true;
     this->owner.onLayerChanged(this);
 }
@@ -301,6 +314,9 @@ void MidiLayer::notifyBeatRangeChanged()
 
 void MidiLayer::updateBeatRange(bool shouldNotifyIfChanged)
 {
+    // every change of the events list ends up here or in notifyLayerChanged
+    this->updateEventsMemoryAccounting();
+    
     if (this->lastStartBeat == this->getFirstBeat() &&
         this->lastEndBeat == this->getLastBeat())
     {
@@ -316,10 +332,17 @@ void MidiLayer::updateBeatRange(bool shouldNotifyIfChanged)
     }
 }
 
+void MidiLayer::updateEventsMemoryAccounting()
+{
+    const int64 eventsMemory = int64(this->midiEvents.size()) * int64(this->getEventSize());
+    MemoryAccounting::add(MemoryAccounting::layers, eventsMemory - this->accountedEventsMemory);
+    this->accountedEventsMemory = eventsMemory;
+}
+
 
 void MidiLayer::sendMidiMessage(const MidiMessage &message)
 {
-    this->owner.getTransport()->sendMidiMessage(this->getLayerId().toString(), message);
+    this->owner.getTransport()->sendMidiMessage(this, message);
 }
 
 void MidiLayer::setInstrumentId(const String &val)
@@ -20,6 +20,7 @@
 #include "Serializable.h"
 #include "MidiLayerOwner.h"
 #include "MidiEvent.h"
+#include "MemoryAccounting.h"
 
 class LayerTreeItem;
 class UndoStack;
@@ -121,10 +122,14 @@ public:
     void notifyEventAdded(const MidiEvent &event);
     void notifyEventRemoved(const MidiEvent &event);
     void notifyEventRemovedPostAction();
+    void notifyEventsChanged(const MidiEventsChangeSet &changes);
     void notifyLayerChanged();
     void notifyBeatRangeChanged();
     void updateBeatRange(bool shouldNotifyIfChanged);
 
+    // The size of the events this layer holds, for the memory accounting
+    virtual size_t getEventSize() const noexcept = 0;
+
     //===------------------------------------------------------------------===//
     // Misc
     //===------------------------------------------------------------------===//
@@ -172,9 +177,16 @@ private:
 
     MidiLayerOwner &owner;
 
+    // The events owned by the layer are counted here, as the layer adds or removes them,
+    // not per event instance: the copies held by the undo actions are the undo's memory
+    int64 accountedEventsMemory;
+    void updateEventsMemoryAccounting();
+
 private:
     
     WeakReference<MidiLayer>::Master masterReference;
     friend class WeakReference<MidiLayer>;
 
+    MEMORY_ACCOUNTED(MidiLayer, layers);
+
 };
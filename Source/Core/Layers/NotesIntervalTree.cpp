@@ -0,0 +1,209 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "NotesIntervalTree.h"
+#include "Note.h"
+
+NotesIntervalTree::NotesIntervalTree() :
+    root(nullptr),
+    numNodes(0)
+{
+}
+
+NotesIntervalTree::~NotesIntervalTree()
+{
+    this->clear();
+}
+
+void NotesIntervalTree::insert(const Note *note)
+{
+    auto node = new Node();
+    node->start = note->getBeat();
+    node->end = note->getBeat() + note->getLength();
+    node->maxEnd = node->end;
+    node->note = note;
+    node->priority = this->random.nextInt();
+    node->left = nullptr;
+    node->right = nullptr;
+
+    Node *left = nullptr;
+    Node *right = nullptr;
+    NotesIntervalTree::split(this->root, node->start, note, false, left, right);
+    this->root = NotesIntervalTree::merge(NotesIntervalTree::merge(left, node), right);
+    this->numNodes++;
+}
+
+void NotesIntervalTree::remove(const Note *note)
+{
+    const float start = note->getBeat();
+
+    Node *left = nullptr;
+    Node *middle = nullptr;
+    Node *right = nullptr;
+
+    // left < key, middle == key, right > key
+    NotesIntervalTree::split(this->root, start, note, false, left, right);
+    NotesIntervalTree::split(right, start, note, true, middle, right);
+
+    if (middle != nullptr)
+    {
+        jassert(middle->left == nullptr && middle->right == nullptr);
+        NotesIntervalTree::deleteSubtree(middle);
+        this->numNodes--;
+    }
+
+    this->root = NotesIntervalTree::merge(left, right);
+}
+
+void NotesIntervalTree::clear()
+{
+    NotesIntervalTree::deleteSubtree(this->root);
+    this->root = nullptr;
+    this->numNodes = 0;
+}
+
+int NotesIntervalTree::size() const noexcept
+{
+    return this->numNodes;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Queries
+//===----------------------------------------------------------------------===//
+
+void NotesIntervalTree::findNotesAt(float targetBeat, Array<const Note *> &result) const
+{
+    NotesIntervalTree::collect(this->root, targetBeat, targetBeat, true, result);
+}
+
+void NotesIntervalTree::findNotesWithin(float startBeat, float endBeat, Array<const Note *> &result) const
+{
+    NotesIntervalTree::collect(this->root, startBeat, endBeat, false, result);
+}
+
+void NotesIntervalTree::collect(const Node *node, float startBeat, float endBeat,
+                                bool includesStartAtEnd, Array<const Note *> &result)
+{
+    // Nothing in this subtree ends after the range start
+    if (node == nullptr || node->maxEnd <= startBeat)
+    { return; }
+
+    NotesIntervalTree::collect(node->left, startBeat, endBeat, includesStartAtEnd, result);
+
+    const bool startsBeforeEnd = includesStartAtEnd ?
+        (node->start <= endBeat) : (node->start < endBeat);
+
+    if (! startsBeforeEnd)
+    { return; } // and so does the whole right subtree
+
+    if (node->end > startBeat)
+    {
+        result.add(node->note);
+    }
+
+    NotesIntervalTree::collect(node->right, startBeat, endBeat, includesStartAtEnd, result);
+}
+
+
+//===----------------------------------------------------------------------===//
+// Treap
+//===----------------------------------------------------------------------===//
+
+bool NotesIntervalTree::isKeyLess(float start1, const Note *note1,
+                                  float start2, const Note *note2) noexcept
+{
+    if (start1 != start2)
+    {
+        return start1 < start2;
+    }
+
+    return reinterpret_cast<pointer_sized_uint>(note1) < reinterpret_cast<pointer_sized_uint>(note2);
+}
+
+void NotesIntervalTree::update(Node *node) noexcept
+{
+    node->maxEnd = node->end;
+
+    if (node->left != nullptr)
+    {
+        node->maxEnd = jmax(node->maxEnd, node->left->maxEnd);
+    }
+
+    if (node->right != nullptr)
+    {
+        node->maxEnd = jmax(node->maxEnd, node->right->maxEnd);
+    }
+}
+
+void NotesIntervalTree::split(Node *node, float start, const Note *note, bool inclusive,
+                              Node *&outLeft, Node *&outRight)
+{
+    if (node == nullptr)
+    {
+        outLeft = nullptr;
+        outRight = nullptr;
+        return;
+    }
+
+    // Non-inclusive split puts the keys less than the given one to the left,
+    // the inclusive one also puts the equal key to the left
+    const bool goesLeft = inclusive ?
+        ! NotesIntervalTree::isKeyLess(start, note, node->start, node->note) :
+        NotesIntervalTree::isKeyLess(node->start, node->note, start, note);
+
+    if (goesLeft)
+    {
+        NotesIntervalTree::split(node->right, start, note, inclusive, node->right, outRight);
+        outLeft = node;
+    }
+    else
+    {
+        NotesIntervalTree::split(node->left, start, note, inclusive, outLeft, node->left);
+        outRight = node;
+    }
+
+    NotesIntervalTree::update(node);
+}
+
+NotesIntervalTree::Node *NotesIntervalTree::merge(Node *left, Node *right)
+{
+    if (left == nullptr) { return right; }
+    if (right == nullptr) { return left; }
+
+    if (left->priority > right->priority)
+    {
+        left->right = NotesIntervalTree::merge(left->right, right);
+        NotesIntervalTree::update(left);
+        return left;
+    }
+
+    right->left = NotesIntervalTree::merge(left, right->left);
+    NotesIntervalTree::update(right);
+    return right;
+}
+
+void NotesIntervalTree::deleteSubtree(Node *node)
+{
+    if (node == nullptr)
+    { return; }
+
+    NotesIntervalTree::deleteSubtree(node->left);
+    NotesIntervalTree::deleteSubtree(node->right);
+    delete node;
+}
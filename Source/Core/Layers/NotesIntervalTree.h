@@ -0,0 +1,85 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class Note;
+
+// An index of notes' [beat, beat + length) ranges, owned by PianoLayer
+// and kept up to date on every edit.
+//
+// A treap keyed by note's start beat (and its pointer, to distinguish equal starts),
+// where each node also stores the max end beat of its subtree, so that queries
+// like "what's sounding at beat X" skip the subtrees that end before X.
+// Insertion and removal take O(log n), queries take O(log n + k) on average.
+//
+// Note that removal looks up a node by note's current beat,
+// so a note must be removed before it is changed, and re-inserted after.
+
+class NotesIntervalTree
+{
+public:
+
+    NotesIntervalTree();
+    ~NotesIntervalTree();
+
+    void insert(const Note *note);
+    void remove(const Note *note);
+    void clear();
+
+    int size() const noexcept;
+
+    // Finds all notes that are sounding at the given beat,
+    // i.e. the ones with beat <= targetBeat < beat + length
+    void findNotesAt(float targetBeat, Array<const Note *> &result) const;
+
+    // Finds all notes overlapping the [startBeat, endBeat) range
+    void findNotesWithin(float startBeat, float endBeat, Array<const Note *> &result) const;
+
+private:
+
+    struct Node
+    {
+        float start;
+        float end;
+        float maxEnd;
+        const Note *note;
+        int priority;
+        Node *left;
+        Node *right;
+    };
+
+    static bool isKeyLess(float start1, const Note *note1,
+                          float start2, const Note *note2) noexcept;
+
+    static void update(Node *node) noexcept;
+
+    static void split(Node *node, float start, const Note *note, bool inclusive, Node *&outLeft, Node *&outRight);
+    static Node *merge(Node *left, Node *right);
+    static void deleteSubtree(Node *node);
+
+    static void collect(const Node *node, float startBeat, float endBeat,
+                        bool includesStartAtEnd, Array<const Note *> &result);
+
+    Node *root;
+    int numNodes;
+
+    Random random;
+
+    JUCE_DECLARE_NON_COPYABLE(NotesIntervalTree);
+
+};
@@ -21,6 +21,7 @@
 #include "PianoRoll.h"
 #include "Note.h"
 #include "NoteActions.h"
+#include "MidiEventsChangeSet.h"
 #include "SerializationKeys.h"
 #include "ProjectTreeItem.h"
 #include "UndoStack.h"
@@ -97,10 +98,16 @@ void PianoLayer::silentImport(const MidiEvent &eventToImport)
     // we need it to be sorted just because of sequence building performance?
     this->midiEvents.addSorted(*storedNote, storedNote); // bottleneck warning
     this->notesHashTable.set(note, storedNote);
+    this->notesIntervalTree.insert(storedNote);
 
     this->updateBeatRange(false);
 }
 
+size_t PianoLayer::getEventSize() const noexcept
+{
+    return sizeof(Note);
+}
+
 MidiEvent *PianoLayer::insert(const Note &note, const bool undoable)
 {
     if (this->notesHashTable.contains(note))
@@ -120,6 +127,7 @@ MidiEvent *PianoLayer::insert(const Note &note, const bool undoable)
         
         this->midiEvents.addSorted(*storedNote, storedNote);
         this->notesHashTable.set(note, storedNote);
+        this->notesIntervalTree.insert(storedNote);
 
         this->notifyEventAdded(*storedNote);
         this->updateBeatRange(true);
@@ -144,6 +152,7 @@ bool PianoLayer::remove(const Note &note, const bool undoable)
         if (Note *matchingNote = this->notesHashTable[note])
         {
             this->notifyEventRemoved(*matchingNote);
+            this->notesIntervalTree.remove(matchingNote);
             
             const int matchingNoteIndex = this->indexOfSorted(matchingNote);
             this->midiEvents.remove(matchingNoteIndex, true);
@@ -178,8 +187,12 @@ bool PianoLayer::change(const Note &note,
     {
         if (Note *matchingNote = this->notesHashTable[note])
         {
+            // the tree looks notes up by their beats, so re-insert it
+            this->notesIntervalTree.remove(matchingNote);
+
             // fixme - remove and addSorted instead?
             (*matchingNote) = newNote;
+            this->notesIntervalTree.insert(matchingNote);
 
             this->notesHashTable.set(newNote, matchingNote);
 
@@ -210,6 +223,8 @@ bool PianoLayer::insertGroup(Array<Note> &notes, bool undoable)
     }
     else
     {
+        MidiEventsChangeSet changes(this);
+
         for (int i = 0; i < notes.size(); ++i)
         {
             const Note &note = notes.getUnchecked(i);
@@ -217,10 +232,12 @@ bool PianoLayer::insertGroup(Array<Note> &notes, bool undoable)
             
             this->midiEvents.add(storedNote); // sorted later
             this->notesHashTable.set(note, storedNote);
-            this->notifyEventAdded(*storedNote);
+            this->notesIntervalTree.insert(storedNote);
+            changes.addAddedEvent(*storedNote);
         }
 
         this->sort();
+        this->notifyEventsChanged(changes);
         this->updateBeatRange(true);
     }
 
@@ -237,22 +254,34 @@ bool PianoLayer::removeGroup(Array<Note> &notes, bool undoable)
     }
     else
     {
+        MidiEventsChangeSet changes(this);
+        Array<Note *> removedNotes;
+
         for (int i = 0; i < notes.size(); ++i)
         {
             const Note &note = notes.getUnchecked(i);
 
             if (Note *matchingNote = this->notesHashTable[note])
             {
-                this->notifyEventRemoved(*matchingNote);
-                
-                const int matchingNoteIndex = this->indexOfSorted(matchingNote);
-                this->midiEvents.remove(matchingNoteIndex, true);
-                //this->midiEvents.removeObject(matchingNote);
-                
+                // removing from the hash table right away also skips duplicates
                 this->notesHashTable.remove(note);
+                removedNotes.add(matchingNote);
+                changes.addRemovedEvent(*matchingNote);
             }
         }
 
+        // listeners are notified while the notes are still there
+        this->notifyEventsChanged(changes);
+
+        for (int i = 0; i < removedNotes.size(); ++i)
+        {
+            Note *removedNote = removedNotes.getUnchecked(i);
+            this->notesIntervalTree.remove(removedNote);
+
+            const int removedNoteIndex = this->indexOfSorted(removedNote);
+            this->midiEvents.remove(removedNoteIndex, true);
+        }
+
         this->updateBeatRange(true);
         this->notifyEventRemovedPostAction();
     }
@@ -275,6 +304,8 @@ bool PianoLayer::changeGroup(Array<Note> &notesBefore,
     }
     else
     {
+        MidiEventsChangeSet changes(this);
+
         for (int i = 0; i < notesBefore.size(); ++i)
         {
             const Note &note = notesBefore.getUnchecked(i);
@@ -282,14 +313,17 @@ bool PianoLayer::changeGroup(Array<Note> &notesBefore,
 
             if (Note *matchingNote = this->notesHashTable[note])
             {
+                this->notesIntervalTree.remove(matchingNote);
                 (*matchingNote) = newNote;
+                this->notesIntervalTree.insert(matchingNote);
 
                 this->notesHashTable.set(newNote, matchingNote);
-                this->notifyEventChanged(note, *matchingNote);
+                changes.addChangedEvent(note, *matchingNote);
             }
         }
 
         this->sort();
+        this->notifyEventsChanged(changes);
         this->updateBeatRange(true);
     }
 
@@ -350,6 +384,16 @@ float PianoLayer::getLastBeat() const
     return note.getBeat() + note.getLength();
 }
 
+void PianoLayer::findNotesAt(float targetBeat, Array<const Note *> &result) const
+{
+    this->notesIntervalTree.findNotesAt(targetBeat, result);
+}
+
+void PianoLayer::findNotesWithin(float startBeat, float endBeat, Array<const Note *> &result) const
+{
+    this->notesIntervalTree.findNotesWithin(startBeat, endBeat, result);
+}
+
 
 //===----------------------------------------------------------------------===//
 // Serializable
@@ -378,6 +422,7 @@ XmlElement *PianoLayer::serialize() const
 void PianoLayer::deserialize(const XmlElement &xml)
 {
     //this->reset(); // this will send change notifications
+    this->notesIntervalTree.clear();
     this->midiEvents.clear();
     this->notesHashTable.clear();
 
@@ -410,6 +455,7 @@ void PianoLayer::deserialize(const XmlElement &xml)
         firstBeat = jmin(firstBeat, note->getBeat());
 
         this->notesHashTable.set(*note, note);
+        this->notesIntervalTree.insert(note);
     }
 
     this->sort();
@@ -419,6 +465,7 @@ void PianoLayer::deserialize(const XmlElement &xml)
 
 void PianoLayer::reset()
 {
+    this->notesIntervalTree.clear();
     this->midiEvents.clear();
     this->notesHashTable.clear();
     this->notifyLayerChanged();
@@ -19,6 +19,7 @@
 
 #include "MidiLayer.h"
 #include "Note.h"
+#include "NotesIntervalTree.h"
 
 class PianoRoll;
 
@@ -41,6 +42,8 @@ public:
     //===------------------------------------------------------------------===//
 
     void silentImport(const MidiEvent &eventToImport) override;
+
+    size_t getEventSize() const noexcept override;
     
     
     MidiEvent *insert(const Note &note, const bool undoable);
@@ -71,6 +74,12 @@ public:
     
     float getLastBeat() const override; // overriding to set beat+length
     
+    // Notes sounding at the given beat, in the order of their start beats
+    void findNotesAt(float targetBeat, Array<const Note *> &result) const;
+
+    // Notes overlapping the [startBeat, endBeat) range
+    void findNotesWithin(float startBeat, float endBeat, Array<const Note *> &result) const;
+    
     
     //===------------------------------------------------------------------===//
     // Serializable
@@ -88,6 +97,9 @@ private:
     // todo вот прям быстрый? замени на dense_hash_map или flat_hash_map
     HashMap<Note, Note *, NoteHashFunction> notesHashTable;
 
+    // notes' time ranges, used for audition and playback start queries
+    NotesIntervalTree notesIntervalTree;
+
 private:
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PianoLayer);
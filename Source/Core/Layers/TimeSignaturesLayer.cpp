@@ -19,6 +19,7 @@
 #include "TimeSignaturesLayer.h"
 #include "Note.h"
 #include "TimeSignatureEventActions.h"
+#include "MidiEventsChangeSet.h"
 #include "SerializationKeys.h"
 #include "UndoStack.h"
 
@@ -81,6 +82,11 @@ void TimeSignaturesLayer::silentImport(const MidiEvent &eventToImport)
     this->updateBeatRange(false);
 }
 
+size_t TimeSignaturesLayer::getEventSize() const noexcept
+{
+    return sizeof(TimeSignatureEvent);
+}
+
 MidiEvent *TimeSignaturesLayer::insert(const TimeSignatureEvent &signature, bool undoable)
 {
     if (this->signaturesHashTable.contains(signature))
@@ -185,6 +191,8 @@ bool TimeSignaturesLayer::insertGroup(Array<TimeSignatureEvent> &signatures, boo
     }
     else
     {
+        MidiEventsChangeSet changes(this);
+
         for (int i = 0; i < signatures.size(); ++i)
         {
             const TimeSignatureEvent &signature = signatures.getUnchecked(i);
@@ -193,10 +201,11 @@ bool TimeSignaturesLayer::insertGroup(Array<TimeSignatureEvent> &signatures, boo
             
             this->midiEvents.add(storedSignature); // sorted later
             this->signaturesHashTable.set(signature, storedSignature);
-            this->notifyEventAdded(*storedSignature);
+            changes.addAddedEvent(*storedSignature);
         }
         
         this->sort();
+        this->notifyEventsChanged(changes);
         this->updateBeatRange(true);
     }
     
@@ -214,17 +223,28 @@ bool TimeSignaturesLayer::removeGroup(Array<TimeSignatureEvent> &signatures, boo
     }
     else
     {
+        MidiEventsChangeSet changes(this);
+        Array<TimeSignatureEvent *> removedSignatures;
+
         for (int i = 0; i < signatures.size(); ++i)
         {
             const TimeSignatureEvent &signature = signatures.getUnchecked(i);
             
             if (TimeSignatureEvent *matchingSignature = this->signaturesHashTable[signature])
             {
-                this->notifyEventRemoved(*matchingSignature);
-                this->midiEvents.removeObject(matchingSignature);
                 this->signaturesHashTable.removeValue(matchingSignature);
+                removedSignatures.add(matchingSignature);
+                changes.addRemovedEvent(*matchingSignature);
             }
         }
+
+        // listeners are notified while the events are still there
+        this->notifyEventsChanged(changes);
+
+        for (int i = 0; i < removedSignatures.size(); ++i)
+        {
+            this->midiEvents.removeObject(removedSignatures.getUnchecked(i));
+        }
         
         this->updateBeatRange(true);
         this->notifyEventRemovedPostAction();
@@ -249,6 +269,8 @@ bool TimeSignaturesLayer::changeGroup(Array<TimeSignatureEvent> &signaturesBefor
     }
     else
     {
+        MidiEventsChangeSet changes(this);
+
         for (int i = 0; i < signaturesBefore.size(); ++i)
         {
             // doing this sucks
@@ -262,11 +284,12 @@ bool TimeSignaturesLayer::changeGroup(Array<TimeSignatureEvent> &signaturesBefor
                 (*matchingSignature) = newSignature;
                 
                 this->signaturesHashTable.set(newSignature, matchingSignature);
-                this->notifyEventChanged(signature, *matchingSignature);
+                changes.addChangedEvent(signature, *matchingSignature);
             }
         }
 
         this->sort();
+        this->notifyEventsChanged(changes);
         this->updateBeatRange(true);
     }
 
@@ -133,6 +133,28 @@ File FileUtils::getConfigSlot(const String &fileName)
     return getFirstSlot(location1, location2, fileName);
 }
 
+File FileUtils::getConfigFolder(const String &folderName)
+{
+#if JUCE_LINUX
+    const File location("~/.config");
+#else
+    const File location(File::getSpecialLocation(File::userApplicationDataDirectory));
+#endif
+
+#if HELIO_DESKTOP
+    const File folder(location.getChildFile("Helio").getChildFile(folderName));
+#else
+    const File folder(location.getChildFile(folderName));
+#endif
+
+    if (! folder.isDirectory())
+    {
+        folder.createDirectory();
+    }
+
+    return folder;
+}
+
 File FileUtils::getDocumentSlot(const String &fileName)
 {
     const auto location1 = File::getSpecialLocation(File::userDocumentsDirectory).getFullPathName();
@@ -29,6 +29,9 @@ public:
 
     static File getConfigSlot(const String &fileName);
 
+    // A subfolder in the same location as configs, created if needed
+    static File getConfigFolder(const String &folderName);
+
     static File getTempSlot(const String &fileName);
 
 };
@@ -0,0 +1,304 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "MidiFileWriter.h"
+#include "MidiLayer.h"
+#include "MidiEvent.h"
+#include "Transport.h"
+
+MidiFileWriter::MidiFileWriter(OutputStream &targetStream) :
+    out(targetStream),
+    lastStatusByte(0),
+    lastTick(0)
+{
+}
+
+bool MidiFileWriter::writeLayers(const Array<MidiLayer *> &layers, const File &file)
+{
+    TemporaryFile tempFile(file);
+
+    {
+        FileOutputStream stream(tempFile.getFile(), MIDI_FILE_WRITER_BUFFER_SIZE);
+
+        if (stream.failedToOpen())
+        {
+            return false;
+        }
+
+        MidiFileWriter writer(stream);
+
+        if (! writer.writeHeader(layers.size()))
+        {
+            return false;
+        }
+
+        for (auto layer : layers)
+        {
+            if (! writer.writeTrack(layer))
+            {
+                return false;
+            }
+        }
+
+        stream.flush();
+
+        if (stream.getStatus().failed())
+        {
+            return false;
+        }
+    }
+
+    return tempFile.overwriteTargetFileWithTemporary();
+}
+
+
+//===----------------------------------------------------------------------===//
+// Batch export
+//===----------------------------------------------------------------------===//
+
+class MidiFileWriterJob : public ThreadPoolJob
+{
+public:
+
+    MidiFileWriterJob(const MidiFileWriter::Task &targetTask, Atomic<int> &numFilesWritten) :
+        ThreadPoolJob("MidiFileWriterJob"),
+        task(targetTask),
+        numWritten(numFilesWritten) {}
+
+    JobStatus runJob() override
+    {
+        if (MidiFileWriter::writeLayers(this->task.layers, this->task.file))
+        {
+            ++this->numWritten;
+        }
+
+        return jobHasFinished;
+    }
+
+private:
+
+    const MidiFileWriter::Task &task;
+    Atomic<int> &numWritten;
+
+};
+
+int MidiFileWriter::writeBatch(const OwnedArray<Task> &tasks)
+{
+    Atomic<int> numWritten(0);
+    ThreadPool pool(jmax(1, SystemStats::getNumCpus()));
+    OwnedArray<MidiFileWriterJob> jobs;
+
+    for (auto task : tasks)
+    {
+        MidiFileWriterJob *job = jobs.add(new MidiFileWriterJob(*task, numWritten));
+        pool.addJob(job, false);
+    }
+
+    for (auto job : jobs)
+    {
+        pool.waitForJobToFinish(job, -1);
+    }
+
+    return numWritten.get();
+}
+
+
+//===----------------------------------------------------------------------===//
+// Streaming
+//===----------------------------------------------------------------------===//
+
+bool MidiFileWriter::writeHeader(int numTracks)
+{
+    // same as MidiFile::writeTo with midiFileType = 1
+    return this->out.writeIntBigEndian(int(ByteOrder::bigEndianInt("MThd"))) &&
+        this->out.writeIntBigEndian(6) &&
+        this->out.writeShortBigEndian(1) &&
+        this->out.writeShortBigEndian(short(numTracks)) &&
+        this->out.writeShortBigEndian(short(Transport::millisecondsPerBeat));
+}
+
+bool MidiFileWriter::writeTrack(const MidiLayer *layer)
+{
+    this->pendingMessages.clearQuick();
+    zeromem(this->soundingNotes, sizeof(this->soundingNotes));
+    this->lastStatusByte = 0;
+    this->lastTick = 0;
+
+    // the chunk size is not known until the track is written,
+    // so leave a placeholder and get back to it afterwards
+    const int64 chunkStart = this->out.getPosition();
+
+    if (! this->out.writeIntBigEndian(int(ByteOrder::bigEndianInt("MTrk"))) ||
+        ! this->out.writeIntBigEndian(0))
+    {
+        return false;
+    }
+
+    // muted layers are exported as empty tracks
+    if (! layer->isMuted())
+    {
+        for (int i = 0; i < layer->size(); ++i)
+        {
+            const Array<MidiMessage> &messages = layer->getUnchecked(i)->getSequence();
+
+            if (messages.size() == 0)
+            { continue; }
+
+            // the events are sorted by beat, and every event's messages start at its beat,
+            // so whatever is pending before this point will never be preceded by anything else
+            double eventTimeStamp = messages.getReference(0).getTimeStamp();
+
+            for (auto &message : messages)
+            {
+                eventTimeStamp = jmin(eventTimeStamp, message.getTimeStamp());
+            }
+
+            this->flushMessagesUntil(eventTimeStamp);
+
+            for (auto &message : messages)
+            {
+                this->addMessage(message);
+            }
+        }
+
+        this->flushMessagesUntil(DBL_MAX);
+    }
+
+    // end of track, the exported sequences never have it
+    this->out.writeByte(0);
+    const MidiMessage endOfTrack(MidiMessage::endOfTrack());
+    this->out.write(endOfTrack.getRawData(), size_t(endOfTrack.getRawDataSize()));
+
+    const int64 chunkEnd = this->out.getPosition();
+    const int chunkDataSize = int(chunkEnd - chunkStart - 8);
+
+    return this->out.setPosition(chunkStart + 4) &&
+        this->out.writeIntBigEndian(chunkDataSize) &&
+        this->out.setPosition(chunkEnd);
+}
+
+void MidiFileWriter::addMessage(const MidiMessage &message)
+{
+    // same as MidiMessageSequence::addEvent: keep the order of messages with equal timestamps
+    const double timeStamp = message.getTimeStamp();
+    int i = this->pendingMessages.size();
+
+    while (i > 0 && this->pendingMessages.getReference(i - 1).getTimeStamp() > timeStamp)
+    {
+        --i;
+    }
+
+    this->pendingMessages.insert(i, message);
+}
+
+void MidiFileWriter::flushMessagesUntil(double timeStamp)
+{
+    int numFlushed = 0;
+
+    while (numFlushed < this->pendingMessages.size() &&
+           this->pendingMessages.getReference(numFlushed).getTimeStamp() <= timeStamp)
+    {
+        this->writeMessage(this->pendingMessages.getReference(numFlushed));
+        ++numFlushed;
+    }
+
+    this->pendingMessages.removeRange(0, numFlushed);
+}
+
+void MidiFileWriter::writeMessage(const MidiMessage &message)
+{
+    // MidiMessageSequence::updateMatchedPairs inserts a note-off
+    // before a note-on, if the same key is still sounding
+    if (message.isNoteOn())
+    {
+        const int index = (message.getChannel() - 1) * 128 + message.getNoteNumber();
+
+        if (this->soundingNotes[index])
+        {
+            MidiMessage noteOff(MidiMessage::noteOff(message.getChannel(), message.getNoteNumber()));
+            noteOff.setTimeStamp(message.getTimeStamp());
+            this->writeEvent(noteOff);
+        }
+
+        this->soundingNotes[index] = true;
+    }
+    else if (message.isNoteOff())
+    {
+        const int index = (message.getChannel() - 1) * 128 + message.getNoteNumber();
+        this->soundingNotes[index] = false;
+    }
+
+    this->writeEvent(message);
+}
+
+void MidiFileWriter::writeEvent(const MidiMessage &message)
+{
+    // same as MidiFile::writeTrack
+    const int tick = roundToInt(message.getTimeStamp());
+    const int delta = jmax(0, tick - this->lastTick);
+    this->writeVariableLengthInt(uint32(delta));
+    this->lastTick = tick;
+
+    const uint8 *data = message.getRawData();
+    int dataSize = message.getRawDataSize();
+    const uint8 statusByte = data[0];
+
+    if (statusByte == this->lastStatusByte &&
+        (statusByte & 0xf0) != 0xf0 &&
+        dataSize > 1)
+    {
+        // running status
+        ++data;
+        --dataSize;
+    }
+    else if (statusByte == 0xf0)
+    {
+        this->out.writeByte(char(statusByte));
+        ++data;
+        --dataSize;
+        this->writeVariableLengthInt(uint32(dataSize));
+    }
+
+    this->out.write(data, size_t(dataSize));
+    this->lastStatusByte = statusByte;
+}
+
+void MidiFileWriter::writeVariableLengthInt(uint32 value)
+{
+    uint32 buffer = value & 0x7f;
+
+    while ((value >>= 7) != 0)
+    {
+        buffer <<= 8;
+        buffer |= ((value & 0x7f) | 0x80);
+    }
+
+    for (;;)
+    {
+        this->out.writeByte(char(buffer));
+
+        if (buffer & 0x80)
+        {
+            buffer >>= 8;
+        }
+        else
+        {
+            break;
+        }
+    }
+}
@@ -0,0 +1,77 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class MidiLayer;
+
+#define MIDI_FILE_WRITER_BUFFER_SIZE (64 * 1024)
+
+// Writes layers into a standard midi file, streaming their events straight
+// into a buffered file stream, without building a MidiMessageSequence
+// and a MidiFile copy of every track first.
+//
+// The output is byte-identical to MidiFile::writeTo for the sequences
+// returned by MidiLayer::exportMidi: a type 1 file with a track per layer,
+// events sorted stably by time, running status, and the note-offs which
+// MidiMessageSequence::updateMatchedPairs inserts between overlapping
+// notes of the same key.
+//
+// Relies on the layers' events being sorted by beat (see MidiEvent::compareElements),
+// so that only the messages of the notes still sounding need to be kept in memory.
+
+class MidiFileWriter
+{
+public:
+
+    static bool writeLayers(const Array<MidiLayer *> &layers, const File &file);
+
+    struct Task
+    {
+        Array<MidiLayer *> layers;
+        File file;
+    };
+
+    // Writes several files in parallel, a worker thread per cpu core.
+    // Blocks until all of them are written, so that the layers are not changed meanwhile.
+    // Returns the number of files written successfully.
+    static int writeBatch(const OwnedArray<Task> &tasks);
+
+private:
+
+    explicit MidiFileWriter(OutputStream &targetStream);
+
+    bool writeHeader(int numTracks);
+    bool writeTrack(const MidiLayer *layer);
+
+    void addMessage(const MidiMessage &message);
+    void flushMessagesUntil(double timeStamp);
+    void writeMessage(const MidiMessage &message);
+    void writeEvent(const MidiMessage &message);
+    void writeVariableLengthInt(uint32 value);
+
+    OutputStream &out;
+
+    // per-track state
+    Array<MidiMessage> pendingMessages;
+    bool soundingNotes[16 * 128];
+    uint8 lastStatusByte;
+    int lastTick;
+
+    JUCE_DECLARE_NON_COPYABLE(MidiFileWriter);
+
+};
@@ -45,6 +45,7 @@ namespace Serialization
 
         static const String plugin = "Plugin";
         static const String pluginState = "State";
+        static const String pluginStateBlob = "Blob";
 
         static const String project = "Project";
         static const String projectInfo = "ProjectInfo";
@@ -228,6 +229,10 @@ namespace Serialization
         static const String head = "Head";
         static const String headIndex = "HeadIndex";
         static const String headIndexData = "HeadIndexData";
+        static const String headSnapshots = "HeadSnapshots";
+        static const String headSnapshot = "HeadSnapshot";
+        static const String headSnapshotRevisionId = "RevisionId";
+        static const String headSnapshotDepth = "Depth";
         static const String headRevisionId = "HeadRevisionId";
         static const String commitMessage = "Message";
         static const String commitTimeStamp = "Date";
@@ -322,6 +327,8 @@ namespace Serialization
     {
         static const String undoStack = "UndoStack";
         static const String transaction = "Transaction";
+        static const String memoryBudget = "UndoMemoryBudget";
+        static const String history = "History";
 
         static const String name = "Name";
         static const String xPath = "Path";
@@ -30,6 +30,8 @@
 #include "Arpeggiator.h"
 #include <float.h>
 #include <math.h>
+#include <map>
+#include <set>
 
 #if !defined M_PI
 #define M_PI 3.14159265358979323846
@@ -685,6 +687,378 @@ void MidiRollToolbox::snapSelection(MidiEventSelection &selection, float snapsPe
 }
 
 
+//===----------------------------------------------------------------------===//
+// Sweep-line helpers for bulk edits
+//===----------------------------------------------------------------------===//
+
+// Bulk edits work on a snapshot of the selected notes (in selection order),
+// simulating every pass of the edit over the snapshot, so that all the changes
+// are applied at once in the end; the notes are visited in the order of keys
+// and beats, so that each pass is a single sweep over every key's notes
+
+struct NoteComparator
+{
+    static int compareElements(const Note &first, const Note &second)
+    { return Note::compareElements(first, second); }
+};
+
+static float endBeatOf(const Note &note)
+{
+    return note.getBeat() + note.getLength();
+}
+
+struct NotesByKeyAndBeat
+{
+    explicit NotesByKeyAndBeat(const Array<Note> &notesRef) : notes(notesRef) {}
+
+    int compareElements(int first, int second) const
+    {
+        const Note &a = this->notes.getReference(first);
+        const Note &b = this->notes.getReference(second);
+
+        const int keyDiff = a.getKey() - b.getKey();
+        if (keyDiff != 0) { return (keyDiff > 0) - (keyDiff < 0); }
+
+        const float beatDiff = a.getBeat() - b.getBeat();
+        const int beatResult = (beatDiff > 0.f) - (beatDiff < 0.f);
+        if (beatResult != 0) { return beatResult; }
+
+        return (first > second) - (first < second);
+    }
+
+    const Array<Note> &notes;
+};
+
+static Array<int> sortByKeyAndBeat(const Array<Note> &notes)
+{
+    Array<int> order;
+    order.ensureStorageAllocated(notes.size());
+
+    for (int i = 0; i < notes.size(); ++i)
+    {
+        order.add(i);
+    }
+
+    NotesByKeyAndBeat comparator(notes);
+    order.sort(comparator);
+    return order;
+}
+
+// Calls the callback for each range of notes with the same key and beat,
+// i.e. callback(int keyStart, int keyEnd, int beatStart, int beatEnd)
+// with positions in the sorted order, in the ascending or descending order of beats
+template<typename Callback>
+static void forEachBeatGroup(const Array<Note> &notes, const Array<int> &order, bool ascending, Callback callback)
+{
+    int keyStart = 0;
+
+    while (keyStart < order.size())
+    {
+        const int key = notes.getReference(order.getUnchecked(keyStart)).getKey();
+        int keyEnd = keyStart;
+
+        while (keyEnd < order.size() &&
+               notes.getReference(order.getUnchecked(keyEnd)).getKey() == key)
+        { ++keyEnd; }
+
+        if (ascending)
+        {
+            for (int groupStart = keyStart; groupStart < keyEnd; )
+            {
+                const float beat = notes.getReference(order.getUnchecked(groupStart)).getBeat();
+                int groupEnd = groupStart;
+
+                while (groupEnd < keyEnd &&
+                       notes.getReference(order.getUnchecked(groupEnd)).getBeat() == beat)
+                { ++groupEnd; }
+
+                callback(keyStart, keyEnd, groupStart, groupEnd);
+                groupStart = groupEnd;
+            }
+        }
+        else
+        {
+            for (int groupEnd = keyEnd; groupEnd > keyStart; )
+            {
+                const float beat = notes.getReference(order.getUnchecked(groupEnd - 1)).getBeat();
+                int groupStart = groupEnd;
+
+                while (groupStart > keyStart &&
+                       notes.getReference(order.getUnchecked(groupStart - 1)).getBeat() == beat)
+                { --groupStart; }
+
+                callback(keyStart, keyEnd, groupStart, groupEnd);
+                groupEnd = groupStart;
+            }
+        }
+
+        keyStart = keyEnd;
+    }
+}
+
+// Each note, fully covered by a longer note started earlier,
+// is extended to the end of the longest of such notes
+static bool extendCoveredNotes(Array<Note> &notes, const Array<int> &order, Array<bool> &changed)
+{
+    Array<Note> result(notes);
+    bool hasChanges = false;
+    float maxEndBeat = -FLT_MAX;
+    int currentKeyStart = -1;
+
+    forEachBeatGroup(notes, order, true, [&](int keyStart, int, int groupStart, int groupEnd)
+    {
+        if (keyStart != currentKeyStart)
+        {
+            currentKeyStart = keyStart;
+            maxEndBeat = -FLT_MAX;
+        }
+
+        for (int i = groupStart; i < groupEnd; ++i)
+        {
+            const int index = order.getUnchecked(i);
+            const Note &note = notes.getReference(index);
+            const float deltaBeats = maxEndBeat - endBeatOf(note);
+
+            if (deltaBeats > 0.f)
+            {
+                result.setUnchecked(index, note.withLength(note.getLength() + deltaBeats));
+                changed.setUnchecked(index, true);
+                hasChanges = true;
+            }
+        }
+
+        for (int i = groupStart; i < groupEnd; ++i)
+        {
+            maxEndBeat = jmax(maxEndBeat, endBeatOf(notes.getReference(order.getUnchecked(i))));
+        }
+    });
+
+    notes.swapWith(result);
+    return hasChanges;
+}
+
+// Each note, partially overlapped by a note started later and ending later,
+// is extended to the end of the overlapping note; when several notes overlap
+// the same note, the one selected last wins, as if the changes were applied in order
+static bool extendOverlappedNotes(Array<Note> &notes, const Array<int> &order, Array<bool> &changed)
+{
+    Array<int> extendedBy;
+    Array<float> extensions;
+    extendedBy.insertMultiple(0, -1, notes.size());
+    extensions.insertMultiple(0, 0.f, notes.size());
+
+    // end beats and indices of the notes started earlier than the current group
+    std::set<std::pair<float, int>> earlierNotes;
+    int currentKeyStart = -1;
+
+    forEachBeatGroup(notes, order, true, [&](int keyStart, int, int groupStart, int groupEnd)
+    {
+        if (keyStart != currentKeyStart)
+        {
+            currentKeyStart = keyStart;
+            earlierNotes.clear();
+        }
+
+        for (int i = groupStart; i < groupEnd; ++i)
+        {
+            const int index = order.getUnchecked(i);
+            const Note &note = notes.getReference(index);
+            const float endBeat = endBeatOf(note);
+
+            // the earliest ending note that still sounds at this note's start
+            const auto overlapping = earlierNotes.upper_bound({ note.getBeat(), std::numeric_limits<int>::max() });
+
+            if (overlapping != earlierNotes.end() &&
+                overlapping->first < endBeat &&
+                extendedBy.getUnchecked(overlapping->second) < index)
+            {
+                extendedBy.setUnchecked(overlapping->second, index);
+                extensions.setUnchecked(overlapping->second, endBeat - overlapping->first);
+            }
+        }
+
+        for (int i = groupStart; i < groupEnd; ++i)
+        {
+            const int index = order.getUnchecked(i);
+            earlierNotes.insert({ endBeatOf(notes.getReference(index)), index });
+        }
+    });
+
+    bool hasChanges = false;
+
+    for (int i = 0; i < notes.size(); ++i)
+    {
+        if (extendedBy.getUnchecked(i) >= 0)
+        {
+            notes.setUnchecked(i, notes.getReference(i).withDeltaLength(extensions.getUnchecked(i)));
+            changed.setUnchecked(i, true);
+            hasChanges = true;
+        }
+    }
+
+    return hasChanges;
+}
+
+// Each note, covering a note started later, is cut at the start of the earliest of such notes
+static bool trimCoveringNotes(Array<Note> &notes, const Array<int> &order, Array<bool> &changed)
+{
+    Array<Note> result(notes);
+    bool hasChanges = false;
+
+    // end beat : start beat of the notes started later than the current group,
+    // kept as a staircase, where start beats decrease as end beats increase,
+    // so the last entry not ending after some beat is the earliest started one
+    std::map<float, float> laterNotes;
+    int currentKeyStart = -1;
+
+    forEachBeatGroup(notes, order, false, [&](int keyStart, int, int groupStart, int groupEnd)
+    {
+        if (keyStart != currentKeyStart)
+        {
+            currentKeyStart = keyStart;
+            laterNotes.clear();
+        }
+
+        for (int i = groupStart; i < groupEnd; ++i)
+        {
+            const int index = order.getUnchecked(i);
+            const Note &note = notes.getReference(index);
+            const float endBeat = endBeatOf(note);
+            auto covered = laterNotes.upper_bound(endBeat);
+
+            if (covered != laterNotes.begin())
+            {
+                --covered;
+                const float overlappingBeats = endBeat - covered->second;
+                result.setUnchecked(index, note.withLength(note.getLength() - overlappingBeats));
+                changed.setUnchecked(index, true);
+                hasChanges = true;
+            }
+        }
+
+        for (int i = groupStart; i < groupEnd; ++i)
+        {
+            const Note &note = notes.getReference(order.getUnchecked(i));
+            const float endBeat = endBeatOf(note);
+            laterNotes.erase(laterNotes.lower_bound(endBeat), laterNotes.end());
+            laterNotes[endBeat] = note.getBeat();
+        }
+    });
+
+    notes.swapWith(result);
+    return hasChanges;
+}
+
+// Finds the notes to be removed as duplicates: a note started at the same beat
+// as another one, or started within another one (or covered by another one,
+// if fullOverlapOnly is set); the notes are checked in the selection order,
+// and the ones that made others removed are never removed themselves
+static void findDuplicates(const Array<Note> &notes, const Array<int> &order,
+                           bool fullOverlapOnly, Array<bool> &outRemoved)
+{
+    // for every note, the notes it duplicates
+    Array<Array<int>> duplicates;
+    duplicates.insertMultiple(0, Array<int>(), notes.size());
+
+    // end beats and indices of the notes started earlier or at the current beat
+    std::multimap<float, int> startedNotes;
+    int currentKeyStart = -1;
+
+    forEachBeatGroup(notes, order, true, [&](int keyStart, int, int groupStart, int groupEnd)
+    {
+        if (keyStart != currentKeyStart)
+        {
+            currentKeyStart = keyStart;
+            startedNotes.clear();
+        }
+
+        for (int i = groupStart; i < groupEnd; ++i)
+        {
+            const int index = order.getUnchecked(i);
+            startedNotes.insert({ endBeatOf(notes.getReference(index)), index });
+        }
+
+        for (int i = groupStart; i < groupEnd; ++i)
+        {
+            const int index = order.getUnchecked(i);
+            const Note &note = notes.getReference(index);
+            Array<int> &noteDuplicates = duplicates.getReference(index);
+
+            const auto overlapping = fullOverlapOnly ?
+                startedNotes.lower_bound(endBeatOf(note)) :
+                startedNotes.upper_bound(note.getBeat());
+
+            for (auto j = overlapping; j != startedNotes.end(); ++j)
+            {
+                if (j->second != index)
+                {
+                    noteDuplicates.add(j->second);
+                }
+            }
+
+            // the notes started at the same beat, if not found above
+            for (int k = groupStart; k < groupEnd; ++k)
+            {
+                const int otherIndex = order.getUnchecked(k);
+                const float otherEndBeat = endBeatOf(notes.getReference(otherIndex));
+
+                const bool foundAbove = fullOverlapOnly ?
+                    (otherEndBeat >= endBeatOf(note)) :
+                    (otherEndBeat > note.getBeat());
+
+                if (otherIndex != index && ! foundAbove)
+                {
+                    noteDuplicates.add(otherIndex);
+                }
+            }
+        }
+    });
+
+    Array<bool> unremovable;
+    unremovable.insertMultiple(0, false, notes.size());
+    outRemoved.clearQuick();
+    outRemoved.insertMultiple(0, false, notes.size());
+
+    for (int i = 0; i < notes.size(); ++i)
+    {
+        for (auto j : duplicates.getReference(i))
+        {
+            if (! unremovable.getUnchecked(j))
+            {
+                unremovable.setUnchecked(i, true);
+                outRemoved.setUnchecked(j, true);
+            }
+        }
+    }
+}
+
+static void applyChangesAndRemovals(const Array<Note> &notesBefore,
+                                    const Array<Note> &notesAfter,
+                                    const Array<bool> &changed,
+                                    const Array<bool> &removed,
+                                    bool shouldCheckpoint)
+{
+    bool didCheckpoint = false;
+    PianoChangeGroup groupBefore, groupAfter, removalGroup;
+
+    for (int i = 0; i < notesBefore.size(); ++i)
+    {
+        if (removed.getUnchecked(i))
+        {
+            removalGroup.add(notesBefore.getReference(i));
+        }
+        else if (changed.getUnchecked(i))
+        {
+            groupBefore.add(notesBefore.getReference(i));
+            groupAfter.add(notesAfter.getReference(i));
+        }
+    }
+
+    applyPianoChanges(groupBefore, groupAfter, didCheckpoint, shouldCheckpoint);
+    applyPianoRemovals(removalGroup, didCheckpoint, shouldCheckpoint);
+}
+
+
 void MidiRollToolbox::removeOverlaps(MidiEventSelection &selection, bool shouldCheckpoint)
 {
     if (selection.getNumSelected() == 0)
@@ -692,34 +1066,41 @@ void MidiRollToolbox::removeOverlaps(MidiEventSelection &selection, bool shouldC
         return;
     }
     
-    bool didCheckpoint = false;
-    
-    // 0 snap to 0.001 beat
-    PianoChangeGroup group0Before, group0After;
+    Array<Note> notesBefore;
+    Array<bool> changed;
     
     for (int i = 0; i < selection.getNumSelected(); ++i)
     {
         NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(i));
+        notesBefore.add(nc->getNote());
+        changed.add(false);
+    }
+    
+    Array<Note> notes(notesBefore);
+    
+    // 0 snap to 0.1 beat
+    for (int i = 0; i < notes.size(); ++i)
+    {
+        const Note &note = notes.getReference(i);
         
         const float minSnap = 0.1f;
-        const float startBeat = nc->getBeat();
+        const float startBeat = note.getBeat();
         const float startBeatSnap = snappedBeat(startBeat, minSnap);
         
-        const float endBeat = nc->getBeat() + nc->getLength();
+        const float endBeat = note.getBeat() + note.getLength();
         const float endBeatSnap = snappedBeat(endBeat, minSnap);
         const float lengthSnap = endBeatSnap - startBeatSnap;
         
         if (startBeat != startBeatSnap ||
             endBeat != endBeatSnap)
         {
-            //Logger::writeToLog("snap");
-            group0Before.add(nc->getNote());
-            group0After.add(nc->getNote().withBeat(startBeatSnap).withLength(lengthSnap));
+            notes.setUnchecked(i, note.withBeat(startBeatSnap).withLength(lengthSnap));
+            changed.setUnchecked(i, true);
         }
     }
     
-    applyPianoChanges(group0Before, group0After, didCheckpoint, shouldCheckpoint);
-    
+    // beats don't change after this point, only lengths do
+    const Array<int> order(sortByKeyAndBeat(notes));
     
     // 1 convert this
     //    ----
@@ -728,109 +1109,16 @@ void MidiRollToolbox::removeOverlaps(MidiEventSelection &selection, bool shouldC
     //    ---------
     // ------------
     
-    // todo repeat while does any changes
-    
-    bool step1HasChanges = false;
-    
-    do
-    {
-        PianoChangeGroup group1Before, group1After;
-        
-        for (int i = 0; i < selection.getNumSelected(); ++i)
-        {
-            NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(i));
-            
-            // для каждой ноты найти ноту, которая полностью перекрывает ее на максимальную длину
-            
-            float deltaBeats = -FLT_MAX;
-            const Note *overlappingNote = nullptr;
-            
-            for (int j = 0; j < selection.getNumSelected(); ++j)
-            {
-                NoteComponent *nc2 = static_cast<NoteComponent *>(selection.getSelectedItem(j));
-                
-                if (nc->getKey() == nc2->getKey() &&
-                    nc->getBeat() > nc2->getBeat() &&
-                    (nc->getBeat() + nc->getLength()) < (nc2->getBeat() + nc2->getLength()))
-                {
-                    const float currentDelta = (nc2->getBeat() + nc2->getLength()) - (nc->getBeat() + nc->getLength());
-                    
-                    if (deltaBeats < currentDelta)
-                    {
-                        deltaBeats = currentDelta;
-                        overlappingNote = &nc2->getNote();
-                    }
-                }
-            }
-            
-            if (overlappingNote != nullptr)
-            {
-                //Logger::writeToLog("edit1");
-                const float newLength = nc->getLength() + deltaBeats;
-                group1Before.add(nc->getNote());
-                group1After.add(nc->getNote().withLength(newLength));
-            }
-        }
-        
-        step1HasChanges = applyPianoChanges(group1Before, group1After, didCheckpoint, shouldCheckpoint);
-    }
-    while (step1HasChanges);
-    
+    while (extendCoveredNotes(notes, order, changed)) {}
     
-    // 1 convert this
+    // 2 convert this
     //    -------------
     // ------------
     // into this
     //    -------------
     // ----------------
     
-    bool step2HasChanges = false;
-
-    do
-    {
-        step2HasChanges = false;
-        PianoChangeGroup group2Before, group2After;
-        
-        for (int i = 0; i < selection.getNumSelected(); ++i)
-        {
-            NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(i));
-            
-            // для каждой ноты найти ноту, которая полностью перекрывает ее на максимальную длину
-            
-            float deltaBeats = -FLT_MAX;
-            const NoteComponent *overlappingNote = nullptr;
-            
-            for (int j = 0; j < selection.getNumSelected(); ++j)
-            {
-                NoteComponent *nc2 = static_cast<NoteComponent *>(selection.getSelectedItem(j));
-                
-                if (nc->getKey() == nc2->getKey() &&
-                    nc->getBeat() > nc2->getBeat() &&
-                    nc->getBeat() < (nc2->getBeat() + nc2->getLength()) &&
-                    (nc->getBeat() + nc->getLength()) > (nc2->getBeat() + nc2->getLength()))
-                {
-                    const float currentDelta = (nc->getBeat() + nc->getLength()) - (nc2->getBeat() + nc2->getLength());
-                    
-                    if (deltaBeats < currentDelta)
-                    {
-                        deltaBeats = currentDelta;
-                        overlappingNote = nc2;
-                    }
-                }
-            }
-            
-            if (overlappingNote != nullptr)
-            {
-                //Logger::writeToLog("edit2");
-                group2Before.add(overlappingNote->getNote());
-                group2After.add(overlappingNote->getNote().withDeltaLength(deltaBeats));
-            }
-        }
-        
-        step2HasChanges = applyPianoChanges(group2Before, group2After, didCheckpoint, shouldCheckpoint);
-    }
-    while (step2HasChanges);
-    
+    while (extendOverlappedNotes(notes, order, changed)) {}
     
     // 3 convert this
     // ------------    ------------
@@ -839,105 +1127,13 @@ void MidiRollToolbox::removeOverlaps(MidiEventSelection &selection, bool shouldC
     // ---             ---
     //    ---------       ---------
     
-    bool step3HasChanges = false;
-
-    do
-    {
-        step3HasChanges = false;
-        PianoChangeGroup group3Before, group3After;
-        
-        for (int i = 0; i < selection.getNumSelected(); ++i)
-        {
-            NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(i));
-            
-            // для каждой ноты найти ноту, которая перекрывает ее максимально
-            
-            float overlappingBeats = -FLT_MAX;
-            const NoteComponent *overlappingNote = nullptr;
-            
-            for (int j = 0; j < selection.getNumSelected(); ++j)
-            {
-                NoteComponent *nc2 = static_cast<NoteComponent *>(selection.getSelectedItem(j));
-                
-                if (nc->getKey() == nc2->getKey() &&
-                    nc->getBeat() < nc2->getBeat() &&
-                    (nc->getBeat() + nc->getLength()) >= (nc2->getBeat() + nc2->getLength()))
-                {
-                    // >0 : has overlap
-                    const float overlapsWith = (nc->getBeat() + nc->getLength()) - nc2->getBeat();
-                    
-                    if (overlapsWith > overlappingBeats)
-                    {
-                        overlappingBeats = overlapsWith;
-                        overlappingNote = nc2;
-                    }
-                }
-            }
-            
-            if (overlappingNote != nullptr)
-            {
-                const float newLength = nc->getLength() - overlappingBeats;
-                //Logger::writeToLog("edit3 " + String(nc->getNote().getLength()) + ":" + String(newLength));
-                group3Before.add(nc->getNote());
-                group3After.add(nc->getNote().withLength(newLength));
-            }
-        }
-        
-        step3HasChanges = applyPianoChanges(group3Before, group3After, didCheckpoint, shouldCheckpoint);
-    }
-    while (step3HasChanges);
-    
+    while (trimCoveringNotes(notes, order, changed)) {}
     
-    // remove duplicates
+    // remove duplicates, partial overlaps also
+    Array<bool> removed;
+    findDuplicates(notes, order, false, removed);
     
-    HashMap<MidiEvent::Id, Note> deferredRemoval;
-    HashMap<MidiEvent::Id, Note> unremovableNotes;
-    
-    for (int i = 0; i < selection.getNumSelected(); ++i)
-    {
-        NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(i));
-        
-        for (int j = 0; j < selection.getNumSelected(); ++j)
-        {
-            if (i == j)
-            {
-                continue;
-            }
-            
-            NoteComponent *nc2 = static_cast<NoteComponent *>(selection.getSelectedItem(j));
-            
-            // full overlap
-            //const bool isOverlappingNote = (nc->getKey() == nc2->getKey() &&
-            //                                nc->getBeat() >= nc2->getBeat() &&
-            //                                (nc->getBeat() + nc->getLength()) <= (nc2->getBeat() + nc2->getLength()));
-
-            // partial overlaps also
-            const bool isOverlappingNote = (nc->getKey() == nc2->getKey() &&
-                                            nc->getBeat() >= nc2->getBeat() &&
-                                            nc->getBeat() < (nc2->getBeat() + nc2->getLength()));
-            
-            const bool startsFromTheSameBeat = (nc->getKey() == nc2->getKey() &&
-                                                nc->getBeat() == nc2->getBeat());
-            
-            const bool isOriginalNote = unremovableNotes.contains(nc2->getNote().getID());
-            
-            if (! isOriginalNote &&
-                (isOverlappingNote || startsFromTheSameBeat))
-            {
-                unremovableNotes.set(nc->getNote().getID(), nc->getNote());
-                deferredRemoval.set(nc2->getNote().getID(), nc2->getNote());
-            }
-        }
-    }
-    
-    PianoChangeGroup removalGroup;
-    HashMap<MidiEvent::Id, Note>::Iterator deferredRemovalIterator(deferredRemoval);
-    while (deferredRemovalIterator.next())
-    {
-        removalGroup.add(deferredRemovalIterator.getValue());
-    }
-
-    applyPianoRemovals(removalGroup, didCheckpoint, shouldCheckpoint);
+    applyChangesAndRemovals(notesBefore, notes, changed, removed, shouldCheckpoint);
 }
 
 void MidiRollToolbox::removeDuplicates(MidiEventSelection &selection, bool shouldCheckpoint)
@@ -945,51 +1141,21 @@ void MidiRollToolbox::removeDuplicates(MidiEventSelection &selection, bool shoul
     if (selection.getNumSelected() == 0)
     { return; }
     
-    HashMap<MidiEvent::Id, Note> deferredRemoval;
-    HashMap<MidiEvent::Id, Note> unremovableNotes;
+    Array<Note> notes;
+    Array<bool> changed;
     
-    bool didCheckpoint = false;
-
     for (int i = 0; i < selection.getNumSelected(); ++i)
     {
         NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(i));
-        
-        for (int j = 0; j < selection.getNumSelected(); ++j)
-        {
-            if (i == j)
-            {
-                continue;
-            }
-            
-            NoteComponent *nc2 = static_cast<NoteComponent *>(selection.getSelectedItem(j));
-            
-            // full overlap
-            const bool isOverlappingNote = (nc->getKey() == nc2->getKey() &&
-                                            nc->getBeat() >= nc2->getBeat() &&
-                                            (nc->getBeat() + nc->getLength()) <= (nc2->getBeat() + nc2->getLength()));
-
-            const bool startsFromTheSameBeat = (nc->getKey() == nc2->getKey() &&
-                                                nc->getBeat() == nc2->getBeat());
-            
-            const bool isOriginalNote = unremovableNotes.contains(nc2->getNote().getID());
-
-            if (! isOriginalNote &&
-                (isOverlappingNote || startsFromTheSameBeat))
-            {
-                unremovableNotes.set(nc->getNote().getID(), nc->getNote());
-                deferredRemoval.set(nc2->getNote().getID(), nc2->getNote());
-            }
-        }
+        notes.add(nc->getNote());
+        changed.add(false);
     }
     
-    PianoChangeGroup removalGroup;
-    HashMap<MidiEvent::Id, Note>::Iterator deferredRemovalIterator(deferredRemoval);
-    while (deferredRemovalIterator.next())
-    {
-        removalGroup.add(deferredRemovalIterator.getValue());
-    }
+    // full overlaps only
+    Array<bool> removed;
+    findDuplicates(notes, sortByKeyAndBeat(notes), true, removed);
     
-    applyPianoRemovals(removalGroup, didCheckpoint, shouldCheckpoint);
+    applyChangesAndRemovals(notes, notes, changed, removed, shouldCheckpoint);
 }
 
 
@@ -1127,13 +1293,18 @@ bool MidiRollToolbox::arpeggiate(MidiEventSelection &selection,
 
         // 1. sort selection
         PianoChangeGroupProxy::Ptr sortedSelection(new PianoChangeGroupProxy());
+        sortedSelection->ensureStorageAllocated(layerSelection->size());
         
         for (int i = 0; i < layerSelection->size(); ++i)
         {
             NoteComponent *nc = static_cast<NoteComponent *>(layerSelection->getUnchecked(i));
-            sortedSelection->addSorted(nc->getNote(), nc->getNote());
+            sortedSelection->add(nc->getNote());
         }
         
+        // sorted once, the same way as addSorted would do
+        NoteComparator comparator;
+        sortedSelection->sort(comparator);
+        
         const float selectionStartBeat = MidiRollToolbox::findStartBeat(*sortedSelection);
         
         
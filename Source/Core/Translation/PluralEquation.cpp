@@ -0,0 +1,368 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "PluralEquation.h"
+#include "SerializationKeys.h"
+
+struct PluralEquation::Node
+{
+    enum Type
+    {
+        Constant,
+        Variable,
+        Not,
+        Negate,
+        Multiply,
+        Divide,
+        Modulo,
+        Add,
+        Subtract,
+        Less,
+        LessOrEqual,
+        Greater,
+        GreaterOrEqual,
+        Equal,
+        NotEqual,
+        And,
+        Or,
+        Condition
+    };
+
+    Node(Type nodeType, Node *first = nullptr, Node *second = nullptr, Node *third = nullptr) :
+        type(nodeType),
+        value(0),
+        a(first),
+        b(second),
+        c(third) {}
+
+    int64 evaluate(int64 x) const noexcept
+    {
+        switch (this->type)
+        {
+            case Constant:          return this->value;
+            case Variable:          return x;
+            case Not:               return ! this->a->evaluate(x);
+            case Negate:            return -this->a->evaluate(x);
+            case Multiply:          return this->a->evaluate(x) * this->b->evaluate(x);
+            case Add:               return this->a->evaluate(x) + this->b->evaluate(x);
+            case Subtract:          return this->a->evaluate(x) - this->b->evaluate(x);
+            case Less:              return this->a->evaluate(x) < this->b->evaluate(x);
+            case LessOrEqual:       return this->a->evaluate(x) <= this->b->evaluate(x);
+            case Greater:           return this->a->evaluate(x) > this->b->evaluate(x);
+            case GreaterOrEqual:    return this->a->evaluate(x) >= this->b->evaluate(x);
+            case Equal:             return this->a->evaluate(x) == this->b->evaluate(x);
+            case NotEqual:          return this->a->evaluate(x) != this->b->evaluate(x);
+            case And:               return this->a->evaluate(x) && this->b->evaluate(x);
+            case Or:                return this->a->evaluate(x) || this->b->evaluate(x);
+            case Condition:         return this->a->evaluate(x) ? this->b->evaluate(x) : this->c->evaluate(x);
+
+            case Divide:
+            case Modulo:
+            {
+                const int64 divisor = this->b->evaluate(x);
+                if (divisor == 0) { return 0; }
+                const int64 dividend = this->a->evaluate(x);
+                return (this->type == Divide) ? (dividend / divisor) : (dividend % divisor);
+            }
+        }
+
+        return 0;
+    }
+
+    Type type;
+    int64 value;
+    ScopedPointer<Node> a;
+    ScopedPointer<Node> b;
+    ScopedPointer<Node> c;
+};
+
+
+//===----------------------------------------------------------------------===//
+// Parser
+//===----------------------------------------------------------------------===//
+
+// A recursive descent parser with the C operator precedence;
+// every parse method returns nullptr on a syntax error
+class PluralEquation::Parser
+{
+public:
+
+    explicit Parser(const String &equation) :
+        source(equation.replace(Serialization::Locales::metaSymbol, "n")),
+        p(source.getCharPointer()) {}
+
+    Node *parse()
+    {
+        ScopedPointer<Node> node(this->parseCondition());
+
+        if (node == nullptr) { return nullptr; }
+
+        this->skipWhitespace();
+        return this->p.isEmpty() ? node.release() : nullptr;
+    }
+
+private:
+
+    String source;
+    String::CharPointerType p;
+
+    void skipWhitespace() noexcept
+    {
+        this->p = this->p.findEndOfWhitespace();
+    }
+
+    bool matches(const char *token) noexcept
+    {
+        this->skipWhitespace();
+        String::CharPointerType t(this->p);
+
+        for (const char *c = token; *c != 0; ++c)
+        {
+            if (t.getAndAdvance() != juce_wchar(*c))
+            { return false; }
+        }
+
+        this->p = t;
+        return true;
+    }
+
+    // Makes sure that, say, "<" does not match the "<=" token
+    bool matchesNotFollowedByEquals(const char *token) noexcept
+    {
+        const String::CharPointerType start(this->p);
+
+        if (! this->matches(token))
+        { return false; }
+
+        if (*this->p == '=')
+        {
+            this->p = start;
+            return false;
+        }
+
+        return true;
+    }
+
+    Node *parseCondition()
+    {
+        ScopedPointer<Node> condition(this->parseOr());
+
+        if (condition == nullptr || ! this->matches("?"))
+        { return condition.release(); }
+
+        ScopedPointer<Node> ifTrue(this->parseCondition());
+
+        if (ifTrue == nullptr || ! this->matches(":"))
+        { return nullptr; }
+
+        ScopedPointer<Node> ifFalse(this->parseCondition());
+
+        if (ifFalse == nullptr)
+        { return nullptr; }
+
+        return new Node(Node::Condition, condition.release(), ifTrue.release(), ifFalse.release());
+    }
+
+    Node *parseOr()
+    {
+        ScopedPointer<Node> left(this->parseAnd());
+
+        while (left != nullptr && this->matches("||"))
+        {
+            Node *right = this->parseAnd();
+            if (right == nullptr) { return nullptr; }
+            left = new Node(Node::Or, left.release(), right);
+        }
+
+        return left.release();
+    }
+
+    Node *parseAnd()
+    {
+        ScopedPointer<Node> left(this->parseEquality());
+
+        while (left != nullptr && this->matches("&&"))
+        {
+            Node *right = this->parseEquality();
+            if (right == nullptr) { return nullptr; }
+            left = new Node(Node::And, left.release(), right);
+        }
+
+        return left.release();
+    }
+
+    Node *parseEquality()
+    {
+        ScopedPointer<Node> left(this->parseComparison());
+
+        while (left != nullptr)
+        {
+            Node::Type type;
+
+            if (this->matches("=="))        { type = Node::Equal; }
+            else if (this->matches("!="))   { type = Node::NotEqual; }
+            else                            { break; }
+
+            Node *right = this->parseComparison();
+            if (right == nullptr) { return nullptr; }
+            left = new Node(type, left.release(), right);
+        }
+
+        return left.release();
+    }
+
+    Node *parseComparison()
+    {
+        ScopedPointer<Node> left(this->parseAdditive());
+
+        while (left != nullptr)
+        {
+            Node::Type type;
+
+            if (this->matches("<="))                    { type = Node::LessOrEqual; }
+            else if (this->matches(">="))               { type = Node::GreaterOrEqual; }
+            else if (this->matchesNotFollowedByEquals("<")) { type = Node::Less; }
+            else if (this->matchesNotFollowedByEquals(">")) { type = Node::Greater; }
+            else                                        { break; }
+
+            Node *right = this->parseAdditive();
+            if (right == nullptr) { return nullptr; }
+            left = new Node(type, left.release(), right);
+        }
+
+        return left.release();
+    }
+
+    Node *parseAdditive()
+    {
+        ScopedPointer<Node> left(this->parseMultiplicative());
+
+        while (left != nullptr)
+        {
+            Node::Type type;
+
+            if (this->matches("+"))         { type = Node::Add; }
+            else if (this->matches("-"))    { type = Node::Subtract; }
+            else                            { break; }
+
+            Node *right = this->parseMultiplicative();
+            if (right == nullptr) { return nullptr; }
+            left = new Node(type, left.release(), right);
+        }
+
+        return left.release();
+    }
+
+    Node *parseMultiplicative()
+    {
+        ScopedPointer<Node> left(this->parseUnary());
+
+        while (left != nullptr)
+        {
+            Node::Type type;
+
+            if (this->matches("*"))         { type = Node::Multiply; }
+            else if (this->matches("/"))    { type = Node::Divide; }
+            else if (this->matches("%"))    { type = Node::Modulo; }
+            else                            { break; }
+
+            Node *right = this->parseUnary();
+            if (right == nullptr) { return nullptr; }
+            left = new Node(type, left.release(), right);
+        }
+
+        return left.release();
+    }
+
+    Node *parseUnary()
+    {
+        if (this->matchesNotFollowedByEquals("!"))
+        {
+            Node *operand = this->parseUnary();
+            return (operand != nullptr) ? new Node(Node::Not, operand) : nullptr;
+        }
+
+        if (this->matches("-"))
+        {
+            Node *operand = this->parseUnary();
+            return (operand != nullptr) ? new Node(Node::Negate, operand) : nullptr;
+        }
+
+        return this->parsePrimary();
+    }
+
+    Node *parsePrimary()
+    {
+        if (this->matches("("))
+        {
+            ScopedPointer<Node> node(this->parseCondition());
+            return (node != nullptr && this->matches(")")) ? node.release() : nullptr;
+        }
+
+        this->skipWhitespace();
+
+        if (*this->p == 'n')
+        {
+            ++this->p;
+            return new Node(Node::Variable);
+        }
+
+        if (this->p.isDigit())
+        {
+            auto node = new Node(Node::Constant);
+
+            while (this->p.isDigit())
+            {
+                node->value = node->value * 10 + (this->p.getAndAdvance() - '0');
+            }
+
+            return node;
+        }
+
+        return nullptr;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE(Parser)
+};
+
+
+//===----------------------------------------------------------------------===//
+// PluralEquation
+//===----------------------------------------------------------------------===//
+
+PluralEquation::PluralEquation() {}
+
+PluralEquation::~PluralEquation() {}
+
+bool PluralEquation::compile(const String &equation)
+{
+    Parser parser(equation);
+    this->root = parser.parse();
+    return this->isCompiled();
+}
+
+bool PluralEquation::isCompiled() const noexcept
+{
+    return (this->root != nullptr);
+}
+
+int64 PluralEquation::evaluate(int64 targetNumber) const noexcept
+{
+    jassert(this->isCompiled());
+    return (this->root != nullptr) ? this->root->evaluate(targetNumber) : 0;
+}
@@ -0,0 +1,52 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// A plural forms equation, like "({x}%10==1 && {x}%100!=11 ? 1 : 2)",
+// parsed once into an expression tree and evaluated natively for each lookup,
+// instead of running the script engine for every plural translation.
+//
+// Supports the C-like syntax of gettext plural forms: integer literals,
+// the {x} placeholder (or n), parentheses, unary ! and -,
+// arithmetic, comparison and logical operators and ternary conditions.
+
+class PluralEquation
+{
+public:
+
+    PluralEquation();
+    ~PluralEquation();
+
+    // Returns false, if the equation has a syntax this parser does not support
+    bool compile(const String &equation);
+
+    bool isCompiled() const noexcept;
+
+    // Returns a plural form number for a given (non-negative) number
+    int64 evaluate(int64 targetNumber) const noexcept;
+
+private:
+
+    struct Node;
+    class Parser;
+
+    ScopedPointer<Node> root;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluralEquation)
+
+};
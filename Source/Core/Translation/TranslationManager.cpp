@@ -88,6 +88,8 @@ void TranslationManager::initialise(const String &commandLine)
 void TranslationManager::shutdown()
 {
     this->reset();
+
+    const ScopedLock lock(this->engineLock);
     this->engine = nullptr;
 }
 
@@ -96,42 +98,74 @@ void TranslationManager::shutdown()
 // Translations
 //===----------------------------------------------------------------------===//
 
-StringPairArray TranslationManager::getMappings() const
+TranslationManager::Translation::Ptr TranslationManager::getCurrentTranslation() const
 {
-    return this->singulars;
+    const SpinLock::ScopedLockType lock(this->currentTranslationLock);
+    return this->currentTranslation;
+}
+
+String TranslationManager::findSingularFor(const String &literal, const String &resultIfNotFound) const
+{
+    const Translation::Ptr translation(this->getCurrentTranslation());
+
+    if (translation != nullptr && translation->singulars.contains(literal))
+    {
+        return translation->singulars[literal];
+    }
+
+    return resultIfNotFound;
 }
 
 String TranslationManager::findPluralFor(const String &baseLiteral, int64 targetNumber)
 {
-    //const double startTime = Time::getMillisecondCounterHiRes();
+    const Translation::Ptr translation(this->getCurrentTranslation());
+    const String fallback(baseLiteral.replace(Serialization::Locales::metaSymbol, String(targetNumber)));
+
+    if (translation == nullptr)
+    {
+        return fallback;
+    }
+
+    const Translation::PluralForms::Ptr targetPlurals(translation->plurals[baseLiteral]);
+
+    if (targetPlurals == nullptr)
+    {
+        return fallback;
+    }
+
     const int64 absTargetNumber = (targetNumber > 0 ? targetNumber : -targetNumber);
-    
-    const String expessionToEvaluate =
-        Serialization::Locales::wrapperClassName +
-        "." +
-        Serialization::Locales::wrapperMethodName +
-        "(" +
-        this->pluralEquation.replace(Serialization::Locales::metaSymbol, String(absTargetNumber)) +
-        ")";
-    
-    //Logger::writeToLog("expessionToEvaluate: " + expessionToEvaluate);
+    String pluralForm;
 
-    Result result = this->engine->execute(expessionToEvaluate);
-    //const double elapsedMs = Time::getMillisecondCounterHiRes() - startTime;
-    
-    if (! result.failed())
+    if (translation->pluralEquation.isCompiled())
     {
-        StringPairArray targetPlurals = this->plurals[baseLiteral];
-        const String pluralForm = this->equationResult;
-        //Logger::writeToLog("(Execution time: " + String (elapsedMs, 2) + " milliseconds): " + pluralForm);
-        
-        for (int i = 0; i < targetPlurals.size(); ++i)
+        pluralForm = String(translation->pluralEquation.evaluate(absTargetNumber));
+    }
+    else
+    {
+        const String expessionToEvaluate =
+            Serialization::Locales::wrapperClassName +
+            "." +
+            Serialization::Locales::wrapperMethodName +
+            "(" +
+            translation->pluralEquationSource.replace(Serialization::Locales::metaSymbol, String(absTargetNumber)) +
+            ")";
+
+        const ScopedLock lock(this->engineLock);
+
+        if (this->engine == nullptr || this->engine->execute(expessionToEvaluate).failed())
         {
-            return targetPlurals[pluralForm].replace(Serialization::Locales::metaSymbol, String(targetNumber));
+            return fallback;
         }
+
+        pluralForm = this->equationResult;
+    }
+
+    if (targetPlurals->forms.contains(pluralForm))
+    {
+        return targetPlurals->forms[pluralForm].replace(Serialization::Locales::metaSymbol, String(targetNumber));
     }
 
-    return baseLiteral.replace(Serialization::Locales::metaSymbol, String(targetNumber));
+    return fallback;
 }
 
 
@@ -170,12 +204,14 @@ void TranslationManager::loadLocaleWithName(const String &localeName)
 
 void TranslationManager::loadLocaleWithId(const String &localeId)
 {
-    if (! this->availableTranslations.contains(localeId))
+    const String key(localeId.toLowerCase());
+
+    if (! this->availableTranslations.contains(key))
     {
         return;
     }
     
-    this->setSelectedLocaleId(localeId);
+    this->setSelectedLocaleId(key);
     this->reloadLocales();
 }
 
@@ -195,23 +231,18 @@ String TranslationManager::getCurrentLocaleId() const
 // Static
 //===----------------------------------------------------------------------===//
 
-SpinLock currentMappingsLock;
-
 String TranslationManager::translate(const String &text)
 {
-    const SpinLock::ScopedLockType sl(currentMappingsLock);
-    return TranslationManager::getInstance().getMappings().getValue(text, text);
+    return TranslationManager::getInstance().findSingularFor(text, text);
 }
 
 String TranslationManager::translate(const String &text, const String &resultIfNotFound)
 {
-    const SpinLock::ScopedLockType sl(currentMappingsLock);
-    return TranslationManager::getInstance().getMappings().getValue(text, resultIfNotFound);
+    return TranslationManager::getInstance().findSingularFor(text, resultIfNotFound);
 }
 
 String TranslationManager::translate(const String &baseLiteral, int64 targetNumber)
 {
-    const SpinLock::ScopedLockType sl(currentMappingsLock);
     return TranslationManager::getInstance().findPluralFor(baseLiteral, targetNumber);
 }
 
@@ -251,6 +282,7 @@ void TranslationManager::deserialize(const XmlElement &xml)
     
     // Now detect the right one and load
     const String selectedLocaleId = this->getSelectedLocaleId();
+    Translation::Ptr translation(new Translation());
     
     forEachXmlChildElementWithTagName(*root, locale, Serialization::Locales::locale)
     {
@@ -261,42 +293,50 @@ void TranslationManager::deserialize(const XmlElement &xml)
         {
             forEachXmlChildElementWithTagName(*locale, pluralForms, Serialization::Locales::pluralForms)
             {
-                this->pluralEquation = pluralForms->getStringAttribute(Serialization::Locales::equation);
+                translation->pluralEquationSource = pluralForms->getStringAttribute(Serialization::Locales::equation);
             }
 
             forEachXmlChildElementWithTagName(*locale, pluralLiteral, Serialization::Locales::pluralLiteral)
             {
                 const String baseLiteral = pluralLiteral->getStringAttribute(Serialization::Locales::name);
 
-                StringPairArray formsAndTranslations;
+                Translation::PluralForms::Ptr formsAndTranslations(new Translation::PluralForms());
                 
                 forEachXmlChildElementWithTagName(*pluralLiteral, pluralTranslation, Serialization::Locales::translation)
                 {
                     const String translatedLiteral = pluralTranslation->getStringAttribute(Serialization::Locales::name);
                     const String pluralForm = pluralTranslation->getStringAttribute(Serialization::Locales::pluralForm);
-                    formsAndTranslations.set(pluralForm, translatedLiteral);
+                    formsAndTranslations->forms.set(pluralForm, translatedLiteral);
                 }
                 
-                this->plurals.set(baseLiteral, formsAndTranslations);
+                translation->plurals.set(baseLiteral, formsAndTranslations);
             }
 
             forEachXmlChildElementWithTagName(*locale, literal, Serialization::Locales::literal)
             {
                 const String literalName = literal->getStringAttribute(Serialization::Locales::name);
                 const String translatedLiteral = literal->getStringAttribute(Serialization::Locales::translation);
-                this->singulars.set(literalName, translatedLiteral);
+                translation->singulars.set(literalName, translatedLiteral);
             }
         }
     }
+
+    if (translation->pluralEquationSource.isNotEmpty() &&
+        ! translation->pluralEquation.compile(translation->pluralEquationSource))
+    {
+        Logger::writeToLog("TranslationManager :: cannot compile plural equation, falling back to the script engine");
+    }
+
+    const SpinLock::ScopedLockType lock(this->currentTranslationLock);
+    this->currentTranslation = translation;
 }
 
 void TranslationManager::reset()
 {
     this->availableTranslations.clear();
-    this->pluralEquation.clear();
-    this->equationResult.clear();
-    this->singulars.clear();
-    this->plurals.clear();
+
+    const SpinLock::ScopedLockType lock(this->currentTranslationLock);
+    this->currentTranslation = nullptr;
 }
 
 
@@ -19,6 +19,7 @@
 
 #include "Serializable.h"
 #include "RequestTranslationsThread.h"
+#include "PluralEquation.h"
 
 class TranslationManager :
     public ChangeBroadcaster,
@@ -47,7 +48,7 @@ public:
     void initialise(const String &commandLine);
     void shutdown();
 
-    StringPairArray getMappings() const;
+    String findSingularFor(const String &literal, const String &resultIfNotFound) const;
     String findPluralFor(const String &baseLiteral, int64 targetNumber);
 
     Array<Locale> getAvailableLocales() const;
@@ -91,13 +92,64 @@ private:
     
     void timerCallback() override;
     
+    // An immutable snapshot of the selected locale's translations:
+    // lookups only take a lock to grab a reference to the current one,
+    // and deserialization builds a new one and swaps it in
+    struct Translation final : public ReferenceCountedObject
+    {
+        typedef ReferenceCountedObjectPtr<Translation> Ptr;
+
+        struct PluralForms final : public ReferenceCountedObject
+        {
+            typedef ReferenceCountedObjectPtr<PluralForms> Ptr;
+            HashMap<String, String> forms; // plural form : translated literal
+        };
+
+        // The lookups have always been case-insensitive; the key wraps
+        // the literal as is, so that TRANS() never has to allocate
+        struct Literal final
+        {
+            Literal() {}
+            Literal(const String &text) : text(text) {}
+
+            bool operator== (const Literal &other) const noexcept
+            { return this->text.equalsIgnoreCase(other.text); }
+
+            String text;
+        };
+
+        struct LiteralHash final
+        {
+            static int generateHash(const Literal &key, int upperLimit) noexcept
+            {
+                uint32 hash = 0;
+
+                for (String::CharPointerType t(key.text.getCharPointer()); ! t.isEmpty();)
+                {
+                    hash = hash * 31 + uint32(CharacterFunctions::toLowerCase(t.getAndAdvance()));
+                }
+
+                return int(hash % uint32(upperLimit));
+            }
+        };
+
+        HashMap<Literal, String, LiteralHash> singulars;
+        HashMap<Literal, PluralForms::Ptr, LiteralHash> plurals;
+
+        String pluralEquationSource;
+        PluralEquation pluralEquation;
+    };
+
+    Translation::Ptr getCurrentTranslation() const;
+
+    Translation::Ptr currentTranslation;
+    mutable SpinLock currentTranslationLock;
+
+    // Only used for the plural equations that PluralEquation fails to compile
     ScopedPointer<JavascriptEngine> engine;
-    String pluralEquation;
+    CriticalSection engineLock;
     String equationResult;
 
-    StringPairArray singulars;
-    HashMap<String, StringPairArray> plurals;
-
     HashMap<String, Locale> availableTranslations;
     String getLocalizationFileContents() const;
     void loadFromXml(const String &xmlData);
@@ -158,9 +158,6 @@ void AutomationLayerTreeItem::resetStateTo(const VCS::TrackedItem &newState)
             this->resetEventsDelta(newDeltaData);
         }
     }
-    
-    this->getLayer()->notifyLayerChanged();
-    this->getLayer()->notifyBeatRangeChanged();
 }
 
 
@@ -290,6 +287,7 @@ void AutomationLayerTreeItem::resetColourDelta(const XmlElement *state)
     if (colour != this->getLayer()->getColour())
     {
         this->getLayer()->setColour(colour);
+        this->getLayer()->notifyLayerChanged();
         this->repaintItem();
     }
 }
@@ -305,18 +303,87 @@ void AutomationLayerTreeItem::resetControllerDelta(const XmlElement *state)
 {
     jassert(state->getTagName() == AutoLayerDeltas::layerController);
     const int ccNumber(state->getIntAttribute(Serialization::VCS::delta));
-    this->getLayer()->setControllerNumber(ccNumber);
+
+    if (ccNumber != this->getLayer()->getControllerNumber())
+    {
+        this->getLayer()->setControllerNumber(ccNumber);
+        this->getLayer()->notifyLayerChanged();
+    }
+}
+
+static bool haveSameParameters(const AutomationEvent &event1, const AutomationEvent &event2) noexcept
+{
+    return event1.getBeat() == event2.getBeat() &&
+           event1.getControllerValue() == event2.getControllerValue() &&
+           event1.getCurvature() == event2.getCurvature();
 }
 
 void AutomationLayerTreeItem::resetEventsDelta(const XmlElement *state)
 {
     jassert(state->getTagName() == AutoLayerDeltas::eventsAdded);
 
-    this->reset();
-    this->getLayer()->reset();
+    // only applies the difference with the target state, see PianoLayerTreeItem::resetEventsDelta
+    AutomationLayer *autoLayer = static_cast<AutomationLayer *>(this->getLayer());
+
+    Array<AutomationEvent> stateEvents;
+    HashMap<MidiEvent::Id, int> stateEventsIndices;
 
     forEachXmlChildElementWithTagName(*state, e, Serialization::Core::event)
     {
-        this->getLayer()->silentImport(AutomationEvent(this->getLayer()).withParameters(*e));
+        const AutomationEvent stateEvent(AutomationEvent(autoLayer).withParameters(*e));
+        stateEventsIndices.set(stateEvent.getID(), stateEvents.size());
+        stateEvents.add(stateEvent);
+    }
+
+    Array<AutomationEvent> eventsToRemove;
+    Array<AutomationEvent> eventsBefore;
+    Array<AutomationEvent> eventsAfter;
+    Array<AutomationEvent> eventsToInsert;
+    Array<bool> stateEventsFound;
+    stateEventsFound.insertMultiple(0, false, stateEvents.size());
+
+    for (int i = 0; i < autoLayer->size(); ++i)
+    {
+        const AutomationEvent *event = static_cast<const AutomationEvent *>(autoLayer->getUnchecked(i));
+
+        if (stateEventsIndices.contains(event->getID()))
+        {
+            const int stateIndex = stateEventsIndices[event->getID()];
+            const AutomationEvent &stateEvent = stateEvents.getReference(stateIndex);
+            stateEventsFound.set(stateIndex, true);
+
+            if (! haveSameParameters(*event, stateEvent))
+            {
+                eventsBefore.add(*event);
+                eventsAfter.add(stateEvent);
+            }
+        }
+        else
+        {
+            eventsToRemove.add(*event);
+        }
+    }
+
+    for (int i = 0; i < stateEvents.size(); ++i)
+    {
+        if (! stateEventsFound.getUnchecked(i))
+        {
+            eventsToInsert.add(stateEvents.getReference(i));
+        }
+    }
+
+    if (eventsToRemove.size() > 0)
+    {
+        autoLayer->removeGroup(eventsToRemove, false);
+    }
+
+    if (eventsBefore.size() > 0)
+    {
+        autoLayer->changeGroup(eventsBefore, eventsAfter, false);
+    }
+
+    if (eventsToInsert.size() > 0)
+    {
+        autoLayer->insertGroup(eventsToInsert, false);
     }
 }
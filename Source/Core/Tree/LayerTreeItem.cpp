@@ -289,6 +289,14 @@ void LayerTreeItem::onEventRemovedPostAction(const MidiLayer *layer)
     }
 }
 
+void LayerTreeItem::onEventsChanged(const MidiEventsChangeSet &changes)
+{
+    if (this->lastFoundParent != nullptr)
+    {
+        this->lastFoundParent->broadcastEventsChanged(changes);
+    }
+}
+
 void LayerTreeItem::onLayerChanged(const MidiLayer *layer)
 {
     if (this->lastFoundParent != nullptr)
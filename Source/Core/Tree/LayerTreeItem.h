@@ -77,6 +77,8 @@ public:
 
     void onEventRemovedPostAction(const MidiLayer *layer) override;
 
+    void onEventsChanged(const MidiEventsChangeSet &changes) override;
+
     void onLayerChanged(const MidiLayer *layer) override;
 
     void onBeatRangeChanged() override;
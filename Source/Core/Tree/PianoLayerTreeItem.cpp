@@ -187,9 +187,6 @@ void PianoLayerTreeItem::resetStateTo(const VCS::TrackedItem &newState)
             this->resetEventsDelta(newDeltaData);
         }
     }
-    
-    this->getLayer()->notifyLayerChanged();
-    this->getLayer()->notifyBeatRangeChanged();
 }
 
 
@@ -311,6 +308,7 @@ void PianoLayerTreeItem::resetColourDelta(const XmlElement *state)
     if (colour != this->getLayer()->getColour())
     {
         this->getLayer()->setColour(colour);
+        this->getLayer()->notifyLayerChanged();
         this->repaintItem();
     }
 }
@@ -322,16 +320,82 @@ void PianoLayerTreeItem::resetInstrumentDelta(const XmlElement *state)
     this->getLayer()->setInstrumentId(instrumentId);
 }
 
+static bool haveSameParameters(const Note &note1, const Note &note2) noexcept
+{
+    return note1.getKey() == note2.getKey() &&
+           note1.getBeat() == note2.getBeat() &&
+           note1.getLength() == note2.getLength() &&
+           note1.getVelocity() == note2.getVelocity();
+}
+
 void PianoLayerTreeItem::resetEventsDelta(const XmlElement *state)
 {
     jassert(state->getTagName() == PianoLayerDeltas::notesAdded);
 
-    // не очень круто вызывать здесь reset, когда нужно просто очистить список событий
-    this->reset();
-    this->getLayer()->reset();
+    // instead of rebuilding the whole layer, only applies the difference
+    // with the target state as batched non-undoable edits,
+    // so that listeners receive the changed notes only
+    PianoLayer *pianoLayer = static_cast<PianoLayer *>(this->getLayer());
+
+    Array<Note> stateNotes;
+    HashMap<MidiEvent::Id, int> stateNotesIndices;
 
     forEachXmlChildElementWithTagName(*state, e, Serialization::Core::note)
     {
-        this->getLayer()->silentImport(Note(this->getLayer()).withParameters(*e));
+        const Note stateNote(Note(pianoLayer).withParameters(*e));
+        stateNotesIndices.set(stateNote.getID(), stateNotes.size());
+        stateNotes.add(stateNote);
+    }
+
+    Array<Note> notesToRemove;
+    Array<Note> notesBefore;
+    Array<Note> notesAfter;
+    Array<Note> notesToInsert;
+    Array<bool> stateNotesFound;
+    stateNotesFound.insertMultiple(0, false, stateNotes.size());
+
+    for (int i = 0; i < pianoLayer->size(); ++i)
+    {
+        const Note *note = static_cast<const Note *>(pianoLayer->getUnchecked(i));
+
+        if (stateNotesIndices.contains(note->getID()))
+        {
+            const int stateIndex = stateNotesIndices[note->getID()];
+            const Note &stateNote = stateNotes.getReference(stateIndex);
+            stateNotesFound.set(stateIndex, true);
+
+            if (! haveSameParameters(*note, stateNote))
+            {
+                notesBefore.add(*note);
+                notesAfter.add(stateNote);
+            }
+        }
+        else
+        {
+            notesToRemove.add(*note);
+        }
+    }
+
+    for (int i = 0; i < stateNotes.size(); ++i)
+    {
+        if (! stateNotesFound.getUnchecked(i))
+        {
+            notesToInsert.add(stateNotes.getReference(i));
+        }
+    }
+
+    if (notesToRemove.size() > 0)
+    {
+        pianoLayer->removeGroup(notesToRemove, false);
+    }
+
+    if (notesBefore.size() > 0)
+    {
+        pianoLayer->changeGroup(notesBefore, notesAfter, false);
+    }
+
+    if (notesToInsert.size() > 0)
+    {
+        pianoLayer->insertGroup(notesToInsert, false);
     }
 }
@@ -21,6 +21,8 @@ class MidiEvent;
 class MidiLayer;
 class ProjectInfo;
 
+#include "MidiEventsChangeSet.h"
+
 class ProjectListener
 {
 public:
@@ -37,6 +39,27 @@ public:
 
     virtual void onEventRemovedPostAction(const MidiLayer *layer) {} // вызывается после удаления события, надо будет переименовать эти методы по-человечески
 
+    // Called once per group operation, before the removed events are deleted;
+    // listeners that can update in bulk should override it,
+    // others get the usual callback for each event
+    virtual void onEventsChanged(const MidiEventsChangeSet &changes)
+    {
+        for (int i = 0; i < changes.getNumRemovedEvents(); ++i)
+        {
+            this->onEventRemoved(changes.getRemovedEvent(i));
+        }
+
+        for (int i = 0; i < changes.getNumChangedEvents(); ++i)
+        {
+            this->onEventChanged(changes.getChangedEventBefore(i), changes.getChangedEventAfter(i));
+        }
+
+        for (int i = 0; i < changes.getNumAddedEvents(); ++i)
+        {
+            this->onEventAdded(changes.getAddedEvent(i));
+        }
+    }
+
     virtual void onLayerChanged(const MidiLayer *layer) = 0;
 
     virtual void onLayerAdded(const MidiLayer *layer) = 0;
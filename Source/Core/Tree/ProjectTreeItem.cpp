@@ -41,6 +41,7 @@
 #include "ProjectInfo.h"
 #include "ProjectTimeline.h"
 #include "DataEncoder.h"
+#include "MidiFileWriter.h"
 
 #include "TrackedItem.h"
 #include "VersionControlTreeItem.h"
@@ -101,12 +102,13 @@ void ProjectTreeItem::initialize()
 
 ProjectTreeItem::~ProjectTreeItem()
 {
-    // the main policy: all data is to be autosaved
-    this->getDocument()->save();
-    
+    // stopping merges the recorded take, if any, so it goes before saving
     this->transport->stopPlayback();
     this->transport->stopRender();
 
+    // the main policy: all data is to be autosaved
+    this->getDocument()->save();
+
     // remember as the recent file
     if (this->recentFilesList != nullptr)
     {
@@ -753,6 +755,12 @@ void ProjectTreeItem::broadcastEventRemovedPostAction(const MidiLayer *layer)
     this->sendChangeMessage();
 }
 
+void ProjectTreeItem::broadcastEventsChanged(const MidiEventsChangeSet &changes)
+{
+    this->changeListeners.call(&ProjectListener::onEventsChanged, changes);
+    this->sendChangeMessage();
+}
+
 void ProjectTreeItem::broadcastLayerChanged(const MidiLayer *layer)
 {
     this->changeListeners.call(&ProjectListener::onLayerChanged, layer);
@@ -864,18 +872,10 @@ bool ProjectTreeItem::onDocumentExport(File &file)
 
 void ProjectTreeItem::exportMidi(File &file) const
 {
-    MidiFile tempFile;
-    tempFile.setTicksPerQuarterNote(Transport::millisecondsPerBeat);
-    
-    const Array<MidiLayer *> &layers = this->getLayersList();
-    
-    for (auto layer : layers)
+    if (! MidiFileWriter::writeLayers(this->getLayersList(), file))
     {
-        tempFile.addTrack(layer->exportMidi());
+        Logger::writeToLog("Failed to export midi to " + file.getFullPathName());
     }
-    
-    ScopedPointer<OutputStream> out(new FileOutputStream(file));
-    tempFile.writeTo(*out);
 }
 
 
@@ -27,6 +27,7 @@ class ProjectListener;
 class MidiEditor;
 class MidiRoll;
 class MidiEvent;
+class MidiEventsChangeSet;
 class TrackMapRenderer;
 class ProjectPage;
 class Origami;
@@ -218,6 +219,8 @@ public:
 
     void broadcastEventRemovedPostAction(const MidiLayer *layer);
 
+    void broadcastEventsChanged(const MidiEventsChangeSet &changes);
+
     void broadcastLayerChanged(const MidiLayer *layer);
 
     void broadcastLayerAdded(const MidiLayer *layer);
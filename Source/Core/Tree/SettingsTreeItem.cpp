@@ -26,6 +26,8 @@
 #include "ThemeSettings.h"
 #include "OpenGLSettings.h"
 #include "TranslationSettings.h"
+#include "MemoryReportComponent.h"
+#include "MemoryAccounting.h"
 #include "ComponentsList.h"
 #include "LabeledSettingsWrapper.h"
 #include "SettingsPage.h"
@@ -72,6 +74,8 @@ void SettingsTreeItem::showPage()
 void SettingsTreeItem::recreatePage()
 {
     this->settingsPage = nullptr;
+    this->memoryReportWrapper = nullptr;
+    this->memoryReport = nullptr;
     this->authSettingsWrapper = nullptr;
     this->authSettings = nullptr;
     this->translationSettingsWrapper = nullptr;
@@ -117,6 +121,12 @@ void SettingsTreeItem::recreatePage()
     this->openGLSettingsWrapper = new LabeledSettingsWrapper(this->openGLSettings, TRANS("settings::renderer"));
     this->settingsList->addAndMakeVisible(this->openGLSettingsWrapper);
 #endif
+    
+#if HELIO_MEMORY_ACCOUNTING
+    this->memoryReport = new MemoryReportComponent();
+    this->memoryReportWrapper = new LabeledSettingsWrapper(this->memoryReport, "Memory");
+    this->settingsList->addAndMakeVisible(this->memoryReportWrapper);
+#endif
 
     this->settingsPage = new SettingsPage(this->settingsList);
 }
@@ -74,6 +74,8 @@ private:
     ScopedPointer<Component> translationSettingsWrapper;
     ScopedPointer<Component> authSettings;
     ScopedPointer<Component> authSettingsWrapper;
+    ScopedPointer<Component> memoryReport;
+    ScopedPointer<Component> memoryReportWrapper;
     ScopedPointer<Component> settingsPage;
 
 };
@@ -21,6 +21,24 @@
 #include "ProjectTreeItem.h"
 #include "SerializationKeys.h"
 
+// The real memory taken by a note copy, including its heap-allocated id
+static int getNoteSizeInBytes(const Note &note)
+{
+    return int(sizeof(Note)) + int(note.getID().getNumBytesAsUTF8()) + 16;
+}
+
+static int getNotesSizeInBytes(const Array<Note> &notes)
+{
+    int size = 0;
+
+    for (const auto &note : notes)
+    {
+        size += getNoteSizeInBytes(note);
+    }
+
+    return size;
+}
+
 
 //===----------------------------------------------------------------------===//
 // Insert
@@ -58,7 +76,7 @@ bool NoteInsertAction::undo()
 
 int NoteInsertAction::getSizeInUnits()
 {
-    return sizeof(Note);
+    return int(sizeof(NoteInsertAction)) + getNoteSizeInBytes(this->note);
 }
 
 XmlElement *NoteInsertAction::serialize() const
@@ -118,7 +136,7 @@ bool NoteRemoveAction::undo()
 
 int NoteRemoveAction::getSizeInUnits()
 {
-    return sizeof(Note);
+    return int(sizeof(NoteRemoveAction)) + getNoteSizeInBytes(this->note);
 }
 
 XmlElement *NoteRemoveAction::serialize() const
@@ -180,7 +198,9 @@ bool NoteChangeAction::undo()
 
 int NoteChangeAction::getSizeInUnits()
 {
-    return sizeof(Note) * 2;
+    return int(sizeof(NoteChangeAction)) +
+        getNoteSizeInBytes(this->noteBefore) +
+        getNoteSizeInBytes(this->noteAfter);
 }
 
 UndoAction *NoteChangeAction::createCoalescedAction(UndoAction *nextAction)
@@ -275,7 +295,7 @@ bool NotesGroupInsertAction::undo()
 
 int NotesGroupInsertAction::getSizeInUnits()
 {
-    return (sizeof(Note) * this->notes.size());
+    return int(sizeof(NotesGroupInsertAction)) + getNotesSizeInBytes(this->notes);
 }
 
 XmlElement *NotesGroupInsertAction::serialize() const
@@ -347,7 +367,7 @@ bool NotesGroupRemoveAction::undo()
 
 int NotesGroupRemoveAction::getSizeInUnits()
 {
-    return (sizeof(Note) * this->notes.size());
+    return int(sizeof(NotesGroupRemoveAction)) + getNotesSizeInBytes(this->notes);
 }
 
 XmlElement *NotesGroupRemoveAction::serialize() const
@@ -395,15 +415,16 @@ NotesGroupChangeAction::NotesGroupChangeAction(ProjectTreeItem &parentProject,
     UndoAction(parentProject),
     layerId(std::move(targetLayerId))
 {
-    this->notesBefore.swapWith(state1);
-    this->notesAfter.swapWith(state2);
+    this->diff.pack(state1, state2);
 }
 
 bool NotesGroupChangeAction::perform()
 {
     if (PianoLayer *layer = this->project.getLayerWithId<PianoLayer>(this->layerId))
     {
-        return layer->changeGroup(this->notesBefore, this->notesAfter, false);
+        Array<Note> notesBefore, notesAfter;
+        this->diff.unpack(layer, notesBefore, notesAfter);
+        return layer->changeGroup(notesBefore, notesAfter, false);
     }
     
     return false;
@@ -413,7 +434,9 @@ bool NotesGroupChangeAction::undo()
 {
     if (PianoLayer *layer = this->project.getLayerWithId<PianoLayer>(this->layerId))
     {
-        return layer->changeGroup(this->notesAfter, this->notesBefore, false);
+        Array<Note> notesBefore, notesAfter;
+        this->diff.unpack(layer, notesBefore, notesAfter);
+        return layer->changeGroup(notesAfter, notesBefore, false);
     }
     
     return false;
@@ -421,7 +444,7 @@ bool NotesGroupChangeAction::undo()
 
 int NotesGroupChangeAction::getSizeInUnits()
 {
-    return (sizeof(Note) * this->notesBefore.size()) + (sizeof(Note) * this->notesAfter.size());
+    return int(sizeof(NotesGroupChangeAction) - sizeof(NotesGroupDiff)) + this->diff.getSizeInBytes();
 }
 
 UndoAction *NotesGroupChangeAction::createCoalescedAction(UndoAction *nextAction)
@@ -435,21 +458,26 @@ UndoAction *NotesGroupChangeAction::createCoalescedAction(UndoAction *nextAction
                 return nullptr;
             }
             
-            if (this->notesBefore.size() != nextChanger->notesAfter.size())
+            if (this->diff.getNumNotes() != nextChanger->diff.getNumNotes())
             {
                 return nullptr;
             }
             
-            for (int i = 0; i < this->notesBefore.size(); ++i)
+            for (int i = 0; i < this->diff.getNumNotes(); ++i)
             {
-                if (this->notesBefore.getUnchecked(i).getID() != nextChanger->notesAfter.getUnchecked(i).getID())
+                if (this->diff.getNoteId(i) != nextChanger->diff.getNoteId(i))
                 {
                     return nullptr;
                 }
             }
             
+            Array<Note> notesBefore, notesAfter;
+            Array<Note> nextNotesBefore, nextNotesAfter;
+            this->diff.unpack(layer, notesBefore, notesAfter);
+            nextChanger->diff.unpack(layer, nextNotesBefore, nextNotesAfter);
+            
             auto newChanger =
-            new NotesGroupChangeAction(this->project, this->layerId, this->notesBefore, nextChanger->notesAfter);
+            new NotesGroupChangeAction(this->project, this->layerId, notesBefore, nextNotesAfter);
             
             return newChanger;
         }
@@ -472,14 +500,17 @@ XmlElement *NotesGroupChangeAction::serialize() const
     auto groupBeforeChild = new XmlElement(Serialization::Undo::groupBefore);
     auto groupAfterChild = new XmlElement(Serialization::Undo::groupAfter);
     
-    for (int i = 0; i < this->notesBefore.size(); ++i)
+    Array<Note> notesBefore, notesAfter;
+    this->diff.unpack(nullptr, notesBefore, notesAfter);
+    
+    for (int i = 0; i < notesBefore.size(); ++i)
     {
-        groupBeforeChild->prependChildElement(this->notesBefore.getUnchecked(i).serialize());
+        groupBeforeChild->prependChildElement(notesBefore.getUnchecked(i).serialize());
     }
     
-    for (int i = 0; i < this->notesAfter.size(); ++i)
+    for (int i = 0; i < notesAfter.size(); ++i)
     {
-        groupAfterChild->prependChildElement(this->notesAfter.getUnchecked(i).serialize());
+        groupAfterChild->prependChildElement(notesAfter.getUnchecked(i).serialize());
     }
     
     xml->prependChildElement(groupBeforeChild);
@@ -497,24 +528,27 @@ void NotesGroupChangeAction::deserialize(const XmlElement &xml)
     XmlElement *groupBeforeChild = xml.getChildByName(Serialization::Undo::groupBefore);
     XmlElement *groupAfterChild = xml.getChildByName(Serialization::Undo::groupAfter);
 
+    Array<Note> notesBefore, notesAfter;
+
     forEachXmlChildElement(*groupBeforeChild, noteXml)
     {
         Note n;
         n.deserialize(*noteXml);
-        this->notesBefore.add(n);
+        notesBefore.add(n);
     }
 
     forEachXmlChildElement(*groupAfterChild, noteXml)
     {
         Note n;
         n.deserialize(*noteXml);
-        this->notesAfter.add(n);
+        notesAfter.add(n);
     }
+
+    this->diff.pack(notesBefore, notesAfter);
 }
 
 void NotesGroupChangeAction::reset()
 {
-    this->notesBefore.clear();
-    this->notesAfter.clear();
+    this->diff.clear();
     this->layerId.clear();
 }
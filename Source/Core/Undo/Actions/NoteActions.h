@@ -21,6 +21,7 @@ class PianoLayer;
 class ProjectTreeItem;
 
 #include "Note.h"
+#include "NotesGroupDiff.h"
 #include "UndoAction.h"
 
 
@@ -220,8 +221,8 @@ private:
 
     String layerId;
 
-    Array<Note> notesBefore;
-    Array<Note> notesAfter;
+    // packed, since group changes take most of the undo history
+    NotesGroupDiff diff;
 
     JUCE_DECLARE_NON_COPYABLE(NotesGroupChangeAction)
 
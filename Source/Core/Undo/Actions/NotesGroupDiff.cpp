@@ -0,0 +1,117 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "NotesGroupDiff.h"
+
+NotesGroupDiff::NotesGroupDiff() {}
+
+void NotesGroupDiff::pack(const Array<Note> &notesBefore, const Array<Note> &notesAfter)
+{
+    jassert(notesBefore.size() == notesAfter.size());
+
+    this->clear();
+    this->ids.ensureStorageAllocated(notesBefore.size());
+
+    MemoryOutputStream stream(this->data, false);
+
+    for (int i = 0; i < notesBefore.size(); ++i)
+    {
+        const Note &before = notesBefore.getReference(i);
+        const Note &after = notesAfter.getReference(i);
+        jassert(before.getID() == after.getID());
+
+        const int changedFields =
+            ((before.getKey() != after.getKey()) ? keyChanged : 0) |
+            ((before.getBeat() != after.getBeat()) ? beatChanged : 0) |
+            ((before.getLength() != after.getLength()) ? lengthChanged : 0) |
+            ((before.getVelocity() != after.getVelocity()) ? velocityChanged : 0);
+
+        this->ids.add(before.getID());
+
+        stream.writeByte(char(changedFields));
+        stream.writeCompressedInt(before.getKey());
+        stream.writeFloat(before.getBeat());
+        stream.writeFloat(before.getLength());
+        stream.writeFloat(before.getVelocity());
+
+        if (changedFields & keyChanged)      { stream.writeCompressedInt(after.getKey() - before.getKey()); }
+        if (changedFields & beatChanged)     { stream.writeFloat(after.getBeat()); }
+        if (changedFields & lengthChanged)   { stream.writeFloat(after.getLength()); }
+        if (changedFields & velocityChanged) { stream.writeFloat(after.getVelocity()); }
+    }
+
+    stream.flush();
+    this->data.setSize(stream.getDataSize());
+}
+
+void NotesGroupDiff::unpack(MidiLayer *layer, Array<Note> &outNotesBefore, Array<Note> &outNotesAfter) const
+{
+    outNotesBefore.clearQuick();
+    outNotesAfter.clearQuick();
+    outNotesBefore.ensureStorageAllocated(this->ids.size());
+    outNotesAfter.ensureStorageAllocated(this->ids.size());
+
+    MemoryInputStream stream(this->data, false);
+
+    for (int i = 0; i < this->ids.size(); ++i)
+    {
+        const int changedFields = stream.readByte();
+        const int key = stream.readCompressedInt();
+        const float beat = stream.readFloat();
+        const float length = stream.readFloat();
+        const float velocity = stream.readFloat();
+
+        const int keyAfter = (changedFields & keyChanged) ? (key + stream.readCompressedInt()) : key;
+        const float beatAfter = (changedFields & beatChanged) ? stream.readFloat() : beat;
+        const float lengthAfter = (changedFields & lengthChanged) ? stream.readFloat() : length;
+        const float velocityAfter = (changedFields & velocityChanged) ? stream.readFloat() : velocity;
+
+        const MidiEvent::Id &id = this->ids.getReference(i);
+        outNotesBefore.add(Note(layer, id, key, beat, length, velocity));
+        outNotesAfter.add(Note(layer, id, keyAfter, beatAfter, lengthAfter, velocityAfter));
+    }
+}
+
+int NotesGroupDiff::getNumNotes() const noexcept
+{
+    return this->ids.size();
+}
+
+const MidiEvent::Id &NotesGroupDiff::getNoteId(int index) const noexcept
+{
+    return this->ids.getReference(index);
+}
+
+int NotesGroupDiff::getSizeInBytes() const noexcept
+{
+    int idsSize = 0;
+
+    for (const auto &id : this->ids)
+    {
+        // string holder's header, its text and the pointer to it
+        idsSize += int(sizeof(MidiEvent::Id)) + int(id.getNumBytesAsUTF8()) + 16;
+    }
+
+    return int(sizeof(NotesGroupDiff)) + idsSize + int(this->data.getSize());
+}
+
+void NotesGroupDiff::clear()
+{
+    this->ids.clearQuick();
+    this->data.reset();
+}
@@ -0,0 +1,66 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class MidiLayer;
+
+#include "Note.h"
+
+// A packed before/after state of a group of changed notes, used by undo actions
+// instead of keeping two full arrays of notes.
+//
+// Note ids are kept once (and are shared with the layer's notes, as strings are ref-counted),
+// each note's state before the change is packed in a binary block,
+// followed by the changed fields only: the key delta as a compressed int,
+// and the beat, length and velocity as raw floats, so that unpacking is lossless.
+
+class NotesGroupDiff
+{
+public:
+
+    NotesGroupDiff();
+
+    void pack(const Array<Note> &notesBefore, const Array<Note> &notesAfter);
+
+    void unpack(MidiLayer *layer, Array<Note> &outNotesBefore, Array<Note> &outNotesAfter) const;
+
+    int getNumNotes() const noexcept;
+
+    const MidiEvent::Id &getNoteId(int index) const noexcept;
+
+    // Real memory usage, including the heap-allocated data
+    int getSizeInBytes() const noexcept;
+
+    void clear();
+
+private:
+
+    enum ChangedFields
+    {
+        keyChanged = 0x01,
+        beatChanged = 0x02,
+        lengthChanged = 0x04,
+        velocityChanged = 0x08
+    };
+
+    Array<MidiEvent::Id> ids;
+    MemoryBlock data;
+
+    JUCE_DECLARE_NON_COPYABLE(NotesGroupDiff)
+
+};
@@ -21,6 +21,8 @@
 #include "SerializationKeys.h"
 
 #include "ProjectTreeItem.h"
+#include "Config.h"
+#include "MemoryAccounting.h"
 
 #include "PianoLayerTreeItemActions.h"
 #include "AutoLayerTreeItemActions.h"
@@ -31,7 +33,176 @@
 #include "AutomationEventActions.h"
 #include "TimeSignatureEventActions.h"
 
-#define MAX_TRANSACTIONS_TO_STORE 10
+//===----------------------------------------------------------------------===//
+// Actions factory
+//===----------------------------------------------------------------------===//
+
+typedef UndoAction *(*UndoActionFactory)(ProjectTreeItem &);
+
+template<typename T>
+static UndoAction *createUndoAction(ProjectTreeItem &project)
+{
+    return new T(project);
+}
+
+struct IdentifierHash
+{
+    // identifiers are pooled, so that each name has a unique pointer
+    static int generateHash(const Identifier &key, int upperLimit) noexcept
+    {
+        const pointer_sized_uint address = pointer_sized_uint(key.getCharPointer().getAddress());
+        return int((address >> 3) % pointer_sized_uint(upperLimit));
+    }
+};
+
+struct UndoActionFactories : public HashMap<Identifier, UndoActionFactory, IdentifierHash>
+{
+    UndoActionFactories()
+    {
+        this->add<PianoLayerTreeItemInsertAction>(Serialization::Undo::pianoLayerTreeItemInsertAction);
+        this->add<PianoLayerTreeItemRemoveAction>(Serialization::Undo::pianoLayerTreeItemRemoveAction);
+        this->add<AutoLayerTreeItemInsertAction>(Serialization::Undo::autoLayerTreeItemInsertAction);
+        this->add<AutoLayerTreeItemRemoveAction>(Serialization::Undo::autoLayerTreeItemRemoveAction);
+        this->add<LayerTreeItemRenameAction>(Serialization::Undo::layerTreeItemRenameAction);
+        this->add<MidiLayerChangeColourAction>(Serialization::Undo::midiLayerChangeColourAction);
+        this->add<MidiLayerChangeInstrumentAction>(Serialization::Undo::midiLayerChangeInstrumentAction);
+        this->add<MidiLayerMuteAction>(Serialization::Undo::midiLayerMuteAction);
+        this->add<NoteInsertAction>(Serialization::Undo::noteInsertAction);
+        this->add<NoteRemoveAction>(Serialization::Undo::noteRemoveAction);
+        this->add<NoteChangeAction>(Serialization::Undo::noteChangeAction);
+        this->add<NotesGroupInsertAction>(Serialization::Undo::notesGroupInsertAction);
+        this->add<NotesGroupRemoveAction>(Serialization::Undo::notesGroupRemoveAction);
+        this->add<NotesGroupChangeAction>(Serialization::Undo::notesGroupChangeAction);
+        this->add<AnnotationEventInsertAction>(Serialization::Undo::annotationEventInsertAction);
+        this->add<AnnotationEventRemoveAction>(Serialization::Undo::annotationEventRemoveAction);
+        this->add<AnnotationEventChangeAction>(Serialization::Undo::annotationEventChangeAction);
+        this->add<AnnotationEventsGroupInsertAction>(Serialization::Undo::annotationEventsGroupInsertAction);
+        this->add<AnnotationEventsGroupRemoveAction>(Serialization::Undo::annotationEventsGroupRemoveAction);
+        this->add<AnnotationEventsGroupChangeAction>(Serialization::Undo::annotationEventsGroupChangeAction);
+        this->add<TimeSignatureEventInsertAction>(Serialization::Undo::timeSignatureEventInsertAction);
+        this->add<TimeSignatureEventRemoveAction>(Serialization::Undo::timeSignatureEventRemoveAction);
+        this->add<TimeSignatureEventChangeAction>(Serialization::Undo::timeSignatureEventChangeAction);
+        this->add<TimeSignatureEventsGroupInsertAction>(Serialization::Undo::timeSignatureEventsGroupInsertAction);
+        this->add<TimeSignatureEventsGroupRemoveAction>(Serialization::Undo::timeSignatureEventsGroupRemoveAction);
+        this->add<TimeSignatureEventsGroupChangeAction>(Serialization::Undo::timeSignatureEventsGroupChangeAction);
+        this->add<AutomationEventInsertAction>(Serialization::Undo::automationEventInsertAction);
+        this->add<AutomationEventRemoveAction>(Serialization::Undo::automationEventRemoveAction);
+        this->add<AutomationEventChangeAction>(Serialization::Undo::automationEventChangeAction);
+        this->add<AutomationEventsGroupInsertAction>(Serialization::Undo::automationEventsGroupInsertAction);
+        this->add<AutomationEventsGroupRemoveAction>(Serialization::Undo::automationEventsGroupRemoveAction);
+        this->add<AutomationEventsGroupChangeAction>(Serialization::Undo::automationEventsGroupChangeAction);
+    }
+    
+    template<typename T>
+    void add(const String &tagName)
+    {
+        this->set(Identifier(tagName), &createUndoAction<T>);
+    }
+};
+
+static UndoAction *createUndoActionByTagName(const Identifier &tagName, ProjectTreeItem &project)
+{
+    static const UndoActionFactories factories;
+    
+    if (const UndoActionFactory factory = factories[tagName])
+    {
+        return factory(project);
+    }
+    
+    jassertfalse;
+    return nullptr;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Binary transaction records
+//===----------------------------------------------------------------------===//
+
+// Each transaction is stored as a self-contained record: its name,
+// the table of all tag and attribute names used by its actions' xml,
+// and the xml trees themselves, with names replaced by the table indices.
+// This skips both formatting and parsing the text xml,
+// and keeps group actions, that repeat the same few names, compact.
+
+struct XmlNamesTable
+{
+    int indexOf(const String &name)
+    {
+        if (this->indices.contains(name))
+        {
+            return this->indices[name];
+        }
+        
+        const int index = this->names.size();
+        this->indices.set(name, index);
+        this->names.add(name);
+        return index;
+    }
+    
+    StringArray names;
+    HashMap<String, int> indices;
+};
+
+static void writeBinaryXml(const XmlElement &xml, XmlNamesTable &table, OutputStream &out)
+{
+    // text elements have no tag name, which is never used by other elements
+    out.writeCompressedInt(table.indexOf(xml.getTagName()));
+    
+    if (xml.isTextElement())
+    {
+        out.writeString(xml.getText());
+        return;
+    }
+    
+    const int numAttributes = xml.getNumAttributes();
+    out.writeCompressedInt(numAttributes);
+    
+    for (int i = 0; i < numAttributes; ++i)
+    {
+        out.writeCompressedInt(table.indexOf(xml.getAttributeName(i)));
+        out.writeString(xml.getAttributeValue(i));
+    }
+    
+    out.writeCompressedInt(xml.getNumChildElements());
+    
+    forEachXmlChildElement(xml, child)
+    {
+        writeBinaryXml(*child, table, out);
+    }
+}
+
+static XmlElement *readBinaryXml(InputStream &in, const Array<Identifier> &names)
+{
+    const Identifier tagName(names[in.readCompressedInt()]);
+    
+    if (tagName.isNull())
+    {
+        return XmlElement::createTextElement(in.readString());
+    }
+    
+    auto xml = new XmlElement(tagName);
+    const int numAttributes = in.readCompressedInt();
+    
+    for (int i = 0; i < numAttributes && ! in.isExhausted(); ++i)
+    {
+        const Identifier attributeName(names[in.readCompressedInt()]);
+        const String value(in.readString());
+        
+        if (! attributeName.isNull())
+        {
+            xml->setAttribute(attributeName, value);
+        }
+    }
+    
+    const int numChildren = in.readCompressedInt();
+    
+    for (int i = 0; i < numChildren && ! in.isExhausted(); ++i)
+    {
+        xml->addChildElement(readBinaryXml(in, names));
+    }
+    
+    return xml;
+}
 
 
 struct UndoStack::ActionSet
@@ -73,7 +244,7 @@ struct UndoStack::ActionSet
             total += actions.getUnchecked(i)->getSizeInUnits();
         }
         
-        return total;
+        return total + this->getRecordSize();
     }
     
     XmlElement *serialize() const
@@ -99,8 +270,107 @@ struct UndoStack::ActionSet
         
         forEachXmlChildElement(xml, childActionXml)
         {
-            UndoAction *action = createUndoActionsByTagName(childActionXml->getTagName());
-            action->deserialize(*childActionXml);
+            this->addDeserializedAction(*childActionXml);
+        }
+    }
+    
+    // The binary record is encoded once on save and kept until the actions change,
+    // so that saving the project does not re-encode the whole history every time;
+    // it is counted in getTotalSize(), so the stack has to account for it when it appears
+    const MemoryBlock &getRecord() const
+    {
+        if (this->record.getSize() == 0)
+        {
+            MemoryOutputStream recordStream(this->record, false);
+            this->encode(recordStream);
+        }
+        
+        return this->record;
+    }
+    
+    int getRecordSize() const noexcept
+    {
+        return int(this->record.getSize());
+    }
+    
+    // Writes the cached record, if any, or encodes the actions without caching them
+    void writeToStream(OutputStream &out) const
+    {
+        if (this->record.getSize() > 0)
+        {
+            out.write(this->record.getData(), this->record.getSize());
+        }
+        else
+        {
+            this->encode(out);
+        }
+    }
+    
+    void readFromRecord(const void *data, size_t size)
+    {
+        MemoryInputStream in(data, size, false);
+        this->readFromStream(in);
+        this->record.replaceWith(data, size);
+    }
+    
+    void invalidateRecord()
+    {
+        this->record.reset();
+    }
+    
+    void encode(OutputStream &out) const
+    {
+        XmlNamesTable table;
+        MemoryOutputStream actionsData;
+        
+        for (int i = 0; i < this->actions.size(); ++i)
+        {
+            const ScopedPointer<XmlElement> actionXml(this->actions.getUnchecked(i)->serialize());
+            writeBinaryXml(*actionXml, table, actionsData);
+        }
+        
+        out.writeString(this->name);
+        out.writeCompressedInt(table.names.size());
+        
+        for (int i = 0; i < table.names.size(); ++i)
+        {
+            out.writeString(table.names[i]);
+        }
+        
+        out.writeCompressedInt(this->actions.size());
+        out.write(actionsData.getData(), actionsData.getDataSize());
+    }
+    
+    void readFromStream(InputStream &in)
+    {
+        this->reset();
+        
+        this->name = in.readString();
+        
+        const int numNames = in.readCompressedInt();
+        Array<Identifier> names;
+        names.ensureStorageAllocated(numNames);
+        
+        for (int i = 0; i < numNames && ! in.isExhausted(); ++i)
+        {
+            const String nameString(in.readString());
+            names.add(nameString.isEmpty() ? Identifier() : Identifier(nameString));
+        }
+        
+        const int numActions = in.readCompressedInt();
+        
+        for (int i = 0; i < numActions && ! in.isExhausted(); ++i)
+        {
+            const ScopedPointer<XmlElement> actionXml(readBinaryXml(in, names));
+            this->addDeserializedAction(*actionXml);
+        }
+    }
+    
+    void addDeserializedAction(const XmlElement &actionXml)
+    {
+        if (UndoAction *action = createUndoActionByTagName(actionXml.getTagName(), this->project))
+        {
+            action->deserialize(actionXml);
             this->actions.add(action);
         }
     }
@@ -108,49 +378,12 @@ struct UndoStack::ActionSet
     void reset()
     {
         this->actions.clear();
-    }
-    
-    UndoAction *createUndoActionsByTagName(const String &tagName)
-    {
-        if      (tagName == Serialization::Undo::pianoLayerTreeItemInsertAction)        { return new PianoLayerTreeItemInsertAction(this->project); }
-        else if (tagName == Serialization::Undo::pianoLayerTreeItemRemoveAction)        { return new PianoLayerTreeItemRemoveAction(this->project); }
-        else if (tagName == Serialization::Undo::autoLayerTreeItemInsertAction)         { return new AutoLayerTreeItemInsertAction(this->project); }
-        else if (tagName == Serialization::Undo::autoLayerTreeItemRemoveAction)         { return new AutoLayerTreeItemRemoveAction(this->project); }
-        else if (tagName == Serialization::Undo::layerTreeItemRenameAction)             { return new LayerTreeItemRenameAction(this->project); }
-        else if (tagName == Serialization::Undo::midiLayerChangeColourAction)           { return new MidiLayerChangeColourAction(this->project); }
-        else if (tagName == Serialization::Undo::midiLayerChangeInstrumentAction)       { return new MidiLayerChangeInstrumentAction(this->project); }
-        else if (tagName == Serialization::Undo::midiLayerMuteAction)                   { return new MidiLayerMuteAction(this->project); }
-        else if (tagName == Serialization::Undo::noteInsertAction)                      { return new NoteInsertAction(this->project); }
-        else if (tagName == Serialization::Undo::noteRemoveAction)                      { return new NoteRemoveAction(this->project); }
-        else if (tagName == Serialization::Undo::noteChangeAction)                      { return new NoteChangeAction(this->project); }
-        else if (tagName == Serialization::Undo::notesGroupInsertAction)                { return new NotesGroupInsertAction(this->project); }
-        else if (tagName == Serialization::Undo::notesGroupRemoveAction)                { return new NotesGroupRemoveAction(this->project); }
-        else if (tagName == Serialization::Undo::notesGroupChangeAction)                { return new NotesGroupChangeAction(this->project); }
-        else if (tagName == Serialization::Undo::annotationEventInsertAction)           { return new AnnotationEventInsertAction(this->project); }
-        else if (tagName == Serialization::Undo::annotationEventRemoveAction)           { return new AnnotationEventRemoveAction(this->project); }
-        else if (tagName == Serialization::Undo::annotationEventChangeAction)           { return new AnnotationEventChangeAction(this->project); }
-        else if (tagName == Serialization::Undo::annotationEventsGroupInsertAction)     { return new AnnotationEventsGroupInsertAction(this->project); }
-        else if (tagName == Serialization::Undo::annotationEventsGroupRemoveAction)     { return new AnnotationEventsGroupRemoveAction(this->project); }
-        else if (tagName == Serialization::Undo::annotationEventsGroupChangeAction)     { return new AnnotationEventsGroupChangeAction(this->project); }
-        else if (tagName == Serialization::Undo::timeSignatureEventInsertAction)        { return new TimeSignatureEventInsertAction(this->project); }
-        else if (tagName == Serialization::Undo::timeSignatureEventRemoveAction)        { return new TimeSignatureEventRemoveAction(this->project); }
-        else if (tagName == Serialization::Undo::timeSignatureEventChangeAction)        { return new TimeSignatureEventChangeAction(this->project); }
-        else if (tagName == Serialization::Undo::timeSignatureEventsGroupInsertAction)  { return new TimeSignatureEventsGroupInsertAction(this->project); }
-        else if (tagName == Serialization::Undo::timeSignatureEventsGroupRemoveAction)  { return new TimeSignatureEventsGroupRemoveAction(this->project); }
-        else if (tagName == Serialization::Undo::timeSignatureEventsGroupChangeAction)  { return new TimeSignatureEventsGroupChangeAction(this->project); }
-        else if (tagName == Serialization::Undo::automationEventInsertAction)           { return new AutomationEventInsertAction(this->project); }
-        else if (tagName == Serialization::Undo::automationEventRemoveAction)           { return new AutomationEventRemoveAction(this->project); }
-        else if (tagName == Serialization::Undo::automationEventChangeAction)           { return new AutomationEventChangeAction(this->project); }
-        else if (tagName == Serialization::Undo::automationEventsGroupInsertAction)     { return new AutomationEventsGroupInsertAction(this->project); }
-        else if (tagName == Serialization::Undo::automationEventsGroupRemoveAction)     { return new AutomationEventsGroupRemoveAction(this->project); }
-        else if (tagName == Serialization::Undo::automationEventsGroupChangeAction)     { return new AutomationEventsGroupChangeAction(this->project); }
-        
-        jassertfalse;
-        return nullptr;
+        this->invalidateRecord();
     }
     
     OwnedArray<UndoAction> actions;
     String name;
+    mutable MemoryBlock record;
     
     ProjectTreeItem &project;
 };
@@ -163,22 +396,31 @@ project(parentProject),
 totalUnitsStored(0),
 nextIndex(0),
 newTransaction(true),
-reentrancyCheck(false)
+reentrancyCheck(false),
+accountedMemory(0)
 {
-    setMaxNumberOfStoredUnits (maxNumberOfUnitsToKeep,
+    const int configuredBudget =
+        Config::get(Serialization::Undo::memoryBudget).getIntValue();
+    
+    setMaxNumberOfStoredUnits ((configuredBudget > 0) ? configuredBudget : maxNumberOfUnitsToKeep,
                                minimumTransactions);
 }
 
 UndoStack::~UndoStack()
 {
+    clearSpilledTransactions();
+    MemoryAccounting::remove(MemoryAccounting::undo, this->accountedMemory);
 }
 
 //==============================================================================
 void UndoStack::clearUndoHistory()
 {
     transactions.clear();
+    clearSpilledTransactions();
+    clearPackedTransactions();
     totalUnitsStored = 0;
     nextIndex = 0;
+    updateMemoryAccounting();
     sendChangeMessage();
 }
 
@@ -267,11 +509,14 @@ bool UndoStack::perform (UndoAction* const newAction)
             }
             
             totalUnitsStored += action->getSizeInUnits();
+            totalUnitsStored -= actionSet->getRecordSize();
             actionSet->actions.add (action.release());
+            actionSet->invalidateRecord();
             newTransaction = false;
             //Logger::writeToLog("size " + String(actionSet->actions.size()));
             
             clearFutureTransactions();
+            updateMemoryAccounting();
             sendChangeMessage();
             return true;
         }
@@ -292,6 +537,14 @@ void UndoStack::clearFutureTransactions()
            && totalUnitsStored > maxNumUnitsToKeep
            && transactions.size() > minimumTransactionsToKeep)
     {
+        // try to keep the oldest transaction on disk instead of dropping it,
+        // otherwise the older history cannot be undone anymore
+        if (! spillOldestTransaction())
+        {
+            clearSpilledTransactions();
+            clearPackedTransactions();
+        }
+        
         totalUnitsStored -= transactions.getFirst()->getTotalSize();
         transactions.remove (0);
         --nextIndex;
@@ -302,6 +555,148 @@ void UndoStack::clearFutureTransactions()
     }
 }
 
+
+//===----------------------------------------------------------------------===//
+// Spilled transactions
+//===----------------------------------------------------------------------===//
+
+bool UndoStack::spillOldestTransaction()
+{
+    const ActionSet *oldest = transactions.getFirst();
+    
+    if (oldest == nullptr)
+    { return false; }
+    
+    if (spillFile == nullptr)
+    {
+        spillFile = new TemporaryFile(".undo");
+    }
+    
+    const File &file = spillFile->getFile();
+    const int64 offset = file.getSize();
+    
+    {
+        FileOutputStream out(file);
+        
+        if (out.failedToOpen())
+        {
+            return false;
+        }
+        
+        out.setPosition(offset);
+        oldest->writeToStream(out);
+    }
+    
+    spilledOffsets.add(offset);
+    spilledNames.add(oldest->name);
+    return true;
+}
+
+bool UndoStack::restoreSpilledTransaction()
+{
+    if (spillFile == nullptr || spilledOffsets.size() == 0)
+    { return false; }
+    
+    const File &file = spillFile->getFile();
+    const int64 offset = spilledOffsets.getLast();
+    MemoryBlock record;
+    
+    {
+        FileInputStream in(file);
+        
+        if (in.failedToOpen())
+        {
+            clearSpilledTransactions();
+            return false;
+        }
+        
+        in.setPosition(offset);
+        in.readIntoMemoryBlock(record);
+    }
+    
+    {
+        FileOutputStream out(file);
+        out.setPosition(offset);
+        out.truncate();
+    }
+    
+    spilledOffsets.removeLast();
+    spilledNames.remove(spilledNames.size() - 1);
+    
+    auto actionSet = new ActionSet(this->project, String::empty);
+    actionSet->readFromRecord(record.getData(), record.getSize());
+    
+    transactions.insert(0, actionSet);
+    totalUnitsStored += actionSet->getTotalSize();
+    ++nextIndex;
+    return true;
+}
+
+void UndoStack::clearSpilledTransactions()
+{
+    spilledOffsets.clear();
+    spilledNames.clear();
+    spillFile = nullptr; // deletes the temporary file
+}
+
+
+//===----------------------------------------------------------------------===//
+// Packed transactions
+//===----------------------------------------------------------------------===//
+
+int UndoStack::getNumPackedTransactions() const noexcept
+{
+    return jmax(0, packedOffsets.size() - 1);
+}
+
+String UndoStack::getPackedTransactionName(int index) const
+{
+    const int start = packedOffsets[index];
+    const int end = packedOffsets[index + 1];
+    
+    MemoryInputStream in(addBytesToPointer(packedHistory.getData(), start), size_t(end - start), false);
+    return in.readString();
+}
+
+bool UndoStack::restorePackedTransaction()
+{
+    const int numPacked = getNumPackedTransactions();
+    
+    if (numPacked == 0)
+    { return false; }
+    
+    const int start = packedOffsets[numPacked - 1];
+    const int end = packedOffsets[numPacked];
+    
+    auto actionSet = new ActionSet(this->project, String::empty);
+    actionSet->readFromRecord(addBytesToPointer(packedHistory.getData(), start), size_t(end - start));
+    
+    packedOffsets.removeLast();
+    
+    if (packedOffsets.size() == 1)
+    {
+        clearPackedTransactions();
+    }
+    
+    transactions.insert(0, actionSet);
+    totalUnitsStored += actionSet->getTotalSize();
+    ++nextIndex;
+    return true;
+}
+
+void UndoStack::clearPackedTransactions()
+{
+    packedOffsets.clear();
+    packedHistory.reset();
+}
+
+void UndoStack::updateMemoryAccounting() const
+{
+    const int64 usedMemory = int64(totalUnitsStored) + int64(packedHistory.getSize());
+    MemoryAccounting::add(MemoryAccounting::undo, usedMemory - accountedMemory);
+    accountedMemory = usedMemory;
+}
+
 void UndoStack::beginNewTransaction() noexcept
 {
     beginNewTransaction (String());
@@ -319,6 +714,9 @@ void UndoStack::setCurrentTransactionName (const String& newName) noexcept
         newTransactionName = newName;
     } else if (ActionSet* action = getCurrentSet()) {
         action->name = newName;
+        totalUnitsStored -= action->getRecordSize();
+        action->invalidateRecord();
+        updateMemoryAccounting();
     }
 }
 
@@ -326,11 +724,16 @@ void UndoStack::setCurrentTransactionName (const String& newName) noexcept
 UndoStack::ActionSet* UndoStack::getCurrentSet() const noexcept     { return transactions [nextIndex - 1]; }
 UndoStack::ActionSet* UndoStack::getNextSet() const noexcept        { return transactions [nextIndex]; }
 
-bool UndoStack::canUndo() const noexcept   { return getCurrentSet() != nullptr; }
+bool UndoStack::canUndo() const noexcept   { return getCurrentSet() != nullptr || spilledOffsets.size() > 0 || packedOffsets.size() > 0; }
 bool UndoStack::canRedo() const noexcept   { return getNextSet()    != nullptr; }
 
 bool UndoStack::undo()
 {
+    if (nextIndex == 0 && ! restoreSpilledTransaction())
+    {
+        restorePackedTransaction();
+    }
+    
     if (const ActionSet* const s = getCurrentSet())
     {
         const ScopedValueSetter<bool> setter (reentrancyCheck, true);
@@ -342,6 +745,7 @@ bool UndoStack::undo()
         }
         
         beginNewTransaction();
+        updateMemoryAccounting();
         sendChangeMessage();
         return true;
     }
@@ -362,6 +766,7 @@ bool UndoStack::redo()
         }
         
         beginNewTransaction();
+        updateMemoryAccounting();
         sendChangeMessage();
         return true;
     }
@@ -375,6 +780,14 @@ String UndoStack::getUndoDescription() const
         return s->name;
     }
     
+    if (nextIndex == 0 && spilledNames.size() > 0) {
+        return spilledNames[spilledNames.size() - 1];
+    }
+    
+    if (nextIndex == 0 && getNumPackedTransactions() > 0) {
+        return getPackedTransactionName(getNumPackedTransactions() - 1);
+    }
+    
     return String();
 }
 
@@ -419,25 +832,88 @@ int UndoStack::getNumActionsInCurrentTransaction() const
 // Serializable
 //===----------------------------------------------------------------------===//
 
+// The whole undo history is stored as one binary blob:
+// the number of transactions, then each transaction's record size,
+// then the records, from the oldest to the most recent one.
+// The packed and the spilled transactions are already encoded this way,
+// and the ones in memory keep their records once encoded, so that saving
+// only encodes the transactions changed since the last save, and loading decodes none.
+// The spilled records are streamed from the spill file as is.
+
 XmlElement *UndoStack::serialize() const
 {
     auto xml = new XmlElement(Serialization::Undo::undoStack);
     
-    int currentIndex = (this->nextIndex - 1);
-    int numStoredTransactions = 0;
+    Array<int> recordSizes;
+    
+    const int numPacked = this->getNumPackedTransactions();
     
-    while (currentIndex >= 0 &&
-           numStoredTransactions < MAX_TRANSACTIONS_TO_STORE)
+    for (int i = 0; i < numPacked; ++i)
     {
-        if (ActionSet *action = this->transactions[currentIndex])
+        recordSizes.add(this->packedOffsets[i + 1] - this->packedOffsets[i]);
+    }
+    
+    ScopedPointer<FileInputStream> spilledRecords;
+    
+    if (this->spillFile != nullptr && this->spilledOffsets.size() > 0)
+    {
+        spilledRecords = this->spillFile->getFile().createInputStream();
+        
+        if (spilledRecords != nullptr)
         {
-            xml->prependChildElement(action->serialize());
+            const int64 spilledSize = spilledRecords->getTotalLength();
+            
+            for (int i = 0; i < this->spilledOffsets.size(); ++i)
+            {
+                const int64 end = (i + 1 < this->spilledOffsets.size()) ?
+                    this->spilledOffsets[i + 1] : spilledSize;
+                
+                recordSizes.add(int(end - this->spilledOffsets[i]));
+            }
         }
-        
-        --currentIndex;
-        ++numStoredTransactions;
     }
     
+    for (int i = 0; i < this->nextIndex; ++i)
+    {
+        const ActionSet *actionSet = this->transactions.getUnchecked(i);
+        const int recordSizeBefore = actionSet->getRecordSize();
+        recordSizes.add(int(actionSet->getRecord().getSize()));
+        this->totalUnitsStored += actionSet->getRecordSize() - recordSizeBefore;
+    }
+    
+    this->updateMemoryAccounting();
+    
+    if (recordSizes.size() == 0)
+    {
+        return xml;
+    }
+    
+    MemoryOutputStream history;
+    history.writeCompressedInt(recordSizes.size());
+    
+    for (int i = 0; i < recordSizes.size(); ++i)
+    {
+        history.writeCompressedInt(recordSizes.getUnchecked(i));
+    }
+    
+    if (numPacked > 0)
+    {
+        const int start = this->packedOffsets.getFirst();
+        const int end = this->packedOffsets.getLast();
+        history.write(addBytesToPointer(this->packedHistory.getData(), start), size_t(end - start));
+    }
+    
+    if (spilledRecords != nullptr)
+    {
+        history.writeFromInputStream(*spilledRecords, -1);
+    }
+    
+    for (int i = 0; i < this->nextIndex; ++i)
+    {
+        this->transactions.getUnchecked(i)->writeToStream(history);
+    }
+    
+    xml->setAttribute(Serialization::Undo::history, history.getMemoryBlock().toBase64Encoding());
     return xml;
 }
 
@@ -451,6 +927,64 @@ void UndoStack::deserialize(const XmlElement &xml)
     
     this->reset();
     
+    if (root->hasAttribute(Serialization::Undo::history))
+    {
+        // only read the records table here, all transactions are decoded lazily
+        bool isValid = this->packedHistory.fromBase64Encoding(root->getStringAttribute(Serialization::Undo::history));
+        
+        if (isValid)
+        {
+            MemoryInputStream in(this->packedHistory, false);
+            const int numTransactions = in.readCompressedInt();
+            
+            // each transaction takes at least a byte in the table and a byte in the records,
+            // so a corrupted count is rejected before anything is allocated for it
+            isValid = (numTransactions > 0 && numTransactions <= in.getNumBytesRemaining() / 2);
+            
+            Array<int> recordSizes;
+            
+            if (isValid)
+            {
+                recordSizes.ensureStorageAllocated(numTransactions);
+                
+                for (int i = 0; i < numTransactions && isValid; ++i)
+                {
+                    const int recordSize = in.readCompressedInt();
+                    isValid = (recordSize > 0 && ! in.isExhausted());
+                    recordSizes.add(recordSize);
+                }
+            }
+            
+            const int64 headerEnd = in.getPosition();
+            const int64 historySize = int64(this->packedHistory.getSize());
+            int64 offset = headerEnd;
+            
+            if (isValid)
+            {
+                this->packedOffsets.ensureStorageAllocated(recordSizes.size() + 1);
+                this->packedOffsets.add(int(offset));
+            }
+            
+            for (int i = 0; i < recordSizes.size() && isValid; ++i)
+            {
+                offset += recordSizes.getUnchecked(i);
+                isValid = (offset > headerEnd && offset <= historySize);
+                this->packedOffsets.add(int(offset));
+            }
+        }
+        
+        if (! isValid || this->packedOffsets.size() < 2)
+        {
+            jassertfalse;
+            this->clearPackedTransactions();
+        }
+        
+        this->updateMemoryAccounting();
+        this->sendChangeMessage();
+        return;
+    }
+    
+    // legacy format, where only the last transactions were stored as xml
     forEachXmlChildElement(*root, childTransactionXml)
     {
         auto actionSet = new ActionSet(this->project, String::empty);
@@ -458,6 +992,8 @@ void UndoStack::deserialize(const XmlElement &xml)
         this->transactions.insert(this->nextIndex, actionSet);
         ++this->nextIndex;
     }
+    
+    this->updateMemoryAccounting();
 }
 
 void UndoStack::reset()
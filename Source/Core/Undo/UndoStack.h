@@ -22,12 +22,17 @@ class ProjectTreeItem;
 
 #include "Serializable.h"
 
+// The undo history memory budget, in bytes, as reported by actions' getSizeInUnits();
+// may be overridden in the config. When the budget is exceeded, the oldest
+// transactions are spilled to a temporary file, and restored when undone back to
+#define UNDO_STACK_DEFAULT_MEMORY_BUDGET (8 * 1024 * 1024)
+
 class UndoStack : public ChangeBroadcaster, public Serializable
 {
 public:
 
     explicit UndoStack(ProjectTreeItem &parentProject,
-              int maxNumberOfUnitsToKeep = 30000,
+              int maxNumberOfUnitsToKeep = UNDO_STACK_DEFAULT_MEMORY_BUDGET,
               int minimumTransactionsToKeep = 30);
 
     ~UndoStack() override;
@@ -72,7 +77,11 @@ private:
     OwnedArray<ActionSet> transactions;
     String newTransactionName;
     
-    int totalUnitsStored, maxNumUnitsToKeep, minimumTransactionsToKeep, nextIndex;
+    // Includes the encoded records cached by the transactions,
+    // which may be added on save, hence mutable
+    mutable int totalUnitsStored;
+    
+    int maxNumUnitsToKeep, minimumTransactionsToKeep, nextIndex;
     bool newTransaction, reentrancyCheck;
     
     ActionSet *getCurrentSet() const noexcept;
@@ -80,5 +89,39 @@ private:
     
     void clearFutureTransactions();
     
+    //===------------------------------------------------------------------===//
+    // Spilled transactions
+    //===------------------------------------------------------------------===//
+    
+    // The oldest transactions, which did not fit the memory budget,
+    // stacked in a temporary file: the last spilled one is the first to restore
+    ScopedPointer<TemporaryFile> spillFile;
+    Array<int64> spilledOffsets;
+    StringArray spilledNames;
+    
+    bool spillOldestTransaction();
+    bool restoreSpilledTransaction();
+    void clearSpilledTransactions();
+    
+    //===------------------------------------------------------------------===//
+    // Packed transactions
+    //===------------------------------------------------------------------===//
+    
+    // The history loaded with the project, kept as binary records
+    // and decoded only when undone back to; it is older than any spilled transaction.
+    // The offsets have one extra item, the end of the last record
+    MemoryBlock packedHistory;
+    Array<int> packedOffsets;
+    
+    int getNumPackedTransactions() const noexcept;
+    String getPackedTransactionName(int index) const;
+    bool restorePackedTransaction();
+    void clearPackedTransactions();
+    
+    // What is reported to MemoryAccounting: the actions' sizes in units
+    // (which are meant to be bytes) plus the packed history
+    mutable int64 accountedMemory;
+    void updateMemoryAccounting() const;
+    
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (UndoStack)
 };
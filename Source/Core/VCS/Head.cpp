@@ -59,7 +59,7 @@ Head::Head(Pack::Ptr packPtr, WeakReference<TrackedItemsSource> targetProject) :
 
 Head::~Head()
 {
-
+    this->historyRoot.removeListener(this);
 }
 
 
@@ -175,28 +175,51 @@ bool Head::moveTo(const Revision &revision)
 
     if (this->targetVcsItemsSource != nullptr)
     {
-        // здесь надо будет пройтись до корня и запомнить все ревизии
+        // здесь надо будет пройтись до корня или до ближайшего снапшота и запомнить все ревизии
         Array<Revision> treePath;
         Revision currentRevision(revision);
-
-        // сначала обнуляем состояние
-        {
-            ScopedWriteLock lock(this->stateLock);
-            this->state = new HeadState();
-        }
+        ScopedPointer<HeadState> newState;
+        int depth = 0;
+        bool isInHistoryTree = false;
 
         Logger::writeToLog("Head::moveTo " + currentRevision.getUuid());
 
         while (currentRevision.isValid())
         {
+            {
+                ScopedReadLock snapshotsReadLock(this->snapshotsLock);
+
+                if (StateSnapshot *snapshot = this->findSnapshotFor(currentRevision))
+                {
+                    newState = new HeadState(*snapshot->state);
+                    depth = snapshot->depth;
+                    isInHistoryTree = true;
+                    break;
+                }
+            }
+
             treePath.insert(0, currentRevision);
+
+            if (currentRevision == this->historyRoot)
+            {
+                isInHistoryTree = true;
+            }
+
             currentRevision = Revision(currentRevision.getParent());
         }
 
-        // затем, идти по ним в обратном порядке - от корня
+        if (newState == nullptr)
+        {
+            // снапшота не нашлось, начинаем с пустого состояния, корень имеет нулевую глубину
+            newState = new HeadState();
+            depth = -1;
+        }
+
+        // затем, идти по ним в обратном порядке - от корня (или от снапшота)
         for (auto && i : treePath)
         {
             const Revision rev(i);
+            ++depth;
 
             Logger::writeToLog("Head::moveTo -> " + rev.getUuid());
 
@@ -211,15 +234,15 @@ bool Head::moveTo(const Revision &revision)
                     if (item->getType() == RevisionItem::Added)
                     {
                         // ::Ptr сам создастся конструктором из указателя и увеличит его счетчик ссылок
-                        this->state->addItem(item);
+                        newState->addItem(item);
                     }
                     else if (item->getType() == RevisionItem::Removed)
                     {
-                        this->state->removeItem(item);
+                        newState->removeItem(item);
                     }
                     else if (item->getType() == RevisionItem::Changed)
                     {
-                        this->state->mergeItem(item);
+                        newState->mergeItem(item);
                     }
                     else
                     {
@@ -227,6 +250,19 @@ bool Head::moveTo(const Revision &revision)
                     }
                 }
             }
+
+            // снапшоты делаем только для ревизий из дерева истории (не для стэшей),
+            // и только если следим за его изменениями
+            if (isInHistoryTree && depth > 0 &&
+                (depth % VCS_HEAD_SNAPSHOTS_INTERVAL) == 0)
+            {
+                this->addSnapshot(rev, depth, *newState);
+            }
+        }
+
+        {
+            ScopedWriteLock lock(this->stateLock);
+            this->state = newState.release();
         }
     }
 
@@ -241,6 +277,14 @@ void Head::pointTo(const Revision &revision)
     this->setDiffOutdated(true);
 }
 
+void Head::setHistoryRoot(const Revision &root)
+{
+    this->historyRoot.removeListener(this);
+    this->clearSnapshots();
+    this->historyRoot = root;
+    this->historyRoot.addListener(this);
+}
+
 
 bool Head::resetChangedItemToState(const VCS::RevisionItem::Ptr diffItem)
 {
@@ -327,6 +371,41 @@ bool Head::resetChangedItemToState(const VCS::RevisionItem::Ptr diffItem)
     return false;
 }
 
+// Tells if the live item already matches the state item, delta by delta
+static bool hasSameDeltas(const TrackedItem &liveItem, const TrackedItem &stateItem)
+{
+    for (int i = 0; i < stateItem.getNumDeltas(); ++i)
+    {
+        const String deltaType(stateItem.getDelta(i)->getType());
+        bool foundDelta = false;
+
+        for (int j = 0; j < liveItem.getNumDeltas(); ++j)
+        {
+            if (liveItem.getDelta(j)->getType() == deltaType)
+            {
+                ScopedPointer<XmlElement> stateData(stateItem.createDeltaDataFor(i));
+                ScopedPointer<XmlElement> liveData(liveItem.createDeltaDataFor(j));
+
+                if (stateData == nullptr || liveData == nullptr ||
+                    ! stateData->isEquivalentTo(liveData, false))
+                {
+                    return false;
+                }
+
+                foundDelta = true;
+                break;
+            }
+        }
+
+        if (! foundDelta)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 void Head::checkout()
 {
     if (this->targetVcsItemsSource == nullptr)
@@ -335,34 +414,46 @@ void Head::checkout()
     if (this->state == nullptr)
     { return; }
 
-    // clear all tracked items
+    const double startTime = Time::getMillisecondCounterHiRes();
+    int numTouchedItems = 0;
+
+    // items are not torn down and rebuilt anymore:
+    // untouched ones are skipped, and the others are reset in place
+    // (layers apply only the changed events, see resetEventsDelta)
+    for (int i = 0; i < this->state->getNumTrackedItems(); ++i)
     {
-        Array<TrackedItem *> itemsToClear;
+        RevisionItem::Ptr stateItem = static_cast<RevisionItem *>(this->state->getTrackedItem(i));
+        TrackedItem *targetItem = nullptr;
 
-        for (int i = 0; i < this->targetVcsItemsSource->getNumTrackedItems(); ++i)
+        for (int j = 0; j < this->targetVcsItemsSource->getNumTrackedItems(); ++j)
         {
-            TrackedItem *ti = this->targetVcsItemsSource->getTrackedItem(i);
+            TrackedItem *item = this->targetVcsItemsSource->getTrackedItem(j);
 
-            if (this->state->getItemWithUuid(ti->getUuid()) != nullptr)
+            if (item->getUuid() == stateItem->getUuid())
             {
-                itemsToClear.add(ti);
+                targetItem = item;
+                break;
             }
         }
 
-        for (auto i : itemsToClear)
+        if (stateItem->getType() == RevisionItem::Removed)
         {
-            this->targetVcsItemsSource->deleteTrackedItem(i);
+            if (targetItem == nullptr)
+            { continue; }
+        }
+        else if (targetItem != nullptr && hasSameDeltas(*targetItem, *stateItem))
+        {
+            continue;
         }
-    }
-
-    //this->targetVcsItemsSource->clearAllTrackedItems();
-
 
-    for (int i = 0; i < this->state->getNumTrackedItems(); ++i)
-    {
-        RevisionItem::Ptr stateItem = static_cast<RevisionItem *>(this->state->getTrackedItem(i));
         this->checkoutItem(stateItem);
+        ++numTouchedItems;
     }
+
+    const double endTime = Time::getMillisecondCounterHiRes();
+    Logger::writeToLog("Head::checkout: " + String(numTouchedItems) + " of " +
+                       String(this->state->getNumTrackedItems()) + " items touched in " +
+                       String(endTime - startTime) + "ms");
 }
 
 void Head::cherryPick(const Array<Uuid> uuids)
@@ -486,10 +577,147 @@ void Head::rebuildDiffNow()
 }
 
 
+//===----------------------------------------------------------------------===//
+// State snapshots
+//===----------------------------------------------------------------------===//
+
+Head::StateSnapshot *Head::findSnapshotFor(const Revision &revision) const
+{
+    return this->snapshotsByRevision[revision.getUuid()];
+}
+
+void Head::addSnapshot(const Revision &revision, int depth, const HeadState &state)
+{
+    const String revisionId(revision.getUuid());
+    ScopedWriteLock lock(this->snapshotsLock);
+
+    if (this->snapshotsByRevision.contains(revisionId))
+    { return; }
+
+    auto snapshot = new StateSnapshot();
+    snapshot->revisionId = revisionId;
+    snapshot->depth = depth;
+    snapshot->state = new HeadState(state);
+
+    this->snapshots.add(snapshot);
+    this->snapshotsByRevision.set(revisionId, snapshot);
+}
+
+void Head::removeSnapshotsInSubtree(const ValueTree &subtreeRoot)
+{
+    ScopedWriteLock lock(this->snapshotsLock);
+
+    if (this->snapshots.size() == 0)
+    { return; }
+
+    Array<ValueTree> subtrees;
+    subtrees.add(subtreeRoot);
+
+    while (subtrees.size() > 0)
+    {
+        const ValueTree tree(subtrees.removeAndReturn(subtrees.size() - 1));
+        const String revisionId(tree.getProperty(Serialization::VCS::commitId).toString());
+
+        if (StateSnapshot *snapshot = this->snapshotsByRevision[revisionId])
+        {
+            this->snapshotsByRevision.remove(revisionId);
+            this->snapshots.removeObject(snapshot);
+        }
+
+        for (int i = 0; i < tree.getNumChildren(); ++i)
+        {
+            subtrees.add(tree.getChild(i));
+        }
+    }
+}
+
+void Head::clearSnapshots()
+{
+    ScopedWriteLock lock(this->snapshotsLock);
+    this->snapshotsByRevision.clear();
+    this->snapshots.clear();
+}
+
+// Any change of a revision's deltas (quick amend, sync, reset)
+// makes the snapshots of that revision and all its children outdated
+
+void Head::valueTreePropertyChanged(ValueTree &tree, const Identifier &property)
+{
+    this->removeSnapshotsInSubtree(tree);
+}
+
+void Head::valueTreeChildAdded(ValueTree &parent, ValueTree &child) {}
+
+void Head::valueTreeChildRemoved(ValueTree &parent, ValueTree &child, int index)
+{
+    this->removeSnapshotsInSubtree(child);
+}
+
+void Head::valueTreeChildOrderChanged(ValueTree &parent, int oldIndex, int newIndex) {}
+
+void Head::valueTreeParentChanged(ValueTree &tree) {}
+
+void Head::valueTreeRedirected(ValueTree &tree)
+{
+    this->clearSnapshots();
+}
+
+
 //===----------------------------------------------------------------------===//
 // Serializable
 //===----------------------------------------------------------------------===//
 
+static void serializeHeadState(HeadState &state, XmlElement &stateXml, XmlElement &stateDataXml)
+{
+    for (int i = 0; i < state.getNumTrackedItems(); ++i)
+    {
+        const RevisionItem::Ptr stateItem = static_cast<RevisionItem *>(state.getTrackedItem(i));
+        XmlElement *serializedItem = stateItem->serialize();
+        stateXml.addChildElement(serializedItem);
+
+        // exports also deltas data
+        for (int j = 0; j < stateItem->getNumDeltas(); ++j)
+        {
+            XmlElement *deltaData = stateItem->createDeltaDataFor(j);
+
+            auto packItem = new XmlElement(Serialization::VCS::packItem);
+            packItem->setAttribute(Serialization::VCS::packItemRevId, stateItem->getUuid().toString());
+            packItem->setAttribute(Serialization::VCS::packItemDeltaId, stateItem->getDelta(j)->getUuid().toString());
+            packItem->addChildElement(deltaData);
+
+            stateDataXml.prependChildElement(packItem);
+        }
+    }
+}
+
+static void deserializeHeadState(HeadState &state, Pack::Ptr pack,
+                                 const XmlElement &indexRoot, const XmlElement &dataRoot)
+{
+    forEachXmlChildElementWithTagName(indexRoot, stateElement, Serialization::VCS::revisionItem)
+    {
+        RevisionItem::Ptr stateItem(new RevisionItem(pack, RevisionItem::Added, nullptr));
+        stateItem->deserialize(*stateElement);
+
+        //Logger::writeToLog("- " + stateItem->getVCSName());
+
+        // import deltas data
+        forEachXmlChildElementWithTagName(dataRoot, dataElement, Serialization::VCS::packItem)
+        {
+            const String packItemRevId = dataElement->getStringAttribute(Serialization::VCS::packItemRevId);
+            const String packItemDeltaId = dataElement->getStringAttribute(Serialization::VCS::packItemDeltaId);
+            const XmlElement *deltaData = dataElement->getFirstChildElement();
+
+            if (packItemRevId == stateItem->getUuid().toString())
+            {
+                stateItem->importDataForDelta(deltaData, packItemDeltaId);
+                //Logger::writeToLog("+ " + String(packItemDeltaId->getNumChildElements()));
+            }
+        }
+
+        state.addItem(stateItem);
+    }
+}
+
 XmlElement *Head::serialize() const
 {
     auto xml = new XmlElement(Serialization::VCS::head);
@@ -498,30 +726,43 @@ XmlElement *Head::serialize() const
 
     {
         ScopedReadLock lock(this->stateLock);
-        
-        for (int i = 0; i < this->state->getNumTrackedItems(); ++i)
+        serializeHeadState(*this->state, *stateXml, *stateDataXml);
+    }
+    
+    xml->addChildElement(stateXml);
+    xml->addChildElement(stateDataXml);
+
+    // saves only the nearest snapshots on the way from heading revision to the root,
+    // which are the ones to be used by the next moveTo's
+    auto snapshotsXml = new XmlElement(Serialization::VCS::headSnapshots);
+
+    {
+        ScopedReadLock lock(this->snapshotsLock);
+        Revision currentRevision(this->headingAt);
+
+        while (currentRevision.isValid() &&
+               snapshotsXml->getNumChildElements() < VCS_HEAD_MAX_SERIALIZED_SNAPSHOTS)
         {
-            const RevisionItem::Ptr stateItem = static_cast<RevisionItem *>(this->state->getTrackedItem(i));
-            XmlElement *serializedItem = stateItem->serialize();
-            stateXml->addChildElement(serializedItem);
-            
-            // exports also deltas data
-            for (int j = 0; j < stateItem->getNumDeltas(); ++j)
+            if (StateSnapshot *snapshot = this->findSnapshotFor(currentRevision))
             {
-                XmlElement *deltaData = stateItem->createDeltaDataFor(j);
-                
-                auto packItem = new XmlElement(Serialization::VCS::packItem);
-                packItem->setAttribute(Serialization::VCS::packItemRevId, stateItem->getUuid().toString());
-                packItem->setAttribute(Serialization::VCS::packItemDeltaId, stateItem->getDelta(j)->getUuid().toString());
-                packItem->addChildElement(deltaData);
-                
-                stateDataXml->prependChildElement(packItem);
+                auto snapshotXml = new XmlElement(Serialization::VCS::headSnapshot);
+                snapshotXml->setAttribute(Serialization::VCS::headSnapshotRevisionId, snapshot->revisionId);
+                snapshotXml->setAttribute(Serialization::VCS::headSnapshotDepth, snapshot->depth);
+
+                auto snapshotStateXml = new XmlElement(Serialization::VCS::headIndex);
+                auto snapshotDataXml = new XmlElement(Serialization::VCS::headIndexData);
+                serializeHeadState(*snapshot->state, *snapshotStateXml, *snapshotDataXml);
+                snapshotXml->addChildElement(snapshotStateXml);
+                snapshotXml->addChildElement(snapshotDataXml);
+
+                snapshotsXml->addChildElement(snapshotXml);
             }
+
+            currentRevision = Revision(currentRevision.getParent());
         }
     }
-    
-    xml->addChildElement(stateXml);
-    xml->addChildElement(stateDataXml);
+
+    xml->addChildElement(snapshotsXml);
     return xml;
 }
 
@@ -539,33 +780,36 @@ void Head::deserialize(const XmlElement &xml)
     const XmlElement *dataRoot = headRoot->getChildByName(Serialization::VCS::headIndexData);
     if (dataRoot == nullptr) { return; }
     
-    forEachXmlChildElementWithTagName(*indexRoot, stateElement, Serialization::VCS::revisionItem)
-    {
-        RevisionItem::Ptr stateItem(new RevisionItem(this->pack, RevisionItem::Added, nullptr));
-        stateItem->deserialize(*stateElement);
+    deserializeHeadState(*this->state, this->pack, *indexRoot, *dataRoot);
 
-        //Logger::writeToLog("- " + stateItem->getVCSName());
-        
-        // import deltas data
-        forEachXmlChildElementWithTagName(*dataRoot, dataElement, Serialization::VCS::packItem)
-        {
-            const String packItemRevId = dataElement->getStringAttribute(Serialization::VCS::packItemRevId);
-            const String packItemDeltaId = dataElement->getStringAttribute(Serialization::VCS::packItemDeltaId);
-            const XmlElement *deltaData = dataElement->getFirstChildElement();
-            
-            if (packItemRevId == stateItem->getUuid().toString())
-            {
-                stateItem->importDataForDelta(deltaData, packItemDeltaId);
-                //Logger::writeToLog("+ " + String(packItemDeltaId->getNumChildElements()));
-            }
-        }
-        
-        this->state->addItem(stateItem);
+    const XmlElement *snapshotsRoot = headRoot->getChildByName(Serialization::VCS::headSnapshots);
+    if (snapshotsRoot == nullptr) { return; }
+
+    forEachXmlChildElementWithTagName(*snapshotsRoot, snapshotXml, Serialization::VCS::headSnapshot)
+    {
+        const XmlElement *snapshotIndexRoot = snapshotXml->getChildByName(Serialization::VCS::headIndex);
+        const XmlElement *snapshotDataRoot = snapshotXml->getChildByName(Serialization::VCS::headIndexData);
+        const String revisionId = snapshotXml->getStringAttribute(Serialization::VCS::headSnapshotRevisionId);
+        const int depth = snapshotXml->getIntAttribute(Serialization::VCS::headSnapshotDepth);
+
+        if (snapshotIndexRoot == nullptr || snapshotDataRoot == nullptr || revisionId.isEmpty())
+        { continue; }
+
+        auto snapshot = new StateSnapshot();
+        snapshot->revisionId = revisionId;
+        snapshot->depth = depth;
+        snapshot->state = new HeadState();
+        deserializeHeadState(*snapshot->state, this->pack, *snapshotIndexRoot, *snapshotDataRoot);
+
+        ScopedWriteLock lock(this->snapshotsLock);
+        this->snapshots.add(snapshot);
+        this->snapshotsByRevision.set(revisionId, snapshot);
     }
 }
 
 void Head::reset()
 {
+    this->clearSnapshots();
     this->state = new HeadState();
     this->setDiffOutdated(true);
 }
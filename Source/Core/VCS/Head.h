@@ -21,6 +21,13 @@
 #include "Revision.h"
 #include "Pack.h"
 
+// Every Nth revision of depth, moveTo keeps a copy of the rebuilt state,
+// so that moving the head replays at most N revisions from the nearest snapshot
+#define VCS_HEAD_SNAPSHOTS_INTERVAL 32
+
+// How many snapshots (the ones on the heading revision's path) are saved with the project
+#define VCS_HEAD_MAX_SERIALIZED_SNAPSHOTS 4
+
 namespace VCS
 {
     class HeadState;
@@ -32,7 +39,8 @@ namespace VCS
         private Thread,
         public ChangeListener, // слушает, изменился ли проект, чтоб запустить билд при показе редактора
         public ChangeBroadcaster, // оповещает о том, что дифф начал или закончил обновляться
-        public Serializable
+        public Serializable,
+        private ValueTree::Listener // следит за деревом истории, чтобы сбрасывать устаревшие снапшоты
     {
     public:
 
@@ -61,6 +69,9 @@ namespace VCS
         bool moveTo(const Revision &revision); // перестраивает индекс-состояние
         
         void pointTo(const Revision &revision); // не перестраивает индекс
+
+        // снапшоты состояния валидны только для ревизий этого дерева
+        void setHistoryRoot(const Revision &root);
         
         bool resetChangedItemToState(const VCS::RevisionItem::Ptr diffItem);
 
@@ -105,6 +116,29 @@ namespace VCS
 
         void checkoutItem(VCS::RevisionItem::Ptr stateItem);
 
+        //===------------------------------------------------------------------===//
+        // State snapshots
+        //
+
+        struct StateSnapshot
+        {
+            String revisionId;
+            int depth;
+            ScopedPointer<HeadState> state;
+        };
+
+        StateSnapshot *findSnapshotFor(const Revision &revision) const;
+        void addSnapshot(const Revision &revision, int depth, const HeadState &state);
+        void removeSnapshotsInSubtree(const ValueTree &subtreeRoot);
+        void clearSnapshots();
+
+        void valueTreePropertyChanged(ValueTree &tree, const Identifier &property) override;
+        void valueTreeChildAdded(ValueTree &parent, ValueTree &child) override;
+        void valueTreeChildRemoved(ValueTree &parent, ValueTree &child, int index) override;
+        void valueTreeChildOrderChanged(ValueTree &parent, int oldIndex, int newIndex) override;
+        void valueTreeParentChanged(ValueTree &tree) override;
+        void valueTreeRedirected(ValueTree &tree) override;
+
         ReadWriteLock outdatedMarkerLock;
         bool diffOutdated;
 
@@ -122,6 +156,14 @@ namespace VCS
 
         ScopedPointer<HeadState> state;
 
+    private:
+
+        ValueTree historyRoot;
+
+        ReadWriteLock snapshotsLock;
+        OwnedArray<StateSnapshot> snapshots;
+        HashMap<String, StateSnapshot *> snapshotsByRevision;
+
     private:
 
         WeakReference<TrackedItemsSource> targetVcsItemsSource; // ProjectTreeItem
@@ -19,6 +19,7 @@
 
 #include "TrackedItemsSource.h"
 #include "RevisionItem.h"
+#include "MemoryAccounting.h"
 
 namespace VCS
 {
@@ -66,6 +67,7 @@ namespace VCS
 
         Array<RevisionItem::Ptr> items;
 
+        MEMORY_ACCOUNTED(HeadState, vcs);
         JUCE_LEAK_DETECTOR(HeadState);
 
     };
@@ -21,6 +21,7 @@
 #include "FileUtils.h"
 #include "DataEncoder.h"
 #include "SerializationKeys.h"
+#include "MemoryAccounting.h"
 
 using namespace VCS;
 
@@ -41,7 +42,8 @@ using namespace VCS;
 // в памяти держим только хэдер, где записано: пара id и смещения в файле.
 //
 
-Pack::Pack()
+Pack::Pack() :
+    unsavedDataSize(0)
 {
     // todo иногда пишет в корень диска c: ? wtf
 
@@ -54,6 +56,7 @@ Pack::~Pack()
     this->packStream = nullptr;
     this->packWriteLocker = nullptr;
     this->packFile->deleteFile();
+    this->clearUnsavedData();
 }
 
 
@@ -133,7 +136,7 @@ void Pack::setDeltaDataFor(const Uuid &itemId,
     data.writeToStream(ms, "", true, false);
     ms.flush();
 
-    this->unsavedData.add(block);
+    this->addUnsavedData(block);
 }
 
 
@@ -206,7 +209,7 @@ void Pack::deserialize(const XmlElement &xml)
 
         ms.flush();
 
-        this->unsavedData.add(block);
+        this->addUnsavedData(block);
     }
 
     // и сливаем на диск
@@ -218,7 +221,7 @@ void Pack::reset()
     ScopedLock lock(this->packStreamLock);
 
     this->headers.clear();
-    this->unsavedData.clear();
+    this->clearUnsavedData();
     this->packStream = nullptr;
     this->packWriteLocker = nullptr;
     this->packFile->deleteFile();
@@ -229,6 +232,20 @@ void Pack::reset()
 // Protected
 //===----------------------------------------------------------------------===//
 
+void Pack::addUnsavedData(PackDataBlock *block)
+{
+    this->unsavedData.add(block);
+    this->unsavedDataSize += int64(block->data.getSize());
+    MemoryAccounting::add(MemoryAccounting::vcs, int64(block->data.getSize()));
+}
+
+void Pack::clearUnsavedData()
+{
+    this->unsavedData.clear();
+    MemoryAccounting::remove(MemoryAccounting::vcs, this->unsavedDataSize);
+    this->unsavedDataSize = 0;
+}
+
 void Pack::flush()
 {
     ScopedLock lock(this->packStreamLock);
@@ -275,7 +292,7 @@ void Pack::flush()
         this->headers.add(newHeader);
     }
 
-    this->unsavedData.clear();
+    this->clearUnsavedData();
 
     tempOutputStream = nullptr;
 
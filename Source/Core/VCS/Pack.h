@@ -90,6 +90,12 @@ namespace VCS
 
         OwnedArray<PackDataBlock> unsavedData;
 
+        // reported to MemoryAccounting until flushed to the pack file
+        int64 unsavedDataSize;
+
+        void addUnsavedData(PackDataBlock *block);
+        void clearUnsavedData();
+
         ScopedPointer<File> packFile;
 
         CriticalSection packStreamLock;
@@ -0,0 +1,302 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "RevisionsIndex.h"
+
+using namespace VCS;
+
+RevisionsIndex::RevisionsIndex() {}
+
+RevisionsIndex::~RevisionsIndex()
+{
+    this->root.removeListener(this);
+}
+
+void RevisionsIndex::setRoot(const Revision &newRoot)
+{
+    this->root.removeListener(this);
+    this->root = newRoot;
+    this->root.addListener(this);
+    this->rebuild();
+}
+
+
+//===----------------------------------------------------------------------===//
+// Queries
+//===----------------------------------------------------------------------===//
+
+int RevisionsIndex::size() const noexcept
+{
+    return this->nodes.size();
+}
+
+Revision RevisionsIndex::getRevision(int index) const
+{
+    if (const Node *node = this->nodes[index])
+    {
+        return Revision(node->revision);
+    }
+
+    return Revision();
+}
+
+Revision RevisionsIndex::getRevisionById(const String &id) const
+{
+    if (const Node *node = this->nodesByUuid[id])
+    {
+        return Revision(node->revision);
+    }
+
+    return Revision();
+}
+
+int RevisionsIndex::getDepth(const Revision &revision) const
+{
+    const Node *node = this->findNode(revision);
+    return (node != nullptr) ? node->depth : -1;
+}
+
+bool RevisionsIndex::isAncestor(const Revision &ancestor, const Revision &revision) const
+{
+    const Node *ancestorNode = this->findNode(ancestor);
+    const Node *node = this->findNode(revision);
+
+    if (ancestorNode == nullptr || node == nullptr)
+    { return false; }
+
+    return findAncestorAtDepth(node, ancestorNode->depth) == ancestorNode;
+}
+
+Revision RevisionsIndex::getAncestorAtDepth(const Revision &revision, int depth) const
+{
+    if (const Node *node = findAncestorAtDepth(this->findNode(revision), depth))
+    {
+        return Revision(node->revision);
+    }
+
+    return Revision();
+}
+
+Revision RevisionsIndex::getCommonAncestor(const Revision &revision1, const Revision &revision2) const
+{
+    const Node *node1 = this->findNode(revision1);
+    const Node *node2 = this->findNode(revision2);
+
+    if (node1 == nullptr || node2 == nullptr)
+    { return Revision(); }
+
+    const int depth = jmin(node1->depth, node2->depth);
+    node1 = findAncestorAtDepth(node1, depth);
+    node2 = findAncestorAtDepth(node2, depth);
+
+    // nodes of the same depth have jump pointers of the same depth,
+    // so both sides can skip together while their jumps still differ
+    while (node1 != node2 && node1 != nullptr && node2 != nullptr)
+    {
+        if (node1->jump != node2->jump)
+        {
+            node1 = node1->jump;
+            node2 = node2->jump;
+        }
+        else
+        {
+            node1 = node1->parent;
+            node2 = node2->parent;
+        }
+    }
+
+    return (node1 != nullptr && node1 == node2) ? Revision(node1->revision) : Revision();
+}
+
+Array<Revision> RevisionsIndex::getPathFromRoot(const Revision &revision) const
+{
+    Array<Revision> path;
+    const Node *node = this->findNode(revision);
+
+    if (node == nullptr)
+    { return path; }
+
+    path.insertMultiple(0, Revision(), node->depth + 1);
+
+    while (node != nullptr)
+    {
+        path.setUnchecked(node->depth, Revision(node->revision));
+        node = node->parent;
+    }
+
+    return path;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Private
+//===----------------------------------------------------------------------===//
+
+RevisionsIndex::Node *RevisionsIndex::findNode(const ValueTree &revision) const
+{
+    Node *node = this->nodesByUuid[revision.getProperty(Serialization::VCS::commitId).toString()];
+    return (node != nullptr && node->revision == revision) ? node : nullptr;
+}
+
+const RevisionsIndex::Node *RevisionsIndex::findAncestorAtDepth(const Node *node, int depth) noexcept
+{
+    if (node == nullptr || depth < 0 || depth > node->depth)
+    { return nullptr; }
+
+    while (node->depth > depth)
+    {
+        if (node->jump != nullptr && node->jump->depth >= depth)
+        {
+            node = node->jump;
+        }
+        else
+        {
+            node = node->parent;
+        }
+    }
+
+    return node;
+}
+
+void RevisionsIndex::rebuild()
+{
+    this->nodesByUuid.clear();
+    this->nodes.clear();
+
+    if (this->root.isValid())
+    {
+        this->addSubtree(this->root, nullptr);
+    }
+}
+
+void RevisionsIndex::addSubtree(const ValueTree &subtreeRoot, Node *parentNode)
+{
+    Array<ValueTree> subtrees;
+    Array<Node *> parentNodes;
+    subtrees.add(subtreeRoot);
+    parentNodes.add(parentNode);
+
+    while (subtrees.size() > 0)
+    {
+        const ValueTree tree(subtrees.removeAndReturn(subtrees.size() - 1));
+        Node *parent = parentNodes.removeAndReturn(parentNodes.size() - 1);
+
+        auto node = new Node();
+        node->revision = tree;
+        node->uuid = tree.getProperty(Serialization::VCS::commitId).toString();
+        node->parent = parent;
+        node->depth = (parent != nullptr) ? (parent->depth + 1) : 0;
+        node->jump = parent;
+
+        if (parent != nullptr && parent->jump != nullptr && parent->jump->jump != nullptr &&
+            (parent->depth - parent->jump->depth) == (parent->jump->depth - parent->jump->jump->depth))
+        {
+            node->jump = parent->jump->jump;
+        }
+
+        this->nodes.add(node);
+
+        if (node->uuid.isNotEmpty())
+        {
+            this->nodesByUuid.set(node->uuid, node);
+        }
+
+        for (int i = 0; i < tree.getNumChildren(); ++i)
+        {
+            subtrees.add(tree.getChild(i));
+            parentNodes.add(node);
+        }
+    }
+}
+
+void RevisionsIndex::removeSubtree(const ValueTree &subtreeRoot)
+{
+    Array<ValueTree> subtrees;
+    subtrees.add(subtreeRoot);
+
+    while (subtrees.size() > 0)
+    {
+        const ValueTree tree(subtrees.removeAndReturn(subtrees.size() - 1));
+
+        if (Node *node = this->findNode(tree))
+        {
+            this->nodesByUuid.remove(node->uuid);
+            this->nodes.removeObject(node);
+        }
+
+        for (int i = 0; i < tree.getNumChildren(); ++i)
+        {
+            subtrees.add(tree.getChild(i));
+        }
+    }
+}
+
+
+//===----------------------------------------------------------------------===//
+// ValueTree::Listener
+//===----------------------------------------------------------------------===//
+
+void RevisionsIndex::valueTreePropertyChanged(ValueTree &tree, const Identifier &property)
+{
+    if (property.toString() != Serialization::VCS::commitId)
+    { return; }
+
+    // the uuid has changed (i.e. the revision is being deserialized or merged),
+    // so the node has to be found by the tree itself and re-keyed
+    for (auto node : this->nodes)
+    {
+        if (node->revision == tree)
+        {
+            if (this->nodesByUuid[node->uuid] == node)
+            {
+                this->nodesByUuid.remove(node->uuid);
+            }
+
+            node->uuid = tree.getProperty(Serialization::VCS::commitId).toString();
+
+            if (node->uuid.isNotEmpty())
+            {
+                this->nodesByUuid.set(node->uuid, node);
+            }
+
+            return;
+        }
+    }
+}
+
+void RevisionsIndex::valueTreeChildAdded(ValueTree &parent, ValueTree &child)
+{
+    if (Node *parentNode = this->findNode(parent))
+    {
+        this->addSubtree(child, parentNode);
+    }
+}
+
+void RevisionsIndex::valueTreeChildRemoved(ValueTree &parent, ValueTree &child, int index)
+{
+    this->removeSubtree(child);
+}
+
+void RevisionsIndex::valueTreeChildOrderChanged(ValueTree &parent, int oldIndex, int newIndex) {}
+
+void RevisionsIndex::valueTreeParentChanged(ValueTree &tree) {}
+
+void RevisionsIndex::valueTreeRedirected(ValueTree &tree)
+{
+    this->rebuild();
+}
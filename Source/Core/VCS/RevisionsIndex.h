@@ -0,0 +1,94 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Revision.h"
+
+namespace VCS
+{
+    // An index of all revisions of the history tree, kept up to date
+    // by listening to the tree, so it follows commits, merges and deserialization.
+    //
+    // Lookups by uuid take O(1). Each revision also stores its depth and a skip pointer
+    // to one of its ancestors (the jump pointers are chosen like in skew-binary lists),
+    // so that ancestor queries take O(log n) instead of walking up to the root.
+
+    class RevisionsIndex : private ValueTree::Listener
+    {
+    public:
+
+        RevisionsIndex();
+
+        ~RevisionsIndex() override;
+
+        void setRoot(const Revision &root);
+
+        int size() const noexcept;
+
+        Revision getRevision(int index) const;
+
+        // returns an empty revision if not found
+        Revision getRevisionById(const String &id) const;
+
+        // returns -1 for the revisions outside of the history tree
+        int getDepth(const Revision &revision) const;
+
+        bool isAncestor(const Revision &ancestor, const Revision &revision) const;
+
+        Revision getAncestorAtDepth(const Revision &revision, int depth) const;
+
+        Revision getCommonAncestor(const Revision &revision1, const Revision &revision2) const;
+
+        // starts from the root, ends with the revision itself
+        Array<Revision> getPathFromRoot(const Revision &revision) const;
+
+    private:
+
+        struct Node
+        {
+            ValueTree revision;
+            String uuid;
+            Node *parent;
+            Node *jump;
+            int depth;
+        };
+
+        Node *findNode(const ValueTree &revision) const;
+
+        static const Node *findAncestorAtDepth(const Node *node, int depth) noexcept;
+
+        void rebuild();
+        void addSubtree(const ValueTree &subtreeRoot, Node *parentNode);
+        void removeSubtree(const ValueTree &subtreeRoot);
+
+        void valueTreePropertyChanged(ValueTree &tree, const Identifier &property) override;
+        void valueTreeChildAdded(ValueTree &parent, ValueTree &child) override;
+        void valueTreeChildRemoved(ValueTree &parent, ValueTree &child, int index) override;
+        void valueTreeChildOrderChanged(ValueTree &parent, int oldIndex, int newIndex) override;
+        void valueTreeParentChanged(ValueTree &tree) override;
+        void valueTreeRedirected(ValueTree &tree) override;
+
+        ValueTree root;
+
+        OwnedArray<Node> nodes;
+        HashMap<String, Node *> nodesByUuid;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RevisionsIndex)
+
+    };
+}  // namespace VCS
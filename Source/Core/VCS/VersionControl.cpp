@@ -61,6 +61,8 @@ VersionControl::VersionControl(WeakReference<VCS::TrackedItemsSource> parent,
     }
 
     this->root = Revision(this->pack, TRANS("defaults::newproject::firstcommit"));
+    this->head.setHistoryRoot(this->root);
+    this->revisionsIndex.setRoot(this->root);
 
     this->remote = new Client(*this);
 
@@ -97,24 +99,15 @@ VersionControlEditor *VersionControl::createEditor()
 MD5 VersionControl::calculateHash() const
 {
     // StringArray и sort - чтоб не зависеть от порядка чайлдов.
-    StringArray ids(this->recursiveGetHashes(this->root));
-    ids.sort(true);
-    return MD5(ids.joinIntoString("").toUTF8());
-}
-
-StringArray VersionControl::recursiveGetHashes(const Revision revision) const
-{
-    StringArray sum;
+    StringArray ids;
 
-    for (int i = 0; i < revision.getNumChildren(); ++i)
+    for (int i = 0; i < this->revisionsIndex.size(); ++i)
     {
-        Revision child(revision.getChild(i));
-        sum.addArray(this->recursiveGetHashes(child));
+        ids.add(this->revisionsIndex.getRevision(i).calculateHash().toHexString());
     }
 
-    const String revisionSum(revision.calculateHash().toHexString());
-    sum.add(revisionSum);
-    return sum;
+    ids.sort(true);
+    return MD5(ids.joinIntoString("").toUTF8());
 }
 
 void VersionControl::mergeWith(VersionControl &remoteHistory)
@@ -124,8 +117,7 @@ void VersionControl::mergeWith(VersionControl &remoteHistory)
     this->publicId = remoteHistory.getPublicId();
     this->historyMergeVersion = remoteHistory.getVersion();
 
-    Revision newHeadRevision(this->getRevisionById(this->root,
-                             remoteHistory.getHead().getHeadingRevision().getUuid()));
+    Revision newHeadRevision(this->getRevisionById(remoteHistory.getHead().getHeadingRevision().getUuid()));
 
     if (!newHeadRevision.isEmpty())
     {
@@ -518,7 +510,7 @@ void VersionControl::deserialize(const XmlElement &xml)
         Logger::writeToLog("Loading index done in " + String(h2 - h1) + "ms");
     }
     
-    Revision headRevision(this->getRevisionById(this->root, headId));
+    Revision headRevision(this->getRevisionById(headId));
 
     // здесь мы раньше полностью десериализовали состояние хэда.
     // если дерево истории со временеи становится большим, moveTo со всеми мержами занимает кучу времени.
@@ -562,26 +554,8 @@ void VersionControl::changeListenerCallback(ChangeBroadcaster* source)
 // Private
 //===----------------------------------------------------------------------===//
 
-Revision VersionControl::getRevisionById(const Revision startFrom, const String &id) const
+Revision VersionControl::getRevisionById(const String &id) const
 {
-    //Logger::writeToLog("getRevisionById, iterating " + startFrom.getUuid());
-
-    if (startFrom.getUuid() == id)
-    {
-        return startFrom;
-    }
-
-    for (int i = 0; i < startFrom.getNumChildren(); ++i)
-    {
-        Revision child(startFrom.getChild(i));
-        Revision search(this->getRevisionById(child, id));
-
-        if (!search.isEmpty())
-        {
-            //Logger::writeToLog("search ok, returning " + search.getUuid());
-            return search;
-        }
-    }
-
-    return Revision(this->pack, "");
+    const Revision revision(this->revisionsIndex.getRevisionById(id));
+    return revision.isValid() ? revision : Revision(this->pack, "");
 }
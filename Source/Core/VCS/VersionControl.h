@@ -29,6 +29,7 @@ class VersionControlEditor;
 
 #include "Delta.h"
 #include "Revision.h"
+#include "RevisionsIndex.h"
 #include "Head.h"
 #include "Pack.h"
 #include "Client.h"
@@ -87,6 +88,8 @@ public:
 
     VCS::Revision getRoot() { return this->root; }
 
+    const VCS::RevisionsIndex &getRevisionsIndex() const { return this->revisionsIndex; }
+
 
     void moveHead(const VCS::Revision revision);
 
@@ -138,11 +141,9 @@ public:
     
 protected:
 
-    StringArray recursiveGetHashes(const VCS::Revision revision) const;
-
     void recursiveTreeMerge(VCS::Revision localRevision, VCS::Revision remoteRevision);
 
-    VCS::Revision getRevisionById(const VCS::Revision startFrom, const String &id) const;
+    VCS::Revision getRevisionById(const String &id) const;
 
     VCS::Pack::Ptr pack;
 
@@ -153,6 +154,9 @@ protected:
     // само дерево vcs
     VCS::Revision root;
 
+    // uuid lookups and ancestor queries over the tree above
+    VCS::RevisionsIndex revisionsIndex;
+
     ScopedPointer<VCS::Client> remote;
 
     WeakReference<VCS::TrackedItemsSource> parentItem;
@@ -223,6 +223,26 @@ void ProjectCommandPanel::handleCommandMessage(int commandId)
             return;
         }
 
+        case CommandIDs::ExportAllProjectsToMidi:
+        {
+#if JUCE_IOS
+            const File exportFolder = File::getSpecialLocation(File::userDocumentsDirectory);
+            App::Workspace().exportAllProjectsToMidi(exportFolder);
+            App::Helio()->showModalComponent(new SuccessTooltip());
+#else
+            FileChooser fc(TRANS("dialog::document::exportfolder"),
+                           File::getSpecialLocation(File::userDocumentsDirectory), ("*.*"), true);
+
+            if (fc.browseForDirectory() &&
+                App::Workspace().exportAllProjectsToMidi(fc.getResult()) > 0)
+            {
+                App::Helio()->showTooltip("dialog::document::export::done", 3000);
+            }
+#endif
+            this->getParentComponent()->exitModalState(0);
+            return;
+        }
+
         case CommandIDs::UnloadProject:
             App::Workspace().unloadProjectById(this->project.getId());
             this->getParentComponent()->exitModalState(0);
@@ -447,6 +467,12 @@ void ProjectCommandPanel::initRenderMenu()
     cmds.add(CommandItem::withParams(Icons::render, CommandIDs::RenderToOGG, TRANS("menu::project::render::ogg")));
     cmds.add(CommandItem::withParams(Icons::render, CommandIDs::RenderToFLAC, TRANS("menu::project::render::flac")));
     cmds.add(CommandItem::withParams(Icons::commit, CommandIDs::ExportMidi, TRANS("menu::project::render::midi")));
+
+    if (App::Workspace().getLoadedProjects().size() > 1)
+    {
+        cmds.add(CommandItem::withParams(Icons::commit, CommandIDs::ExportAllProjectsToMidi, TRANS("menu::project::render::midi::all")));
+    }
+
     this->updateContent(cmds, CommandPanel::SlideLeft);
 }
 
@@ -135,6 +135,7 @@ namespace CommandIDs
         LoginLogout                     = 0x015000,
         OpenProject                     = 0x015001,
         CreateNewProject                = 0x015002,
+        ExportAllProjectsToMidi         = 0x015003,
         
         // ProjectCommandPanel
         RenderToFLAC                    = 0x016000,
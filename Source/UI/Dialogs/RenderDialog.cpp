@@ -303,7 +303,9 @@ void RenderDialog::startOrAbortRender()
 
     if (! transport.isRendering())
     {
-        transport.startRender(this->getFileName());
+        // shift-click also renders each instrument into a separate file
+        const bool renderStems = ModifierKeys::getCurrentModifiers().isShiftDown();
+        transport.startRender(this->getFileName(), renderStems);
         this->startTrackingProgress();
     }
     else
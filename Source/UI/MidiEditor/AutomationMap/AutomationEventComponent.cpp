@@ -24,7 +24,6 @@
 //[MiscUserDefs]
 #include "AutomationTrackMap.h"
 #include "AutomationCurveHelper.h"
-#include "AutomationEventsConnector.h"
 #include "AutomationLayer.h"
 //[/MiscUserDefs]
 
@@ -44,7 +43,6 @@ AutomationEventComponent::AutomationEventComponent(AutomationTrackMap &parent, c
     this->setOpaque(false);
     this->setInterceptsMouseClicks(true, false);
     this->setPaintingIsUnclipped(true);
-    this->recreateConnector();
     //[/UserPreSize]
 
     setSize (32, 32);
@@ -180,13 +178,6 @@ void AutomationEventComponent::mouseUp (const MouseEvent& e)
 
 //[MiscUserCode]
 
-void AutomationEventComponent::recreateConnector()
-{
-    this->connector = new AutomationEventsConnector(this->editor, this, this->nextEventHolder);
-    this->editor.addAndMakeVisible(this->connector);
-    this->updateConnector();
-}
-
 void AutomationEventComponent::recreateHelper()
 {
     this->helper = new AutomationCurveHelper(this->editor, this->event, this, this->nextEventHolder);
@@ -194,20 +185,18 @@ void AutomationEventComponent::recreateHelper()
     this->updateHelper();
 }
 
-void AutomationEventComponent::updateConnector()
-{
-    this->connector->resizeToFit(this->event.getCurvature());
-}
-
 void AutomationEventComponent::updateHelper()
 {
     if (this->helper && this->nextEventHolder)
     {
-        const float d = this->editor.getHelperDiameter();
-        const Point<int> linePos(this->connector->getPosition());
-        const Point<float> lineCentre(this->connector->getCentrePoint());
-        Rectangle<int> bounds(0, 0, int(d), int(d));
-        this->helper->setBounds(bounds.withPosition(lineCentre.toInt()).translated(linePos.getX() - int(d / 2), linePos.getY() - int(d / 2)));
+        // the helper sits in the middle of the curve, as the lane draws it
+        const int d = int(this->editor.getHelperDiameter());
+        const Point<float> curveCentre =
+            AutomationTrackMap::getCurvePoint(this->getBounds().getCentre().toFloat(),
+                                              this->nextEventHolder->getBounds().getCentre().toFloat(),
+                                              this->event.getCurvature(), 0.5f);
+
+        this->helper->setBounds(Rectangle<int>(d, d).withCentre(curveCentre.toInt()));
     }
 }
 
@@ -215,13 +204,11 @@ void AutomationEventComponent::setNextNeighbour(AutomationEventComponent *next)
 {
     if (next == this->nextEventHolder)
     {
-        this->updateConnector();
         this->updateHelper();
         return;
     }
 
     this->nextEventHolder = next;
-    this->recreateConnector();
 
     if (this->nextEventHolder == nullptr)
     {
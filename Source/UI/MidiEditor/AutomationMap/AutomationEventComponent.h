@@ -20,7 +20,6 @@
 //[Headers]
 #include "AutomationEvent.h"
 
-class AutomationEventsConnector;
 class AutomationCurveHelper;
 class AutomationTrackMap;
 //[/Headers]
@@ -42,7 +41,6 @@ public:
     inline float getBeat() const
     { return this->event.getBeat(); }
 
-    void updateConnector();
     void updateHelper();
     void setNextNeighbour(AutomationEventComponent *next);
 
@@ -93,10 +91,8 @@ private:
     Point<int> clickOffset;
     bool draggingState;
 
-    void recreateConnector();
     void recreateHelper();
 
-    ScopedPointer<AutomationEventsConnector> connector;
     ScopedPointer<AutomationCurveHelper> helper;
     SafePointer<AutomationEventComponent> nextEventHolder;
 
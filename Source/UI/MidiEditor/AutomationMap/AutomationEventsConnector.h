@@ -1,47 +0,0 @@
-/*
-    This file is part of Helio Workstation.
-
-    Helio is free software: you can redistribute it and/or modify
-    it under the terms of the GNU General Public License as published by
-    the Free Software Foundation, either version 3 of the License, or
-    (at your option) any later version.
-
-    Helio is distributed in the hope that it will be useful,
-    but WITHOUT ANY WARRANTY; without even the implied warranty of
-    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
-    GNU General Public License for more details.
-
-    You should have received a copy of the GNU General Public License
-    along with Helio. If not, see <http://www.gnu.org/licenses/>.
-*/
-
-#pragma once
-
-class AutomationTrackMap;
-
-#include "ComponentConnectorCurve.h"
-
-class AutomationEventsConnector : public ComponentConnectorCurve
-{
-public:
-
-    AutomationEventsConnector(AutomationTrackMap &parentTrack, Component *c1, Component *c2);
-    
-    //===------------------------------------------------------------------===//
-    // Component
-    //===------------------------------------------------------------------===//
-
-    void mouseDown(const MouseEvent &e) override;
-    
-    void mouseDrag(const MouseEvent &e) override;
-    
-    void mouseUp(const MouseEvent &e) override;
-    
-private:
-
-    float xAnchor;
-    
-    AutomationTrackMap &editor;
-
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AutomationEventsConnector)
-};
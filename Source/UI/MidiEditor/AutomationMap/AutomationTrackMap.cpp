@@ -24,7 +24,7 @@
 #include "AutomationLayer.h"
 #include "PlayerThread.h"
 #include "MidiRoll.h"
-#include "ComponentConnectorCurve.h"
+#include <float.h>
 
 #if HELIO_DESKTOP
 #   define TRACKMAP_NOTE_COMPONENT_HEIGHT (1)
@@ -38,6 +38,38 @@
 
 #define DEFAULT_TRACKMAP_HEIGHT 128
 
+// Stretched maps may get really wide, columns get wider than a pixel beyond that
+#define AUTOMATION_TRACKMAP_MAX_COLUMNS 8192
+#define AUTOMATION_TRACKMAP_MAX_SEGMENT_STEPS 256
+#define AUTOMATION_TRACKMAP_MAX_HOVERED_EVENTS 16
+#define AUTOMATION_TRACKMAP_LINE_THICKNESS (5.f)
+#define AUTOMATION_TRACKMAP_POINT_DIAMETER (4.f)
+
+// Index of the first event at the given beat or later,
+// or strictly later, if not inclusive; the layer is sorted by beat
+static int findEventIndex(const MidiLayer &layer, float beat, bool inclusive)
+{
+    int start = 0;
+    int end = layer.size();
+
+    while (start < end)
+    {
+        const int middle = (start + end) / 2;
+        const float middleBeat = layer.getUnchecked(middle)->getBeat();
+
+        if (inclusive ? (middleBeat < beat) : (middleBeat <= beat))
+        {
+            start = middle + 1;
+        }
+        else
+        {
+            end = middle;
+        }
+    }
+
+    return start;
+}
+
 AutomationTrackMap::AutomationTrackMap(ProjectTreeItem &parentProject, MidiRoll &parentRoll, WeakReference<MidiLayer> targetLayer) :
     project(parentProject),
     roll(parentRoll),
@@ -46,15 +78,15 @@ AutomationTrackMap::AutomationTrackMap(ProjectTreeItem &parentProject, MidiRoll
     projectLastBeat(16.f),
     rollFirstBeat(0.f),
     rollLastBeat(16.f),
+    numColumns(0),
+    dirtyStartBeat(FLT_MAX),
+    dirtyEndBeat(-FLT_MAX),
     draggingEvent(nullptr),
     addNewEventMode(false)
 {
     this->setFocusContainer(false);
     this->setWantsKeyboardFocus(false);
     
-    this->leadingConnector = new ComponentConnectorCurve(nullptr, nullptr);
-    this->addAndMakeVisible(this->leadingConnector);
-    
     this->setMouseCursor(MouseCursor::CopyingCursor);
     
     this->setOpaque(false);
@@ -72,11 +104,38 @@ AutomationTrackMap::~AutomationTrackMap()
     this->project.removeListener(this);
 }
 
+Point<float> AutomationTrackMap::getCurvePoint(Point<float> p1, Point<float> p2, float curvature, float t) noexcept
+{
+    const float dx = (p2.x - p1.x);
+    const float dy = (p2.y - p1.y);
+    const bool goesUp = (p1.y > p2.y);
+    const float c = goesUp ? curvature : (1.f - curvature);
+    const float rc = goesUp ? (1.f - curvature) : curvature;
+    const Point<float> control(p1.x + dx * rc, p1.y + dy * c);
+
+    const float u = 1.f - t;
+    return (p1 * (u * u * u)) + (control * (3.f * t * u)) + (p2 * (t * t * t));
+}
+
 
 //===----------------------------------------------------------------------===//
 // Component
 //===----------------------------------------------------------------------===//
 
+void AutomationTrackMap::mouseMove(const MouseEvent &e)
+{
+    this->updateHoveredEvents(e.x);
+}
+
+void AutomationTrackMap::mouseExit(const MouseEvent &e)
+{
+    // moving onto one of the hovered components also counts as exit
+    if (this->draggingEvent == nullptr && ! this->isMouseOver(true))
+    {
+        this->clearEventComponents();
+    }
+}
+
 void AutomationTrackMap::mouseDown(const MouseEvent &e)
 {
     if (e.mods.isLeftButtonDown())
@@ -109,33 +168,90 @@ void AutomationTrackMap::mouseUp(const MouseEvent &e)
         this->setMouseCursor(MouseCursor::CopyingCursor);
         this->draggingEvent = nullptr;
     }
+
+    this->updateHoveredEvents(e.x);
 }
 
 void AutomationTrackMap::resized()
 {
-    this->rollFirstBeat = float(this->roll.getFirstBeat());
-    this->rollLastBeat = float(this->roll.getLastBeat());
-    
-    this->setVisible(false);
-    
-    // во избежание глюков - сначала обновляем позиции
-    for (int i = 0; i < this->eventComponents.size(); ++i)
+    const float newFirstBeat = float(this->roll.getFirstBeat());
+    const float newLastBeat = float(this->roll.getLastBeat());
+    const int newNumColumns = jmin(this->getWidth(), AUTOMATION_TRACKMAP_MAX_COLUMNS);
+
+    // Scrolling only moves this component, and the columns are independent
+    // of height, so they are only recomputed when the zoom level changes
+    const bool geometryChanged =
+        this->numColumns != newNumColumns ||
+        this->rollFirstBeat != newFirstBeat ||
+        this->rollLastBeat != newLastBeat;
+
+    if (geometryChanged)
     {
-        AutomationEventComponent *const c = this->eventComponents.getUnchecked(i);
-        c->setBounds(this->getEventBounds(c));
+        this->rollFirstBeat = newFirstBeat;
+        this->rollLastBeat = newLastBeat;
+        this->numColumns = newNumColumns;
+        this->columns.malloc(size_t(jmax(1, newNumColumns)));
+        this->dirtyStartBeat = FLT_MAX;
+        this->dirtyEndBeat = -FLT_MAX;
+        this->updateColumns(0, this->numColumns);
     }
-    
-    // затем - зависимые элементы
-    for (int i = 0; i < this->eventComponents.size(); ++i)
+
+    this->updateEventComponents();
+}
+
+void AutomationTrackMap::paint(Graphics &g)
+{
+    const MidiLayer *autoLayer = this->layer.get();
+
+    if (autoLayer == nullptr || this->numColumns <= 0)
+    { return; }
+
+    const Rectangle<int> clip(g.getClipBounds());
+    const float columnWidth = float(this->getWidth()) / float(this->numColumns);
+    const float height = float(this->getAvailableHeight());
+    const float halfThickness = AUTOMATION_TRACKMAP_LINE_THICKNESS / 2.f;
+
+    const int startColumn = jmax(0, int(float(clip.getX()) / columnWidth) - 1);
+    const int endColumn = jmin(this->numColumns, int(float(clip.getRight()) / columnWidth) + 2);
+
+    // Integer rectangles do not overlap, so that the translucent curve has even colour
+    g.setColour(Colours::white.withAlpha(0.15f));
+
+    for (int i = startColumn; i < endColumn; ++i)
     {
-        AutomationEventComponent *const c = this->eventComponents.getUnchecked(i);
-        c->updateConnector();
-        c->updateHelper();
+        const CurveColumn &column = this->columns[i];
+
+        if (column.minY > column.maxY)
+        { continue; }
+
+        const int x1 = roundToInt(float(i) * columnWidth);
+        const int x2 = roundToInt(float(i + 1) * columnWidth);
+        const int y1 = roundToInt(column.minY * height - halfThickness);
+        const int y2 = roundToInt(column.maxY * height + halfThickness);
+        g.fillRect(x1, y1, x2 - x1, y2 - y1);
+    }
+
+    // Events are drawn as dots, skipping the ones too close to the previous dot
+    g.setColour(Colour(0x3affffff));
+
+    const float d = AUTOMATION_TRACKMAP_POINT_DIAMETER;
+    const float clipEndBeat = this->getBeatForColumn(float(endColumn));
+    int i = findEventIndex(*autoLayer, this->getBeatForColumn(float(startColumn)), true);
+
+    while (i < autoLayer->size())
+    {
+        const MidiEvent *event = autoLayer->getUnchecked(i);
+
+        if (event->getBeat() > clipEndBeat)
+        { break; }
+
+        const Point<float> position(this->getColumnPosition(*event));
+        const float x = position.x * columnWidth;
+        g.fillEllipse(x - d / 2.f, position.y * height - d / 2.f, d, d);
+
+        const float nextBeat = this->getBeatForColumn((x + d) / columnWidth);
+        i = jmax(i + 1, findEventIndex(*autoLayer, nextBeat, true));
     }
-    
-    this->leadingConnector->resizeToFit();
-    
-    this->setVisible(true);
 }
 
 void AutomationTrackMap::mouseWheelMove(const MouseEvent &event, const MouseWheelDetails &wheel)
@@ -236,27 +352,6 @@ void AutomationTrackMap::getRowsColsByMousePosition(int x, int y, float &targetV
 }
 
 
-AutomationEventComponent *AutomationTrackMap::getPreviousEventComponent(int indexOfSorted) const
-{
-    const int indexOfPrevious = indexOfSorted - 1;
-    
-    return
-        isPositiveAndBelow(indexOfPrevious, this->eventComponents.size()) ?
-        this->eventComponents.getUnchecked(indexOfPrevious) :
-        nullptr;
-}
-
-AutomationEventComponent *AutomationTrackMap::getNextEventComponent(int indexOfSorted) const
-{
-    const int indexOfNext = indexOfSorted + 1;
-    
-    return
-        isPositiveAndBelow(indexOfNext, this->eventComponents.size()) ?
-        this->eventComponents.getUnchecked(indexOfNext) :
-        nullptr;
-}
-
-
 //===----------------------------------------------------------------------===//
 // ProjectListener
 //===----------------------------------------------------------------------===//
@@ -265,45 +360,9 @@ void AutomationTrackMap::onEventChanged(const MidiEvent &oldEvent, const MidiEve
 {
     if (newEvent.getLayer() == this->layer)
     {
-        const AutomationEvent &autoEvent = static_cast<const AutomationEvent &>(oldEvent);
-        const AutomationEvent &newAutoEvent = static_cast<const AutomationEvent &>(newEvent);
-        
-        if (AutomationEventComponent *component = this->eventsHash[autoEvent])
-        {
-            // update links and connectors
-            this->eventComponents.sort(*component);
-            const int indexOfSorted = this->eventComponents.indexOfSorted(*component, component);
-            AutomationEventComponent *previousEventComponent(this->getPreviousEventComponent(indexOfSorted));
-            AutomationEventComponent *nextEventComponent(this->getNextEventComponent(indexOfSorted));
-            
-            component->setNextNeighbour(nextEventComponent);
-            //component->setVisible(false);
-            this->updateTempoComponent(component);
-            //component->setVisible(true);
-            
-            if (previousEventComponent)
-            {
-                previousEventComponent->setNextNeighbour(component);
-                
-                if (AutomationEventComponent *oneMorePrevious = this->getPreviousEventComponent(indexOfSorted - 1))
-                {
-                    oneMorePrevious->setNextNeighbour(previousEventComponent);
-                }
-            }
-            
-            if (nextEventComponent)
-            {
-                nextEventComponent->setNextNeighbour(this->getNextEventComponent(indexOfSorted + 1));
-            }
-            
-            this->eventsHash.remove(autoEvent);
-            this->eventsHash.set(newAutoEvent, component);
-            
-            if (indexOfSorted == 0 || indexOfSorted == 1)
-            {
-                this->leadingConnector->retargetAndUpdate(nullptr, this->eventComponents[0]);
-            }
-        }
+        this->invalidateAroundBeat(oldEvent.getBeat());
+        this->invalidateAroundBeat(newEvent.getBeat());
+        this->updateEventComponents();
     }
 }
 
@@ -311,38 +370,20 @@ void AutomationTrackMap::onEventAdded(const MidiEvent &event)
 {
     if (event.getLayer() == this->layer)
     {
-        const AutomationEvent &autoEvent = static_cast<const AutomationEvent &>(event);
-        
-        auto component = new AutomationEventComponent(*this, autoEvent);
-        this->addAndMakeVisible(component);
-
-        // update links and connectors
-        const int indexOfSorted = this->eventComponents.addSorted(*component, component);
-        AutomationEventComponent *previousEventComponent(this->getPreviousEventComponent(indexOfSorted));
-        AutomationEventComponent *nextEventComponent(this->getNextEventComponent(indexOfSorted));
-
-        component->setNextNeighbour(nextEventComponent);
-        this->updateTempoComponent(component);
-        component->toFront(true);
-        //this->eventAnimator.fadeIn(component, 150);
-        
-        if (previousEventComponent)
-        {
-            previousEventComponent->setNextNeighbour(component);
-        }
-
-        this->eventsHash.set(autoEvent, component);
-        
-        if (indexOfSorted == 0)
-        {
-            this->leadingConnector->retargetAndUpdate(nullptr, this->eventComponents[0]);
-        }
+        this->invalidateAroundBeat(event.getBeat());
         
         if (this->addNewEventMode)
         {
+            const AutomationEvent &autoEvent = static_cast<const AutomationEvent &>(event);
+            auto component = new AutomationEventComponent(*this, autoEvent);
+            this->addAndMakeVisible(component);
+            this->eventComponents.add(component);
+            
             this->draggingEvent = component;
             this->addNewEventMode = false;
         }
+        
+        this->updateEventComponents();
     }
 }
 
@@ -350,30 +391,19 @@ void AutomationTrackMap::onEventRemoved(const MidiEvent &event)
 {
     if (event.getLayer() == this->layer)
     {
-        const AutomationEvent &autoEvent = static_cast<const AutomationEvent &>(event);
+        // the event is still there, so are its neighbours
+        this->invalidateAroundBeat(event.getBeat());
         
-        if (AutomationEventComponent *component = this->eventsHash[autoEvent])
+        if (AutomationEventComponent *component = this->findEventComponent(event))
         {
-            //this->eventAnimator.fadeOut(component, 150);
-            this->removeChildComponent(component);
-            this->eventsHash.remove(autoEvent);
-            
-            // update links and connectors for neighbours
-            const int indexOfSorted = this->eventComponents.indexOfSorted(*component, component);
-            AutomationEventComponent *previousEventComponent(this->getPreviousEventComponent(indexOfSorted));
-            AutomationEventComponent *nextEventComponent(this->getNextEventComponent(indexOfSorted));
-            
-            if (previousEventComponent)
+            if (this->draggingEvent == component)
             {
-                previousEventComponent->setNextNeighbour(nextEventComponent);
+                this->draggingEvent = nullptr;
             }
             
+            this->removeChildComponent(component);
             this->eventComponents.removeObject(component, true);
-            
-            if (this->eventComponents.size() > 0)
-            {
-                this->leadingConnector->retargetAndUpdate(nullptr, this->eventComponents[0]);
-            }
+            this->updateEventComponents();
         }
     }
 }
@@ -433,6 +463,40 @@ void AutomationTrackMap::onProjectBeatRangeChanged(float firstBeat, float lastBe
 }
 
 
+//===----------------------------------------------------------------------===//
+// AsyncUpdater
+//===----------------------------------------------------------------------===//
+
+void AutomationTrackMap::handleAsyncUpdate()
+{
+    if (this->dirtyStartBeat > this->dirtyEndBeat || this->numColumns <= 0)
+    { return; }
+
+    const float startBeat = jmax(this->dirtyStartBeat, this->rollFirstBeat);
+    const float endBeat = jmin(this->dirtyEndBeat, this->rollLastBeat);
+
+    this->dirtyStartBeat = FLT_MAX;
+    this->dirtyEndBeat = -FLT_MAX;
+
+    if (startBeat > endBeat)
+    { return; }
+
+    const int startColumn = jmax(0, int(floorf(this->getColumnForBeat(startBeat))) - 1);
+    const int endColumn = jmin(this->numColumns, int(ceilf(this->getColumnForBeat(endBeat))) + 2);
+
+    if (startColumn < endColumn)
+    {
+        this->updateColumns(startColumn, endColumn);
+
+        const float columnWidth = float(this->getWidth()) / float(this->numColumns);
+        const int margin = int(AUTOMATION_TRACKMAP_POINT_DIAMETER) + 1;
+        const int repaintX = int(floorf(startColumn * columnWidth)) - margin;
+        const int repaintWidth = int(ceilf((endColumn - startColumn) * columnWidth)) + margin * 2;
+        this->repaint(repaintX, 0, repaintWidth, this->getHeight());
+    }
+}
+
+
 //===----------------------------------------------------------------------===//
 // Private
 //===----------------------------------------------------------------------===//
@@ -440,54 +504,298 @@ void AutomationTrackMap::onProjectBeatRangeChanged(float firstBeat, float lastBe
 void AutomationTrackMap::updateTempoComponent(AutomationEventComponent *component)
 {
     component->setBounds(this->getEventBounds(component));
-    component->updateConnector();
-    component->updateHelper();
+
+    // curve helpers depend on both neighbours' positions
+    for (int i = 0; i < this->eventComponents.size(); ++i)
+    {
+        this->eventComponents.getUnchecked(i)->updateHelper();
+    }
 }
 
 void AutomationTrackMap::reloadTrack()
+{
+    this->clearEventComponents();
+    this->dirtyStartBeat = FLT_MAX;
+    this->dirtyEndBeat = -FLT_MAX;
+    this->updateColumns(0, this->numColumns);
+    this->repaint();
+}
+
+
+//===----------------------------------------------------------------------===//
+// Hovered events
+//===----------------------------------------------------------------------===//
+
+void AutomationTrackMap::updateHoveredEvents(int mouseX)
+{
+    if (this->draggingEvent != nullptr)
+    { return; }
+
+    const MidiLayer *autoLayer = this->layer.get();
+
+    if (autoLayer == nullptr || autoLayer->size() == 0 || this->numColumns <= 0)
+    {
+        this->clearEventComponents();
+        return;
+    }
+
+    const int numEvents = autoLayer->size();
+    const float columnsPerPixel = float(this->numColumns) / float(this->getWidth());
+    const float radius = this->getEventDiameter();
+    const float startBeat = this->getBeatForColumn((mouseX - radius) * columnsPerPixel);
+    const float mouseBeat = this->getBeatForColumn(mouseX * columnsPerPixel);
+    const float endBeat = this->getBeatForColumn((mouseX + radius) * columnsPerPixel);
+
+    // All events within the radius, and the ones that start
+    // and end the curve segments crossing it, so that their helpers can be shown
+    int firstIndex = jmax(0, findEventIndex(*autoLayer, startBeat, true) - 1);
+    int lastIndex = jmin(numEvents - 1, findEventIndex(*autoLayer, endBeat, false));
+
+    if (lastIndex - firstIndex + 1 > AUTOMATION_TRACKMAP_MAX_HOVERED_EVENTS)
+    {
+        const int nearestIndex = jlimit(firstIndex, lastIndex, findEventIndex(*autoLayer, mouseBeat, true));
+        firstIndex = jmax(firstIndex, nearestIndex - AUTOMATION_TRACKMAP_MAX_HOVERED_EVENTS / 2);
+        lastIndex = jmin(lastIndex, firstIndex + AUTOMATION_TRACKMAP_MAX_HOVERED_EVENTS - 1);
+    }
+
+    OwnedArray<AutomationEventComponent> hoveredComponents;
+
+    for (int i = firstIndex; i <= lastIndex; ++i)
+    {
+        const MidiEvent *event = autoLayer->getUnchecked(i);
+
+        if (AutomationEventComponent *existingComponent = this->findEventComponent(*event))
+        {
+            this->eventComponents.removeObject(existingComponent, false);
+            hoveredComponents.add(existingComponent);
+        }
+        else
+        {
+            auto component = new AutomationEventComponent(*this, *static_cast<const AutomationEvent *>(event));
+            this->addAndMakeVisible(component);
+            hoveredComponents.add(component);
+        }
+    }
+
+    this->clearEventComponents();
+    this->eventComponents.swapWith(hoveredComponents);
+    this->updateEventComponents();
+}
+
+void AutomationTrackMap::updateEventComponents()
+{
+    const MidiLayer *autoLayer = this->layer.get();
+
+    if (autoLayer == nullptr || this->eventComponents.size() == 0)
+    { return; }
+
+    this->eventComponents.sort(*this->eventComponents.getFirst());
+
+    for (int i = 0; i < this->eventComponents.size(); ++i)
+    {
+        AutomationEventComponent *const component = this->eventComponents.getUnchecked(i);
+        component->setBounds(this->getEventBounds(component));
+        component->toFront(false);
+    }
+
+    for (int i = 0; i < this->eventComponents.size(); ++i)
+    {
+        AutomationEventComponent *const component = this->eventComponents.getUnchecked(i);
+        AutomationEventComponent *nextComponent = this->eventComponents[i + 1];
+
+        // a curve helper only makes sense between the adjacent events
+        if (nextComponent != nullptr &&
+            autoLayer->indexOfSorted(&nextComponent->event) != autoLayer->indexOfSorted(&component->event) + 1)
+        {
+            nextComponent = nullptr;
+        }
+
+        component->setNextNeighbour(nextComponent);
+    }
+}
+
+void AutomationTrackMap::clearEventComponents()
 {
     for (int i = 0; i < this->eventComponents.size(); ++i)
     {
         this->removeChildComponent(this->eventComponents.getUnchecked(i));
     }
-    
+
     this->eventComponents.clear();
-    this->eventsHash.clear();
-    
-    this->setVisible(false);
-    
-    for (int j = 0; j < this->layer->size(); ++j)
+    this->draggingEvent = nullptr;
+}
+
+AutomationEventComponent *AutomationTrackMap::findEventComponent(const MidiEvent &event) const
+{
+    for (int i = 0; i < this->eventComponents.size(); ++i)
     {
-        MidiEvent *event = this->layer->getUnchecked(j);
-        
-        if (AutomationEvent *autoEvent = dynamic_cast<AutomationEvent *>(event))
+        AutomationEventComponent *const component = this->eventComponents.getUnchecked(i);
+
+        if (&component->event == &event)
         {
-            auto component = new AutomationEventComponent(*this, *autoEvent);
-            this->addAndMakeVisible(component);
-            
-            // update links and connectors
-            const int indexOfSorted = this->eventComponents.addSorted(*component, component);
-            AutomationEventComponent *previousEventComponent(this->getPreviousEventComponent(indexOfSorted));
-            AutomationEventComponent *nextEventComponent(this->getNextEventComponent(indexOfSorted));
-            
-            component->setNextNeighbour(nextEventComponent);
-            //this->updateTempoComponent(component);
-            component->toFront(true);
-            
-            if (previousEventComponent)
-            {
-                previousEventComponent->setNextNeighbour(component);
-            }
-            
-            this->eventsHash.set(*autoEvent, component);
+            return component;
         }
     }
-    
-    if (this->eventComponents.size() > 0)
+
+    return nullptr;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Decimated curve
+//===----------------------------------------------------------------------===//
+
+// Column positions have x in columns and y normalized to [0, 1], upside down;
+// the curve is affine invariant, so that the height does not matter
+
+void AutomationTrackMap::invalidateAroundBeat(float beat)
+{
+    const MidiLayer *autoLayer = this->layer.get();
+
+    if (autoLayer == nullptr)
+    { return; }
+
+    // the curve changes between the neighbours, or up to the edges
+    const int previousIndex = findEventIndex(*autoLayer, beat, true) - 1;
+    const int nextIndex = findEventIndex(*autoLayer, beat, false);
+
+    const float startBeat = (previousIndex >= 0) ?
+        autoLayer->getUnchecked(previousIndex)->getBeat() : -FLT_MAX;
+
+    const float endBeat = (nextIndex < autoLayer->size()) ?
+        autoLayer->getUnchecked(nextIndex)->getBeat() : FLT_MAX;
+
+    this->dirtyStartBeat = jmin(this->dirtyStartBeat, startBeat);
+    this->dirtyEndBeat = jmax(this->dirtyEndBeat, endBeat);
+    this->triggerAsyncUpdate();
+}
+
+void AutomationTrackMap::updateColumns(int startColumn, int endColumn)
+{
+    startColumn = jmax(0, startColumn);
+    endColumn = jmin(this->numColumns, endColumn);
+
+    if (startColumn >= endColumn)
+    { return; }
+
+    for (int i = startColumn; i < endColumn; ++i)
     {
-        this->leadingConnector->retargetAndUpdate(nullptr, this->eventComponents[0]);
+        this->columns[i].minY = FLT_MAX;
+        this->columns[i].maxY = -FLT_MAX;
     }
-    
-    this->resized();
-    this->setVisible(true);
+
+    const MidiLayer *autoLayer = this->layer.get();
+
+    if (autoLayer == nullptr || autoLayer->size() == 0)
+    { return; }
+
+    const int numEvents = autoLayer->size();
+
+    // the leading line, from the left edge to the first event
+    const Point<float> firstPosition(this->getColumnPosition(*autoLayer->getUnchecked(0)));
+    this->addCurveLine(firstPosition.withX(jmin(0.f, firstPosition.x)), firstPosition, startColumn, endColumn);
+
+    const float startBeat = this->getBeatForColumn(float(startColumn));
+    const float endBeat = this->getBeatForColumn(float(endColumn));
+
+    for (int i = jmax(0, findEventIndex(*autoLayer, startBeat, true) - 1); i < numEvents; ++i)
+    {
+        const AutomationEvent *event = static_cast<const AutomationEvent *>(autoLayer->getUnchecked(i));
+
+        if (event->getBeat() > endBeat)
+        { break; }
+
+        const Point<float> position(this->getColumnPosition(*event));
+
+        if (i + 1 < numEvents)
+        {
+            const Point<float> nextPosition(this->getColumnPosition(*autoLayer->getUnchecked(i + 1)));
+            this->addCurveSegment(position, nextPosition, event->getCurvature(), startColumn, endColumn);
+        }
+        else
+        {
+            // the trailing line, from the last event to the right edge
+            const float rightEdge = jmax(float(this->numColumns), position.x);
+            this->addCurveLine(position, position.withX(rightEdge), startColumn, endColumn);
+        }
+    }
+}
+
+void AutomationTrackMap::addCurveSegment(Point<float> p1, Point<float> p2, float curvature,
+                                         int startColumn, int endColumn)
+{
+    if (p2.x < float(startColumn) || p1.x > float(endColumn))
+    { return; }
+
+    const float segmentWidth = (p2.x - p1.x);
+
+    // dense events are just connected with lines
+    if (segmentWidth < 2.f || p1.y == p2.y)
+    {
+        this->addCurveLine(p1, p2, startColumn, endColumn);
+        return;
+    }
+
+    // x grows monotonically along the curve, so it is approximated with a polyline
+    const int numSteps = jlimit(2, AUTOMATION_TRACKMAP_MAX_SEGMENT_STEPS, int(segmentWidth));
+    Point<float> previous(p1);
+
+    for (int step = 1; step <= numSteps; ++step)
+    {
+        const Point<float> next((step == numSteps) ? p2 :
+            getCurvePoint(p1, p2, curvature, float(step) / float(numSteps)));
+
+        this->addCurveLine(previous, next, startColumn, endColumn);
+        previous = next;
+    }
+}
+
+void AutomationTrackMap::addCurveLine(Point<float> p1, Point<float> p2, int startColumn, int endColumn)
+{
+    const int firstColumn = jmax(startColumn, int(floorf(p1.x)));
+    const int lastColumn = jmin(endColumn - 1, int(floorf(p2.x)));
+    const float dx = (p2.x - p1.x);
+    const float dy = (p2.y - p1.y);
+
+    for (int i = firstColumn; i <= lastColumn; ++i)
+    {
+        // the part of the line within this column
+        float y1 = p1.y;
+        float y2 = p2.y;
+
+        if (dx > 0.f)
+        {
+            y1 = p1.y + dy * jlimit(0.f, 1.f, (float(i) - p1.x) / dx);
+            y2 = p1.y + dy * jlimit(0.f, 1.f, (float(i + 1) - p1.x) / dx);
+        }
+
+        CurveColumn &column = this->columns[i];
+        column.minY = jmin(column.minY, y1, y2);
+        column.maxY = jmax(column.maxY, y1, y2);
+    }
+}
+
+Point<float> AutomationTrackMap::getColumnPosition(const MidiEvent &event) const noexcept
+{
+    const AutomationEvent &autoEvent = static_cast<const AutomationEvent &>(event);
+    return Point<float>(this->getColumnForBeat(autoEvent.getBeat()), 1.f - autoEvent.getControllerValue());
+}
+
+float AutomationTrackMap::getColumnForBeat(float beat) const noexcept
+{
+    const float rollLengthInBeats = (this->rollLastBeat - this->rollFirstBeat);
+
+    if (rollLengthInBeats <= 0.f)
+    { return 0.f; }
+
+    return (beat - this->rollFirstBeat) * float(this->numColumns) / rollLengthInBeats;
+}
+
+float AutomationTrackMap::getBeatForColumn(float column) const noexcept
+{
+    if (this->numColumns <= 0)
+    { return this->rollFirstBeat; }
+
+    const float rollLengthInBeats = (this->rollLastBeat - this->rollFirstBeat);
+    return this->rollFirstBeat + column * rollLengthInBeats / float(this->numColumns);
 }
@@ -24,7 +24,6 @@ class MidiRoll;
 class ProjectTreeItem;
 class AutomationCurveHelper;
 class AutomationEventComponent;
-class ComponentConnectorCurve;
 
 
 class AutomationTrackMapCommon : public Component, public ProjectListener
@@ -35,7 +34,16 @@ public:
 };
 
 
-class AutomationTrackMap : public AutomationTrackMapCommon
+// A single component automation lane.
+//
+// The curve is decimated into a min/max range of y per column, one column per pixel
+// (or less, for really wide maps), so that painting does not depend on events count.
+// The columns are recomputed on resize, when the zoom level changes,
+// and edits only recompute the columns between the changed event's neighbours.
+//
+// Interactive components are only kept for a handful of events around the mouse cursor.
+
+class AutomationTrackMap : public AutomationTrackMapCommon, private AsyncUpdater
 {
 public:
     
@@ -47,11 +55,18 @@ public:
 
     void reloadTrack() override;
 
+    // The curve between two points, as drawn both by the lane and by curve helpers:
+    // a cubic with both control points in the same spot, set by the curvature
+    static Point<float> getCurvePoint(Point<float> p1, Point<float> p2, float curvature, float t) noexcept;
     
     //===------------------------------------------------------------------===//
     // Component
     //===------------------------------------------------------------------===//
     
+    void mouseMove(const MouseEvent &e) override;
+
+    void mouseExit(const MouseEvent &e) override;
+
     void mouseDown(const MouseEvent &e) override;
 
     void mouseDrag(const MouseEvent &e) override;
@@ -60,6 +75,8 @@ public:
     
     void resized() override;
 
+    void paint(Graphics &g) override;
+
     void mouseWheelMove(const MouseEvent &event, const MouseWheelDetails &wheel) override;
     
     
@@ -93,15 +110,42 @@ protected:
     float getHelperDiameter() const;
     int getAvailableHeight() const;
     
-    AutomationEventComponent *getPreviousEventComponent(int indexOfSorted) const;
-    AutomationEventComponent *getNextEventComponent(int indexOfSorted) const;
-    
     friend class AutomationEventComponent;
     
 private:
     
+    void handleAsyncUpdate() override;
+
     void updateTempoComponent(AutomationEventComponent *);
-    
+
+    //===------------------------------------------------------------------===//
+    // Hovered events
+    //===------------------------------------------------------------------===//
+
+    void updateHoveredEvents(int mouseX);
+    void updateEventComponents();
+    void clearEventComponents();
+    AutomationEventComponent *findEventComponent(const MidiEvent &event) const;
+
+    //===------------------------------------------------------------------===//
+    // Decimated curve
+    //===------------------------------------------------------------------===//
+
+    struct CurveColumn
+    {
+        float minY;
+        float maxY;
+    };
+
+    void invalidateAroundBeat(float beat);
+    void updateColumns(int startColumn, int endColumn);
+    void addCurveSegment(Point<float> p1, Point<float> p2, float curvature, int startColumn, int endColumn);
+    void addCurveLine(Point<float> p1, Point<float> p2, int startColumn, int endColumn);
+
+    Point<float> getColumnPosition(const MidiEvent &event) const noexcept;
+    float getColumnForBeat(float beat) const noexcept;
+    float getBeatForColumn(float column) const noexcept;
+
     float projectFirstBeat;
     float projectLastBeat;
     
@@ -113,10 +157,15 @@ private:
 
     WeakReference<MidiLayer> layer;
     
-    ScopedPointer<ComponentConnectorCurve> leadingConnector;
+    HeapBlock<CurveColumn> columns;
+    int numColumns;
+
+    float dirtyStartBeat;
+    float dirtyEndBeat;
 
+    // Sorted by beat, a contiguous range of the layer's events around the cursor,
+    // and sometimes the event being dragged
     OwnedArray<AutomationEventComponent> eventComponents;
-    HashMap<AutomationEvent, AutomationEventComponent *, AutomationEventHashFunction> eventsHash;
     
     AutomationEventComponent *draggingEvent;
     bool addNewEventMode;
@@ -0,0 +1,125 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "MidiRollBackgroundTiles.h"
+#include "MidiRoll.h"
+#include "MemoryAccounting.h"
+
+MidiRollBackgroundTiles::MidiRollBackgroundTiles(MidiRoll &parentRoll) :
+    roll(parentRoll),
+    tilesScale(1.f),
+    tilesSize(0)
+{
+}
+
+MidiRollBackgroundTiles::~MidiRollBackgroundTiles()
+{
+    this->clearTiles();
+}
+
+void MidiRollBackgroundTiles::invalidate()
+{
+    this->clearTiles();
+}
+
+int MidiRollBackgroundTiles::getNumTiles() const noexcept
+{
+    return this->tiles.size();
+}
+
+int MidiRollBackgroundTiles::paint(Graphics &g, const Rectangle<int> &area)
+{
+    // render the tiles in physical pixels, so that they look sharp on retina displays
+    const float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+
+    if (scale != this->tilesScale)
+    {
+        this->clearTiles();
+        this->tilesScale = scale;
+    }
+
+    const int tileSize = MIDIROLL_BACKGROUND_TILE_SIZE;
+    const int firstColumn = jmax(0, area.getX() / tileSize);
+    const int lastColumn = jmax(0, (area.getRight() - 1) / tileSize);
+    const int firstRow = jmax(0, area.getY() / tileSize);
+    const int lastRow = jmax(0, (area.getBottom() - 1) / tileSize);
+
+    // the roll can be huge, so only keep as much tiles as several screens need
+    const int numTilesToPaint = (lastColumn - firstColumn + 1) * (lastRow - firstRow + 1);
+
+    if (this->tiles.size() + numTilesToPaint > MIDIROLL_BACKGROUND_MAX_TILES)
+    {
+        this->clearTiles();
+    }
+
+    int numTilesRendered = 0;
+
+    for (int row = firstRow; row <= lastRow; ++row)
+    {
+        for (int column = firstColumn; column <= lastColumn; ++column)
+        {
+            const int64 key = MidiRollBackgroundTiles::getTileKey(column, row);
+            Image tile(this->tiles[key]);
+
+            if (! tile.isValid())
+            {
+                tile = this->renderTile(column, row, scale);
+                this->tiles.set(key, tile);
+
+                const int64 tileBytes = int64(tile.getWidth()) * tile.getHeight() * 4;
+                MemoryAccounting::add(MemoryAccounting::caches, tileBytes);
+                this->tilesSize += tileBytes;
+                ++numTilesRendered;
+            }
+
+            g.drawImage(tile,
+                        column * tileSize, row * tileSize, tileSize, tileSize,
+                        0, 0, tile.getWidth(), tile.getHeight());
+        }
+    }
+
+    return numTilesRendered;
+}
+
+Image MidiRollBackgroundTiles::renderTile(int column, int row, float scale) const
+{
+    const int tileSize = MIDIROLL_BACKGROUND_TILE_SIZE;
+    const int tileImageSize = roundToInt(tileSize * scale);
+    const Rectangle<int> tileArea(column * tileSize, row * tileSize, tileSize, tileSize);
+
+    Image tile(Image::ARGB, tileImageSize, tileImageSize, true);
+    Graphics g(tile);
+    g.addTransform(AffineTransform::translation(float(-tileArea.getX()), float(-tileArea.getY())).scaled(scale));
+    g.reduceClipRegion(tileArea);
+
+    this->roll.paintBackground(g, tileArea);
+
+    return tile;
+}
+
+int64 MidiRollBackgroundTiles::getTileKey(int column, int row) noexcept
+{
+    return (int64(column) << 32) | int64(uint32(row));
+}
+
+void MidiRollBackgroundTiles::clearTiles()
+{
+    this->tiles.clear();
+    MemoryAccounting::remove(MemoryAccounting::caches, this->tilesSize);
+    this->tilesSize = 0;
+}
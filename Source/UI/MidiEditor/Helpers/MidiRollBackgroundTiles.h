@@ -0,0 +1,66 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class MidiRoll;
+
+#define MIDIROLL_BACKGROUND_TILE_SIZE 256
+#define MIDIROLL_BACKGROUND_MAX_TILES 96
+
+// A cache of the roll's static background layers (key rows, bar, beat and snap lines,
+// time signature changes), rendered by MidiRoll::paintBackground into fixed-size tiles
+// aligned to the roll's coordinates. Painting only composites the tiles under the clip,
+// so that small repaints, like the ones caused by the moving playhead,
+// don't redraw the whole grid.
+//
+// The roll drops the tiles whenever anything they depend on changes,
+// i.e. zooming, row height, bar range, time signatures or colours.
+
+class MidiRollBackgroundTiles
+{
+public:
+
+    explicit MidiRollBackgroundTiles(MidiRoll &parentRoll);
+    ~MidiRollBackgroundTiles();
+
+    void invalidate();
+
+    // Returns the number of tiles which had to be rendered
+    int paint(Graphics &g, const Rectangle<int> &area);
+
+    int getNumTiles() const noexcept;
+
+private:
+
+    Image renderTile(int column, int row, float scale) const;
+
+    static int64 getTileKey(int column, int row) noexcept;
+
+    void clearTiles();
+
+    MidiRoll &roll;
+
+    HashMap<int64, Image> tiles;
+    float tilesScale;
+
+    // pixel data of all tiles, as reported to MemoryAccounting
+    int64 tilesSize;
+
+    JUCE_DECLARE_NON_COPYABLE(MidiRollBackgroundTiles);
+
+};
@@ -21,6 +21,7 @@ class MidiEvent;
 class MidiLayer;
 class Transport;
 class ProjectTreeItem;
+class MidiEventsChangeSet;
 
 // duplicates methods from ProjectListener :(
 class MidiLayerOwner
@@ -45,6 +46,8 @@ public:
 
     virtual void onEventRemovedPostAction(const MidiLayer *layer) {}
 
+    virtual void onEventsChanged(const MidiEventsChangeSet &changes) {}
+
     virtual void onLayerChanged(const MidiLayer *layer) = 0;
 
     virtual void onBeatRangeChanged() = 0;
@@ -22,6 +22,7 @@
 #include "MidiEvent.h"
 #include "MidiEventComponent.h"
 #include "MidiLayer.h"
+#include "PianoLayer.h"
 #include "MidiEventComponentLasso.h"
 #include "ProjectTreeItem.h"
 #include "TriggersTrackMap.h"
@@ -32,6 +33,7 @@
 #include "WipeSpaceHelper.h"
 #include "InsertSpaceHelper.h"
 #include "TimelineWarningMarker.h"
+#include "MidiRollBackgroundTiles.h"
 
 #include "InternalClipboard.h"
 #include "SerializationKeys.h"
@@ -106,11 +108,21 @@ MidiRoll::MidiRoll(ProjectTreeItem &parentProject,
     timeEnteredDragMode(0),
     transportLastCorrectPosition(0.0),
     transportIndicatorOffset(0.0),
-    shouldFollowIndicator(false)
+    shouldFollowIndicator(false),
+    backgroundLayoutHash(0)
 {
     this->setOpaque(true);
     this->setBufferedToImage(false);
 
+    this->backgroundTiles = new MidiRollBackgroundTiles(*this);
+
+#if MIDIROLL_SHOWS_FRAME_STATS
+    this->frameStartTicks = 0;
+    this->numFrames = 0;
+    this->numTilesRendered = 0;
+    zeromem(this->frameTimes, sizeof(this->frameTimes));
+#endif
+
     this->setSize(this->viewport.getWidth(), this->viewport.getHeight());
 
     this->setWantsKeyboardFocus(true);
@@ -690,24 +702,40 @@ float MidiRoll::getSnapWidth() const
 
 void MidiRoll::computeVisibleBeatLines()
 {
-    this->visibleBars.clearQuick();
-    this->visibleBeats.clearQuick();
-    this->visibleSnaps.clearQuick();
+    const float viewPosX = float(this->viewport.getViewPositionX());
+    const float viewEndX = viewPosX + float(this->viewport.getViewWidth());
+    this->computeBeatLines(viewPosX, viewEndX, this->visibleBars, this->visibleBeats, this->visibleSnaps);
+}
+
+void MidiRoll::computeBeatLines(float startX, float endX,
+                                Array<float> &bars, Array<float> &beats, Array<float> &snaps) const
+{
+    bars.clearQuick();
+    beats.clearQuick();
+    snaps.clearQuick();
 
     const auto tsLayer = this->project.getTimeline()->getTimeSignatures();
     
     const float zeroCanvasOffset = this->getFirstBar() * this->barWidth;
     
-    const float viewPosX = this->viewport.getViewPositionX();
-    const float paintStartX = viewPosX + zeroCanvasOffset;
-    const float paintEndX = float(viewPosX + this->viewport.getViewWidth()) + zeroCanvasOffset;
+    const float paintStartX = startX + zeroCanvasOffset;
+    const float paintEndX = endX + zeroCanvasOffset;
     
     const int paintStartBar = int(paintStartX / this->barWidth) - 1;
     const int paintEndBar = int(paintEndX / this->barWidth) + 1;
+
+    // Lines are 1px wide, and bar lines have a bevel next to them,
+    // so the ones just before the range start still need to be painted
+    const float rangeStartX = startX - 2.f;
+    const float rangeEndX = endX + 1.f;
     
     int numerator = TIME_SIGNATURE_DEFAULT_NUMERATOR;
     int denominator = TIME_SIGNATURE_DEFAULT_DENOMINATOR;
-    float i = float(paintStartBar);
+
+    // Always start from the canvas beginning or from a time signature change,
+    // so that the lines skipped when zoomed out are the same for any range,
+    // and the background tiles fit each other
+    float i = float(this->getFirstBar() - 1);
 
     int nextSignatureIdx = 0;
 
@@ -738,10 +766,13 @@ void MidiRoll::computeVisibleBeatLines()
         const float stepWidth = this->barWidth * barStep;
         barWidthSum += stepWidth;
 
-        if (barWidthSum > MIN_BAR_WIDTH &&
-            barStartX >= viewPosX)
+        if (barWidthSum > MIN_BAR_WIDTH)
         {
-            visibleBars.add(barStartX);
+            if (barStartX >= rangeStartX && barStartX < rangeEndX)
+            {
+                bars.add(barStartX);
+            }
+
             barWidthSum = 0;
         }
         
@@ -774,19 +805,29 @@ void MidiRoll::computeVisibleBeatLines()
                     lastFrame = true;
                 }
             }
+
+            // Skip the beats out of range
+            if (nextBeatStartX < rangeStartX || beatStartX >= rangeEndX)
+            {
+                continue;
+            }
             
             // Get snap lines and beat lines
             for (float k = beatStartX + this->snapWidth;
                  k < (nextBeatStartX - 1);
                  k += this->snapWidth)
             {
-                visibleSnaps.add(k);
+                if (k >= rangeStartX && k < rangeEndX)
+                {
+                    snaps.add(k);
+                }
             }
             
             if (j >= beatStep && // Don't draw the first one as it is a barline
-                (nextBeatStartX - beatStartX) > MIN_BEAT_WIDTH)
+                (nextBeatStartX - beatStartX) > MIN_BEAT_WIDTH &&
+                beatStartX >= rangeStartX)
             {
-                visibleBeats.add(beatStartX);
+                beats.add(beatStartX);
             }
         }
         
@@ -936,6 +977,7 @@ void MidiRoll::onEventChanged(const MidiEvent &oldEvent, const MidiEvent &newEve
     // Time signatures have changed, need to repaint
     if (dynamic_cast<const TimeSignatureEvent *>(&oldEvent))
     {
+        this->invalidateBackground();
         this->updateChildrenBounds();
 		this->repaint();
     }
@@ -945,6 +987,7 @@ void MidiRoll::onEventAdded(const MidiEvent &event)
 {
     if (dynamic_cast<const TimeSignatureEvent *>(&event))
     {
+        this->invalidateBackground();
         this->updateChildrenBounds();
 		this->repaint();
 	}
@@ -954,11 +997,22 @@ void MidiRoll::onEventRemoved(const MidiEvent &event)
 {
     if (dynamic_cast<const TimeSignatureEvent *>(&event))
     {
+        this->invalidateBackground();
         this->updateChildrenBounds();
 		this->repaint();
 	}
 }
 
+void MidiRoll::onEventsChanged(const MidiEventsChangeSet &changes)
+{
+    if (dynamic_cast<const TimeSignaturesLayer *>(changes.getLayer()))
+    {
+        this->invalidateBackground();
+        this->updateChildrenBounds();
+        this->repaint();
+    }
+}
+
 void MidiRoll::onProjectBeatRangeChanged(float firstBeat, float lastBeat)
 {
     //Logger::writeToLog("MidiRoll::onProjectBeatRangeChanged " + String(firstBeat) + " " + String(lastBeat));
@@ -1188,6 +1242,23 @@ bool MidiRoll::keyPressed(const KeyPress &key)
 
         return true;
     }
+    else if (key == KeyPress::createFromDescription("shift + return"))
+    {
+        Transport &transport = this->project.getTransport();
+
+        if (transport.isRecording())
+        {
+            transport.stopPlayback();
+            this->stopFollowingIndicator();
+        }
+        else if (PianoLayer *pianoLayer = dynamic_cast<PianoLayer *>(this->getPrimaryActiveMidiLayer()))
+        {
+            transport.startRecording(pianoLayer);
+            this->startFollowingIndicator();
+        }
+
+        return true;
+    }
 
     return false;
 }
@@ -1396,40 +1467,130 @@ void MidiRoll::resized()
 }
 
 void MidiRoll::paint(Graphics &g)
+{
+#if MIDIROLL_SHOWS_FRAME_STATS
+    this->frameStartTicks = Time::getHighResolutionTicks();
+#endif
+
+    const int64 layoutHash = this->getBackgroundLayoutHash();
+
+    if (layoutHash != this->backgroundLayoutHash)
+    {
+        this->backgroundLayoutHash = layoutHash;
+        this->invalidateBackground();
+    }
+
+    // the header and the editor use the visible lines too
+    const Rectangle<int> viewArea(this->viewport.getViewArea());
+
+    if (viewArea != this->visibleBeatLinesArea)
+    {
+        this->visibleBeatLinesArea = viewArea;
+        this->computeVisibleBeatLines();
+    }
+
+    const int numRendered = this->backgroundTiles->paint(g, g.getClipBounds());
+
+#if MIDIROLL_SHOWS_FRAME_STATS
+    this->numTilesRendered = numRendered;
+#else
+    ignoreUnused(numRendered);
+#endif
+}
+
+void MidiRoll::paintBackground(Graphics &g, const Rectangle<int> &area)
 {
     const Colour barLine = findColour(MidiRoll::barLineColourId);
     const Colour barLineBevel = findColour(MidiRoll::barLineBevelColourId);
     const Colour beatLine = findColour(MidiRoll::beatLineColourId);
     const Colour snapLine = findColour(MidiRoll::snapLineColourId);
     
-    this->computeVisibleBeatLines();
+    this->computeBeatLines(float(area.getX()), float(area.getRight()),
+                           this->tileBars, this->tileBeats, this->tileSnaps);
 
-    const float paintStartY = float(this->viewport.getViewPositionY());
-    const float paintEndY = paintStartY + this->viewport.getViewHeight();
+    const float paintStartY = float(area.getY());
+    const float paintEndY = float(area.getBottom());
 
     g.setColour(barLine);
-    for (const auto f : this->visibleBars)
+    for (const auto f : this->tileBars)
     {
-        g.drawVerticalLine(f, paintStartY, paintEndY);
+        g.drawVerticalLine(int(f), paintStartY, paintEndY);
     }
 
     g.setColour(barLineBevel);
-    for (const auto f : this->visibleBars)
+    for (const auto f : this->tileBars)
     {
-        g.drawVerticalLine(f + 1, paintStartY, paintEndY);
+        g.drawVerticalLine(int(f + 1), paintStartY, paintEndY);
     }
 
     g.setColour(beatLine);
-    for (const auto f : this->visibleBeats)
+    for (const auto f : this->tileBeats)
     {
-        g.drawVerticalLine(f, paintStartY, paintEndY);
+        g.drawVerticalLine(int(f), paintStartY, paintEndY);
     }
     
     g.setColour(snapLine);
-    for (const auto f : this->visibleSnaps)
+    for (const auto f : this->tileSnaps)
+    {
+        g.drawVerticalLine(int(f), paintStartY, paintEndY);
+    }
+}
+
+#if MIDIROLL_SHOWS_FRAME_STATS
+void MidiRoll::paintOverChildren(Graphics &g)
+{
+    const double frameTime =
+        Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - this->frameStartTicks) * 1000.0;
+
+    this->frameTimes[this->numFrames % MIDIROLL_FRAME_STATS_SIZE] = frameTime;
+    this->numFrames++;
+
+    const int numStats = jmin(this->numFrames, MIDIROLL_FRAME_STATS_SIZE);
+    double sum = 0.0;
+    double max = 0.0;
+
+    for (int i = 0; i < numStats; ++i)
     {
-        g.drawVerticalLine(f, paintStartY, paintEndY);
+        sum += this->frameTimes[i];
+        max = jmax(max, this->frameTimes[i]);
     }
+
+    const String stats =
+        "paint: " + String(frameTime, 2) +
+        " ms, avg: " + String(sum / numStats, 2) +
+        " ms, max: " + String(max, 2) +
+        " ms, tiles: " + String(this->numTilesRendered) +
+        " rendered, " + String(this->backgroundTiles->getNumTiles()) + " cached";
+
+    const Rectangle<int> statsArea(this->viewport.getViewPositionX() + 8,
+                                   this->viewport.getViewPositionY() + MIDIROLL_HEADER_HEIGHT + 8,
+                                   400, 16);
+
+    if (g.clipRegionIntersects(statsArea))
+    {
+        g.setColour(Colours::black.withAlpha(0.5f));
+        g.fillRect(statsArea);
+        g.setColour(Colours::white);
+        g.setFont(12.f);
+        g.drawText(stats, statsArea.reduced(4, 0), Justification::centredLeft, false);
+    }
+}
+#endif
+
+int64 MidiRoll::getBackgroundLayoutHash() const
+{
+    int64 hash = int64(roundToInt(this->barWidth * 1000.f));
+    hash = hash * 31 + int64(roundToInt(this->snapWidth * 1000.f));
+    hash = hash * 31 + int64(this->firstBar);
+    hash = hash * 31 + int64(this->findColour(MidiRoll::barLineColourId).getARGB());
+    hash = hash * 31 + int64(this->findColour(MidiRoll::whiteKeyBrightColourId).getARGB());
+    return hash;
+}
+
+void MidiRoll::invalidateBackground()
+{
+    this->backgroundTiles->invalidate();
+    this->visibleBeatLinesArea = Rectangle<int>();
 }
 
 //===----------------------------------------------------------------------===//
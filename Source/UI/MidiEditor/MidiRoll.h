@@ -33,6 +33,7 @@ class MidiRollListener;
 class WipeSpaceHelper;
 class InsertSpaceHelper;
 class TimelineWarningMarker;
+class MidiRollBackgroundTiles;
 
 #include "ComponentFader.h"
 #include "AnnotationsTrackMap.h"
@@ -42,6 +43,7 @@ class TimelineWarningMarker;
 #include "TransportIndicator.h"
 #include "TransportListener.h"
 #include "MidiEventComponent.h"
+#include "MemoryAccounting.h"
 #include "ClipboardOwner.h"
 #include "LongTapListener.h"
 #include "SmoothPanListener.h"
@@ -62,6 +64,15 @@ class TimelineWarningMarker;
 #endif
 
 
+// Shows paint timings over the roll
+#if JUCE_DEBUG
+#   define MIDIROLL_SHOWS_FRAME_STATS 1
+#else
+#   define MIDIROLL_SHOWS_FRAME_STATS 0
+#endif
+
+#define MIDIROLL_FRAME_STATS_SIZE 60
+
 // Track is measured in quarter beats
 #define NUM_BEATS_IN_BAR 4
 
@@ -280,6 +291,7 @@ public:
     void onEventChanged(const MidiEvent &oldEvent, const MidiEvent &newEvent) override;
     void onEventAdded(const MidiEvent &event) override;
     void onEventRemoved(const MidiEvent &event) override;
+    void onEventsChanged(const MidiEventsChangeSet &changes) override;
     void onProjectBeatRangeChanged(float firstBeat, float lastBeat) override;
 
     //===------------------------------------------------------------------===//
@@ -305,6 +317,14 @@ public:
     void resized() override;
     void paint(Graphics &g) override;
 
+#if MIDIROLL_SHOWS_FRAME_STATS
+    void paintOverChildren(Graphics &g) override;
+#endif
+
+    // Paints the static layers of the background (i.e. everything but the child components)
+    // within the given area; used to render the background tiles, see MidiRollBackgroundTiles
+    virtual void paintBackground(Graphics &g, const Rectangle<int> &area);
+
 protected:
     
     ListenerList<MidiRollListener> listeners;
@@ -465,6 +485,31 @@ protected:
     Array<float> visibleSnaps;
 
     void computeVisibleBeatLines();
+    void computeBeatLines(float startX, float endX,
+                          Array<float> &bars, Array<float> &beats, Array<float> &snaps) const;
+
+    Rectangle<int> visibleBeatLinesArea;
+
+protected:
+
+    // Anything the background tiles depend on, except for the time signatures,
+    // which have to be tracked explicitly with invalidateBackground()
+    virtual int64 getBackgroundLayoutHash() const;
+    void invalidateBackground();
+
+    ScopedPointer<MidiRollBackgroundTiles> backgroundTiles;
+    int64 backgroundLayoutHash;
+
+    Array<float> tileBars;
+    Array<float> tileBeats;
+    Array<float> tileSnaps;
+
+#if MIDIROLL_SHOWS_FRAME_STATS
+    int64 frameStartTicks;
+    double frameTimes[MIDIROLL_FRAME_STATS_SIZE];
+    int numFrames;
+    int numTilesRendered;
+#endif
 
 protected:
 
@@ -479,4 +524,8 @@ protected:
     
     void changeListenerCallback(ChangeBroadcaster *source) override;
 
+private:
+
+    MEMORY_ACCOUNTED(MidiRoll, components);
+
 };
@@ -21,6 +21,7 @@ class PianoRoll;
 
 #include "MidiEventComponent.h"
 #include "Note.h"
+#include "MemoryAccounting.h"
 
 class NoteComponent : public MidiEventComponent
 {
@@ -132,6 +133,7 @@ protected:
     bool shouldGoQuickSelectLayerMode(const ModifierKeys &modifiers) const;
     void setQuickSelectLayerMode(bool value);
     
+    MEMORY_ACCOUNTED(NoteComponent, components);
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NoteComponent)
     
 };
@@ -23,6 +23,7 @@
 #include "PianoLayer.h"
 #include "AutomationLayer.h"
 #include "AnnotationsLayer.h"
+#include "TimeSignaturesLayer.h"
 #include "PianoLayerTreeItem.h"
 #include "AutomationLayerTreeItem.h"
 #include "ProjectTreeItem.h"
@@ -39,6 +40,7 @@
 #include "SerializationKeys.h"
 #include "Icons.h"
 #include "InternalClipboard.h"
+#include "ClipboardPayload.h"
 #include "HelioCallout.h"
 #include "NotesTuningPanel.h"
 #include "ArpeggiatorPanel.h"
@@ -515,8 +517,81 @@ void PianoRoll::onEventRemoved(const MidiEvent &event)
     }
 }
 
+void PianoRoll::onEventsChanged(const MidiEventsChangeSet &changes)
+{
+    MidiRoll::onEventsChanged(changes);
+
+    if (! dynamic_cast<const PianoLayer *>(changes.getLayer())) { return; }
+
+    // all components to remove are collected first and sorted once,
+    // so that the components list is compacted in a single pass
+    Array<MidiEventComponent *> removedComponents;
+
+    for (int i = 0; i < changes.getNumRemovedEvents(); ++i)
+    {
+        const Note &note = static_cast<const Note &>(changes.getRemovedEvent(i));
+
+        if (NoteComponent *component = this->componentsHashTable[note])
+        {
+            this->fader.fadeOut(component, 150);
+            this->selection.deselect(component);
+            this->removeChildComponent(component);
+            this->componentsHashTable.remove(note);
+            removedComponents.add(component);
+        }
+    }
+
+    if (removedComponents.size() > 0)
+    {
+        DefaultElementComparator<MidiEventComponent *> comparator;
+        removedComponents.sort(comparator);
+
+        int numKept = 0;
+
+        for (int i = 0; i < this->eventComponents.size(); ++i)
+        {
+            if (removedComponents.indexOfSorted(comparator, this->eventComponents.getUnchecked(i)) < 0)
+            {
+                this->eventComponents.swap(i, numKept++);
+            }
+        }
+
+        this->eventComponents.removeRange(numKept, this->eventComponents.size() - numKept, true);
+    }
+
+    for (int i = 0; i < changes.getNumChangedEvents(); ++i)
+    {
+        const Note &note = static_cast<const Note &>(changes.getChangedEventBefore(i));
+        const Note &newNote = static_cast<const Note &>(changes.getChangedEventAfter(i));
+
+        if (NoteComponent *component = this->componentsHashTable[note])
+        {
+            this->batchRepaintList.add(component);
+            this->componentsHashTable.remove(note);
+            this->componentsHashTable.set(newNote, component);
+        }
+    }
+
+    for (int i = 0; i < changes.getNumAddedEvents(); ++i)
+    {
+        this->onEventAdded(changes.getAddedEvent(i));
+    }
+
+    if (changes.getNumChangedEvents() > 0)
+    {
+        this->triggerAsyncUpdate();
+    }
+}
+
 void PianoRoll::onLayerChanged(const MidiLayer *layer)
 {
+    if (dynamic_cast<const TimeSignaturesLayer *>(layer))
+    {
+        this->invalidateBackground();
+        this->repaint();
+        return;
+    }
+
     if (! dynamic_cast<const PianoLayer *>(layer)) { return; }
 
     this->reloadMidiTrack();
@@ -587,9 +662,9 @@ void PianoRoll::findLassoItemsInArea(Array<MidiEventComponent *> &itemsFound, co
 // ClipboardOwner
 //===----------------------------------------------------------------------===//
 
-XmlElement *PianoRoll::clipboardCopy() const
+void PianoRoll::clipboardCopy(MemoryBlock &payload) const
 {
-    auto xml = new XmlElement(Serialization::Clipboard::clipboard);
+    ClipboardPayload::Writer writer;
     
     const MidiEventSelection::MultiLayerMap &selections = this->selection.getMultiLayerSelections();
     MidiEventSelection::MultiLayerMap::Iterator selectionsMapIterator(selections);
@@ -601,18 +676,14 @@ XmlElement *PianoRoll::clipboardCopy() const
     {
         SelectionProxyArray::Ptr layerSelection(selectionsMapIterator.getValue());
         const String layerId = selectionsMapIterator.getKey();
-
-        // create xml parent with layer id
-        auto layerIdParent = new XmlElement(Serialization::Clipboard::layer);
-        layerIdParent->setAttribute(Serialization::Clipboard::layerId, layerId);
-        xml->addChildElement(layerIdParent);
+        writer.beginLayer(layerId, ClipboardPayload::Notes);
 
         for (int i = 0; i < layerSelection->size(); ++i)
         {
             if (const NoteComponent *noteComponent =
                 dynamic_cast<NoteComponent *>(layerSelection->getUnchecked(i)))
             {
-                layerIdParent->addChildElement(noteComponent->getNote().serialize());
+                writer.addNote(noteComponent->getNote());
 
                 if (firstBeat > noteComponent->getBeat())
                 {
@@ -635,9 +706,7 @@ XmlElement *PianoRoll::clipboardCopy() const
     {
         // todo copy from
         const auto timeline = this->project.getTimeline();
-        auto annotationLayerIdParent = new XmlElement(Serialization::Clipboard::layer);
-        annotationLayerIdParent->setAttribute(Serialization::Clipboard::layerId, timeline->getAnnotations()->getLayerIdAsString());
-        xml->addChildElement(annotationLayerIdParent);
+        writer.beginLayer(timeline->getAnnotations()->getLayerIdAsString(), ClipboardPayload::Annotations);
 
         for (int i = 0; i < timeline->getAnnotations()->size(); ++i)
         {
@@ -647,7 +716,7 @@ XmlElement *PianoRoll::clipboardCopy() const
                 if (const bool eventFitsInRange =
                     (event->getBeat() >= firstBeat) && (event->getBeat() < lastBeat))
                 {
-                    annotationLayerIdParent->addChildElement(event->serialize());
+                    writer.addAnnotation(*event);
                 }
             }
         }
@@ -657,9 +726,7 @@ XmlElement *PianoRoll::clipboardCopy() const
         for (auto automation : automations)
         {
             MidiLayer *autoLayer = automation->getLayer();
-            auto autoLayerIdParent = new XmlElement(Serialization::Clipboard::layer);
-            autoLayerIdParent->setAttribute(Serialization::Clipboard::layerId, autoLayer->getLayerIdAsString());
-            xml->addChildElement(autoLayerIdParent);
+            writer.beginLayer(autoLayer->getLayerIdAsString(), ClipboardPayload::AutomationEvents);
             
             for (int j = 0; j < autoLayer->size(); ++j)
             {
@@ -669,87 +736,86 @@ XmlElement *PianoRoll::clipboardCopy() const
                     if (const bool eventFitsInRange =
                         (event->getBeat() >= firstBeat) && (event->getBeat() < lastBeat))
                     {
-                        autoLayerIdParent->addChildElement(event->serialize());
+                        writer.addAutomationEvent(*event);
                     }
                 }
             }
         }
     }
 
-    xml->setAttribute(Serialization::Clipboard::firstBeat, firstBeat);
-    xml->setAttribute(Serialization::Clipboard::lastBeat, lastBeat);
-
-    return xml;
+    writer.writeTo(payload, firstBeat, lastBeat);
 }
 
-void PianoRoll::clipboardPaste(const XmlElement &xml)
+void PianoRoll::clipboardPaste(const MemoryBlock &payload)
 {
-    const XmlElement *mainSlot = (xml.getTagName() == Serialization::Clipboard::clipboard) ?
-                                 &xml : xml.getChildByName(Serialization::Clipboard::clipboard);
+    ClipboardPayload::Reader reader(payload);
 
-    if (mainSlot == nullptr) { return; }
+    if (! reader.isValid()) { return; }
 
-    float trackLength = 0;
     bool didCheckpoint = false;
 
     const float indicatorRoughBeat = this->getBeatByTransportPosition(this->project.getTransport().getSeekPosition());
     const float indicatorBeat = roundf(indicatorRoughBeat * 1000.f) / 1000.f;
 
-    const float firstBeat = mainSlot->getDoubleAttribute(Serialization::Clipboard::firstBeat);
-    const float lastBeat = mainSlot->getDoubleAttribute(Serialization::Clipboard::lastBeat);
-    const bool indicatorIsWithinSelection = (indicatorBeat >= firstBeat) && (indicatorBeat < lastBeat);
+    const float firstBeat = reader.getFirstBeat();
+    const float lastBeat = reader.getLastBeat();
     const float startBeatAligned = roundf(firstBeat);
     const float deltaBeat = (indicatorBeat - startBeatAligned);
 
     this->deselectAll();
 
-    forEachXmlChildElementWithTagName(*mainSlot, layerElement, Serialization::Core::layer)
+    while (reader.nextLayer())
     {
-        Array<Note> pastedNotes;
+        const String layerId = reader.getLayerId();
+        const int numEvents = reader.getNumEvents();
 
-        const String layerId = layerElement->getStringAttribute(Serialization::Clipboard::layerId);
-        
-        // TODO: store layer type in copy-paste info
-        // when pasting, use these priorities:
+        // TODO: when pasting, use these priorities:
         // 1. layer with the same id
         // 2. layer with the same type and controller
         // 3. active layer
         
-        if (nullptr != this->project.getLayerWithId<AutomationLayer>(layerId))
+        if (reader.getEventsType() == ClipboardPayload::AutomationEvents)
         {
             AutomationLayer *targetLayer = this->project.getLayerWithId<AutomationLayer>(layerId);
             const bool correspondingTreeItemExists =
             (this->project.findChildByLayerId<AutomationLayerTreeItem>(layerId) != nullptr);
             
-            if (correspondingTreeItemExists)
+            if (targetLayer != nullptr && correspondingTreeItemExists && numEvents > 0)
             {
                 Array<AutomationEvent> pastedEvents;
+                pastedEvents.ensureStorageAllocated(numEvents);
                 
-                forEachXmlChildElementWithTagName(*layerElement, autoElement, Serialization::Core::event)
+                for (int i = 0; i < numEvents; ++i)
                 {
-                    AutomationEvent &&ae = AutomationEvent(targetLayer).withParameters(*autoElement).copyWithNewId();
-                    pastedEvents.add(ae.withDeltaBeat(deltaBeat));
+                    const AutomationEvent event(reader.readAutomationEvent(targetLayer));
+                    if (! reader.isValid()) { return; }
+                    pastedEvents.add(event.withDeltaBeat(deltaBeat));
                 }
                 
                 targetLayer->insertGroup(pastedEvents, true);
             }
         }
-        else if (nullptr != this->project.getLayerWithId<AnnotationsLayer>(layerId))
+        else if (reader.getEventsType() == ClipboardPayload::Annotations)
         {
             AnnotationsLayer *targetLayer = this->project.getLayerWithId<AnnotationsLayer>(layerId);
             
             // no check for a tree item as there isn't any for ProjectTimeline
-            Array<AnnotationEvent> pastedAnnotations;
-            
-            forEachXmlChildElementWithTagName(*layerElement, annotationElement, Serialization::Core::annotation)
+            if (targetLayer != nullptr && numEvents > 0)
             {
-                AnnotationEvent &&ae = AnnotationEvent(targetLayer).withParameters(*annotationElement).copyWithNewId();
-                pastedAnnotations.add(ae.withDeltaBeat(deltaBeat));
+                Array<AnnotationEvent> pastedAnnotations;
+                pastedAnnotations.ensureStorageAllocated(numEvents);
+                
+                for (int i = 0; i < numEvents; ++i)
+                {
+                    const AnnotationEvent annotation(reader.readAnnotation(targetLayer));
+                    if (! reader.isValid()) { return; }
+                    pastedAnnotations.add(annotation.withDeltaBeat(deltaBeat));
+                }
+                
+                targetLayer->insertGroup(pastedAnnotations, true);
             }
-            
-            targetLayer->insertGroup(pastedAnnotations, true);
         }
-        else
+        else if (reader.getEventsType() == ClipboardPayload::Notes && numEvents > 0)
         {
             PianoLayer *targetLayer = this->project.getLayerWithId<PianoLayer>(layerId);
             PianoLayerTreeItem *targetLayerItem = this->project.findChildByLayerId<PianoLayerTreeItem>(layerId);
@@ -761,35 +827,33 @@ void PianoRoll::clipboardPaste(const XmlElement &xml)
                 targetLayer = static_cast<PianoLayer *>(this->primaryActiveLayer);
             }
             
-            forEachXmlChildElementWithTagName(*layerElement, noteElement, Serialization::Core::note)
+            Array<Note> pastedNotes;
+            pastedNotes.ensureStorageAllocated(numEvents);
+            
+            for (int i = 0; i < numEvents; ++i)
             {
-                Note &&n = Note(targetLayer).withParameters(*noteElement).copyWithNewId();
-                pastedNotes.add(n.withDeltaBeat(deltaBeat));
+                const Note note(reader.readNote(targetLayer));
+                if (! reader.isValid()) { return; }
+                pastedNotes.add(note.withDeltaBeat(deltaBeat));
             }
             
-            if (pastedNotes.size() > 0)
+            if (! didCheckpoint)
             {
-                if (! didCheckpoint)
+                targetLayer->checkpoint();
+                didCheckpoint = true;
+                
+                // also insert space if needed
+                const bool isShiftPressed = Desktop::getInstance().getMainMouseSource().getCurrentModifiers().isShiftDown();
+                if (isShiftPressed)
                 {
-                    targetLayer->checkpoint();
-                    didCheckpoint = true;
-                    
-                    // also insert space if needed
-                    const bool isShiftPressed = Desktop::getInstance().getMainMouseSource().getCurrentModifiers().isShiftDown();
-                    if (isShiftPressed)
-                    {
-                        const float changeDelta = lastBeat - firstBeat;
-                        MidiRollToolbox::shiftEventsToTheRight(this->project.getLayersList(), indicatorBeat, changeDelta, false);
-                    }
+                    const float changeDelta = lastBeat - firstBeat;
+                    MidiRollToolbox::shiftEventsToTheRight(this->project.getLayersList(), indicatorBeat, changeDelta, false);
                 }
-                
-                targetLayer->insertGroup(pastedNotes, true);
             }
+            
+            targetLayer->insertGroup(pastedNotes, true);
         }
-
     }
-
-    return;
 }
 
 
@@ -1132,20 +1196,15 @@ void PianoRoll::resized()
     MIDI_ROLL_BULK_REPAINT_END
 }
 
-void PianoRoll::paint(Graphics &g)
+void PianoRoll::paintBackground(Graphics &g, const Rectangle<int> &area)
 {
 #if PIANOROLL_HAS_PRERENDERED_BACKGROUND
 
-//    Icons::drawImageRetinaAware(PianoRoll::backgroundsCache[this->rowHeight], g,
-//                                this->viewport.getViewPositionX() + this->viewport.getViewWidth() / 2,
-//                                this->viewport.getViewPositionY() + this->viewport.getViewHeight() / 2);
-
     g.setTiledImageFill(*(static_cast<HelioTheme &>(this->getLookAndFeel()).getRollBgCache()[this->rowHeight]), 0, 0, 1.f);
-    g.fillRect(this->viewport.getViewArea());
+    g.fillRect(area);
 
 #else
 
-    // opengl does render pretty smoothly
     const Colour blackKey = this->findColour(MidiRoll::blackKeyColourId);
     const Colour blackKeyBright = this->findColour(MidiRoll::blackKeyBrightColourId);
     const Colour whiteKey = this->findColour(MidiRoll::whiteKeyColourId);
@@ -1153,16 +1212,15 @@ void PianoRoll::paint(Graphics &g)
     const Colour whiteKeyBrighter = whiteKeyBright.brighter(0.025f);
     const Colour rowLine = this->findColour(MidiRoll::rowLineColourId);
 
-    const float visibleWidth = float(this->viewport.getViewWidth());
-    const float visibleHeight = float(this->viewport.getViewHeight());
-    const Point<int> &viewPosition = this->viewport.getViewPosition();
+    const float areaX = float(area.getX());
+    const float areaWidth = float(area.getWidth());
 
-    const int keyStart = int(viewPosition.getY() / this->rowHeight);
-    const int keyEnd = int((viewPosition.getY() + visibleHeight) / this->rowHeight);
+    const int keyStart = int(area.getY() / this->rowHeight);
+    const int keyEnd = int(area.getBottom() / this->rowHeight);
 
     // Fill everything with white keys color
     g.setColour(whiteKeyBright);
-    g.fillRect(float(viewPosition.getX()), float(viewPosition.getY()), visibleWidth, visibleHeight);
+    g.fillRect(area);
 
     for (int i = keyStart; i <= keyEnd; i++)
     {
@@ -1174,34 +1232,35 @@ void PianoRoll::paint(Graphics &g)
 
         switch (noteNumber)
         {
-            //case 0:
-            //    g.setColour(rowLine);
-            //    g.drawHorizontalLine(yPos - 1, float(viewPosition.getX()), float(viewPosition.getX() + visibleWidth));
-            //    break;
             case 1:
             case 3:
             case 6:
             case 8:
             case 10: // black keys
                 g.setColour(octaveIsOdd ? blackKeyBright : blackKey);
-                g.fillRect(float(viewPosition.getX()), float(yPos), visibleWidth, float(this->rowHeight));
+                g.fillRect(areaX, float(yPos), areaWidth, float(this->rowHeight));
                 break;
 
             default: // white keys bevel
                 g.setColour(whiteKeyBrighter);
-                g.drawHorizontalLine(yPos + 1, float(viewPosition.getX()), float(viewPosition.getX() + visibleWidth));
+                g.drawHorizontalLine(yPos + 1, areaX, areaX + areaWidth);
                 break;
         }
 
         g.setColour(rowLine);
-        g.drawHorizontalLine(yPos, float(viewPosition.getX()), float(viewPosition.getX() + visibleWidth));
+        g.drawHorizontalLine(yPos, areaX, areaX + areaWidth);
     }
 
-    HelioTheme::drawNoiseWithin(this->viewport.getViewArea().toFloat(), this, g, 2.0);
+    HelioTheme::drawNoiseWithin(area.toFloat(), this, g, 2.0);
 
 #endif
 
-    MidiRoll::paint(g);
+    MidiRoll::paintBackground(g, area);
+}
+
+int64 PianoRoll::getBackgroundLayoutHash() const
+{
+    return MidiRoll::getBackgroundLayoutHash() * 31 + this->rowHeight;
 }
 
 void PianoRoll::insertNewNoteAt(const MouseEvent &e)
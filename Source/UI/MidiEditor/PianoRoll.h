@@ -135,6 +135,7 @@ public:
     void onEventChanged(const MidiEvent &oldEvent, const MidiEvent &newEvent) override;
     void onEventAdded(const MidiEvent &event) override;
     void onEventRemoved(const MidiEvent &event) override;
+    void onEventsChanged(const MidiEventsChangeSet &changes) override;
     void onLayerChanged(const MidiLayer *layer) override;
     void onLayerAdded(const MidiLayer *layer) override;
     void onLayerRemoved(const MidiLayer *layer) override;
@@ -152,8 +153,8 @@ public:
     // ClipboardOwner
     //===------------------------------------------------------------------===//
 
-    XmlElement *clipboardCopy() const override;
-    void clipboardPaste(const XmlElement &xml) override;
+    void clipboardCopy(MemoryBlock &payload) const override;
+    void clipboardPaste(const MemoryBlock &payload) override;
 
 
     //===------------------------------------------------------------------===//
@@ -167,7 +168,7 @@ public:
     void mouseDrag(const MouseEvent &e) override;
     bool keyPressed(const KeyPress &key) override;
     void resized() override;
-    void paint(Graphics &g) override;
+    void paintBackground(Graphics &g, const Rectangle<int> &area) override;
 
     
     //===------------------------------------------------------------------===//
@@ -175,6 +176,7 @@ public:
     //===------------------------------------------------------------------===//
     
     void handleAsyncUpdate() override;
+    int64 getBackgroundLayoutHash() const override;
     
     
     //===------------------------------------------------------------------===//
@@ -20,65 +20,11 @@
 #include "ProjectTreeItem.h"
 #include "MidiLayer.h"
 #include "PianoLayer.h"
-#include "PlayerThread.h"
 #include "MidiRoll.h"
-#include "AnnotationEvent.h"
-
-class TrackMapNoteComponent : public Component
-{
-public:
-
-    TrackMapNoteComponent(PianoTrackMap &parent, const Note &event) :
-        note(event),
-        map(parent),
-        dx(0.f),
-        dw(0.f)
-    {
-        this->setOpaque(false);
-        this->setInterceptsMouseClicks(false, false);
-        this->setWantsKeyboardFocus(false);
-        this->setPaintingIsUnclipped(true);
-    }
-
-    inline int getKey() const noexcept           { return this->note.getKey(); }
-    inline float getBeat() const noexcept        { return this->note.getBeat(); }
-    inline float getLength() const noexcept      { return this->note.getLength(); }
-    inline float getVelocity() const noexcept    { return this->note.getVelocity(); }
-
-    void setRealBounds(float x, int y, float w, int h)
-    {
-#if HELIO_DESKTOP
-        this->dx = x - float(int(x));
-        this->dw = w - float(int(w));
-#endif
-        this->setBounds(int(x), y, int(w), h);
-    }
-    
-    void paint(Graphics &g) override
-    {
-        g.setColour(this->note.getLayer()->getColour().
-                    interpolatedWith(Colours::white, .35f).
-                    withAlpha(this->note.getVelocity() * .3f + .4f));
-
-#if HELIO_DESKTOP
-        g.drawHorizontalLine(0, this->dx, float(this->getWidth()) + this->dw + this->dx);
-#elif HELIO_MOBILE
-        g.drawHorizontalLine(0, 0, float(this->getWidth()));
-#endif
-    }
-
-private:
-
-    const Note &note;
-
-    PianoTrackMap &map;
-    
-    float dx;
-    
-    float dw;
-
-};
+#include <float.h>
 
+// Stretched maps may get really wide, the image is scaled beyond that
+#define PIANO_TRACK_MAP_MAX_IMAGE_WIDTH 8192
 
 PianoTrackMap::PianoTrackMap(ProjectTreeItem &parentProject, MidiRoll &parentRoll) :
     project(parentProject),
@@ -87,7 +33,9 @@ PianoTrackMap::PianoTrackMap(ProjectTreeItem &parentProject, MidiRoll &parentRol
     projectLastBeat(0.f),
     rollFirstBeat(0.f),
     rollLastBeat(0.f),
-    componentHeight(1.f)
+    fullRenderPending(false),
+    dirtyStartBeat(FLT_MAX),
+    dirtyEndBeat(-FLT_MAX)
 {
     this->setOpaque(false);
     this->setInterceptsMouseClicks(false, false);
@@ -107,18 +55,42 @@ PianoTrackMap::~PianoTrackMap()
 
 void PianoTrackMap::resized()
 {
-    this->rollFirstBeat = this->roll.getFirstBeat();
-    this->rollLastBeat = this->roll.getLastBeat();
-    this->componentHeight = float(this->getHeight()) / 128.f;
-    
-    this->setVisible(false);
-
-    for (int i = 0; i < this->eventComponents.size(); ++i)
+    const float newFirstBeat = this->roll.getFirstBeat();
+    const float newLastBeat = this->roll.getLastBeat();
+    const int imageWidth = jmin(this->getWidth(), PIANO_TRACK_MAP_MAX_IMAGE_WIDTH);
+    const int imageHeight = this->getHeight();
+
+    // Scrolling only moves this component, so nothing needs to be re-rendered
+    const bool geometryChanged =
+        this->trackImage.getWidth() != imageWidth ||
+        this->trackImage.getHeight() != imageHeight ||
+        this->rollFirstBeat != newFirstBeat ||
+        this->rollLastBeat != newLastBeat;
+
+    if (geometryChanged)
     {
-        this->applyNoteBounds(this->eventComponents.getUnchecked(i));
+        this->rollFirstBeat = newFirstBeat;
+        this->rollLastBeat = newLastBeat;
+        this->reloadTrackMap();
     }
+}
+
+void PianoTrackMap::paint(Graphics &g)
+{
+    if (this->trackImage.isNull())
+    { return; }
 
-    this->setVisible(true);
+    if (this->trackImage.getWidth() == this->getWidth())
+    {
+        g.drawImageAt(this->trackImage, 0, 0);
+    }
+    else
+    {
+        g.setImageResamplingQuality(Graphics::lowResamplingQuality);
+        g.drawImage(this->trackImage,
+                    0, 0, this->getWidth(), this->getHeight(),
+                    0, 0, this->trackImage.getWidth(), this->trackImage.getHeight());
+    }
 }
 
 
@@ -133,15 +105,8 @@ void PianoTrackMap::onEventChanged(const MidiEvent &oldEvent, const MidiEvent &n
     const Note &note = static_cast<const Note &>(oldEvent);
     const Note &newNote = static_cast<const Note &>(newEvent);
 
-    if (TrackMapNoteComponent *component = this->componentsHashTable[note])
-    {
-        //component->setVisible(false);
-        this->applyNoteBounds(component);
-        //component->repaint(); // for volume changes
-        //component->setVisible(true);
-
-        this->componentsHashTable.set(newNote, component);
-    }
+    this->invalidateNote(note);
+    this->invalidateNote(newNote);
 }
 
 void PianoTrackMap::onEventAdded(const MidiEvent &event)
@@ -149,30 +114,53 @@ void PianoTrackMap::onEventAdded(const MidiEvent &event)
     if (!dynamic_cast<const Note *>(&event)) { return; }
 
     const Note &note = static_cast<const Note &>(event);
-
-    auto component = new TrackMapNoteComponent(*this, note);
-    this->addAndMakeVisible(component);
-    this->applyNoteBounds(component);
-    component->toFront(false);
-
-    //this->eventAnimator.fadeIn(component, 150);
-    this->eventComponents.add(component);
-
-    this->componentsHashTable.set(note, component);
+    this->invalidateNote(note);
 }
 
 void PianoTrackMap::onEventRemoved(const MidiEvent &event)
 {
     if (!dynamic_cast<const Note *>(&event)) { return; }
 
+    // The note is still there at this moment,
+    // but the columns will be redrawn later, after it is removed
     const Note &note = static_cast<const Note &>(event);
+    this->invalidateNote(note);
+}
+
+void PianoTrackMap::onEventsChanged(const MidiEventsChangeSet &changes)
+{
+    if (!dynamic_cast<const PianoLayer *>(changes.getLayer())) { return; }
+
+    // invalidate the whole affected span at once instead of note by note
+    float startBeat = FLT_MAX;
+    float endBeat = -FLT_MAX;
+
+    auto includeNote = [&startBeat, &endBeat](const MidiEvent &event)
+    {
+        const Note &note = static_cast<const Note &>(event);
+        startBeat = jmin(startBeat, note.getBeat());
+        endBeat = jmax(endBeat, note.getBeat() + note.getLength());
+    };
+
+    for (int i = 0; i < changes.getNumRemovedEvents(); ++i)
+    {
+        includeNote(changes.getRemovedEvent(i));
+    }
+
+    for (int i = 0; i < changes.getNumChangedEvents(); ++i)
+    {
+        includeNote(changes.getChangedEventBefore(i));
+        includeNote(changes.getChangedEventAfter(i));
+    }
+
+    for (int i = 0; i < changes.getNumAddedEvents(); ++i)
+    {
+        includeNote(changes.getAddedEvent(i));
+    }
 
-    if (TrackMapNoteComponent *component = this->componentsHashTable[note])
+    if (startBeat <= endBeat)
     {
-        //this->eventAnimator.fadeOut(component, 150);
-        this->removeChildComponent(component);
-        this->componentsHashTable.remove(note);
-        this->eventComponents.removeObject(component, true);
+        this->invalidateBeatRange(startBeat, endBeat);
     }
 }
 
@@ -180,7 +168,8 @@ void PianoTrackMap::onLayerChanged(const MidiLayer *layer)
 {
     if (!dynamic_cast<const PianoLayer *>(layer)) { return; }
 
-    this->reloadTrackMap();
+    this->fullRenderPending = true;
+    this->triggerAsyncUpdate();
 }
 
 void PianoTrackMap::onLayerAdded(const MidiLayer *layer)
@@ -189,7 +178,8 @@ void PianoTrackMap::onLayerAdded(const MidiLayer *layer)
 
     if (layer->size() > 0)
     {
-        this->reloadTrackMap();
+        this->fullRenderPending = true;
+        this->triggerAsyncUpdate();
     }
 }
 
@@ -197,16 +187,10 @@ void PianoTrackMap::onLayerRemoved(const MidiLayer *layer)
 {
     if (!dynamic_cast<const PianoLayer *>(layer)) { return; }
 
-    for (int i = 0; i < layer->size(); ++i)
+    if (layer->size() > 0)
     {
-        const Note &note = static_cast<const Note &>(*layer->getUnchecked(i));
-
-        if (TrackMapNoteComponent *component = this->componentsHashTable[note])
-        {
-            this->removeChildComponent(component);
-            this->componentsHashTable.remove(note);
-            this->eventComponents.removeObject(component, true);
-        }
+        this->fullRenderPending = true;
+        this->triggerAsyncUpdate();
     }
 }
 
@@ -217,58 +201,145 @@ void PianoTrackMap::onProjectBeatRangeChanged(float firstBeat, float lastBeat)
 }
 
 
+//===----------------------------------------------------------------------===//
+// AsyncUpdater
+//===----------------------------------------------------------------------===//
+
+void PianoTrackMap::handleAsyncUpdate()
+{
+    if (this->fullRenderPending)
+    {
+        this->reloadTrackMap();
+        return;
+    }
+
+    if (this->dirtyStartBeat > this->dirtyEndBeat || this->trackImage.isNull())
+    { return; }
+
+    const int imageWidth = this->trackImage.getWidth();
+    const int startX = jmax(0, int(floorf(this->getImageXForBeat(this->dirtyStartBeat))));
+    const int endX = jmin(imageWidth, int(ceilf(this->getImageXForBeat(this->dirtyEndBeat))) + 1);
+
+    this->dirtyStartBeat = FLT_MAX;
+    this->dirtyEndBeat = -FLT_MAX;
+
+    if (startX < endX)
+    {
+        this->renderColumns(startX, endX);
+
+        const float scale = float(this->getWidth()) / float(imageWidth);
+        const int repaintX = int(floorf(startX * scale));
+        const int repaintWidth = int(ceilf((endX - startX) * scale)) + 1;
+        this->repaint(repaintX, 0, repaintWidth, this->getHeight());
+    }
+}
+
+
 //===----------------------------------------------------------------------===//
 // Private
 //===----------------------------------------------------------------------===//
 
 void PianoTrackMap::reloadTrackMap()
 {
-    for (int i = 0; i < this->eventComponents.size(); ++i)
+    this->fullRenderPending = false;
+    this->dirtyStartBeat = FLT_MAX;
+    this->dirtyEndBeat = -FLT_MAX;
+
+    const int imageWidth = jmin(this->getWidth(), PIANO_TRACK_MAP_MAX_IMAGE_WIDTH);
+    const int imageHeight = this->getHeight();
+
+    if (imageWidth <= 0 || imageHeight <= 0)
     {
-        this->removeChildComponent(this->eventComponents.getUnchecked(i));
+        this->trackImage = Image();
+        return;
     }
 
-    this->eventComponents.clear();
-    this->componentsHashTable.clear();
+    if (this->trackImage.getWidth() != imageWidth ||
+        this->trackImage.getHeight() != imageHeight)
+    {
+        this->trackImage = Image(Image::ARGB, imageWidth, imageHeight, true);
+    }
 
-    const Array<MidiLayer *> &layers = this->project.getLayersList();
+    this->renderColumns(0, imageWidth);
+    this->repaint();
+}
 
-    this->setVisible(false);
+void PianoTrackMap::invalidateBeatRange(float startBeat, float endBeat)
+{
+    this->dirtyStartBeat = jmin(this->dirtyStartBeat, startBeat);
+    this->dirtyEndBeat = jmax(this->dirtyEndBeat, endBeat);
+    this->triggerAsyncUpdate();
+}
+
+void PianoTrackMap::invalidateNote(const Note &note)
+{
+    this->invalidateBeatRange(note.getBeat(), note.getBeat() + note.getLength());
+}
+
+void PianoTrackMap::renderColumns(int startX, int endX)
+{
+    const int imageWidth = this->trackImage.getWidth();
+    const int imageHeight = this->trackImage.getHeight();
+
+    if (this->trackImage.isNull() || startX >= endX)
+    { return; }
+
+    const Rectangle<int> area(startX, 0, endX - startX, imageHeight);
+    this->trackImage.clear(area);
+
+    Graphics g(this->trackImage);
+    g.reduceClipRegion(area);
+
+    const float startBeat = this->getBeatForImageX(float(startX));
+    const float endBeat = this->getBeatForImageX(float(endX));
+    const float keyHeight = float(imageHeight) / 128.f;
+    const float rollLengthInBeats = (this->rollLastBeat - this->rollFirstBeat);
+    const float beatWidth = (rollLengthInBeats > 0.f) ? (float(imageWidth) / rollLengthInBeats) : 0.f;
+
+    const Array<MidiLayer *> &layers = this->project.getLayersList();
+    Array<const Note *> visibleNotes;
 
     for (auto layer : layers)
     {
-        for (int j = 0; j < layer->size(); ++j)
-        {
-            MidiEvent *event = layer->getUnchecked(j);
+        const PianoLayer *pianoLayer = dynamic_cast<const PianoLayer *>(layer);
+        if (pianoLayer == nullptr) { continue; }
 
-            if (Note *note = dynamic_cast<Note *>(event))
-            {
-                auto noteComponent = new TrackMapNoteComponent(*this, *note);
+        const Colour layerColour(layer->getColour().interpolatedWith(Colours::white, .35f));
 
-                this->eventComponents.add(noteComponent);
-                this->componentsHashTable.set(*note, noteComponent);
+        // Only the notes overlapping the dirty columns, found in the layer's interval tree
+        visibleNotes.clearQuick();
+        pianoLayer->findNotesWithin(startBeat, endBeat, visibleNotes);
 
-                //const bool &belongsToActiveLayer = noteComponent->belongsToLayer(this->activeLayer);
-                //noteComponent->setActive(belongsToActiveLayer);
-                this->addAndMakeVisible(noteComponent);
-            }
+        for (int j = 0; j < visibleNotes.size(); ++j)
+        {
+            const Note *note = visibleNotes.getUnchecked(j);
+            const float x = this->getImageXForBeat(note->getBeat());
+            const float w = jmax(1.f, note->getLength() * beatWidth);
+            const int y = int(imageHeight - note->getKey() * keyHeight);
+
+            g.setColour(layerColour.withAlpha(note->getVelocity() * .3f + .4f));
+            g.drawHorizontalLine(y, x, x + w);
         }
     }
-
-    this->resized();
-    this->setVisible(true);
 }
 
-void PianoTrackMap::applyNoteBounds(TrackMapNoteComponent *nc)
+float PianoTrackMap::getImageXForBeat(float beat) const noexcept
 {
     const float rollLengthInBeats = (this->rollLastBeat - this->rollFirstBeat);
-    const float projectLengthInBeats = (this->projectLastBeat - this->projectFirstBeat);
 
-    const float beat = (nc->getBeat() - this->rollFirstBeat);
-    const float mapWidth = float(this->getWidth()) * (projectLengthInBeats / rollLengthInBeats);
+    if (rollLengthInBeats <= 0.f)
+    { return 0.f; }
 
-    const float x = (mapWidth * (beat / projectLengthInBeats));
-    const float w = (mapWidth * (nc->getLength() / projectLengthInBeats));
-    const int y = this->getHeight() - (nc->getKey() * this->componentHeight);
-    nc->setRealBounds(x, y, jmax(1.f, w), 1.f);
+    return float(this->trackImage.getWidth()) * ((beat - this->rollFirstBeat) / rollLengthInBeats);
+}
+
+float PianoTrackMap::getBeatForImageX(float x) const noexcept
+{
+    const int imageWidth = this->trackImage.getWidth();
+
+    if (imageWidth <= 0)
+    { return this->rollFirstBeat; }
+
+    const float rollLengthInBeats = (this->rollLastBeat - this->rollFirstBeat);
+    return this->rollFirstBeat + rollLengthInBeats * (x / float(imageWidth));
 }
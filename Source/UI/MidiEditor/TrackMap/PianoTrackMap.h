@@ -22,11 +22,16 @@
 
 class MidiRoll;
 class ProjectTreeItem;
-class TrackMapNoteComponent;
+
+// Renders all notes into an offscreen image, which is only blitted on paint.
+// Edits mark the affected beat range as dirty, and only the corresponding
+// columns of the image get redrawn, once per message loop cycle.
+// The image itself is re-rendered from scratch only on resize or reload.
 
 class PianoTrackMap :
     public Component,
-    public ProjectListener
+    public ProjectListener,
+    private AsyncUpdater
 {
 public:
 
@@ -38,6 +43,7 @@ public:
     //===------------------------------------------------------------------===//
 
     void resized() override;
+    void paint(Graphics &g) override;
 
     //===------------------------------------------------------------------===//
     // ProjectListener
@@ -46,6 +52,7 @@ public:
     void onEventChanged(const MidiEvent &oldEvent, const MidiEvent &newEvent) override;
     void onEventAdded(const MidiEvent &event) override;
     void onEventRemoved(const MidiEvent &event) override;
+    void onEventsChanged(const MidiEventsChangeSet &changes) override;
     void onLayerChanged(const MidiLayer *layer) override;
     void onLayerAdded(const MidiLayer *layer) override;
     void onLayerRemoved(const MidiLayer *layer) override;
@@ -53,8 +60,15 @@ public:
 
 private:
 
-    void applyNoteBounds(TrackMapNoteComponent *nc);
+    void handleAsyncUpdate() override;
+
     void reloadTrackMap();
+    void invalidateBeatRange(float startBeat, float endBeat);
+    void invalidateNote(const Note &note);
+    void renderColumns(int startX, int endX);
+
+    float getImageXForBeat(float beat) const noexcept;
+    float getBeatForImageX(float x) const noexcept;
 
     float projectFirstBeat;
     float projectLastBeat;
@@ -62,12 +76,13 @@ private:
     float rollFirstBeat;
     float rollLastBeat;
     
-    float componentHeight;
-    
     MidiRoll &roll;
     ProjectTreeItem &project;
-    
-    OwnedArray<TrackMapNoteComponent> eventComponents;
-    HashMap<Note, TrackMapNoteComponent *, NoteHashFunction> componentsHashTable;
+
+    Image trackImage;
+
+    bool fullRenderPending;
+    float dirtyStartBeat;
+    float dirtyEndBeat;
     
 };
@@ -0,0 +1,100 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "MemoryReportComponent.h"
+#include "MemoryAccounting.h"
+#include "FileUtils.h"
+
+MemoryReportComponent::MemoryReportComponent()
+{
+    this->addAndMakeVisible(this->reportText = new TextEditor(String()));
+    this->reportText->setMultiLine(true);
+    this->reportText->setReadOnly(true);
+    this->reportText->setScrollbarsShown(false);
+    this->reportText->setCaretVisible(false);
+    this->reportText->setPopupMenuEnabled(false);
+    this->reportText->setWantsKeyboardFocus(false);
+    this->reportText->setFont(Font(Font::getDefaultMonospacedFontName(), 14.f, Font::plain));
+    this->reportText->setColour(TextEditor::textColourId, Colours::white);
+    this->reportText->setColour(TextEditor::backgroundColourId, Colour(0xa9000000));
+
+    this->addAndMakeVisible(this->dumpButton = new TextButton(String()));
+    this->dumpButton->setButtonText("Dump to JSON");
+    this->dumpButton->addListener(this);
+
+    this->setSize(600, 160);
+    this->syncWithCounters();
+}
+
+MemoryReportComponent::~MemoryReportComponent()
+{
+    this->stopTimer();
+    this->dumpButton = nullptr;
+    this->reportText = nullptr;
+}
+
+void MemoryReportComponent::resized()
+{
+    this->reportText->setBounds(0, 0, this->getWidth(), this->getHeight() - 40);
+    this->dumpButton->setBounds(this->getWidth() - 160, this->getHeight() - 32, 160, 32);
+}
+
+void MemoryReportComponent::visibilityChanged()
+{
+    if (this->isVisible())
+    {
+        this->syncWithCounters();
+        this->startTimer(MEMORY_REPORT_UPDATE_INTERVAL_MS);
+    }
+    else
+    {
+        this->stopTimer();
+    }
+}
+
+void MemoryReportComponent::timerCallback()
+{
+    this->syncWithCounters();
+}
+
+void MemoryReportComponent::buttonClicked(Button *button)
+{
+    if (button == this->dumpButton)
+    {
+        const File reportFile(FileUtils::getTempSlot("memory-report.json"));
+
+        if (MemoryAccounting::dumpToJson(reportFile))
+        {
+            Logger::writeToLog("Memory report saved to " + reportFile.getFullPathName());
+        }
+        else
+        {
+            Logger::writeToLog("Failed to save memory report to " + reportFile.getFullPathName());
+        }
+    }
+}
+
+void MemoryReportComponent::syncWithCounters()
+{
+    const String report(MemoryAccounting::createReport());
+
+    if (report != this->reportText->getText())
+    {
+        this->reportText->setText(report, false);
+    }
+}
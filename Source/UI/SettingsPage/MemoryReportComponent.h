@@ -0,0 +1,49 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#define MEMORY_REPORT_UPDATE_INTERVAL_MS 1000
+
+// A debug settings section showing MemoryAccounting counters,
+// refreshed once a second while visible, with a button to dump them to a json file
+
+class MemoryReportComponent : public Component,
+                              private Timer,
+                              private Button::Listener
+{
+public:
+
+    MemoryReportComponent();
+
+    ~MemoryReportComponent() override;
+
+    void resized() override;
+    void visibilityChanged() override;
+
+private:
+
+    void timerCallback() override;
+    void buttonClicked(Button *button) override;
+
+    void syncWithCounters();
+
+    ScopedPointer<TextEditor> reportText;
+    ScopedPointer<TextButton> dumpButton;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MemoryReportComponent)
+};
@@ -1000,6 +1000,8 @@ void HelioTheme::updateBackgroundRenders(bool force)
         this->getRollBgCache().clear();
     }
     
+    Icons::prerenderCommonSizes(*this);
+    
 #if PIANOROLL_HAS_PRERENDERED_BACKGROUND
     PianoRoll::repaintBackgroundsCache(*this);
 #endif
@@ -20,6 +20,7 @@
 #include "BinaryData.h"
 #include "App.h"
 #include "HelioTheme.h"
+#include "MemoryAccounting.h"
 
 const String Icons::empty = "empty";
 const String Icons::menu = "menu";
@@ -115,10 +116,14 @@ struct BuiltInImageData
 
 
 static HashMap<String, BuiltInImageData> builtInImages;
+static HashMap<String, int> iconIds;
+static StringArray iconNames;
 
 void Icons::clearBuiltInImages()
 {
     builtInImages.clear();
+    iconIds.clear();
+    iconNames.clear();
 }
 
 void Icons::setupBuiltInImages()
@@ -230,6 +235,18 @@ void Icons::setupBuiltInImages()
     
     builtInImages.set(Icons::toggleOn, BuiltInImageData(BinaryData::toggleon_svg, BinaryData::toggleon_svgSize));
     builtInImages.set(Icons::toggleOff, BuiltInImageData(BinaryData::toggleoff_svg, BinaryData::toggleoff_svgSize));
+    
+    // integer ids are used as the prerendered cache keys instead of names,
+    // zero is left for the unknown names
+    iconNames.clearQuick();
+    iconNames.add(String::empty);
+    iconIds.clear();
+    
+    for (HashMap<String, BuiltInImageData>::Iterator i(builtInImages); i.next();)
+    {
+        iconIds.set(i.getKey(), iconNames.size());
+        iconNames.add(i.getKey());
+    }
 }
 
 static const Path extractPathFromDrawable(const Drawable *d)
@@ -322,53 +339,253 @@ Path Icons::getPathByName(const String &name)
     return Path(extractPathFromDrawable(drawableSVG));
 }
 
-static HashMap<String, Image> prerenderedVectors;
+//===----------------------------------------------------------------------===//
+// Prerendered cache
+//===----------------------------------------------------------------------===//
 
-void Icons::clearPrerenderedCache()
+// The icons of the commonly used sizes are prerendered on a background thread
+// at startup and after the theme changes, and are packed into atlas pages;
+// the cached images are clipped from those pages, which are never changed
+// once published, so that drawImageRetinaAware can draw straight from a page,
+// and the OpenGL renderer only has to upload a texture per page, not per icon.
+// Any other sizes are still rendered on demand and cached as separate images.
+
+#define ICONS_ATLAS_PAGE_SIZE 512
+#define ICONS_ATLAS_PADDING 2
+
+static const int kRoundFactor = 8;
+static const int kPrerenderedSizes[] = { 16, 24, 32 };
+
+struct IconsAtlasSlot
 {
-    prerenderedVectors.clear();
+    Image page;
+    Rectangle<int> area;
+};
+
+static CriticalSection prerenderedVectorsLock;
+static HashMap<int64, Image> prerenderedVectors;
+static HashMap<int64, IconsAtlasSlot> atlasSlots;
+
+// pixel data held by the cache, as reported to MemoryAccounting;
+// guarded by prerenderedVectorsLock, like the cache itself
+static int64 cachedImagesSize = 0;
+
+static void addCachedImageSize(const Image &image) noexcept
+{
+    const int64 numBytes = int64(image.getWidth()) * image.getHeight() * 4;
+    cachedImagesSize += numBytes;
+    MemoryAccounting::add(MemoryAccounting::caches, numBytes);
 }
 
-const int kRoundFactor = 8;
+static int64 getIconKey(int iconId, int size, const Colour &colour) noexcept
+{
+    return (int64(iconId & 0xffff) << 48) | (int64(size & 0xffff) << 32) | int64(colour.getARGB());
+}
 
-Image Icons::findByName(const String &name, int maxSize)
+static int64 getImageKey(const Image &image) noexcept
 {
-    const Desktop::Displays::Display &dis = Desktop::getInstance().getDisplays().getMainDisplay();
+    return int64(pointer_sized_int(image.getPixelData()));
+}
 
+static int getRetinaFactor()
+{
 #if JUCE_ANDROID
-    const int retinaFactor = 2;
+    return 2;
 #else
-    const int retinaFactor = int(dis.scale);
+    return int(Desktop::getInstance().getDisplays().getMainDisplay().scale);
 #endif
+}
+
+static int getFixedSize(int maxSize, int retinaFactor) noexcept
+{
+    return int(floorf(float(maxSize) / float(kRoundFactor))) * kRoundFactor * retinaFactor;
+}
+
+class IconsPrerenderer : public Thread
+{
+public:
+
+    IconsPrerenderer(const Colour &baseColour, const Colour &shadeColour, int retinaFactor) :
+        Thread("IconsPrerenderer"),
+        iconBaseColour(baseColour),
+        iconShadeColour(shadeColour),
+        retina(retinaFactor) {}
+
+    void run() override
+    {
+        // a simple shelf packer: icons are placed row by row,
+        // and a page is published when there's no more room in it
+        const int pageSize = ICONS_ATLAS_PAGE_SIZE * this->retina;
+        int x = 0, y = 0, shelfHeight = 0;
+
+        for (auto size : kPrerenderedSizes)
+        {
+            const int fixedSize = getFixedSize(size, this->retina);
 
-    const int fixedSize = int(floorf(float(maxSize) / float(kRoundFactor))) * kRoundFactor * retinaFactor;
-    const String nameKey = name + "@" + String(fixedSize);
+            for (int iconId = 1; iconId < iconNames.size(); ++iconId)
+            {
+                if (this->threadShouldExit())
+                {
+                    return;
+                }
+
+                const int64 key = getIconKey(iconId, fixedSize, this->iconBaseColour);
+
+                {
+                    const ScopedLock lock(prerenderedVectorsLock);
+
+                    if (prerenderedVectors.contains(key))
+                    { continue; }
+                }
+
+                if (x + fixedSize > pageSize)
+                {
+                    x = 0;
+                    y += shelfHeight + ICONS_ATLAS_PADDING;
+                    shelfHeight = 0;
+                }
+
+                if (y + fixedSize > pageSize)
+                {
+                    this->publishPage();
+                    x = 0;
+                    y = 0;
+                    shelfHeight = 0;
+                }
+
+                if (! this->page.isValid())
+                {
+                    this->page = Image(Image::ARGB, pageSize, pageSize, true);
+                }
+
+                const Image icon(renderVector(iconNames[iconId], fixedSize,
+                                              this->iconBaseColour, this->iconShadeColour));
+
+                {
+                    Graphics g(this->page);
+                    g.drawImageAt(icon, x, y);
+                }
+
+                this->keys.add(key);
+                this->areas.add(Rectangle<int>(x, y, fixedSize, fixedSize));
+
+                x += fixedSize + ICONS_ATLAS_PADDING;
+                shelfHeight = jmax(shelfHeight, fixedSize);
+            }
+        }
+
+        this->publishPage();
+    }
+
+private:
+
+    void publishPage()
+    {
+        if (this->keys.size() > 0)
+        {
+            const ScopedLock lock(prerenderedVectorsLock);
+            bool pageIsUsed = false;
+
+            for (int i = 0; i < this->keys.size(); ++i)
+            {
+                if (prerenderedVectors.contains(this->keys[i]))
+                { continue; }
+
+                pageIsUsed = true;
+
+                IconsAtlasSlot slot;
+                slot.page = this->page;
+                slot.area = this->areas[i];
+
+                const Image icon(this->page.getClippedImage(slot.area));
+                prerenderedVectors.set(this->keys[i], icon);
+                atlasSlots.set(getImageKey(icon), slot);
+            }
+
+            if (pageIsUsed)
+            {
+                addCachedImageSize(this->page);
+            }
+        }
+
+        this->keys.clearQuick();
+        this->areas.clearQuick();
+        this->page = Image();
+    }
+
+    const Colour iconBaseColour;
+    const Colour iconShadeColour;
+    const int retina;
+
+    Image page;
+    Array<int64> keys;
+    Array<Rectangle<int>> areas;
+
+};
+
+static ScopedPointer<IconsPrerenderer> prerenderer;
+
+void Icons::clearPrerenderedCache()
+{
+    if (prerenderer != nullptr)
+    {
+        prerenderer->stopThread(1000);
+        prerenderer = nullptr;
+    }
     
-    if (prerenderedVectors.contains(nameKey))
+    const ScopedLock lock(prerenderedVectorsLock);
+    prerenderedVectors.clear();
+    atlasSlots.clear();
+
+    MemoryAccounting::remove(MemoryAccounting::caches, cachedImagesSize);
+    cachedImagesSize = 0;
+}
+
+void Icons::prerenderCommonSizes(LookAndFeel &lf)
+{
+    if (prerenderer != nullptr)
     {
-        return prerenderedVectors[nameKey];
+        prerenderer->stopThread(1000);
     }
     
+    const Colour iconBaseColour(lf.findColour(Icons::iconColourId));
+    const Colour iconShadeColour(lf.findColour(Icons::iconShadowColourId));
+    prerenderer = new IconsPrerenderer(iconBaseColour, iconShadeColour, getRetinaFactor());
+    prerenderer->startThread(3);
+}
+
+Image Icons::findByName(const String &name, int maxSize)
+{
+    const int fixedSize = getFixedSize(maxSize, getRetinaFactor());
     const Colour iconBaseColour(App::Helio()->getTheme()->findColour(Icons::iconColourId));
+    const int64 key = getIconKey(iconIds[name], fixedSize, iconBaseColour);
+    
+    {
+        const ScopedLock lock(prerenderedVectorsLock);
+        
+        if (prerenderedVectors.contains(key))
+        {
+            return prerenderedVectors[key];
+        }
+    }
+    
     const Colour iconShadeColour(App::Helio()->getTheme()->findColour(Icons::iconShadowColourId));
     Image prerenderedImage = renderVector(name, fixedSize, iconBaseColour, iconShadeColour);
-    prerenderedVectors.set(nameKey, prerenderedImage);
-
+    
+    const ScopedLock lock(prerenderedVectorsLock);
+    
+    if (! prerenderedVectors.contains(key))
+    {
+        addCachedImageSize(prerenderedImage);
+    }
+    
+    prerenderedVectors.set(key, prerenderedImage);
     return prerenderedImage;
 }
 
 Image Icons::findByName(const String &name, int maxSize, LookAndFeel &lf)
 {
-    const Desktop::Displays::Display &dis = Desktop::getInstance().getDisplays().getMainDisplay();
-
-#if JUCE_ANDROID
-    const int retinaFactor = 2;
-#else
-    const int retinaFactor = int(dis.scale);
-#endif
-
-    const int fixedSize = int(floorf(float(maxSize) / float(kRoundFactor))) * kRoundFactor * retinaFactor;
-
+    const int fixedSize = getFixedSize(maxSize, getRetinaFactor());
     const Colour iconBaseColour(lf.findColour(Icons::iconColourId));
     const Colour iconShadeColour(lf.findColour(Icons::iconShadowColourId));
     Image prerenderedImage = renderVector(name, fixedSize, iconBaseColour, iconShadeColour);
@@ -389,7 +606,30 @@ void Icons::drawImageRetinaAware(const Image &image, Graphics &g, int cx, int cy
     const int w = image.getWidth();
     const int h = image.getHeight();
 
-    if (scale > 1)
+    IconsAtlasSlot slot;
+
+    {
+        const ScopedLock lock(prerenderedVectorsLock);
+        slot = atlasSlots[getImageKey(image)];
+    }
+
+    if (slot.page.isValid())
+    {
+        // draw from the whole atlas page clipped to the icon's bounds,
+        // so that the renderer can reuse the page's texture
+        const int w2 = w / jmax(1, scale);
+        const int h2 = h / jmax(1, scale);
+        const Rectangle<int> target(cx - int(w2 / 2), cy - int(h2 / 2), w2, h2);
+
+        Graphics::ScopedSaveState state(g);
+        g.reduceClipRegion(target);
+        g.drawImageTransformed(slot.page,
+                               AffineTransform::translation(float(-slot.area.getX()), float(-slot.area.getY()))
+                               .scaled(float(w2) / float(w), float(h2) / float(h))
+                               .translated(float(target.getX()), float(target.getY())),
+                               false);
+    }
+    else if (scale > 1)
     {
         //Logger::writeToLog(String(x) + ":" + String(y));
 
@@ -116,6 +116,7 @@ public:
     static void setupBuiltInImages();
     
     static void clearPrerenderedCache();
+    static void prerenderCommonSizes(LookAndFeel &lf);
     
     static Image findByName(const String &name, int maxSize);
     static Image findByName(const String &name, int maxSize, LookAndFeel &lf);